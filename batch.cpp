@@ -0,0 +1,103 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#include "batch.hpp"
+using namespace std;
+using namespace fbjs;
+
+BatchParser::BatchParser(node_parse_enum opts /* = PARSE_NONE */, unsigned int threads /* = 0 */) :
+  _opts(opts), _pool(threads), _parsed(0) {
+  _parsers.resize(_pool.size(), NULL);
+}
+
+BatchParser::~BatchParser() {
+  for (vector<result_t>::iterator ii = _results.begin(); ii != _results.end(); ++ii) {
+    delete ii->program;
+    delete ii->error;
+  }
+  for (vector<Parser*>::iterator ii = _parsers.begin(); ii != _parsers.end(); ++ii) {
+    delete *ii;
+  }
+}
+
+size_t BatchParser::add(const char* data, size_t len) {
+  input_t input;
+  input.data = data;
+  input.len = len;
+  _inputs.push_back(input);
+  return _inputs.size() - 1;
+}
+
+size_t BatchParser::addFile(const char* path) {
+  input_t input;
+  input.data = NULL;
+  input.len = 0;
+  input.path = path;
+  _inputs.push_back(input);
+  return _inputs.size() - 1;
+}
+
+void BatchParser::parse() {
+  result_t empty = {NULL, NULL};
+  _results.resize(_inputs.size(), empty);
+  _pool.run(BatchParser::parseInput, this, _inputs.size() - _parsed);
+  _parsed = _inputs.size();
+}
+
+size_t BatchParser::size() const {
+  return _inputs.size();
+}
+
+const BatchParser::result_t& BatchParser::result(size_t index) const {
+  return _results.at(index);
+}
+
+NodeProgram* BatchParser::releaseProgram(size_t index) {
+  NodeProgram* program = _results.at(index).program;
+  _results[index].program = NULL;
+  return program;
+}
+
+void BatchParser::parseInput(void* context, unsigned int worker, size_t index) {
+  BatchParser* that = static_cast<BatchParser*>(context);
+  index += that->_parsed;
+  const input_t& input = that->_inputs[index];
+  result_t& result = that->_results[index];
+
+  try {
+    // Only this worker touches its parser slot
+    Parser*& parser = that->_parsers[worker];
+    if (parser == NULL) {
+      parser = new Parser();
+    }
+    if (input.data != NULL) {
+      result.program = parser->parse(input.data, input.len, that->_opts);
+    } else {
+      result.program = parser->parseFile(input.path.c_str(), that->_opts);
+    }
+    result.errors = parser->errors();
+  } catch (const ParseException& e) {
+    result.error = new ParseException(e);
+  } catch (const exception& e) {
+    result.failure = e.what();
+  } catch (...) {
+    result.failure = "unknown error";
+  }
+}
@@ -0,0 +1,78 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#pragma once
+#include <string>
+#include <vector>
+#include "node.hpp"
+#include "thread_pool.hpp"
+
+namespace fbjs {
+
+  //
+  // BatchParser: parses many independent programs across a thread pool. Each
+  // worker keeps one Parser for every input it handles. Inputs with a syntax
+  // error carry a ParseException in their result, and inputs that couldn't be
+  // parsed at all, say a missing file or running out of memory, carry what
+  // went wrong in `failure`. The others carry a NodeProgram, and with
+  // PARSE_RECOVER the errors its parse got past in `errors`, as
+  // Parser::errors() would list them.
+  class BatchParser {
+    public:
+      struct result_t {
+        NodeProgram* program;
+        ParseException* error;
+        std::string failure;
+        std::vector<ParseException> errors;
+      };
+
+      BatchParser(node_parse_enum opts = PARSE_NONE, unsigned int threads = 0);
+      ~BatchParser();
+
+      // `data` is not copied and must stay valid until parse() returns
+      size_t add(const char* data, size_t len);
+      size_t addFile(const char* path);
+
+      // Parses every input added since the last call
+      void parse();
+
+      size_t size() const;
+      const result_t& result(size_t index) const;
+      NodeProgram* releaseProgram(size_t index);
+
+    protected:
+      struct input_t {
+        const char* data;
+        size_t len;
+        std::string path;
+      };
+      node_parse_enum _opts;
+      ThreadPool _pool;
+      std::vector<Parser*> _parsers;
+      std::vector<input_t> _inputs;
+      std::vector<result_t> _results;
+      size_t _parsed;
+      static void parseInput(void* context, unsigned int worker, size_t index);
+
+    private:
+      BatchParser(const BatchParser&);
+      BatchParser& operator= (const BatchParser&);
+  };
+}
@@ -0,0 +1,374 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet
+*/
+
+//
+// fbjs_bench: times parsing, walking, cloning, comparing and rendering each
+// input, and prints one JSON object per input and size on stdout.
+//
+//   fbjs_bench [-t seconds] [-s size]... [-a] [-l] file...
+//
+// Each file is run as it is and then repeated end to end up to every -s size
+// (a number with an optional K or M suffix). Files named *.e4x.js are parsed
+// with PARSE_E4X. -a parses into an arena and -l uses the fast lexer. Every
+// operation is repeated until it has run for -t seconds, 0.5 by default.
+//
+// Each input runs in its own process so peak_rss_kb is its own. allocs and
+// alloc_bytes are the malloc calls and bytes asked for per run of an
+// operation.
+#include "node.hpp"
+#include "walker.hpp"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+using namespace std;
+using namespace fbjs;
+
+//
+// Allocation counting. Nodes and the standard library both allocate with
+// malloc, so that's what gets counted. This needs glibc, elsewhere the counts
+// are left out of the results.
+static size_t bench_allocs = 0;
+static size_t bench_alloc_bytes = 0;
+
+#ifdef __GLIBC__
+#define BENCH_COUNT_ALLOCS 1
+extern "C" {
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t count, size_t size);
+  void* __libc_realloc(void* ptr, size_t size);
+
+  void* malloc(size_t size) {
+    ++bench_allocs;
+    bench_alloc_bytes += size;
+    return __libc_malloc(size);
+  }
+
+  void* calloc(size_t count, size_t size) {
+    ++bench_allocs;
+    bench_alloc_bytes += count * size;
+    return __libc_calloc(count, size);
+  }
+
+  void* realloc(void* ptr, size_t size) {
+    ++bench_allocs;
+    bench_alloc_bytes += size;
+    return __libc_realloc(ptr, size);
+  }
+}
+#endif
+
+//
+// Operations
+struct bench_input_t {
+  string name;
+  string code;
+  node_parse_enum opts;
+  NodeProgram* program;
+  NodeProgram* copy;
+  string output;
+};
+
+// run() is timed, cleanup() runs after it untimed. `opts` is passed to run().
+struct bench_op_t {
+  const char* name;
+  void (*run)(bench_input_t& input, int opts);
+  void (*cleanup)(bench_input_t& input);
+  int opts;
+};
+
+static NodeProgram* bench_parsed = NULL;
+static Node* bench_cloned = NULL;
+static volatile bool bench_equal;
+
+static void bench_parse(bench_input_t& input, int opts) {
+  bench_parsed = new NodeProgram(input.code.data(), input.code.size(), input.opts);
+}
+
+static void bench_parse_cleanup(bench_input_t& input) {
+  delete bench_parsed;
+  bench_parsed = NULL;
+}
+
+class NoopWalker: public NodeWalker {
+  public:
+    virtual NodeWalker* clone() const {
+      return new NoopWalker();
+    }
+};
+
+class NoopInPlaceWalker: public InPlaceNodeWalker {
+};
+
+static void bench_walk(bench_input_t& input, int opts) {
+  NoopWalker walker;
+  walker.walk(input.program);
+}
+
+static void bench_walk_in_place(bench_input_t& input, int opts) {
+  NoopInPlaceWalker walker;
+  walker.walk(input.program);
+}
+
+static void bench_clone(bench_input_t& input, int opts) {
+  bench_cloned = input.program->clone();
+}
+
+static void bench_clone_cleanup(bench_input_t& input) {
+  delete bench_cloned;
+  bench_cloned = NULL;
+}
+
+static void bench_compare(bench_input_t& input, int opts) {
+  bench_equal = *input.program == *input.copy;
+}
+
+static void bench_render(bench_input_t& input, int opts) {
+  input.output.clear();
+  RenderSink sink(input.output);
+  input.program->render(sink, opts);
+}
+
+static const bench_op_t bench_ops[] = {
+  {"parse", bench_parse, bench_parse_cleanup, 0},
+  {"walk", bench_walk, NULL, 0},
+  {"walk_in_place", bench_walk_in_place, NULL, 0},
+  {"clone", bench_clone, bench_clone_cleanup, 0},
+  {"compare", bench_compare, NULL, 0},
+  {"render", bench_render, NULL, RENDER_NONE},
+  {"render_pretty", bench_render, NULL, RENDER_PRETTY},
+  {"render_maintain_lineno", bench_render, NULL, RENDER_MAINTAIN_LINENO},
+};
+
+//
+// Measurement
+static double bench_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t bench_count_nodes(const Node* node) {
+  if (node == NULL) {
+    return 0;
+  }
+  size_t count = 1;
+  const node_list_t& children = node->childNodes();
+  for (node_list_t::const_iterator ii = children.begin(); ii != children.end(); ++ii) {
+    count += bench_count_nodes(*ii);
+  }
+  return count;
+}
+
+static string bench_json_string(const string& str) {
+  string out("\"");
+  for (size_t ii = 0; ii < str.size(); ++ii) {
+    unsigned char c = str[ii];
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (c < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out += buf;
+    } else {
+      out += c;
+    }
+  }
+  return out + "\"";
+}
+
+// Runs every operation on `input` and prints the results
+static void bench_run(bench_input_t& input, double min_time) {
+  input.program = new NodeProgram(input.code.data(), input.code.size(), input.opts);
+  input.copy = static_cast<NodeProgram*>(input.program->clone());
+  size_t nodes = bench_count_nodes(input.program);
+  double mb = input.code.size() / (1024.0 * 1024.0);
+
+  printf("{\"input\":%s,\"bytes\":%lu,\"nodes\":%lu,\"ops\":{",
+    bench_json_string(input.name).c_str(), (unsigned long)input.code.size(), (unsigned long)nodes);
+  for (size_t ii = 0; ii < sizeof(bench_ops) / sizeof(bench_ops[0]); ++ii) {
+    const bench_op_t& op = bench_ops[ii];
+    size_t iterations = 0, allocs = 0, alloc_bytes = 0;
+    double elapsed = 0;
+    do {
+      size_t allocs_before = bench_allocs, bytes_before = bench_alloc_bytes;
+      double start = bench_now();
+      op.run(input, op.opts);
+      elapsed += bench_now() - start;
+      allocs += bench_allocs - allocs_before;
+      alloc_bytes += bench_alloc_bytes - bytes_before;
+      if (op.cleanup) {
+        op.cleanup(input);
+      }
+      ++iterations;
+    } while (elapsed < min_time);
+
+    double seconds = elapsed / iterations;
+    printf("%s\"%s\":{\"iterations\":%lu,\"seconds\":%.9f,\"mb_per_s\":%.3f,\"nodes_per_s\":%.0f",
+      ii ? "," : "", op.name, (unsigned long)iterations, seconds, mb / seconds, nodes / seconds);
+#ifdef BENCH_COUNT_ALLOCS
+    printf(",\"allocs\":%lu,\"alloc_bytes\":%lu", (unsigned long)(allocs / iterations),
+      (unsigned long)(alloc_bytes / iterations));
+#endif
+    if (op.run == bench_render) {
+      printf(",\"output_bytes\":%lu", (unsigned long)input.output.size());
+    }
+    printf("}");
+  }
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  printf("},\"peak_rss_kb\":%ld}\n", usage.ru_maxrss);
+  fflush(stdout);
+  delete input.copy;
+  delete input.program;
+}
+
+//
+// Driver
+static bool bench_read(const char* path, string& code) {
+  FILE* file = fopen(path, "rb");
+  if (file == NULL) {
+    return false;
+  }
+  char buf[65536];
+  size_t len;
+  while ((len = fread(buf, 1, sizeof(buf), file)) > 0) {
+    code.append(buf, len);
+  }
+  bool ok = !ferror(file);
+  fclose(file);
+  return ok;
+}
+
+static bool bench_parse_size(const char* str, size_t& size) {
+  char* end;
+  double value = strtod(str, &end);
+  if (end == str || value <= 0) {
+    return false;
+  }
+  if (*end == 'K' || *end == 'k') {
+    value *= 1024;
+    ++end;
+  } else if (*end == 'M' || *end == 'm') {
+    value *= 1024 * 1024;
+    ++end;
+  }
+  size = static_cast<size_t>(value);
+  return *end == '\0';
+}
+
+static bool bench_has_suffix(const string& str, const char* suffix) {
+  size_t len = strlen(suffix);
+  return str.size() >= len && str.compare(str.size() - len, len, suffix) == 0;
+}
+
+static void bench_usage() {
+  fprintf(stderr, "usage: fbjs_bench [-t seconds] [-s size]... [-a] [-l] file...\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  double min_time = 0.5;
+  vector<size_t> sizes;
+  int opts = PARSE_NONE;
+  int ch;
+  while ((ch = getopt(argc, argv, "t:s:al")) != -1) {
+    size_t size;
+    switch (ch) {
+      case 't':
+        min_time = atof(optarg);
+        break;
+      case 's':
+        if (!bench_parse_size(optarg, size)) {
+          bench_usage();
+        }
+        sizes.push_back(size);
+        break;
+      case 'a':
+        opts |= PARSE_ARENA;
+        break;
+      case 'l':
+        opts |= PARSE_FAST_LEXER;
+        break;
+      default:
+        bench_usage();
+    }
+  }
+  if (optind == argc) {
+    bench_usage();
+  }
+
+  int failures = 0;
+  for (int ii = optind; ii < argc; ++ii) {
+    string code;
+    if (!bench_read(argv[ii], code) || code.empty()) {
+      fprintf(stderr, "%s: %s\n", argv[ii], code.empty() ? "empty file" : strerror(errno));
+      ++failures;
+      continue;
+    }
+    if (code[code.size() - 1] != '\n') {
+      code += '\n';
+    }
+
+    vector<size_t> copies(1, 1);
+    for (vector<size_t>::iterator jj = sizes.begin(); jj != sizes.end(); ++jj) {
+      if (*jj > code.size()) {
+        copies.push_back((*jj + code.size() / 2) / code.size());
+      }
+    }
+
+    for (vector<size_t>::iterator jj = copies.begin(); jj != copies.end(); ++jj) {
+      fflush(stdout);
+      pid_t pid = fork();
+      if (pid == 0) {
+        bench_input_t input;
+        input.name = argv[ii];
+        input.opts = static_cast<node_parse_enum>(opts | (bench_has_suffix(input.name, ".e4x.js") ? PARSE_E4X : 0));
+        input.code.reserve(code.size() * *jj);
+        for (size_t kk = 0; kk < *jj; ++kk) {
+          input.code += code;
+        }
+        try {
+          bench_run(input, min_time);
+        } catch (exception& e) {
+          fprintf(stderr, "%s: %s\n", argv[ii], e.what());
+          _exit(1);
+        }
+
+        // Not _exit(), a -fprofile-generate build writes its profile at exit
+        exit(0);
+      }
+      int status;
+      if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status)) {
+        fprintf(stderr, "%s: benchmark failed at %lu bytes\n", argv[ii], (unsigned long)(code.size() * *jj));
+        ++failures;
+      }
+    }
+  }
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,116 @@
+#!/bin/sh
+#
+# Copyright (c) 2008-2009 Facebook
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# See accompanying file LICENSE.txt.
+#
+# @author Marcel Laverdet
+
+#
+# compare.sh: runs two builds of fbjs_bench over the same inputs and prints
+# the MB/s of every operation side by side, then the geometric mean of the
+# speedups for each operation and overall.
+#
+#   bench/compare.sh baseline candidate [fbjs_bench options] file...
+#
+# Everything after the two binaries goes to both of them as is. The two take
+# turns COMPARE_RUNS times, 3 by default, and each keeps its best result, so
+# a busy machine slows down both rather than whichever ran at the time.
+set -e
+if [ $# -lt 3 ]; then
+  echo "usage: compare.sh baseline candidate [fbjs_bench options] file..." >&2
+  exit 2
+fi
+baseline=$1
+candidate=$2
+shift 2
+
+out=${TMPDIR:-/tmp}/fbjs_compare.$$
+trap 'rm -f "$out.baseline" "$out.candidate"' EXIT
+: > "$out.baseline"
+: > "$out.candidate"
+run=0
+while [ $run -lt ${COMPARE_RUNS:-3} ]; do
+  "$baseline" "$@" >> "$out.baseline"
+  "$candidate" "$@" >> "$out.candidate"
+  run=$((run + 1))
+done
+
+awk -v baseline="$baseline" -v candidate="$candidate" '
+  # The value of "name": in one line of fbjs_bench output, quotes and all
+  function field(line, name) {
+    if (!match(line, "\"" name "\":[^,}]*")) {
+      return ""
+    }
+    return substr(line, RSTART + length(name) + 3, RLENGTH - length(name) - 3)
+  }
+
+  {
+    input = field($0, "input") " " field($0, "bytes")
+    gsub(/"/, "", input)
+    rest = $0
+    while (match(rest, /"[a-z_]+":\{"iterations"/)) {
+      op = substr(rest, RSTART + 1, RLENGTH - length("\":{\"iterations\"") - 1)
+      rest = substr(rest, RSTART + RLENGTH)
+      mb_per_s = field(rest, "mb_per_s") + 0
+      if (FILENAME == ARGV[1]) {
+        if (!((input, op) in before) || mb_per_s > before[input, op]) {
+          before[input, op] = mb_per_s
+        }
+      } else if ((input, op) in before) {
+        if (!(input in seen)) {
+          seen[input] = 1
+          inputs[++ninputs] = input
+        }
+        if (!(op in known)) {
+          known[op] = 1
+          ops[++nops] = op
+        }
+        if (!((input, op) in result) || mb_per_s > result[input, op]) {
+          result[input, op] = mb_per_s
+        }
+      }
+    }
+  }
+
+  END {
+    printf "baseline:  %s\ncandidate: %s\n\n", baseline, candidate
+    printf "%-40s %-24s %10s %10s %8s\n", "input bytes", "operation", "MB/s", "MB/s", "speedup"
+    for (ii = 1; ii <= ninputs; ++ii) {
+      for (jj = 1; jj <= nops; ++jj) {
+        if ((inputs[ii], ops[jj]) in result) {
+          b = before[inputs[ii], ops[jj]]
+          a = result[inputs[ii], ops[jj]]
+          printf "%-40s %-24s %10.2f %10.2f %7.3fx\n", inputs[ii], ops[jj], b, a, (b > 0 ? a / b : 0)
+          if (b > 0 && a > 0) {
+            logs[ops[jj]] += log(a / b)
+            nlogs[ops[jj]]++
+            total += log(a / b)
+            ntotal++
+          }
+        }
+      }
+    }
+    printf "\ngeometric mean speedup\n"
+    for (jj = 1; jj <= nops; ++jj) {
+      if (nlogs[ops[jj]]) {
+        printf "  %-24s %7.3fx\n", ops[jj], exp(logs[ops[jj]] / nlogs[ops[jj]])
+      }
+    }
+    if (ntotal) {
+      printf "  %-24s %7.3fx\n", "all", exp(total / ntotal)
+    }
+  }
+' "$out.baseline" "$out.candidate"
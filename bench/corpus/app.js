@@ -0,0 +1,650 @@
+/**
+ * Application code for a news feed page: URI handling, an async request
+ * queue, JSON encoding, date formatting, string templates, a typeahead and
+ * the feed controller that ties them together.
+ */
+var Env = {
+  user: 0,
+  locale: 'en_US',
+  start: +new Date(),
+  debug: false,
+  version: '1.0.3129'
+};
+
+function copyProperties(target, source) {
+  for (var ii = 1; ii < arguments.length; ii++) {
+    var from = arguments[ii];
+    for (var key in from) {
+      if (from.hasOwnProperty(key)) {
+        target[key] = from[key];
+      }
+    }
+  }
+  return target;
+}
+
+function bind(context, fn) {
+  var args = Array.prototype.slice.call(arguments, 2);
+  if (typeof fn == 'string') {
+    fn = context[fn];
+  }
+  return function() {
+    return fn.apply(context, args.concat(Array.prototype.slice.call(arguments)));
+  };
+}
+
+function emptyFunction() {}
+
+var URI = function(uri) {
+  this.protocol = '';
+  this.domain = '';
+  this.port = '';
+  this.path = '';
+  this.query = {};
+  this.fragment = '';
+  if (uri) {
+    this.parse(uri);
+  }
+};
+
+URI.pattern = /^(?:([^:\/?#]+):)?(?:\/\/([^:\/?#]*)(?::(\d+))?)?([^?#]*)(?:\?([^#]*))?(?:#(.*))?/;
+
+URI.explodeQuery = function(query) {
+  var result = {};
+  if (!query) {
+    return result;
+  }
+  var pairs = query.split('&');
+  for (var ii = 0; ii < pairs.length; ii++) {
+    var pair = pairs[ii].split('='), key = decodeURIComponent(pair[0]);
+    if (!key) {
+      continue;
+    }
+    var value = pair.length > 1 ? decodeURIComponent(pair[1].replace(/\+/g, ' ')) : '';
+    if (/\[\]$/.test(key)) {
+      key = key.slice(0, -2);
+      (result[key] || (result[key] = [])).push(value);
+    } else {
+      result[key] = value;
+    }
+  }
+  return result;
+};
+
+URI.implodeQuery = function(obj, prefix) {
+  var parts = [];
+  for (var key in obj) {
+    if (!obj.hasOwnProperty(key)) {
+      continue;
+    }
+    var name = prefix ? prefix + '[' + key + ']' : key, value = obj[key];
+    if (value === null || value === undefined) {
+      continue;
+    } else if (typeof value == 'object') {
+      parts.push(URI.implodeQuery(value, name));
+    } else {
+      parts.push(encodeURIComponent(name) + '=' + encodeURIComponent(value));
+    }
+  }
+  return parts.join('&');
+};
+
+copyProperties(URI.prototype, {
+  parse: function(uri) {
+    var match = URI.pattern.exec(String(uri));
+    if (!match) {
+      throw new Error('URI.parse: could not parse "' + uri + '"');
+    }
+    this.protocol = match[1] || '';
+    this.domain = match[2] || '';
+    this.port = match[3] || '';
+    this.path = match[4] || '';
+    this.query = URI.explodeQuery(match[5]);
+    this.fragment = match[6] || '';
+    return this;
+  },
+
+  addQueryData: function(data) {
+    copyProperties(this.query, data);
+    return this;
+  },
+
+  isSameOrigin: function(other) {
+    var uri = other || new URI(window.location.href);
+    return !this.domain || (this.protocol == uri.protocol && this.domain == uri.domain &&
+      this.port == uri.port);
+  },
+
+  toString: function() {
+    var str = '';
+    if (this.protocol) {
+      str += this.protocol + '://';
+    }
+    str += this.domain;
+    if (this.port) {
+      str += ':' + this.port;
+    }
+    str += this.path || (this.domain ? '/' : '');
+    var query = URI.implodeQuery(this.query);
+    if (query) {
+      str += '?' + query;
+    }
+    if (this.fragment) {
+      str += '#' + this.fragment;
+    }
+    return str;
+  }
+});
+
+var JSONEncoder = {
+  escapes: {
+    '\b': '\\b',
+    '\t': '\\t',
+    '\n': '\\n',
+    '\f': '\\f',
+    '\r': '\\r',
+    '"': '\\"',
+    '\\': '\\\\'
+  },
+
+  quote: function(str) {
+    var escapes = JSONEncoder.escapes;
+    return '"' + str.replace(/[\x00-\x1f"\\\u2028\u2029]/g, function(chr) {
+      return escapes[chr] || '\\u' + ('0000' + chr.charCodeAt(0).toString(16)).slice(-4);
+    }) + '"';
+  },
+
+  encode: function(value, depth) {
+    depth = depth || 0;
+    if (depth > 32) {
+      throw new Error('JSONEncoder: object too deep');
+    }
+    switch (typeof value) {
+      case 'string':
+        return JSONEncoder.quote(value);
+      case 'number':
+        return isFinite(value) ? String(value) : 'null';
+      case 'boolean':
+        return value ? 'true' : 'false';
+      case 'undefined':
+      case 'function':
+        return undefined;
+    }
+    if (value === null) {
+      return 'null';
+    } else if (typeof value.toJSON == 'function') {
+      return JSONEncoder.encode(value.toJSON(), depth + 1);
+    }
+    var parts = [], ii, encoded;
+    if (value instanceof Array) {
+      for (ii = 0; ii < value.length; ii++) {
+        encoded = JSONEncoder.encode(value[ii], depth + 1);
+        parts.push(encoded === undefined ? 'null' : encoded);
+      }
+      return '[' + parts.join(',') + ']';
+    }
+    for (ii in value) {
+      if (value.hasOwnProperty(ii)) {
+        encoded = JSONEncoder.encode(value[ii], depth + 1);
+        if (encoded !== undefined) {
+          parts.push(JSONEncoder.quote(ii) + ':' + encoded);
+        }
+      }
+    }
+    return '{' + parts.join(',') + '}';
+  }
+};
+
+var DateFormat = {
+  months: ['January', 'February', 'March', 'April', 'May', 'June', 'July',
+    'August', 'September', 'October', 'November', 'December'],
+  days: ['Sunday', 'Monday', 'Tuesday', 'Wednesday', 'Thursday', 'Friday', 'Saturday'],
+
+  pad: function(num, width) {
+    var str = String(num);
+    while (str.length < (width || 2)) {
+      str = '0' + str;
+    }
+    return str;
+  },
+
+  format: function(date, pattern) {
+    var self = DateFormat;
+    return pattern.replace(/[a-zA-Z]/g, function(chr) {
+      switch (chr) {
+        case 'Y': return date.getFullYear();
+        case 'y': return self.pad(date.getFullYear() % 100);
+        case 'm': return self.pad(date.getMonth() + 1);
+        case 'n': return date.getMonth() + 1;
+        case 'F': return self.months[date.getMonth()];
+        case 'M': return self.months[date.getMonth()].substr(0, 3);
+        case 'd': return self.pad(date.getDate());
+        case 'j': return date.getDate();
+        case 'l': return self.days[date.getDay()];
+        case 'D': return self.days[date.getDay()].substr(0, 3);
+        case 'H': return self.pad(date.getHours());
+        case 'g': return date.getHours() % 12 || 12;
+        case 'i': return self.pad(date.getMinutes());
+        case 's': return self.pad(date.getSeconds());
+        case 'a': return date.getHours() < 12 ? 'am' : 'pm';
+        default: return chr;
+      }
+    });
+  },
+
+  relative: function(time, now) {
+    var delta = Math.floor(((now || +new Date()) - time) / 1000);
+    if (delta < 0) {
+      return 'in the future';
+    } else if (delta < 60) {
+      return 'a few seconds ago';
+    } else if (delta < 3600) {
+      var minutes = Math.floor(delta / 60);
+      return minutes == 1 ? 'about a minute ago' : minutes + ' minutes ago';
+    } else if (delta < 86400) {
+      var hours = Math.floor(delta / 3600);
+      return hours == 1 ? 'about an hour ago' : hours + ' hours ago';
+    } else if (delta < 172800) {
+      return 'Yesterday at ' + DateFormat.format(new Date(time), 'g:ia');
+    }
+    return DateFormat.format(new Date(time), 'F j \\a\\t g:ia');
+  }
+};
+
+function Template(source) {
+  this.source = source;
+  this.compiled = null;
+}
+
+Template.escapeHTML = function(str) {
+  return String(str).replace(/&/g, '&amp;').replace(/</g, '&lt;').replace(/>/g, '&gt;')
+    .replace(/"/g, '&quot;').replace(/'/g, '&#039;');
+};
+
+Template.prototype.render = function(data) {
+  if (!this.compiled) {
+    var pieces = this.source.split(/\{\{|\}\}/), code = [];
+    for (var ii = 0; ii < pieces.length; ii++) {
+      if (ii % 2) {
+        var raw = pieces[ii].charAt(0) == '&', name = raw ? pieces[ii].substr(1) : pieces[ii];
+        code.push({name: name.replace(/^\s+|\s+$/g, ''), raw: raw});
+      } else if (pieces[ii]) {
+        code.push(pieces[ii]);
+      }
+    }
+    this.compiled = code;
+  }
+  var out = '';
+  for (var jj = 0; jj < this.compiled.length; jj++) {
+    var piece = this.compiled[jj];
+    if (typeof piece == 'string') {
+      out += piece;
+      continue;
+    }
+    var value = data, path = piece.name.split('.');
+    for (var kk = 0; kk < path.length && value != null; kk++) {
+      value = value[path[kk]];
+    }
+    if (value != null) {
+      out += piece.raw ? value : Template.escapeHTML(value);
+    }
+  }
+  return out;
+};
+
+function AsyncRequest(uri) {
+  this.uri = new URI(uri);
+  this.data = {};
+  this.method = 'POST';
+  this.handler = emptyFunction;
+  this.errorHandler = emptyFunction;
+  this.finallyHandler = emptyFunction;
+  this.retries = 2;
+  this.timeout = 30000;
+  this.transport = null;
+}
+
+AsyncRequest.pending = 0;
+AsyncRequest.queue = [];
+AsyncRequest.maxConcurrent = 4;
+
+AsyncRequest.createTransport = function() {
+  if (window.XMLHttpRequest) {
+    return new XMLHttpRequest();
+  }
+  var progids = ['Msxml2.XMLHTTP.6.0', 'Msxml2.XMLHTTP.3.0', 'Microsoft.XMLHTTP'];
+  for (var ii = 0; ii < progids.length; ii++) {
+    try {
+      return new ActiveXObject(progids[ii]);
+    } catch (e) {
+      // try the next one
+    }
+  }
+  throw new Error('AsyncRequest: no transport available');
+};
+
+copyProperties(AsyncRequest.prototype, {
+  setData: function(data) {
+    this.data = data;
+    return this;
+  },
+
+  setMethod: function(method) {
+    this.method = method.toUpperCase();
+    return this;
+  },
+
+  setHandler: function(fn) {
+    this.handler = fn;
+    return this;
+  },
+
+  setErrorHandler: function(fn) {
+    this.errorHandler = fn;
+    return this;
+  },
+
+  setFinallyHandler: function(fn) {
+    this.finallyHandler = fn;
+    return this;
+  },
+
+  send: function() {
+    if (AsyncRequest.pending >= AsyncRequest.maxConcurrent) {
+      AsyncRequest.queue.push(this);
+      return this;
+    }
+    AsyncRequest.pending++;
+    var uri = new URI(this.uri.toString()), body = null;
+    var payload = copyProperties({__user: Env.user, __a: 1}, this.data);
+    if (this.method == 'GET') {
+      uri.addQueryData(payload);
+    } else {
+      body = URI.implodeQuery(payload);
+    }
+    var transport = this.transport = AsyncRequest.createTransport();
+    transport.open(this.method, uri.toString(), true);
+    if (body !== null) {
+      transport.setRequestHeader('Content-Type', 'application/x-www-form-urlencoded');
+    }
+    transport.onreadystatechange = bind(this, 'onStateChange');
+    this.timer = setTimeout(bind(this, 'onTimeout'), this.timeout);
+    transport.send(body);
+    return this;
+  },
+
+  onStateChange: function() {
+    var transport = this.transport;
+    if (!transport || transport.readyState != 4) {
+      return;
+    }
+    clearTimeout(this.timer);
+    var status = 0;
+    try {
+      status = transport.status;
+    } catch (e) {
+      status = 0;
+    }
+    if (status >= 200 && status < 300) {
+      this.onSuccess(transport.responseText);
+    } else if (status >= 500 && this.retries-- > 0) {
+      this.finish(true);
+      return;
+    } else {
+      this.errorHandler({status: status, text: transport.responseText});
+    }
+    this.finish(false);
+  },
+
+  onSuccess: function(text) {
+    var prefix = 'for (;;);', payload;
+    if (text.substr(0, prefix.length) == prefix) {
+      text = text.substr(prefix.length);
+    }
+    try {
+      payload = eval('(' + text + ')');
+    } catch (e) {
+      this.errorHandler({status: -1, text: text, error: e});
+      return;
+    }
+    if (payload.error) {
+      this.errorHandler(payload);
+    } else {
+      this.handler(payload.payload, payload);
+    }
+  },
+
+  onTimeout: function() {
+    if (this.transport) {
+      this.transport.onreadystatechange = emptyFunction;
+      this.transport.abort();
+    }
+    this.errorHandler({status: 0, text: 'timeout'});
+    this.finish(false);
+  },
+
+  finish: function(retry) {
+    AsyncRequest.pending--;
+    this.transport = null;
+    if (retry) {
+      this.send();
+    } else {
+      this.finallyHandler();
+    }
+    var next = AsyncRequest.queue.shift();
+    next && next.send();
+  }
+});
+
+function Typeahead(input, source, options) {
+  this.input = input;
+  this.source = source;
+  this.options = copyProperties({max: 8, minLength: 1, delay: 120}, options || {});
+  this.results = [];
+  this.selected = -1;
+  this.timer = null;
+  this.list = DOM.create('ul', {className: 'typeahead_list'});
+  input.parentNode.appendChild(this.list);
+  DOM.listen(input, 'keydown', bind(this, 'onKeyDown'));
+  DOM.listen(input, 'keyup', bind(this, 'onKeyUp'));
+  DOM.listen(input, 'blur', bind(this, 'hide'));
+}
+
+Typeahead.KEYS = {UP: 38, DOWN: 40, RETURN: 13, ESC: 27, TAB: 9};
+
+Typeahead.normalize = function(str) {
+  return str.toLowerCase().replace(/[à-å]/g, 'a').replace(/[è-ë]/g, 'e')
+    .replace(/[^a-z0-9 ]+/g, ' ').replace(/\s+/g, ' ');
+};
+
+copyProperties(Typeahead.prototype, {
+  onKeyDown: function(event) {
+    var keys = Typeahead.KEYS;
+    switch (event.keyCode) {
+      case keys.UP:
+        this.select(this.selected - 1);
+        return false;
+      case keys.DOWN:
+        this.select(this.selected + 1);
+        return false;
+      case keys.RETURN:
+      case keys.TAB:
+        if (this.selected >= 0) {
+          this.choose(this.results[this.selected]);
+          return false;
+        }
+        break;
+      case keys.ESC:
+        this.hide();
+        return false;
+    }
+    return true;
+  },
+
+  onKeyUp: function(event) {
+    var code = event.keyCode, keys = Typeahead.KEYS;
+    if (code == keys.UP || code == keys.DOWN || code == keys.RETURN || code == keys.ESC) {
+      return;
+    }
+    clearTimeout(this.timer);
+    this.timer = setTimeout(bind(this, 'search'), this.options.delay);
+  },
+
+  search: function() {
+    var query = Typeahead.normalize(this.input.value), tokens = query.split(' ');
+    if (query.length < this.options.minLength) {
+      this.hide();
+      return;
+    }
+    var matches = [];
+    outer: for (var ii = 0; ii < this.source.length && matches.length < this.options.max; ii++) {
+      var entry = this.source[ii], text = Typeahead.normalize(entry.text);
+      for (var jj = 0; jj < tokens.length; jj++) {
+        if (tokens[jj] && text.indexOf(tokens[jj]) == -1) {
+          continue outer;
+        }
+      }
+      matches.push(entry);
+    }
+    this.show(matches);
+  },
+
+  show: function(results) {
+    this.results = results;
+    this.selected = -1;
+    DOM.empty(this.list);
+    for (var ii = 0; ii < results.length; ii++) {
+      DOM.appendContent(this.list, DOM.create('li', {
+        className: 'typeahead_item',
+        onmousedown: bind(this, 'choose', results[ii])
+      }, results[ii].text));
+    }
+    this.list.style.display = results.length ? 'block' : 'none';
+  },
+
+  hide: function() {
+    this.list.style.display = 'none';
+    this.selected = -1;
+  },
+
+  select: function(index) {
+    var items = this.list.childNodes, count = items.length;
+    if (!count) {
+      return;
+    }
+    if (this.selected >= 0) {
+      DOM.removeClass(items[this.selected], 'selected');
+    }
+    this.selected = (index + count) % count;
+    DOM.addClass(items[this.selected], 'selected');
+  },
+
+  choose: function(entry) {
+    this.input.value = entry.text;
+    this.hide();
+    this.options.onSelect && this.options.onSelect(entry);
+  }
+});
+
+var Feed = {
+  stories: [],
+  oldest: 0,
+  loading: false,
+  storyTemplate: new Template(
+    '<div class="story" id="story_{{id}}">' +
+      '<a class="actor" href="{{actor.uri}}">{{actor.name}}</a> ' +
+      '<span class="message">{{&message}}</span>' +
+      '<abbr class="time" title="{{time_title}}">{{time_ago}}</abbr>' +
+      '<a class="like" href="#">Like ({{likes}})</a>' +
+    '</div>'),
+
+  init: function(container) {
+    this.container = DOM.$(container);
+    this.search = new Typeahead(DOM.$('feed_search'), [], {
+      onSelect: bind(this, 'filterByActor')
+    });
+    DOM.listen(window, 'scroll', bind(this, 'onScroll'));
+    DOM.listen(this.container, 'click', bind(this, 'onClick'));
+    this.load();
+  },
+
+  load: function() {
+    if (this.loading) {
+      return;
+    }
+    this.loading = true;
+    new AsyncRequest('/ajax/feed.php')
+      .setMethod('GET')
+      .setData({oldest: this.oldest, count: 20})
+      .setHandler(bind(this, 'onLoad'))
+      .setErrorHandler(bind(this, 'onError'))
+      .setFinallyHandler(bind(this, function() {
+        this.loading = false;
+      }))
+      .send();
+  },
+
+  onLoad: function(payload) {
+    var now = +new Date(), html = [];
+    for (var ii = 0; ii < payload.stories.length; ii++) {
+      var story = payload.stories[ii];
+      story.time_ago = DateFormat.relative(story.time * 1000, now);
+      story.time_title = DateFormat.format(new Date(story.time * 1000), 'l, F j, Y \\a\\t g:ia');
+      html.push(this.storyTemplate.render(story));
+      this.stories.push(story);
+      this.oldest = this.oldest ? Math.min(this.oldest, story.time) : story.time;
+      this.search.source.push({text: story.actor.name, id: story.actor.id});
+    }
+    var fragment = DOM.create('div', {html: html.join('')});
+    while (fragment.firstChild) {
+      this.container.appendChild(fragment.firstChild);
+    }
+  },
+
+  onError: function(error) {
+    if (Env.debug && window.console) {
+      console.error('Feed: ' + JSONEncoder.encode(error));
+    }
+  },
+
+  onScroll: function() {
+    var view = DOM.viewport(), bottom = DOM.offset(this.container).y + this.container.offsetHeight;
+    if (view.scrollY + view.height > bottom - 600) {
+      this.load();
+    }
+  },
+
+  onClick: function(event) {
+    var target = event.target;
+    while (target && target != this.container && !DOM.hasClass(target, 'like')) {
+      target = target.parentNode;
+    }
+    if (!target || target == this.container) {
+      return true;
+    }
+    var story = target.parentNode, id = story.id.replace(/^story_/, '');
+    new AsyncRequest('/ajax/like.php').setData({story: id}).setHandler(function(payload) {
+      target.innerHTML = 'Like (' + payload.likes + ')';
+      DOM.animate(story, {opacity: 0.5}, 200, 'easeOut', function() {
+        DOM.animate(story, {opacity: 1}, 200, 'easeIn');
+      });
+    }).send();
+    return false;
+  },
+
+  filterByActor: function(entry) {
+    var stories = DOM.scry(this.container, 'div.story');
+    for (var ii = 0; ii < stories.length; ii++) {
+      var actor = DOM.scry(stories[ii], 'a.actor')[0];
+      stories[ii].style.display = actor && actor.innerHTML == Template.escapeHTML(entry.text) ? '' : 'none';
+    }
+  }
+};
+
+DOM.listen(window, 'load', function() {
+  var timing = {start: Env.start, loaded: +new Date(), ratio: 0x10 / 1e3};
+  Feed.init('feed');
+  if (Env.debug) {
+    window.status = 'Loaded in ' + (timing.loaded - timing.start) + 'ms';
+  }
+});
@@ -0,0 +1,283 @@
+/**
+ * DOM helpers: element lookup, class names, styles, events and a small
+ * animation loop. Written against the browsers of its day, so it sniffs
+ * for attachEvent and friends.
+ */
+var DOM = (function() {
+  var doc = document, win = window;
+  var ua = navigator.userAgent.toLowerCase();
+  var isIE = /msie/.test(ua) && !/opera/.test(ua);
+  var isWebKit = /webkit/.test(ua);
+  var uid = 0;
+  var cache = {};
+  var whitespace = /\s+/;
+  var camelRe = /-([a-z])/g;
+
+  function camelize(name) {
+    return name.replace(camelRe, function(match, chr) {
+      return chr.toUpperCase();
+    });
+  }
+
+  function byId(id) {
+    return typeof id == 'string' ? doc.getElementById(id) : id;
+  }
+
+  function scry(root, selector) {
+    var parts = selector.split('.'), tag = parts[0] || '*', cls = parts[1];
+    var candidates = root.getElementsByTagName(tag), result = [];
+    for (var ii = 0, len = candidates.length; ii < len; ii++) {
+      if (!cls || hasClass(candidates[ii], cls)) {
+        result.push(candidates[ii]);
+      }
+    }
+    return result;
+  }
+
+  function hasClass(el, cls) {
+    var names = ' ' + el.className + ' ';
+    return names.indexOf(' ' + cls + ' ') != -1;
+  }
+
+  function addClass(el, cls) {
+    if (!hasClass(el, cls)) {
+      el.className = el.className ? el.className + ' ' + cls : cls;
+    }
+    return el;
+  }
+
+  function removeClass(el, cls) {
+    var names = el.className.split(whitespace), kept = [];
+    for (var ii = 0; ii < names.length; ++ii) {
+      if (names[ii] && names[ii] != cls) {
+        kept.push(names[ii]);
+      }
+    }
+    el.className = kept.join(' ');
+    return el;
+  }
+
+  function toggleClass(el, cls, force) {
+    var add = force === undefined ? !hasClass(el, cls) : !!force;
+    return add ? addClass(el, cls) : removeClass(el, cls);
+  }
+
+  function getStyle(el, prop) {
+    prop = camelize(prop);
+    if (el.style[prop]) {
+      return el.style[prop];
+    } else if (el.currentStyle) {
+      return el.currentStyle[prop];
+    } else if (win.getComputedStyle) {
+      return win.getComputedStyle(el, null)[prop];
+    }
+    return null;
+  }
+
+  function setStyle(el, prop, value) {
+    if (typeof prop == 'object') {
+      for (var key in prop) {
+        if (prop.hasOwnProperty(key)) {
+          setStyle(el, key, prop[key]);
+        }
+      }
+      return el;
+    }
+    prop = camelize(prop);
+    if (prop == 'opacity' && isIE) {
+      el.style.filter = 'alpha(opacity=' + Math.round(value * 100) + ')';
+      el.style.zoom = 1;
+    } else if (typeof value == 'number' && !/^(zIndex|opacity|zoom|fontWeight)$/.test(prop)) {
+      el.style[prop] = value + 'px';
+    } else {
+      el.style[prop] = value;
+    }
+    return el;
+  }
+
+  function getData(el) {
+    var id = el.__domUid || (el.__domUid = ++uid);
+    return cache[id] || (cache[id] = {});
+  }
+
+  function listen(el, type, fn) {
+    var data = getData(el);
+    var handlers = data.handlers || (data.handlers = {});
+    var list = handlers[type];
+    if (!list) {
+      list = handlers[type] = [];
+      var dispatch = function(event) {
+        event = event || win.event;
+        if (!event.target) {
+          event.target = event.srcElement;
+        }
+        if (!event.preventDefault) {
+          event.preventDefault = function() {
+            this.returnValue = false;
+          };
+          event.stopPropagation = function() {
+            this.cancelBubble = true;
+          };
+        }
+        var copy = list.slice(), result = true;
+        for (var ii = 0; ii < copy.length; ii++) {
+          if (copy[ii].call(el, event) === false) {
+            event.preventDefault();
+            event.stopPropagation();
+            result = false;
+          }
+        }
+        return result;
+      };
+      if (el.addEventListener) {
+        el.addEventListener(type, dispatch, false);
+      } else if (el.attachEvent) {
+        el.attachEvent('on' + type, dispatch);
+      } else {
+        el['on' + type] = dispatch;
+      }
+    }
+    list.push(fn);
+    return {
+      remove: function() {
+        for (var ii = 0; ii < list.length; ii++) {
+          if (list[ii] === fn) {
+            list.splice(ii, 1);
+            break;
+          }
+        }
+      }
+    };
+  }
+
+  function create(tag, attrs, children) {
+    var el = doc.createElement(tag);
+    if (attrs) {
+      for (var name in attrs) {
+        if (!attrs.hasOwnProperty(name)) {
+          continue;
+        }
+        switch (name) {
+          case 'className':
+          case 'class':
+            el.className = attrs[name];
+            break;
+          case 'style':
+            setStyle(el, attrs[name]);
+            break;
+          case 'html':
+            el.innerHTML = attrs[name];
+            break;
+          default:
+            if (name.substr(0, 2) == 'on') {
+              listen(el, name.substr(2), attrs[name]);
+            } else {
+              el.setAttribute(name, attrs[name]);
+            }
+        }
+      }
+    }
+    if (children) {
+      appendContent(el, children);
+    }
+    return el;
+  }
+
+  function appendContent(el, content) {
+    if (content === null || content === undefined) {
+      return el;
+    } else if (content instanceof Array) {
+      for (var ii = 0; ii < content.length; ii++) {
+        appendContent(el, content[ii]);
+      }
+    } else if (typeof content == 'string' || typeof content == 'number') {
+      el.appendChild(doc.createTextNode(String(content)));
+    } else {
+      el.appendChild(content);
+    }
+    return el;
+  }
+
+  function empty(el) {
+    while (el.firstChild) {
+      el.removeChild(el.firstChild);
+    }
+    return el;
+  }
+
+  function offset(el) {
+    var x = 0, y = 0;
+    do {
+      x += el.offsetLeft || 0;
+      y += el.offsetTop || 0;
+      el = el.offsetParent;
+    } while (el);
+    return {x: x, y: y};
+  }
+
+  function viewport() {
+    var root = doc.documentElement, body = doc.body;
+    return {
+      width: win.innerWidth || root.clientWidth || body.clientWidth,
+      height: win.innerHeight || root.clientHeight || body.clientHeight,
+      scrollX: win.pageXOffset || root.scrollLeft || body.scrollLeft,
+      scrollY: win.pageYOffset || root.scrollTop || body.scrollTop
+    };
+  }
+
+  var easing = {
+    linear: function(t) {
+      return t;
+    },
+    easeIn: function(t) {
+      return t * t;
+    },
+    easeOut: function(t) {
+      return -t * (t - 2);
+    },
+    easeInOut: function(t) {
+      return (t /= 0.5) < 1 ? 0.5 * t * t : -0.5 * ((--t) * (t - 2) - 1);
+    }
+  };
+
+  function animate(el, props, duration, ease, done) {
+    var start = +new Date(), from = {}, key;
+    ease = easing[ease] || easing.easeInOut;
+    for (key in props) {
+      from[key] = parseFloat(getStyle(el, key)) || 0;
+    }
+    var timer = setInterval(function() {
+      var now = +new Date(), t = Math.min(1, (now - start) / duration), p = ease(t);
+      for (var name in props) {
+        setStyle(el, name, from[name] + (props[name] - from[name]) * p);
+      }
+      if (t >= 1) {
+        clearInterval(timer);
+        done && done(el);
+      }
+    }, isWebKit ? 10 : 16);
+    return {
+      stop: function() {
+        clearInterval(timer);
+      }
+    };
+  }
+
+  return {
+    $: byId,
+    scry: scry,
+    hasClass: hasClass,
+    addClass: addClass,
+    removeClass: removeClass,
+    toggleClass: toggleClass,
+    getStyle: getStyle,
+    setStyle: setStyle,
+    listen: listen,
+    create: create,
+    appendContent: appendContent,
+    empty: empty,
+    offset: offset,
+    viewport: viewport,
+    animate: animate
+  };
+})();
@@ -0,0 +1,47 @@
+/**
+ * Minimal event emitter, the kind of module every page ships a copy of.
+ */
+function EventEmitter() {
+  this._listeners = {};
+}
+
+EventEmitter.prototype.on = function(type, fn, context) {
+  var list = this._listeners[type] || (this._listeners[type] = []);
+  list.push({fn: fn, context: context || null, once: false});
+  return this;
+};
+
+EventEmitter.prototype.once = function(type, fn, context) {
+  this.on(type, fn, context);
+  var list = this._listeners[type];
+  list[list.length - 1].once = true;
+  return this;
+};
+
+EventEmitter.prototype.off = function(type, fn) {
+  var list = this._listeners[type];
+  if (!list) {
+    return this;
+  }
+  for (var ii = list.length - 1; ii >= 0; --ii) {
+    if (!fn || list[ii].fn === fn) {
+      list.splice(ii, 1);
+    }
+  }
+  return this;
+};
+
+EventEmitter.prototype.emit = function(type) {
+  var list = this._listeners[type], args = Array.prototype.slice.call(arguments, 1);
+  if (!list) {
+    return false;
+  }
+  list = list.slice();
+  for (var ii = 0; ii < list.length; ++ii) {
+    list[ii].fn.apply(list[ii].context, args);
+    if (list[ii].once) {
+      this.off(type, list[ii].fn);
+    }
+  }
+  return true;
+};
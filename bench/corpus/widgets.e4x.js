@@ -0,0 +1,124 @@
+/**
+ * Profile widgets built with E4X: markup is written as XML literals with
+ * embedded expressions, and XML from the server is read with attribute,
+ * descendant and filtering selectors.
+ */
+default xml namespace = 'http://www.w3.org/1999/xhtml';
+
+var ProfileWidgets = {
+  pictureSizes: {square: 50, small: 100, normal: 200},
+
+  picture: function(user, size) {
+    var width = ProfileWidgets.pictureSizes[size] || 50;
+    var img = <img class="profile_pic" src={user.pic} width={width} height={width} alt={user.name} />;
+    return img;
+  },
+
+  nameLink: function(user) {
+    var link = <a href={'/profile.php?id=' + user.id} class="name">{user.name}</a>;
+    return link;
+  },
+
+  friendList: function(friends, max) {
+    var list = <ul class="friend_list"></ul>;
+    for (var ii = 0; ii < friends.length && ii < max; ii++) {
+      var friend = friends[ii];
+      list.appendChild(
+        <li class={ii % 2 ? 'odd' : 'even'}>
+          {ProfileWidgets.picture(friend, 'square')}
+          <div class="friend_info">
+            {ProfileWidgets.nameLink(friend)}
+            <span class="mutual">{friend.mutual} mutual friends</span>
+          </div>
+        </li>);
+    }
+    if (friends.length > max) {
+      list.appendChild(<li class="more"><a href="/friends.php">See all {friends.length}</a></li>);
+    }
+    return list;
+  },
+
+  infoSection: function(title, rows) {
+    var table = <table class="info_table" cellspacing="0"><tbody/></table>;
+    for (var key in rows) {
+      if (rows.hasOwnProperty(key) && rows[key]) {
+        table.tbody.appendChild(
+          <tr>
+            <th class="label">{key}:</th>
+            <td class="data">{rows[key]}</td>
+          </tr>);
+      }
+    }
+    var section =
+      <div class="info_section">
+        <h3 class="section_title">{title}</h3>
+        {table}
+      </div>;
+    return section;
+  },
+
+  header: function(user, viewer) {
+    var actions = <></>;
+    if (viewer.id != user.id) {
+      actions += <a class="button" href={'/message.php?id=' + user.id}>Send Message</a>;
+      if (!viewer.friends[user.id]) {
+        actions += <a class="button" href={'/addfriend.php?id=' + user.id}>Add as Friend</a>;
+      }
+    } else {
+      actions += <a class="button" href="/editprofile.php">Edit My Profile</a>;
+    }
+    var header =
+      <div id="profile_header">
+        {ProfileWidgets.picture(user, 'normal')}
+        <h1 id="profile_name">{user.name}</h1>
+        <div class="status">{user.status || ''}</div>
+        <div class="actions">{actions}</div>
+      </div>;
+    return header;
+  },
+
+  // Server responses come back as XML; these read them without a DOM
+  parseFriends: function(response) {
+    var friends = [];
+    var nodes = response..friend.(@visible == 'true');
+    for each (var node in nodes) {
+      friends.push({
+        id: parseInt(node.@id, 10),
+        name: String(node.name),
+        pic: String(node.pic.@src),
+        mutual: parseInt(node.@mutual, 10) || 0
+      });
+    }
+    return friends;
+  },
+
+  parseInfo: function(response) {
+    var info = {};
+    for each (var field in response.info.*) {
+      info[field.@label] = field.toString();
+    }
+    return info;
+  },
+
+  render: function(container, response, viewer) {
+    var user = {
+      id: parseInt(response.user.@id, 10),
+      name: String(response.user.name),
+      pic: String(response.user.pic.@src),
+      status: String(response.user.status)
+    };
+    var page =
+      <div class="profile">
+        {ProfileWidgets.header(user, viewer)}
+        <div class="left_column">
+          {ProfileWidgets.friendList(ProfileWidgets.parseFriends(response), 6)}
+        </div>
+        <div class="right_column">
+          {ProfileWidgets.infoSection('Information', ProfileWidgets.parseInfo(response))}
+          <!-- wall posts are loaded after the page -->
+          <div id="wall" class="wall"/>
+        </div>
+      </div>;
+    container.innerHTML = page.toXMLString();
+  }
+};
@@ -0,0 +1,133 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet
+*/
+
+//
+// check_number: formats doubles with both fbjs_format_number and dmg_fp's
+// g_fmt and fails if they ever differ.
+//
+//   check_number [-n count] [-s seed]
+//
+// The doubles are `count` random bit patterns, 1M by default, then every
+// power of two and the two doubles either side of it, every integer up to 1M
+// and `count` / 10 random ones up to 2^64, and `count` / 10 short decimals,
+// all with both signs. The random ones come from `seed`, so a failure can be
+// run again.
+#include "number.hpp"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+using namespace fbjs;
+
+extern "C" char* g_fmt(char*, double);
+
+static size_t check_count = 0;
+static size_t check_failures = 0;
+
+static uint64_t check_random(uint64_t& state) {
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+static void check_one(double value) {
+  char expected[40], actual[40];
+  for (int sign = 0; sign < 2; ++sign, value = -value) {
+    g_fmt(expected, value);
+    fbjs_format_number(actual, value);
+    ++check_count;
+    if (strcmp(expected, actual) != 0) {
+      if (++check_failures <= 20) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        fprintf(stderr, "%016llx: g_fmt gives %s, fbjs_format_number gives %s\n",
+          (unsigned long long)bits, expected, actual);
+      }
+    }
+  }
+}
+
+static void check_usage() {
+  fprintf(stderr, "usage: check_number [-n count] [-s seed]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  size_t count = 1000000;
+  uint64_t seed = 88172645463325252ULL;
+  int ch;
+  while ((ch = getopt(argc, argv, "n:s:")) != -1) {
+    switch (ch) {
+      case 'n':
+        count = strtoull(optarg, NULL, 10);
+        break;
+      case 's':
+        seed = strtoull(optarg, NULL, 10);
+        if (seed == 0) {
+          check_usage();
+        }
+        break;
+      default:
+        check_usage();
+    }
+  }
+  uint64_t state = seed;
+
+  // Random bit patterns, skipping Infinity and NaN which g_fmt spells its own way
+  for (size_t ii = 0; ii < count; ++ii) {
+    uint64_t bits = check_random(state);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    if (isfinite(value)) {
+      check_one(value);
+    }
+  }
+
+  // Powers of two from the smallest denormal up, and their neighbours
+  for (int exponent = -1074; exponent <= 1023; ++exponent) {
+    double value = ldexp(1, exponent);
+    check_one(value);
+    check_one(nextafter(value, 0));
+    check_one(nextafter(nextafter(value, 0), 0));
+    check_one(nextafter(value, HUGE_VAL));
+    check_one(nextafter(nextafter(value, HUGE_VAL), HUGE_VAL));
+  }
+
+  // Integers, all the small ones and then random ones of every size
+  for (int ii = 0; ii <= 1000000; ++ii) {
+    check_one(ii);
+  }
+  for (size_t ii = 0; ii < count / 10; ++ii) {
+    uint64_t value = check_random(state) >> (check_random(state) % 64);
+    check_one((double)value);
+  }
+
+  // Short decimals like the ones people write
+  for (size_t ii = 0; ii < count / 10; ++ii) {
+    double digits = (double)(check_random(state) % 1000000);
+    check_one(digits / pow(10, (double)(check_random(state) % 12)));
+  }
+
+  printf("%lu doubles, %lu mismatches\n", (unsigned long)check_count, (unsigned long)check_failures);
+  return check_failures ? 1 : 0;
+}
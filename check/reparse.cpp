@@ -0,0 +1,223 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet
+*/
+
+//
+// check_reparse: makes random edits to each input with Parser::reparse() and
+// fails if the program it leaves ever differs from a fresh parse of the edited
+// source.
+//
+//   check_reparse [-n edits] [-s seed] [-l] file...
+//
+// Each file gets `edits` edits in a row, 2000 by default. An edit removes up
+// to three bytes somewhere and puts in a short snippet of code, whitespace or
+// punctuation. When the edited source doesn't parse, reparse() has to throw
+// and leave the source as it was. Otherwise every node has to match the fresh
+// parse: kind, line number, source range and position, and the program has
+// to compare and render the same. -l parses with PARSE_FAST_LEXER.
+#include "node.hpp"
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+using namespace std;
+using namespace fbjs;
+
+static const char* const check_snippets[] = {
+  "", " ", "\n", ";", "a", "b", "1", "+", "-", ".", ",", "(", ")", "{", "}", "[", "]",
+  "x()", "+b", "a\n", "\nb", "return", "var c", "if (a) ", "{}", "function(){}",
+  "function f(){}", "'s'", "'\\\n'", "\\", "/r/", "// c\n", "/* c */",
+};
+
+static uint64_t check_random(uint64_t& state) {
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+static bool check_read(const char* path, string& code) {
+  FILE* file = fopen(path, "rb");
+  if (file == NULL) {
+    return false;
+  }
+  char buf[65536];
+  size_t len;
+  while ((len = fread(buf, 1, sizeof(buf), file)) > 0) {
+    code.append(buf, len);
+  }
+  bool ok = !ferror(file);
+  fclose(file);
+  return ok;
+}
+
+//
+// Why `actual` doesn't match `expected`, or an empty string if it does
+static string check_compare(const Node* actual, const Node* expected) {
+  char why[256];
+  vector<pair<const Node*, const Node*> > stack(1, make_pair(actual, expected));
+  while (!stack.empty()) {
+    const Node* aa = stack.back().first;
+    const Node* ee = stack.back().second;
+    stack.pop_back();
+    if (aa == NULL || ee == NULL) {
+      if (aa != ee) {
+        return "a child is missing";
+      }
+      continue;
+    }
+    if (aa->kind() != ee->kind() || aa->childNodes().size() != ee->childNodes().size()) {
+      snprintf(why, sizeof(why), "node at %u has kind %d and %lu children, expected kind %d and %lu children",
+        ee->sourceBegin(), aa->kind(), (unsigned long)aa->childNodes().size(), ee->kind(),
+        (unsigned long)ee->childNodes().size());
+      return why;
+    }
+    // Nodes without a range keep whatever the parser had lying around there
+    bool ranged = aa->hasSourceRange() || ee->hasSourceRange();
+    if (aa->lineno() != ee->lineno() || (ranged && (aa->sourceBegin() != ee->sourceBegin() ||
+        aa->sourceEnd() != ee->sourceEnd() || aa->sourceLine() != ee->sourceLine() ||
+        aa->sourceColumn() != ee->sourceColumn()))) {
+      snprintf(why, sizeof(why), "node of kind %d has lineno %u, range [%u, %u) and position %u:%u, "
+        "expected lineno %u, range [%u, %u) and position %u:%u", ee->kind(),
+        aa->lineno(), aa->sourceBegin(), aa->sourceEnd(), aa->sourceLine(), aa->sourceColumn(),
+        ee->lineno(), ee->sourceBegin(), ee->sourceEnd(), ee->sourceLine(), ee->sourceColumn());
+      return why;
+    }
+    for (size_t ii = 0; ii < aa->childNodes().size(); ++ii) {
+      stack.push_back(make_pair(aa->childNodes()[ii], ee->childNodes()[ii]));
+    }
+  }
+  if (!(*actual == *expected)) {
+    return "operator== says they differ";
+  }
+  if (actual->render(RENDER_MAINTAIN_LINENO) != expected->render(RENDER_MAINTAIN_LINENO)) {
+    return "they render differently";
+  }
+  return "";
+}
+
+static void check_usage() {
+  fprintf(stderr, "usage: check_reparse [-n edits] [-s seed] [-l] file...\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  size_t edits = 2000;
+  uint64_t seed = 88172645463325252ULL;
+  node_parse_enum opts = PARSE_NONE;
+  int ch;
+  while ((ch = getopt(argc, argv, "n:s:l")) != -1) {
+    switch (ch) {
+      case 'n':
+        edits = strtoull(optarg, NULL, 10);
+        break;
+      case 's':
+        seed = strtoull(optarg, NULL, 10);
+        if (seed == 0) {
+          check_usage();
+        }
+        break;
+      case 'l':
+        opts = PARSE_FAST_LEXER;
+        break;
+      default:
+        check_usage();
+    }
+  }
+  if (optind == argc) {
+    check_usage();
+  }
+
+  Parser parser;
+  uint64_t state = seed;
+  size_t failures = 0, applied = 0, rejected = 0;
+  for (int ii = optind; ii < argc; ++ii) {
+    string source;
+    if (!check_read(argv[ii], source)) {
+      fprintf(stderr, "%s: %s\n", argv[ii], strerror(errno));
+      ++failures;
+      continue;
+    }
+    auto_ptr<NodeProgram> program;
+    try {
+      program.reset(parser.parse(source.data(), source.size(), opts));
+    } catch (ParseException& e) {
+      fprintf(stderr, "%s: %s\n", argv[ii], e.what());
+      ++failures;
+      continue;
+    }
+
+    for (size_t jj = 0; jj < edits; ++jj) {
+      size_t offset = check_random(state) % (source.size() + 1);
+      size_t removed = min<size_t>(check_random(state) % 4, source.size() - offset);
+      string inserted = check_snippets[check_random(state) % (sizeof(check_snippets) / sizeof(*check_snippets))];
+      string text(source, 0, offset);
+      text.append(inserted);
+      text.append(source, offset + removed, string::npos);
+
+      auto_ptr<NodeProgram> expected;
+      try {
+        expected.reset(parser.parse(text.data(), text.size(), opts));
+      } catch (ParseException& e) {}
+
+      string before(source);
+      string why;
+      try {
+        parser.reparse(program.get(), source, offset, removed, inserted, opts);
+        if (expected.get() == NULL) {
+          why = "reparse() took source that doesn't parse";
+        } else {
+          why = check_compare(program.get(), expected.get());
+        }
+        ++applied;
+      } catch (ParseException& e) {
+        if (expected.get() != NULL) {
+          why = string("reparse() threw on source that parses: ") + e.what();
+        } else if (source != before) {
+          why = "reparse() threw but changed the source";
+        }
+        ++rejected;
+      }
+      if (!why.empty()) {
+        ++failures;
+        size_t context = offset > 40 ? offset - 40 : 0;
+        fprintf(stderr, "%s: edit %lu replacing \"%s\" at %lu in \"%s\" with \"%s\": %s\n", argv[ii],
+          (unsigned long)jj, before.substr(offset, removed).c_str(), (unsigned long)offset,
+          before.substr(context, offset + removed + 40 - context).c_str(), inserted.c_str(), why.c_str());
+
+        // Carry on from a fresh parse, so one bug is reported once
+        if (expected.get() == NULL) {
+          break;
+        }
+        source = text;
+        program = expected;
+      }
+    }
+  }
+
+  printf("%lu edits applied, %lu rejected, %lu failures\n", (unsigned long)applied, (unsigned long)rejected,
+    (unsigned long)failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,569 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#include "fold.hpp"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+using namespace std;
+using namespace fbjs;
+
+//
+// The value of a literal, as far as folding is concerned
+enum fold_type_enum {
+  FOLD_NUMBER,
+  FOLD_STRING,
+  FOLD_BOOLEAN,
+  FOLD_NULL
+};
+
+struct fold_value_t {
+  fold_type_enum type;
+  double number; // booleans are 0 or 1
+  string str;
+};
+
+static bool fold_value(const Node* node, fold_value_t& value) {
+  switch (node->kind()) {
+    case KIND_PARENTHETICAL:
+      return fold_value(node->childNodes().front(), value);
+
+    case KIND_NUMERIC_LITERAL:
+      value.type = FOLD_NUMBER;
+      value.number = static_cast<const NodeNumericLiteral*>(node)->numericValue();
+      return true;
+
+    case KIND_STRING_LITERAL:
+      value.type = FOLD_STRING;
+      value.str = static_cast<const NodeStringLiteral*>(node)->decodedValue();
+      return true;
+
+    case KIND_BOOLEAN_LITERAL:
+      value.type = FOLD_BOOLEAN;
+      value.number = static_cast<const NodeBooleanLiteral*>(node)->booleanValue();
+      return true;
+
+    case KIND_NULL_LITERAL:
+      value.type = FOLD_NULL;
+      value.number = 0;
+      return true;
+
+    case KIND_UNARY: {
+      // -1 is how a negative number is written, and !0 and !1 are booleans
+      const NodeUnary* unary = static_cast<const NodeUnary*>(node);
+      const Node* operand = unary->childNodes().front();
+      if (unary->operatorType() == MINUS_UNARY && operand->kind() == KIND_NUMERIC_LITERAL) {
+        value.type = FOLD_NUMBER;
+        value.number = -static_cast<const NodeNumericLiteral*>(operand)->numericValue();
+        return true;
+      } else if (unary->operatorType() == NOT_UNARY && static_cast<const NodeExpression*>(operand)->compare(true)) {
+        value.type = FOLD_BOOLEAN;
+        value.number = 0;
+        return true;
+      } else if (unary->operatorType() == NOT_UNARY && static_cast<const NodeExpression*>(operand)->compare(false)) {
+        value.type = FOLD_BOOLEAN;
+        value.number = 1;
+        return true;
+      }
+      return false;
+    }
+
+    default:
+      return false;
+  }
+}
+
+static bool fold_truthy(const fold_value_t& value) {
+  switch (value.type) {
+    case FOLD_STRING:
+      return !value.str.empty();
+    case FOLD_NULL:
+      return false;
+    default:
+      return value.number != 0 && !isnan(value.number);
+  }
+}
+
+// ToString, but only where it's simple: numbers have to be integers below
+// 2^53, whose digits %.0f prints exactly as ToString does. Past that ToString
+// stops at the shortest digits which read back and pads with zeros.
+static bool fold_to_string(const fold_value_t& value, string& str) {
+  switch (value.type) {
+    case FOLD_STRING:
+      str = value.str;
+      return true;
+    case FOLD_BOOLEAN:
+      str = value.number ? "true" : "false";
+      return true;
+    case FOLD_NULL:
+      str = "null";
+      return true;
+    default: {
+      if (value.number != floor(value.number) || fabs(value.number) >= 9007199254740992.0) {
+        return false;
+      }
+      char buf[32];
+      snprintf(buf, sizeof(buf), "%.0f", value.number == 0 ? 0 : value.number);
+      str = buf;
+      return true;
+    }
+  }
+}
+
+static int32_t fold_to_int32(double value) {
+  if (isnan(value) || isinf(value)) {
+    return 0;
+  }
+  double bits = fmod(value < 0 ? ceil(value) : floor(value), 4294967296.0);
+  if (bits < 0) {
+    bits += 4294967296.0;
+  }
+  return static_cast<int32_t>(static_cast<uint32_t>(bits));
+}
+
+// Whether UTF-8 byte order is UTF-16 code unit order for this string, which it
+// is unless there's something outside the BMP
+static bool fold_comparable(const string& str) {
+  for (size_t ii = 0; ii < str.size(); ++ii) {
+    if (static_cast<unsigned char>(str[ii]) >= 0xf0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Evaluates `left op right`. Strings are only ever concatenated or compared
+// with strings, since ToNumber on a string is more than it's worth here.
+static bool fold_binary(node_operator_t op, const fold_value_t& left, const fold_value_t& right, fold_value_t& result) {
+  bool strings = left.type == FOLD_STRING || right.type == FOLD_STRING;
+  if (op == PLUS && strings) {
+    string rhs;
+    if (!fold_to_string(left, result.str) || !fold_to_string(right, rhs)) {
+      return false;
+    }
+    result.type = FOLD_STRING;
+    result.str += rhs;
+    return true;
+  }
+
+  if (op == EQUAL || op == NOT_EQUAL || op == STRICT_EQUAL || op == STRICT_NOT_EQUAL) {
+    bool equal;
+    if (left.type == right.type) {
+      equal = left.type == FOLD_STRING ? left.str == right.str : left.number == right.number;
+    } else if (op == STRICT_EQUAL || op == STRICT_NOT_EQUAL || left.type == FOLD_NULL || right.type == FOLD_NULL) {
+      equal = false;
+    } else if (strings) {
+      return false;
+    } else {
+      // A boolean and a number
+      equal = left.number == right.number;
+    }
+    result.type = FOLD_BOOLEAN;
+    result.number = equal == (op == EQUAL || op == STRICT_EQUAL);
+    return true;
+  }
+
+  if (op == LESS_THAN || op == GREATER_THAN || op == LESS_THAN_EQUAL || op == GREATER_THAN_EQUAL) {
+    int order;
+    if (left.type == FOLD_STRING && right.type == FOLD_STRING) {
+      if (!fold_comparable(left.str) || !fold_comparable(right.str)) {
+        return false;
+      }
+      order = left.str.compare(right.str);
+    } else if (strings) {
+      return false;
+    } else if (isnan(left.number) || isnan(right.number)) {
+      result.type = FOLD_BOOLEAN;
+      result.number = 0;
+      return true;
+    } else {
+      order = left.number < right.number ? -1 : left.number > right.number ? 1 : 0;
+    }
+    result.type = FOLD_BOOLEAN;
+    switch (op) {
+      case LESS_THAN: result.number = order < 0; break;
+      case GREATER_THAN: result.number = order > 0; break;
+      case LESS_THAN_EQUAL: result.number = order <= 0; break;
+      default: result.number = order >= 0; break;
+    }
+    return true;
+  }
+
+  if (strings) {
+    return false;
+  }
+  double lhs = left.number, rhs = right.number;
+  result.type = FOLD_NUMBER;
+  switch (op) {
+    case PLUS: result.number = lhs + rhs; break;
+    case MINUS: result.number = lhs - rhs; break;
+    case MULT: result.number = lhs * rhs; break;
+    case DIV: result.number = lhs / rhs; break;
+    case MOD: result.number = fmod(lhs, rhs); break;
+    case BIT_OR: result.number = fold_to_int32(lhs) | fold_to_int32(rhs); break;
+    case BIT_XOR: result.number = fold_to_int32(lhs) ^ fold_to_int32(rhs); break;
+    case BIT_AND: result.number = fold_to_int32(lhs) & fold_to_int32(rhs); break;
+    case LSHIFT: result.number = static_cast<int32_t>(static_cast<uint32_t>(fold_to_int32(lhs)) << (fold_to_int32(rhs) & 31)); break;
+    case RSHIFT: result.number = fold_to_int32(lhs) >> (fold_to_int32(rhs) & 31); break;
+    case RSHIFT3: result.number = static_cast<uint32_t>(fold_to_int32(lhs)) >> (fold_to_int32(rhs) & 31); break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+static bool fold_unary(node_unary_t op, const fold_value_t& operand, fold_value_t& result) {
+  switch (op) {
+    case NOT_UNARY:
+      result.type = FOLD_BOOLEAN;
+      result.number = !fold_truthy(operand);
+      return true;
+    case MINUS_UNARY:
+    case PLUS_UNARY:
+    case BIT_NOT_UNARY:
+      if (operand.type == FOLD_STRING) {
+        return false;
+      }
+      result.type = FOLD_NUMBER;
+      result.number = op == MINUS_UNARY ? -operand.number :
+        op == PLUS_UNARY ? operand.number : ~fold_to_int32(operand.number);
+      return true;
+    default:
+      return false;
+  }
+}
+
+// The code point encoded at `ii` in `str`, which is moved past it. Fails on
+// anything that isn't UTF-8, though surrogates are let through since string
+// literals can hold those on their own.
+static bool fold_utf8(const string& str, size_t& ii, unsigned int& code) {
+  unsigned char c = str[ii];
+  size_t length = c >= 0xc2 && c <= 0xdf ? 2 : c >= 0xe0 && c <= 0xef ? 3 : c >= 0xf0 && c <= 0xf4 ? 4 : 0;
+  if (length == 0 || ii + length > str.size()) {
+    return false;
+  }
+  code = c & (0x7f >> length);
+  for (size_t jj = 1; jj < length; ++jj) {
+    unsigned char next = str[ii + jj];
+    if ((next & 0xc0) != 0x80) {
+      return false;
+    }
+    code = (code << 6) | (next & 0x3f);
+  }
+  if ((length == 3 && code < 0x800) || (length == 4 && (code < 0x10000 || code > 0x10ffff))) {
+    return false;
+  }
+  ii += length;
+  return true;
+}
+
+// A string literal which reads back as `value`, in whichever quotes need
+// fewer escapes. Anything outside of printable ASCII is escaped so the output
+// means the same in any encoding; bytes that aren't UTF-8 can't be, so those
+// aren't folded at all.
+static Node* fold_string_literal(const string& value) {
+  size_t doubles = 0, singles = 0;
+  for (size_t ii = 0; ii < value.size(); ++ii) {
+    doubles += value[ii] == '"';
+    singles += value[ii] == '\'';
+  }
+  char quote = singles < doubles ? '\'' : '"';
+  string raw(1, quote);
+  for (size_t ii = 0; ii < value.size(); ) {
+    unsigned char c = value[ii];
+    char buf[16];
+    if (c >= 0x80) {
+      unsigned int code;
+      if (!fold_utf8(value, ii, code)) {
+        return NULL;
+      } else if (code <= 0xff) {
+        snprintf(buf, sizeof(buf), "\\x%02x", code);
+      } else if (code <= 0xffff) {
+        snprintf(buf, sizeof(buf), "\\u%04x", code);
+      } else {
+        code -= 0x10000;
+        snprintf(buf, sizeof(buf), "\\u%04x\\u%04x", 0xd800 + (code >> 10), 0xdc00 + (code & 0x3ff));
+      }
+      raw += buf;
+      continue;
+    }
+    if (c == quote || c == '\\') {
+      raw += '\\';
+      raw += c;
+    } else if (c == '\n') {
+      raw += "\\n";
+    } else if (c == '\r') {
+      raw += "\\r";
+    } else if (c == '\t') {
+      raw += "\\t";
+    } else if (c < 0x20 || c == 0x7f) {
+      snprintf(buf, sizeof(buf), "\\x%02x", c);
+      raw += buf;
+    } else if (c == '/' && ii && value[ii - 1] == '<') {
+      // Keep "</script>" from closing an inline script
+      raw += "\\/";
+    } else {
+      raw += c;
+    }
+    ++ii;
+  }
+  raw += quote;
+  return new NodeStringLiteral(raw, value, true, 0);
+}
+
+// The node for a folded value. Booleans are !0 and !1, which is what they're
+// written as once minified anyway; NaN and the infinities aren't literals.
+static Node* fold_literal(const fold_value_t& value) {
+  switch (value.type) {
+    case FOLD_STRING:
+      return fold_string_literal(value.str);
+    case FOLD_BOOLEAN:
+      return (new NodeUnary(NOT_UNARY))->appendChild(new NodeNumericLiteral(value.number ? 0 : 1));
+    case FOLD_NULL:
+      return new NodeNullLiteral();
+    default:
+      if (isnan(value.number) || isinf(value.number)) {
+        return NULL;
+      } else if (signbit(value.number)) {
+        return (new NodeUnary(MINUS_UNARY))->appendChild(new NodeNumericLiteral(-value.number));
+      }
+      return new NodeNumericLiteral(value.number);
+  }
+}
+
+static bool fold_is_reference(const Node* node) {
+  return node && (node->kind() == KIND_IDENTIFIER || node->kind() == KIND_STATIC_MEMBER_EXPRESSION ||
+    node->kind() == KIND_DYNAMIC_MEMBER_EXPRESSION);
+}
+
+// var names declared in `node`, outside of any function in it. Fails if there's
+// a function declaration, which can't be kept without keeping the code around
+// it.
+static bool fold_hoisted(Node* node, vector<string>& names) {
+  if (node == NULL) {
+    return true;
+  }
+  switch (node->kind()) {
+    case KIND_FUNCTION_DECLARATION:
+      return false;
+    case KIND_FUNCTION_EXPRESSION:
+      return true;
+    case KIND_VAR_DECLARATION: {
+      node_list_t& children = node->childNodes();
+      for (size_t ii = 0; ii < children.size(); ++ii) {
+        Node* name = children[ii];
+        if (name->kind() == KIND_ASSIGNMENT) {
+          name = name->childNodes()[0];
+        }
+        if (name->kind() == KIND_TYPEHINT) {
+          name = name->childNodes()[0];
+        }
+        names.push_back(static_cast<NodeIdentifier*>(name)->name());
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  node_list_t& children = node->childNodes();
+  for (size_t ii = 0; ii < children.size(); ++ii) {
+    if (!fold_hoisted(children[ii], names)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static Node* fold_var_declaration(const vector<string>& names, unsigned int lineno) {
+  Node* var = new NodeVarDeclaration(false, lineno);
+  for (vector<string>::const_iterator ii = names.begin(); ii != names.end(); ++ii) {
+    var->appendChild(new NodeIdentifier(*ii, lineno));
+  }
+  return var;
+}
+
+static bool fold_test(const Node* node, bool& value) {
+  const NodeExpression* test = static_cast<const NodeExpression*>(node);
+  if (test->compare(true)) {
+    value = true;
+    return true;
+  } else if (test->compare(false)) {
+    value = false;
+    return true;
+  }
+  return false;
+}
+
+// Statements after one of these never run
+static bool fold_ends_flow(const Node* node) {
+  if (node == NULL) {
+    return false;
+  } else if (node->kind() == KIND_STATEMENT_WITH_EXPRESSION) {
+    return true;
+  } else if (node->kind() == KIND_STATEMENT_LIST && !node->childNodes().empty()) {
+    // Nested lists are rendered inline, as if their statements were ours.
+    // A switch's list of clauses never is.
+    const node_list_t& children = node->childNodes();
+    for (size_t ii = 0; ii < children.size(); ++ii) {
+      if (children[ii] && (children[ii]->kind() == KIND_CASE_CLAUSE || children[ii]->kind() == KIND_DEFAULT_CLAUSE)) {
+        return false;
+      }
+    }
+    return fold_ends_flow(children.back());
+  }
+  return false;
+}
+
+//
+// ConstantFolder
+ConstantFolder::ConstantFolder() : _folded(0) {}
+
+NodeWalker* ConstantFolder::clone() const {
+  return new ConstantFolder();
+}
+
+// Replaces the node being visited with `node`, if that's no bigger rendered
+void ConstantFolder::fold(Node* node) {
+  if (node == NULL) {
+    return;
+  }
+
+  // `a - -1` and `- -1` don't say what they mean. The parentheses count
+  // towards the size, so `1 - 2 - a` doesn't become `(-1)-a`.
+  Node* parent = this->parentNode();
+  if (node->kind() == KIND_UNARY && static_cast<NodeUnary*>(node)->operatorType() == MINUS_UNARY && parent &&
+      ((parent->kind() == KIND_OPERATOR && static_cast<NodeOperator*>(parent)->operatorType() == MINUS &&
+        parent->childNodes().back() == this->node()) ||
+       (parent->kind() == KIND_UNARY && static_cast<NodeUnary*>(parent)->operatorType() == MINUS_UNARY))) {
+    node = (new NodeParenthetical())->appendChild(node);
+  }
+  if (*node == *this->node() || node->render().size() > this->node()->render().size()) {
+    delete node;
+    return;
+  }
+  this->replace(node);
+  ++_folded;
+}
+
+// Replaces `node`, which is being visited, with one of its children. If the
+// result would be a reference in parentheses, which calls and typeof tell apart
+// from other expressions which evaluate to the same, it's left as it is.
+void ConstantFolder::replaceWithChild(Node& node, size_t index) {
+  node_list_t& children = node.childNodes();
+  Node* parent = this->parentNode();
+  if (fold_is_reference(children[index]) && parent && parent->kind() == KIND_PARENTHETICAL) {
+    return;
+  }
+  Node* child = node.replaceChild(NULL, node_list_t::iterator(&children, index));
+  this->replace(child);
+  ++_folded;
+}
+
+void ConstantFolder::visit(NodeOperator& node) {
+  this->visitEachChild();
+  node_list_t& children = node.childNodes();
+  node_operator_t op = node.operatorType();
+  bool value;
+  fold_value_t left, right, result;
+  if (op == AND || op == OR) {
+    // a && b is a when a is falsy and b otherwise, and the reverse for ||
+    if (fold_test(children[0], value)) {
+      this->replaceWithChild(node, value == (op == AND) ? 1 : 0);
+    }
+  } else if (op == COMMA) {
+    if (fold_value(children[0], left)) {
+      this->replaceWithChild(node, 1);
+    }
+  } else if (fold_value(children[0], left) && fold_value(children[1], right) &&
+      fold_binary(op, left, right, result)) {
+    this->fold(fold_literal(result));
+  }
+}
+
+void ConstantFolder::visit(NodeUnary& node) {
+  this->visitEachChild();
+  fold_value_t operand, result;
+  if (fold_value(node.childNodes().front(), operand) && fold_unary(node.operatorType(), operand, result)) {
+    this->fold(fold_literal(result));
+  }
+}
+
+void ConstantFolder::visit(NodeConditionalExpression& node) {
+  this->visitEachChild();
+  bool value;
+  if (fold_test(node.childNodes()[0], value)) {
+    this->replaceWithChild(node, value ? 1 : 2);
+  }
+}
+
+void ConstantFolder::visit(NodeIf& node) {
+  this->visitEachChild();
+  node_list_t& children = node.childNodes();
+  bool value;
+  vector<string> names;
+  if (!fold_test(children[0], value) || !fold_hoisted(children[value ? 2 : 1], names)) {
+    return;
+  }
+
+  Node* taken = node.replaceChild(NULL, node_list_t::iterator(&children, value ? 1 : 2));
+  if (!names.empty()) {
+    Node* list = (new NodeStatementList(node.lineno()))->appendChild(fold_var_declaration(names, node.lineno()));
+    if (taken) {
+      list->appendChild(taken);
+    }
+    taken = list;
+  }
+  ++_folded;
+  if (taken) {
+    this->replace(taken);
+  } else if (this->parentNode() && this->parentNode()->kind() == KIND_STATEMENT_LIST) {
+    this->remove();
+  } else {
+    this->replace(new NodeEmptyExpression(node.lineno()));
+  }
+}
+
+void ConstantFolder::visit(NodeStatementList& node) {
+  this->visitEachChild();
+  node_list_t& children = node.childNodes();
+
+  // In a switch the clauses are statements of this list, and each one can be
+  // jumped to, so only what's between a return and the next clause is dead
+  bool dead = false;
+  for (size_t ii = 0; ii < children.size(); ) {
+    Node* child = children[ii];
+    vector<string> names;
+    if (child && (child->kind() == KIND_CASE_CLAUSE || child->kind() == KIND_DEFAULT_CLAUSE)) {
+      dead = false;
+    } else if (!dead) {
+      dead = fold_ends_flow(child);
+    } else if (child && child->kind() != KIND_FUNCTION_DECLARATION && fold_hoisted(child, names)) {
+      ++_folded;
+      if (names.empty()) {
+        delete node.removeChild(node_list_t::iterator(&children, ii));
+        continue;
+      }
+      delete node.replaceChild(fold_var_declaration(names, child->lineno()), node_list_t::iterator(&children, ii));
+    }
+    ++ii;
+  }
+}
@@ -0,0 +1,58 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#pragma once
+#include <stddef.h>
+#include "node.hpp"
+#include "walker.hpp"
+
+namespace fbjs {
+
+  //
+  // ConstantFolder: evaluates operators whose operands are literals, and
+  // throws away code which can never run: the branch of an if or ?: that a
+  // constant test rules out, the side of an && or || which can't matter, and
+  // statements after a return, throw, break or continue. Hoisting is kept
+  // intact, so var names from dropped code are still declared, and code with
+  // function declarations in it is only dropped when they come along.
+  // Arithmetic is only folded where the result renders no longer than the
+  // expression did. Children are folded first, so fused into a
+  // CompositeWalker it still works but folds less.
+  class ConstantFolder: public InPlaceNodeWalker {
+    protected:
+      size_t _folded;
+      void fold(Node* node);
+      void replaceWithChild(Node& node, size_t index);
+
+    public:
+      using NodeWalker::visit;
+      ConstantFolder();
+      virtual NodeWalker* clone() const;
+
+      // How many expressions and statements were replaced or removed
+      size_t folded() const { return _folded; }
+
+      virtual void visit(NodeOperator& node);
+      virtual void visit(NodeUnary& node);
+      virtual void visit(NodeConditionalExpression& node);
+      virtual void visit(NodeIf& node);
+      virtual void visit(NodeStatementList& node);
+  };
+}
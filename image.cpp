@@ -0,0 +1,610 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#include "image.hpp"
+#include <errno.h>
+#include <fcntl.h>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+using namespace fbjs;
+
+// The last byte is the format version
+static const char node_image_magic[8] = {'F', 'B', 'J', 'S', 'A', 'S', 'T', 1};
+
+// Changes whenever this file is rebuilt, which it is whenever node.hpp changes
+static const char node_image_build[] = __DATE__ " " __TIME__;
+
+static void node_image_varint(string& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+static void node_image_signed(string& out, int64_t value) {
+  node_image_varint(out, value < 0 ? (~static_cast<uint64_t>(value) << 1) | 1 : static_cast<uint64_t>(value) << 1);
+}
+
+//
+// Writing: nodes are encoded into one buffer while the string table is built
+// and the two are joined at the end.
+struct node_image_writer_t {
+  std::string nodes;
+  map<std::string, size_t> index;
+  vector<const std::string*> strings;
+
+  void str(const std::string& str) {
+    map<std::string, size_t>::iterator ii = index.find(str);
+    if (ii == index.end()) {
+      ii = index.insert(make_pair(str, strings.size())).first;
+      strings.push_back(&ii->first);
+    }
+    node_image_varint(nodes, ii->second);
+  }
+
+  void node(const Node* node, const Node* parent) {
+    if (node == NULL) {
+      nodes.push_back(0);
+      return;
+    }
+    if (NodeImage::deferred(node)) {
+      throw runtime_error("function body not loaded, see NodeImage::materialize()");
+    }
+    nodes.push_back(static_cast<char>(node->kind() + 1));
+    node_image_signed(nodes, static_cast<int64_t>(node->lineno()) - (parent ? parent->lineno() : 0));
+    node_image_signed(nodes, static_cast<int64_t>(node->sourceBegin()) - (parent ? parent->sourceBegin() : 0));
+    node_image_signed(nodes, static_cast<int64_t>(node->sourceEnd()) - node->sourceBegin());
+    node_image_signed(nodes, static_cast<int64_t>(node->sourceLine()) - (parent ? parent->sourceLine() : 0));
+    node_image_varint(nodes, node->sourceColumn());
+
+    switch (node->kind()) {
+      case KIND_NUMERIC_LITERAL: {
+        double value = static_cast<const NodeNumericLiteral*>(node)->numericValue();
+        nodes.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        break;
+      }
+      case KIND_STRING_LITERAL:
+        str(static_cast<const NodeStringLiteral*>(node)->stringValue());
+        nodes.push_back(static_cast<const NodeStringLiteral*>(node)->isQuoted());
+        break;
+      case KIND_REGEX_LITERAL:
+        str(static_cast<const NodeRegexLiteral*>(node)->regexValue());
+        str(static_cast<const NodeRegexLiteral*>(node)->regexFlags());
+        break;
+      case KIND_BOOLEAN_LITERAL:
+        nodes.push_back(static_cast<const NodeBooleanLiteral*>(node)->booleanValue());
+        break;
+      case KIND_OPERATOR:
+        node_image_varint(nodes, static_cast<const NodeOperator*>(node)->operatorType());
+        break;
+      case KIND_ASSIGNMENT:
+        node_image_varint(nodes, static_cast<const NodeAssignment*>(node)->operatorType());
+        break;
+      case KIND_UNARY:
+        node_image_varint(nodes, static_cast<const NodeUnary*>(node)->operatorType());
+        break;
+      case KIND_POSTFIX:
+        node_image_varint(nodes, static_cast<const NodePostfix*>(node)->operatorType());
+        break;
+      case KIND_IDENTIFIER:
+        str(static_cast<const NodeIdentifier*>(node)->name());
+        break;
+      case KIND_STATEMENT_WITH_EXPRESSION:
+        node_image_varint(nodes, static_cast<const NodeStatementWithExpression*>(node)->statementType());
+        break;
+      case KIND_VAR_DECLARATION:
+        nodes.push_back(static_cast<const NodeVarDeclaration*>(node)->iterator());
+        break;
+      case KIND_XML_NAME:
+        str(static_cast<const NodeXMLName*>(node)->ns());
+        str(static_cast<const NodeXMLName*>(node)->name());
+        break;
+      case KIND_XML_COMMENT:
+        str(static_cast<const NodeXMLComment*>(node)->comment());
+        break;
+      case KIND_XML_PI:
+        str(static_cast<const NodeXMLPI*>(node)->data());
+        break;
+      case KIND_XML_TEXT_DATA:
+        str(static_cast<const NodeXMLTextData*>(node)->data());
+        nodes.push_back(static_cast<const NodeXMLTextData*>(node)->isWhitespace());
+        break;
+      default:
+        break;
+    }
+
+    // Function bodies are prefixed with their length so lazy loads can skip them
+    const node_list_t& children = node->childNodes();
+    bool function = node->kind() == KIND_FUNCTION_DECLARATION || node->kind() == KIND_FUNCTION_EXPRESSION;
+    node_image_varint(nodes, children.size());
+    for (size_t ii = 0; ii < children.size(); ++ii) {
+      if (function && ii + 1 == children.size()) {
+        size_t length = nodes.size();
+        nodes.append(4, 0);
+        this->node(children[ii], node);
+        uint32_t len = nodes.size() - length - 4;
+        for (size_t jj = 0; jj < 4; ++jj) {
+          nodes[length + jj] = static_cast<char>(len >> (jj * 8));
+        }
+      } else {
+        this->node(children[ii], node);
+      }
+    }
+  }
+};
+
+void NodeImage::write(const NodeProgram* program, std::string& out) {
+  node_image_writer_t writer;
+  writer.node(program, NULL);
+  out.assign(node_image_magic, sizeof(node_image_magic));
+  node_image_varint(out, writer.strings.size());
+  for (vector<const std::string*>::iterator ii = writer.strings.begin(); ii != writer.strings.end(); ++ii) {
+    node_image_varint(out, (*ii)->size());
+    out.append(**ii);
+  }
+  out.append(writer.nodes);
+}
+
+void NodeImage::writeFile(const NodeProgram* program, const char* path) {
+  std::string image;
+  NodeImage::write(program, image);
+  FILE* file = fopen(path, "wb");
+  if (file == NULL) {
+    throw runtime_error(std::string("unable to open ") + path + ": " + strerror(errno));
+  }
+  bool failed = fwrite(image.data(), 1, image.size(), file) != image.size();
+  if (fclose(file) != 0 || failed) {
+    throw runtime_error(std::string("error writing ") + path);
+  }
+}
+
+//
+// Reading. Until it's materialized, whatever would need a deferred body's
+// statements throws instead of going on without them; operator== gets there
+// through hashValue().
+class NodeImage::deferred_body_t: public NodeStatementList {
+  public:
+    NodeImage* image;
+    load_t* load;
+    const char* begin;
+    const char* end;
+    deferred_body_t(const unsigned int lineno) : NodeStatementList(lineno), image(NULL), load(NULL), begin(NULL), end(NULL) {}
+
+    virtual Node* clone(Node* node = NULL) const {
+      this->loaded();
+      return NodeStatementList::clone(node);
+    }
+
+    virtual void render(render_guts_t* guts, int indentation) const {
+      this->loaded();
+      NodeStatementList::render(guts, indentation);
+    }
+
+    virtual void renderBlock(bool must, render_guts_t* guts, int indentation) const {
+      this->loaded();
+      NodeStatementList::renderBlock(must, guts, indentation);
+    }
+
+    virtual void renderStatement(render_guts_t* guts, int indentation) const {
+      this->loaded();
+      NodeStatementList::renderStatement(guts, indentation);
+    }
+
+    virtual void renderIndentedStatement(render_guts_t* guts, int indentation) const {
+      this->loaded();
+      NodeStatementList::renderIndentedStatement(guts, indentation);
+    }
+
+    virtual unsigned int hashValue() const {
+      this->loaded();
+      return NodeStatementList::hashValue();
+    }
+
+  protected:
+    void loaded() const {
+      if (image != NULL) {
+        throw runtime_error("function body not loaded, see NodeImage::materialize()");
+      }
+    }
+};
+
+struct NodeImage::reader_t {
+  NodeImage* image;
+  load_t* load;
+  const char* cursor;
+  const char* end;
+  bool lazy;
+
+  reader_t(NodeImage* image, load_t* load, const char* cursor, const char* end, bool lazy) :
+    image(image), load(load), cursor(cursor), end(end), lazy(lazy) {}
+
+  static void corrupt() {
+    throw runtime_error("corrupt AST image");
+  }
+
+  unsigned char byte() {
+    if (cursor == end) {
+      corrupt();
+    }
+    return *cursor++;
+  }
+
+  uint64_t varint() {
+    uint64_t value = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+      unsigned char next = byte();
+      value |= static_cast<uint64_t>(next & 0x7f) << shift;
+      if (!(next & 0x80)) {
+        return value;
+      }
+    }
+    corrupt();
+    return 0;
+  }
+
+  int64_t signedVarint() {
+    uint64_t value = varint();
+    return value & 1 ? ~static_cast<int64_t>(value >> 1) : static_cast<int64_t>(value >> 1);
+  }
+
+  const string_t& str() {
+    uint64_t index = varint();
+    if (index >= image->_strings.size()) {
+      corrupt();
+    }
+    return image->_strings[index];
+  }
+
+  std::string copy() {
+    const string_t& value = str();
+    return std::string(value.data, value.len);
+  }
+
+  const std::string* atom() {
+    uint64_t index = varint();
+    if (index >= image->_strings.size()) {
+      corrupt();
+    }
+    const std::string*& atom = load->atom_cache[index];
+    if (atom == NULL) {
+      atom = load->atoms->intern(image->_strings[index].data, image->_strings[index].len);
+    }
+    return atom;
+  }
+
+  Node* make(unsigned char tag, unsigned int lineno) {
+    NodeArena* arena = load->arena;
+    switch (tag - 1) {
+      case KIND_NODE: return new (arena) Node(lineno);
+      case KIND_STATEMENT_LIST: return new (arena) NodeStatementList(lineno);
+      case KIND_NUMERIC_LITERAL: {
+        double value;
+        if (end - cursor < static_cast<ptrdiff_t>(sizeof(value))) {
+          corrupt();
+        }
+        memcpy(&value, cursor, sizeof(value));
+        cursor += sizeof(value);
+        return new (arena) NodeNumericLiteral(value, lineno);
+      }
+      case KIND_STRING_LITERAL: {
+        std::string value = copy();
+        return new (arena) NodeStringLiteral(value, byte(), lineno);
+      }
+      case KIND_REGEX_LITERAL: {
+        std::string value = copy();
+        return new (arena) NodeRegexLiteral(value, copy(), lineno);
+      }
+      case KIND_BOOLEAN_LITERAL: return new (arena) NodeBooleanLiteral(byte(), lineno);
+      case KIND_NULL_LITERAL: return new (arena) NodeNullLiteral(lineno);
+      case KIND_THIS: return new (arena) NodeThis(lineno);
+      case KIND_EMPTY_EXPRESSION: return new (arena) NodeEmptyExpression(lineno);
+      case KIND_OPERATOR: return new (arena) NodeOperator(static_cast<node_operator_t>(varint()), lineno);
+      case KIND_CONDITIONAL_EXPRESSION: return new (arena) NodeConditionalExpression(lineno);
+      case KIND_PARENTHETICAL: return new (arena) NodeParenthetical(lineno);
+      case KIND_ASSIGNMENT: return new (arena) NodeAssignment(static_cast<node_assignment_t>(varint()), lineno);
+      case KIND_UNARY: return new (arena) NodeUnary(static_cast<node_unary_t>(varint()), lineno);
+      case KIND_POSTFIX: return new (arena) NodePostfix(static_cast<node_postfix_t>(varint()), lineno);
+      case KIND_IDENTIFIER: return new (arena) NodeIdentifier(atom(), load->atoms, lineno);
+      case KIND_FUNCTION_CALL: return new (arena) NodeFunctionCall(lineno);
+      case KIND_FUNCTION_CONSTRUCTOR: return new (arena) NodeFunctionConstructor(lineno);
+      case KIND_OBJECT_LITERAL: return new (arena) NodeObjectLiteral(lineno);
+      case KIND_ARRAY_LITERAL: return new (arena) NodeArrayLiteral(lineno);
+      case KIND_STATIC_MEMBER_EXPRESSION: return new (arena) NodeStaticMemberExpression(lineno);
+      case KIND_DYNAMIC_MEMBER_EXPRESSION: return new (arena) NodeDynamicMemberExpression(lineno);
+      case KIND_STATEMENT_WITH_EXPRESSION:
+        return new (arena) NodeStatementWithExpression(static_cast<node_statement_with_expression_t>(varint()), lineno);
+      case KIND_VAR_DECLARATION: return new (arena) NodeVarDeclaration(byte(), lineno);
+      case KIND_TYPEHINT: return new (arena) NodeTypehint(lineno);
+      case KIND_FUNCTION_DECLARATION: return new (arena) NodeFunctionDeclaration(lineno);
+      case KIND_FUNCTION_EXPRESSION: return new (arena) NodeFunctionExpression(lineno);
+      case KIND_ARG_LIST: return new (arena) NodeArgList(lineno);
+      case KIND_IF: return new (arena) NodeIf(lineno);
+      case KIND_WITH: return new (arena) NodeWith(lineno);
+      case KIND_TRY: return new (arena) NodeTry(lineno);
+      case KIND_LABEL: return new (arena) NodeLabel(lineno);
+      case KIND_CASE_CLAUSE: return new (arena) NodeCaseClause(lineno);
+      case KIND_SWITCH: return new (arena) NodeSwitch(lineno);
+      case KIND_DEFAULT_CLAUSE: return new (arena) NodeDefaultClause(lineno);
+      case KIND_OBJECT_LITERAL_PROPERTY: return new (arena) NodeObjectLiteralProperty(lineno);
+      case KIND_FOR_LOOP: return new (arena) NodeForLoop(lineno);
+      case KIND_FOR_IN: return new (arena) NodeForIn(lineno);
+      case KIND_FOR_EACH_IN: return new (arena) NodeForEachIn(lineno);
+      case KIND_WHILE: return new (arena) NodeWhile(lineno);
+      case KIND_DO_WHILE: return new (arena) NodeDoWhile(lineno);
+      case KIND_XML_DEFAULT_NAMESPACE: return new (arena) NodeXMLDefaultNamespace(lineno);
+      case KIND_XML_NAME: {
+        std::string ns = copy();
+        return new (arena) NodeXMLName(ns, copy(), lineno);
+      }
+      case KIND_XML_ELEMENT: return new (arena) NodeXMLElement(lineno);
+      case KIND_XML_COMMENT: return new (arena) NodeXMLComment(copy(), lineno);
+      case KIND_XML_PI: return new (arena) NodeXMLPI(copy(), lineno);
+      case KIND_XML_CONTENT_LIST: return new (arena) NodeXMLContentList(lineno);
+      case KIND_XML_TEXT_DATA: {
+        const string_t& data = str();
+        NodeXMLTextData* node = new (arena) NodeXMLTextData(lineno);
+        node->appendData(rope_t(data.data, data.len), byte());
+        return node;
+      }
+      case KIND_XML_EMBEDDED_EXPRESSION: return new (arena) NodeXMLEmbeddedExpression(lineno);
+      case KIND_XML_ATTRIBUTE_LIST: return new (arena) NodeXMLAttributeList(lineno);
+      case KIND_XML_ATTRIBUTE: return new (arena) NodeXMLAttribute(lineno);
+      case KIND_WILDCARD_IDENTIFIER: return new (arena) NodeWildcardIdentifier(lineno);
+      case KIND_STATIC_ATTRIBUTE_IDENTIFIER: return new (arena) NodeStaticAttributeIdentifier(lineno);
+      case KIND_DYNAMIC_ATTRIBUTE_IDENTIFIER: return new (arena) NodeDynamicAttributeIdentifier(lineno);
+      case KIND_STATIC_QUALIFIED_IDENTIFIER: return new (arena) NodeStaticQualifiedIdentifier(lineno);
+      case KIND_DYNAMIC_QUALIFIED_IDENTIFIER: return new (arena) NodeDynamicQualifiedIdentifier(lineno);
+      case KIND_FILTERING_PREDICATE: return new (arena) NodeFilteringPredicate(lineno);
+      case KIND_DESCENDANT_EXPRESSION: return new (arena) NodeDescendantExpression(lineno);
+      default:
+        // Programs only appear at the root and the abstract kinds never do
+        corrupt();
+        return NULL;
+    }
+  }
+
+  // With `defer` a statement list is left for materialize() to read later
+  Node* node(const Node* parent, bool defer = false) {
+    unsigned char tag = byte();
+    if (tag == 0) {
+      return NULL;
+    }
+    unsigned int lineno = signedVarint() + (parent ? parent->lineno() : 0);
+    int64_t begin = signedVarint() + (parent ? parent->sourceBegin() : 0);
+    int64_t length = signedVarint();
+    int64_t line = signedVarint() + (parent ? parent->sourceLine() : 0);
+    uint64_t column = varint();
+    Node* node;
+    bool deferred = defer && tag == KIND_STATEMENT_LIST + 1;
+    if (deferred) {
+      deferred_body_t* body = new (load->arena) deferred_body_t(lineno);
+      body->image = image;
+      body->load = load;
+      body->begin = cursor;
+      body->end = end;
+      cursor = end;
+      node = body;
+    } else {
+      node = make(tag, lineno);
+    }
+    node->setSourceRange(begin, begin + length);
+    node->setSourcePosition(line, column);
+    if (!deferred) {
+      children(node);
+    }
+    return node;
+  }
+
+  void children(Node* node) {
+    uint64_t count = varint();
+    if (count > static_cast<uint64_t>(end - cursor)) {
+      corrupt();
+    }
+    bool function = node->kind() == KIND_FUNCTION_DECLARATION || node->kind() == KIND_FUNCTION_EXPRESSION;
+    for (uint64_t ii = 0; ii < count; ++ii) {
+      if (function && ii + 1 == count) {
+        if (end - cursor < 4) {
+          corrupt();
+        }
+        uint32_t len = 0;
+        for (size_t jj = 0; jj < 4; ++jj) {
+          len |= static_cast<uint32_t>(static_cast<unsigned char>(cursor[jj])) << (jj * 8);
+        }
+        cursor += 4;
+        if (len > static_cast<uint64_t>(end - cursor)) {
+          corrupt();
+        }
+        reader_t body(image, load, cursor, cursor + len, lazy);
+        node->appendChild(body.node(node, lazy));
+        if (body.cursor != body.end) {
+          corrupt();
+        }
+        cursor = body.end;
+      } else {
+        node->appendChild(this->node(node));
+      }
+    }
+  }
+};
+
+NodeImage::NodeImage(const char* data, size_t len) : _data(data), _len(len), _map(NULL), _map_len(0) {
+  if (len < sizeof(node_image_magic) || memcmp(data, node_image_magic, sizeof(node_image_magic)) != 0) {
+    throw runtime_error("not an AST image");
+  }
+  reader_t reader(this, NULL, data + sizeof(node_image_magic), data + len, false);
+  uint64_t count = reader.varint();
+  if (count > len) {
+    reader_t::corrupt();
+  }
+  _strings.resize(count);
+  for (vector<string_t>::iterator ii = _strings.begin(); ii != _strings.end(); ++ii) {
+    uint64_t size = reader.varint();
+    if (size > static_cast<uint64_t>(reader.end - reader.cursor)) {
+      reader_t::corrupt();
+    }
+    ii->data = reader.cursor;
+    ii->len = size;
+    reader.cursor += size;
+  }
+  _nodes = reader.cursor;
+}
+
+NodeImage::~NodeImage() {
+  for (vector<load_t*>::iterator ii = _loads.begin(); ii != _loads.end(); ++ii) {
+    delete *ii;
+  }
+  if (_map) {
+    munmap(_map, _map_len);
+  }
+}
+
+//
+// Maps the file at `path`, which must stay unchanged while the image is open.
+// Caller owns the returned image.
+NodeImage* NodeImage::openFile(const char* path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    throw runtime_error(std::string("unable to open ") + path + ": " + strerror(errno));
+  }
+  struct stat st;
+  void* map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) {
+    throw runtime_error(std::string("unable to map ") + path);
+  }
+  NodeImage* image;
+  try {
+    image = new NodeImage(static_cast<const char*>(map), st.st_size);
+  } catch (...) {
+    munmap(map, st.st_size);
+    throw;
+  }
+  image->_map = map;
+  image->_map_len = st.st_size;
+  return image;
+}
+
+//
+// Caller owns the returned program. Its nodes come from its own arena, like a
+// parsed program's, and deferred bodies are filled in from the same one.
+NodeProgram* NodeImage::load(bool lazy /* = false */) {
+  auto_ptr<NodeProgram> program(new NodeProgram());
+  program->_arena = new NodeArena();
+  program->_atoms = new NodeAtomTable();
+  auto_ptr<load_t> load(new load_t);
+  load->arena = program->_arena;
+  load->atoms = program->_atoms;
+  load->atom_cache.resize(_strings.size(), NULL);
+
+  reader_t reader(this, load.get(), _nodes, _data + _len, lazy);
+  if (reader.byte() != KIND_PROGRAM + 1) {
+    reader_t::corrupt();
+  }
+  program->setLineno(reader.signedVarint());
+  int64_t begin = reader.signedVarint();
+  int64_t length = reader.signedVarint();
+  int64_t line = reader.signedVarint();
+  program->setSourceRange(begin, begin + length);
+  program->setSourcePosition(line, reader.varint());
+  reader.children(program.get());
+  if (reader.cursor != reader.end) {
+    reader_t::corrupt();
+  }
+  if (lazy) {
+    _loads.push_back(load.release());
+  }
+  return program.release();
+}
+
+string NodeImage::buildId() {
+  uint32_t hash = 2166136261U;
+  for (const char* ii = node_image_build; *ii; ++ii) {
+    hash = (hash ^ static_cast<unsigned char>(*ii)) * 16777619U;
+  }
+  char id[32];
+  snprintf(id, sizeof(id), "%d-%08x", node_image_magic[sizeof(node_image_magic) - 1], hash);
+  return id;
+}
+
+bool NodeImage::deferred(const Node* node) {
+  if (node == NULL || node->kind() != KIND_STATEMENT_LIST) {
+    return false;
+  }
+  const deferred_body_t* body = dynamic_cast<const deferred_body_t*>(node);
+  return body != NULL && body->image != NULL;
+}
+
+//
+// Reads a deferred body's statements into `list`
+void NodeImage::materialize(deferred_body_t* body, Node* list) {
+  reader_t reader(body->image, body->load, body->begin, body->end, false);
+  try {
+    reader.children(list);
+  } catch (...) {
+    while (!list->empty()) {
+      delete list->removeChild(list->childNodes().begin());
+    }
+    throw;
+  }
+}
+
+//
+// Replaces every deferred body under `node` with the statements it stands for.
+// A deferred body passed in directly is filled in place instead.
+void NodeImage::materialize(Node* node) {
+  if (node == NULL) {
+    return;
+  }
+  if (NodeImage::deferred(node)) {
+    deferred_body_t* body = static_cast<deferred_body_t*>(node);
+    NodeImage::materialize(body, body);
+    body->image = NULL;
+    return;
+  }
+  node_list_t& children = node->childNodes();
+  for (size_t ii = 0; ii < children.size(); ++ii) {
+    if (NodeImage::deferred(children[ii])) {
+      deferred_body_t* body = static_cast<deferred_body_t*>(children[ii]);
+      Node* list = new (Node::arenaOf(body)) NodeStatementList(body->lineno());
+      list->setSourceRange(body->sourceBegin(), body->sourceEnd());
+      list->setSourcePosition(body->sourceLine(), body->sourceColumn());
+      try {
+        NodeImage::materialize(body, list);
+      } catch (...) {
+        delete list;
+        throw;
+      }
+      delete node->replaceChild(list, node_list_t::iterator(&children, ii));
+    } else {
+      NodeImage::materialize(children[ii]);
+    }
+  }
+}
@@ -0,0 +1,88 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "node.hpp"
+
+namespace fbjs {
+
+  //
+  // NodeImage: a program serialized to a compact binary form that loads much
+  // faster than parsing it again. Nodes are written in preorder as a kind tag,
+  // varints for line numbers and source positions (relative to the parent),
+  // the node's own data, and a varint child count. Strings live once in a
+  // table up front and numbers are stored as raw doubles. Images are only
+  // read back by the build that wrote them.
+  //
+  // A lazy load leaves every function body deferred: an empty statement list
+  // that remembers where its statements are in the image. materialize()
+  // swaps the deferred bodies under a node for the real ones. Until then
+  // clone(), render(), operator== and write() throw rather than take a
+  // deferred body for an empty one, and walkers see no statements in it;
+  // deferred() tells it apart. The image must outlive any program loaded
+  // from it that still has deferred bodies.
+  class NodeImage {
+    public:
+      NodeImage(const char* data, size_t len);
+      ~NodeImage();
+      static NodeImage* openFile(const char* path);
+      static void write(const NodeProgram* program, std::string& out);
+      static void writeFile(const NodeProgram* program, const char* path);
+
+      NodeProgram* load(bool lazy = false);
+      static bool deferred(const Node* node);
+      static void materialize(Node* node);
+
+      // The format version and a stamp of the build, for caches that keep
+      // images where another build might find them
+      static std::string buildId();
+
+    protected:
+      struct string_t {
+        const char* data;
+        size_t len;
+      };
+      struct load_t {
+        NodeArena* arena;
+        NodeAtomTable* atoms;
+        std::vector<const std::string*> atom_cache;
+      };
+      const char* _data;
+      size_t _len;
+      void* _map;
+      size_t _map_len;
+      const char* _nodes;
+      std::vector<string_t> _strings;
+      std::vector<load_t*> _loads;
+      struct reader_t;
+      class deferred_body_t;
+      friend struct reader_t;
+      friend class deferred_body_t;
+      static void materialize(deferred_body_t* body, Node* list);
+
+    private:
+      NodeImage(const NodeImage&);
+      NodeImage& operator= (const NodeImage&);
+  };
+}
@@ -0,0 +1,994 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet
+*/
+
+//
+// Hand-written scanner for in-memory, non-E4X input. It produces exactly the
+// token stream the flex rules in parser.ll do, quirks included, so anything in
+// there that changes must change here too. Flex keeps the start condition and
+// takes over for good if the parser ever switches to an XML state.
+
+#include "parser.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+using namespace std;
+using namespace fbjs;
+
+// Byte classes, see fbjs_lex_class
+enum {
+  LEX_IDENT = 0x01, // [a-zA-Z$_]
+  LEX_WORD = 0x02, // [a-zA-Z$_0-9]
+  LEX_DIGIT = 0x04, // [0-9]
+  LEX_OCTAL = 0x08, // [0-7]
+  LEX_HEX = 0x10, // [a-fA-F0-9]
+  LEX_SPACE = 0x20, // JS_WHITESPACE, [ \t\x0b\x0c\xa0\r]
+  LEX_FLAG = 0x40, // [A-Za-z]
+};
+
+static const unsigned char fbjs_lex_class[256] = {
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x20, 0x20, 0x20, 0x00, 0x00, // 00
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 10
+  0x20, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 20
+  0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x16, 0x16, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 30
+  0x00, 0x53, 0x53, 0x53, 0x53, 0x53, 0x53, 0x43, 0x43, 0x43, 0x43, 0x43, 0x43, 0x43, 0x43, 0x43, // 40
+  0x43, 0x43, 0x43, 0x43, 0x43, 0x43, 0x43, 0x43, 0x43, 0x43, 0x43, 0x00, 0x00, 0x00, 0x00, 0x03, // 50
+  0x00, 0x53, 0x53, 0x53, 0x53, 0x53, 0x53, 0x43, 0x43, 0x43, 0x43, 0x43, 0x43, 0x43, 0x43, 0x43, // 60
+  0x43, 0x43, 0x43, 0x43, 0x43, 0x43, 0x43, 0x43, 0x43, 0x43, 0x43, 0x00, 0x00, 0x00, 0x00, 0x00, // 70
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 80
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 90
+  0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // a0
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // b0
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // c0
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // d0
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // e0
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // f0
+};
+#define LEX_IS(c, cls) (fbjs_lex_class[static_cast<unsigned char>(c)] & (cls))
+
+// The flex rules read with yyinput() into a char, so a 0xff byte ends a string
+// or comment just like the end of input does. Same here.
+static const char LEX_EOF = static_cast<char>(EOF);
+
+// Keywords by length; fbjs_lex_keyword_index[len] is the first of that length
+struct fbjs_lex_keyword_t {
+  const char* name;
+  int tok;
+};
+static const fbjs_lex_keyword_t fbjs_lex_keywords[] = {
+  {"do", t_DO}, {"if", t_IF}, {"in", t_IN},
+  {"for", t_FOR}, {"new", t_NEW}, {"try", t_TRY}, {"var", t_VAR},
+  {"case", t_CASE}, {"else", t_ELSE}, {"null", t_NULL}, {"this", t_THIS}, {"true", t_TRUE}, {"void", t_VOID},
+  {"with", t_WITH},
+  {"break", t_BREAK}, {"catch", t_CATCH}, {"const", t_CONST}, {"false", t_FALSE}, {"throw", t_THROW},
+  {"while", t_WHILE},
+  {"delete", t_DELETE}, {"return", t_RETURN}, {"switch", t_SWITCH}, {"typeof", t_TYPEOF},
+  {"default", t_DEFAULT}, {"finally", t_FINALLY},
+  {"continue", t_CONTINUE}, {"function", t_FUNCTION},
+  {"instanceof", t_INSTANCEOF},
+};
+static const unsigned char fbjs_lex_keyword_index[] = {0, 0, 0, 3, 7, 14, 20, 24, 26, 28, 28, 29};
+
+static int fbjs_lex_keyword(const char* word, size_t len) {
+  if (len + 1 >= sizeof(fbjs_lex_keyword_index)) {
+    return 0;
+  }
+  for (size_t ii = fbjs_lex_keyword_index[len]; ii < fbjs_lex_keyword_index[len + 1]; ++ii) {
+    if (fbjs_lex_keywords[ii].name[0] == word[0] && memcmp(fbjs_lex_keywords[ii].name, word, len) == 0) {
+      return fbjs_lex_keywords[ii].tok;
+    }
+  }
+  return 0;
+}
+
+//
+// Runs of identifier characters and whitespace go 16 bytes at a time where
+// SSE2 is around, anything else (and the tail of the input) a byte at a time.
+static inline const char* fbjs_lex_skip_word(const char* p, const char* end) {
+#ifdef __SSE2__
+  const __m128i lower = _mm_set1_epi8(0x20);
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i folded = _mm_or_si128(v, lower);
+
+    // Signed compares, so nothing at or above 0x80 lands in a range
+    __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(folded, _mm_set1_epi8('a' - 1)),
+      _mm_cmplt_epi8(folded, _mm_set1_epi8('z' + 1)));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+      _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    __m128i other = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('$')), _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+    unsigned int miss = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), other)) ^ 0xffff;
+    if (miss) {
+      return p + __builtin_ctz(miss);
+    }
+    p += 16;
+  }
+#endif
+  while (p < end && LEX_IS(*p, LEX_WORD)) {
+    ++p;
+  }
+  return p;
+}
+
+static inline const char* fbjs_lex_skip_space(const char* p, const char* end) {
+#ifdef __SSE2__
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+
+    // \t \x0b \x0c \r, which is \t through \r without \n
+    __m128i control = _mm_andnot_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+      _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1))));
+    __m128i space = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+      _mm_cmpeq_epi8(v, _mm_set1_epi8(static_cast<char>(0xa0))));
+    unsigned int miss = _mm_movemask_epi8(_mm_or_si128(control, space)) ^ 0xffff;
+    if (miss) {
+      return p + __builtin_ctz(miss);
+    }
+    p += 16;
+  }
+#endif
+  while (p < end && LEX_IS(*p, LEX_SPACE)) {
+    ++p;
+  }
+  return p;
+}
+
+static inline const char* fbjs_lex_skip(const char* p, const char* end, unsigned char cls) {
+  while (p < end && LEX_IS(*p, cls)) {
+    ++p;
+  }
+  return p;
+}
+
+//
+// First byte in a string literal that needs a look: the quote, a backslash, a
+// line break or LEX_EOF.
+static inline const char* fbjs_lex_find_string_stop(const char* p, const char* end, char quote) {
+#ifdef __SSE2__
+  const __m128i q = _mm_set1_epi8(quote);
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i lf = _mm_set1_epi8('\n');
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i eof = _mm_set1_epi8(LEX_EOF);
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, q), _mm_cmpeq_epi8(v, backslash)),
+      _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)), _mm_cmpeq_epi8(v, eof)));
+    unsigned int mask = _mm_movemask_epi8(hit);
+    if (mask) {
+      return p + __builtin_ctz(mask);
+    }
+    p += 16;
+  }
+#endif
+  for (; p < end; ++p) {
+    char c = *p;
+    if (c == quote || c == '\\' || c == '\n' || c == '\r' || c == LEX_EOF) {
+      return p;
+    }
+  }
+  return end;
+}
+
+// Same for block comments: '*', '\n' or LEX_EOF
+static inline const char* fbjs_lex_find_comment_stop(const char* p, const char* end) {
+#ifdef __SSE2__
+  const __m128i star = _mm_set1_epi8('*');
+  const __m128i lf = _mm_set1_epi8('\n');
+  const __m128i eof = _mm_set1_epi8(LEX_EOF);
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    unsigned int mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, star),
+      _mm_cmpeq_epi8(v, lf)), _mm_cmpeq_epi8(v, eof)));
+    if (mask) {
+      return p + __builtin_ctz(mask);
+    }
+    p += 16;
+  }
+#endif
+  for (; p < end; ++p) {
+    char c = *p;
+    if (c == '*' || c == '\n' || c == LEX_EOF) {
+      return p;
+    }
+  }
+  return end;
+}
+
+// Scanner state for one call of fbjs_fast_lex
+struct fbjs_lexer_t {
+  fbjs_parse_extra* extra;
+  YYSTYPE* yylval;
+  YYLTYPE* yylloc;
+  const char* input;
+  const char* end;
+  const char* p;
+  const char* start; // where the rule being matched began
+  size_t start_line_start; // extra->line_start as of `start`
+  int state;
+  bool virtual_newline; // the byte at p reads as '\n', flex's unput() after a comment
+};
+
+// parsertok() from parser.ll, less the XML bits
+static int fbjs_lex_token(fbjs_lexer_t& lex, int tok) {
+  switch (tok) {
+    case t_IDENTIFIER:
+    case t_NUMBER:
+    case t_STRING:
+    case t_REGEX:
+    case t_INCR:
+    case t_DECR:
+    case t_RBRACKET:
+    case t_RPAREN:
+    case t_FALSE:
+    case t_NULL:
+    case t_THIS:
+    case t_TRUE:
+      lex.state = FBJS_LEX_INITIAL;
+      break;
+    case t_CONTINUE:
+    case t_BREAK:
+    case t_RETURN:
+    case t_THROW:
+      lex.state = FBJS_LEX_NO_LINEBREAK;
+      break;
+    case t_PERIOD:
+      lex.state = FBJS_LEX_DOT;
+      break;
+    default:
+      lex.state = FBJS_LEX_IDENTIFIER;
+      break;
+  }
+  lex.extra->last_tok = tok;
+  lex.extra->last_tok_xml = false;
+  return tok;
+}
+
+// Step over the '\n' at p, which is the whole match of one of the \n rules
+static inline void fbjs_lex_newline(fbjs_lexer_t& lex) {
+  if (lex.virtual_newline) {
+    lex.virtual_newline = false;
+  } else {
+    lex.extra->line_start = lex.p - lex.input + 1;
+  }
+  ++lex.p;
+  ++lex.yylloc->first_line;
+}
+
+//
+// The "/*" rule, p is just past the opener. Returns false if the input ran out
+// first, which the rule answers by returning 0.
+static bool fbjs_lex_block_comment(fbjs_lexer_t& lex) {
+  bool newline = false;
+  const char* p = lex.p;
+  const char* end = lex.end;
+  bool closed = false;
+  while (!closed) {
+    p = fbjs_lex_find_comment_stop(p, end);
+    if (p == end) {
+      break;
+    }
+    char c = *p++;
+    if (c == '*') {
+      while (p < end && *p == '*') {
+        ++p;
+      }
+      if (p == end) {
+        break;
+      }
+      c = *p++;
+      if (c == '/') {
+        closed = true;
+        continue;
+      }
+    }
+    if (c == '\n') {
+      ++lex.yylloc->first_line;
+      lex.extra->line_start = p - lex.input;
+      newline = true;
+    } else if (c == LEX_EOF) {
+      break;
+    }
+  }
+  lex.p = p;
+  if (!closed) {
+    return false;
+  }
+
+  // See the rule for why a comment spanning lines reads as a newline
+  if (newline) {
+    --lex.yylloc->first_line;
+    --lex.p;
+    lex.virtual_newline = true;
+  }
+  return true;
+}
+
+//
+// "for each" and "default xml namespace" take any whitespace and newlines
+// between the words. Matches one separator run and `word` at p.
+static const char* fbjs_lex_phrase(const char* p, const char* end, const char* word, size_t len) {
+  const char* q = p;
+  while (q < end && (LEX_IS(*q, LEX_SPACE) || *q == '\n')) {
+    ++q;
+  }
+  if (q == p || static_cast<size_t>(end - q) < len || memcmp(q, word, len) != 0) {
+    return NULL;
+  }
+  return q + len;
+}
+
+// Line bookkeeping for a token that went over newlines, like the phrases above
+static void fbjs_lex_count_lines(fbjs_lexer_t& lex, const char* p, const char* end) {
+  for (; p < end; ++p) {
+    if (*p == '\n') {
+      ++lex.yylloc->first_line;
+      lex.extra->line_start = p - lex.input + 1;
+    }
+  }
+}
+
+enum fbjs_lex_number_enum {
+  LEX_NUMBER_HEX,
+  LEX_NUMBER_OCTAL,
+  LEX_NUMBER_EXPONENT,
+  LEX_NUMBER_DECIMAL,
+};
+
+//
+// Longest match of the four number rules at p, the earlier rule winning a tie
+// like flex would have it. Returns NULL if none of them match.
+static const char* fbjs_lex_number(const char* p, const char* end, fbjs_lex_number_enum* kind) {
+  const char* best = NULL;
+
+  // 0x[a-fA-F0-9]+
+  if (end - p > 2 && p[0] == '0' && p[1] == 'x' && LEX_IS(p[2], LEX_HEX)) {
+    best = fbjs_lex_skip(p + 3, end, LEX_HEX);
+    *kind = LEX_NUMBER_HEX;
+  }
+
+  // 0[0-7]+
+  if (end - p > 1 && p[0] == '0' && LEX_IS(p[1], LEX_OCTAL)) {
+    const char* q = fbjs_lex_skip(p + 2, end, LEX_OCTAL);
+    if (q > best) {
+      best = q;
+      *kind = LEX_NUMBER_OCTAL;
+    }
+  }
+
+  // [0-9]*\.?[0-9]+[eE][\-+]?[0-9]{1,3}, the mantissa can only end where the
+  // digits do
+  const char* digits = fbjs_lex_skip(p, end, LEX_DIGIT);
+  const char* fraction = NULL;
+  if (digits < end && *digits == '.') {
+    const char* q = fbjs_lex_skip(digits + 1, end, LEX_DIGIT);
+    if (q > digits + 1) {
+      fraction = q;
+    }
+  }
+  const char* mantissa = fraction ? fraction : (digits > p ? digits : NULL);
+  if (mantissa && mantissa < end && (*mantissa == 'e' || *mantissa == 'E')) {
+    const char* q = mantissa + 1;
+    if (q < end && (*q == '-' || *q == '+')) {
+      ++q;
+    }
+    const char* exponent = q;
+    while (q < end && q - exponent < 3 && LEX_IS(*q, LEX_DIGIT)) {
+      ++q;
+    }
+    if (q > exponent && q > best) {
+      best = q;
+      *kind = LEX_NUMBER_EXPONENT;
+    }
+  }
+
+  // [0-9]+\.? | [0-9]*\.[0-9]+
+  const char* decimal = fraction;
+  if (!decimal && digits > p) {
+    decimal = digits < end && *digits == '.' ? digits + 1 : digits;
+  }
+  if (decimal > best) {
+    best = decimal;
+    *kind = LEX_NUMBER_DECIMAL;
+  }
+  return best;
+}
+
+// The same conversions the flex rules use, they want a terminated string
+static double fbjs_lex_number_value(const char* p, size_t len, fbjs_lex_number_enum kind) {
+  char buf[64];
+  string big;
+  const char* text = buf;
+  if (len < sizeof(buf)) {
+    memcpy(buf, p, len);
+    buf[len] = 0;
+  } else {
+    big.assign(p, len);
+    text = big.c_str();
+  }
+  unsigned int val;
+  switch (kind) {
+    case LEX_NUMBER_HEX:
+      sscanf(text, "%x", &val);
+      return (double)val;
+    case LEX_NUMBER_OCTAL:
+      sscanf(text, "%o", &val);
+      return (double)val;
+    case LEX_NUMBER_EXPONENT:
+      return strtod(text, NULL);
+    case LEX_NUMBER_DECIMAL:
+    default:
+      return atof(text);
+  }
+}
+
+//
+// The quote rule. The raw value keeps the quotes and escapes as written, minus
+// line continuations; a bare line break gives back everything but the text
+// scanned so far, which is yyless(0) in the flex rule. The decoded value comes
+// for free unless the scan ran into a backslash.
+static int fbjs_lex_string(fbjs_lexer_t& lex) {
+  const char* open = lex.p;
+  const char* end = lex.end;
+  char quote = *open;
+  size_t line_start = lex.extra->line_start;
+  string str; // only used once a continuation leaves a hole in the text
+  const char* seg = open; // text from here on is still to be added to str
+  const char* stop; // end of the value
+  const char* p = open + 1;
+  bool escaped = false; // whether the value needs NodeStringLiteral::decode
+  while (true) {
+    const char* q = fbjs_lex_find_string_stop(p, end, quote);
+    if (q == end) {
+      stop = p = end;
+      break;
+    }
+    char c = *q;
+    if (c == quote) {
+      stop = p = q + 1;
+      break;
+    } else if (c == LEX_EOF) {
+      stop = q;
+      p = q + 1;
+      break;
+    } else if (c == '\n' || c == '\r') {
+      stop = q + 1;
+      p = open;
+      break;
+    }
+
+    // Backslash
+    escaped = true;
+    if (q + 1 == end || q[1] == LEX_EOF) {
+      stop = q + 1;
+      p = open;
+      break;
+    } else if (q[1] == '\r') {
+      str.append(seg, q - seg);
+      if (q + 2 == end) {
+        str += LEX_EOF;
+        seg = p = end;
+      } else if (q[2] == '\n') {
+        lex.extra->line_start = q + 3 - lex.input;
+        seg = p = q + 3;
+      } else {
+        seg = q + 2;
+        p = q + 3;
+        if (q[2] == quote) {
+          stop = p;
+          break;
+        }
+      }
+    } else if (q[1] == '\n') {
+      str.append(seg, q - seg);
+      lex.extra->line_start = q + 2 - lex.input;
+      seg = p = q + 2;
+    } else {
+      p = q + 2;
+    }
+  }
+  if (p == open) {
+    lex.extra->line_start = line_start;
+  }
+  lex.p = p;
+  const char* raw = seg;
+  size_t len = stop - seg;
+  if (!str.empty()) {
+    str.append(seg, stop - seg);
+    raw = str.data();
+    len = str.size();
+  }
+  lex.yylval->atom_duple[0] = lex.extra->atoms->intern(raw, len);
+  if (escaped) {
+    lex.yylval->atom_duple[1] = lex.extra->atoms->intern(NodeStringLiteral::decode(raw, len));
+  } else {
+    // Nothing to decode: the value is what's between the quotes
+    size_t inner = len - 1;
+    if (inner && raw[len - 1] == quote) {
+      --inner;
+    }
+    lex.yylval->atom_duple[1] = lex.extra->atoms->intern(raw + 1, inner);
+  }
+  return fbjs_lex_token(lex, t_STRING);
+}
+
+//
+// The REGEX rule, (\[([^\]\\\n]+|\\.)+\]|\\.|[^\/\\\n])*"/"[A-Za-z]*, run as a
+// little NFA since '[' may open a class or just be itself. Returns the end of
+// the longest match or NULL.
+static const char* fbjs_lex_regex(const char* p, const char* end) {
+  enum {
+    OUTSIDE = 0x01,
+    OUTSIDE_ESCAPE = 0x02,
+    CLASS_OPEN = 0x04, // just after '[', which needs at least one member
+    CLASS = 0x08,
+    CLASS_ESCAPE = 0x10,
+    FLAGS = 0x20,
+  };
+  const char* best = NULL;
+  unsigned int states = OUTSIDE;
+  while (states && p < end) {
+    char c = *p++;
+    if (c == '\n') {
+      break;
+    }
+    unsigned int next = 0;
+    if (states & OUTSIDE) {
+      if (c == '[') {
+        next |= OUTSIDE | CLASS_OPEN;
+      } else if (c == '\\') {
+        next |= OUTSIDE_ESCAPE;
+      } else if (c == '/') {
+        next |= FLAGS;
+      } else {
+        next |= OUTSIDE;
+      }
+    }
+    if (states & OUTSIDE_ESCAPE) {
+      next |= OUTSIDE;
+    }
+    if (states & (CLASS_OPEN | CLASS)) {
+      if (c == '\\') {
+        next |= CLASS_ESCAPE;
+      } else if (c != ']') {
+        next |= CLASS;
+      } else if (states & CLASS) {
+        next |= OUTSIDE;
+      }
+    }
+    if (states & CLASS_ESCAPE) {
+      next |= CLASS;
+    }
+    if ((states & FLAGS) && LEX_IS(c, LEX_FLAG)) {
+      next |= FLAGS;
+    }
+    states = next;
+    if (states & FLAGS) {
+      best = p;
+    }
+  }
+  return best;
+}
+
+static int fbjs_lex_punctuator(fbjs_lexer_t& lex) {
+  const char* p = lex.p;
+  const char* end = lex.end;
+  char next = p + 1 < end ? p[1] : 0;
+  char third = p + 2 < end ? p[2] : 0;
+  int tok;
+  size_t len = 1;
+  switch (*p) {
+    case '[': tok = t_LBRACKET; break;
+    case ']': tok = t_RBRACKET; break;
+    case ';': tok = t_SEMICOLON; break;
+    case ',': tok = t_COMMA; break;
+    case '?': tok = t_PLING; break;
+    case '~': tok = t_BIT_NOT; break;
+    case '@': tok = t_XML_ATTRIBUTE; break;
+    case ':':
+      if (next == ':') {
+        tok = t_XML_QUALIFIER, len = 2;
+      } else {
+        tok = t_COLON;
+      }
+      break;
+    case '&':
+      if (next == '&') {
+        tok = t_AND, len = 2;
+      } else if (next == '=') {
+        tok = t_BIT_AND_ASSIGN, len = 2;
+      } else {
+        tok = t_BIT_AND;
+      }
+      break;
+    case '|':
+      if (next == '|') {
+        tok = t_OR, len = 2;
+      } else if (next == '=') {
+        tok = t_BIT_OR_ASSIGN, len = 2;
+      } else {
+        tok = t_BIT_OR;
+      }
+      break;
+    case '=':
+      if (next == '=') {
+        if (third == '=') {
+          tok = t_STRICT_EQUAL, len = 3;
+        } else {
+          tok = t_EQUAL, len = 2;
+        }
+      } else {
+        tok = t_ASSIGN;
+      }
+      break;
+    case '!':
+      if (next == '=') {
+        if (third == '=') {
+          tok = t_STRICT_NOT_EQUAL, len = 3;
+        } else {
+          tok = t_NOT_EQUAL, len = 2;
+        }
+      } else {
+        tok = t_NOT;
+      }
+      break;
+    case '<':
+      if (next == '<') {
+        if (third == '=') {
+          tok = t_LSHIFT_ASSIGN, len = 3;
+        } else {
+          tok = t_LSHIFT, len = 2;
+        }
+      } else if (next == '=') {
+        tok = t_LESS_THAN_EQUAL, len = 2;
+      } else {
+        tok = t_LESS_THAN;
+      }
+      break;
+    case '>':
+      if (next == '>') {
+        if (third == '>') {
+          if (p + 3 < end && p[3] == '=') {
+            tok = t_RSHIFT3_ASSIGN, len = 4;
+          } else {
+            tok = t_RSHIFT3, len = 3;
+          }
+        } else if (third == '=') {
+          tok = t_RSHIFT_ASSIGN, len = 3;
+        } else {
+          tok = t_RSHIFT, len = 2;
+        }
+      } else if (next == '=') {
+        tok = t_GREATER_THAN_EQUAL, len = 2;
+      } else {
+        tok = t_GREATER_THAN;
+      }
+      break;
+    case '+':
+      if (next == '+') {
+        tok = t_INCR, len = 2;
+      } else if (next == '=') {
+        tok = t_PLUS_ASSIGN, len = 2;
+      } else {
+        tok = t_PLUS;
+      }
+      break;
+    case '-':
+      if (next == '-') {
+        tok = t_DECR, len = 2;
+      } else if (next == '=') {
+        tok = t_MINUS_ASSIGN, len = 2;
+      } else {
+        tok = t_MINUS;
+      }
+      break;
+    case '*':
+      tok = next == '=' ? (len = 2, t_MULT_ASSIGN) : t_MULT;
+      break;
+    case '%':
+      tok = next == '=' ? (len = 2, t_MOD_ASSIGN) : t_MOD;
+      break;
+    case '^':
+      tok = next == '=' ? (len = 2, t_BIT_XOR_ASSIGN) : t_BIT_XOR;
+      break;
+    case '/':
+      tok = next == '=' && lex.state == FBJS_LEX_INITIAL ? (len = 2, t_DIV_ASSIGN) : t_DIV;
+      break;
+    default:
+      return 0;
+  }
+  lex.p += len;
+  return fbjs_lex_token(lex, tok);
+}
+
+//
+// One call of the flex scanner: skip whatever the rules skip and return the
+// next token, switching start conditions along the way.
+static int fbjs_lex_scan(fbjs_lexer_t& lex) {
+  fbjs_parse_extra* extra = lex.extra;
+  const char* end = lex.end;
+
+  // YY_USER_ACTION, the first rule to match returns 0
+  if (extra->terminated && lex.p < end) {
+    return 0;
+  }
+  while (true) {
+    const char* p = lex.start = lex.p;
+    lex.start_line_start = extra->line_start;
+    if (p == end) {
+      if (extra->last_tok != t_VIRTUAL_SEMICOLON && extra->last_tok != t_SEMICOLON) {
+        return fbjs_lex_token(lex, t_VIRTUAL_SEMICOLON);
+      }
+      return 0;
+    }
+    char c = lex.virtual_newline ? '\n' : *p;
+    char next = p + 1 < end ? p[1] : 0;
+
+    // Comments and whitespace, in every state but REGEX
+    if (lex.state != FBJS_LEX_REGEX && c != '\n') {
+      if (LEX_IS(c, LEX_SPACE)) {
+        const char* q = fbjs_lex_skip_space(p + 1, end);
+
+        // NO_LINEBREAK's "." wins a tie with a single whitespace character
+        if (lex.state == FBJS_LEX_NO_LINEBREAK && q == p + 1) {
+          lex.state = FBJS_LEX_IDENTIFIER;
+        }
+        lex.p = q;
+        continue;
+      } else if ((c == '/' && next == '/') || (c == '<' && end - p >= 4 && memcmp(p, "<!--", 4) == 0)) {
+        const char* q = static_cast<const char*>(memchr(p, '\n', end - p));
+        lex.p = q ? q : end;
+        continue;
+      } else if (c == '/' && next == '*') {
+        lex.p = p + 2;
+        if (!fbjs_lex_block_comment(lex)) {
+          return 0;
+        }
+        continue;
+      }
+    }
+
+    switch (lex.state) {
+      case FBJS_LEX_NO_LINEBREAK:
+        lex.state = FBJS_LEX_IDENTIFIER;
+        if (c == '\n') {
+          fbjs_lex_newline(lex);
+          return t_VIRTUAL_SEMICOLON;
+        }
+
+        // Anything longer "." would lose to scans the same in IDENTIFIER
+        continue;
+
+      case FBJS_LEX_VIRTUAL_SEMICOLON:
+        if (c == '\n') {
+          fbjs_lex_newline(lex);
+          continue;
+        } else if (LEX_IS(c, LEX_WORD)) {
+          const char* q = fbjs_lex_skip_word(p + 1, end);
+          int tok = fbjs_lex_keyword(p, q - p);
+          int last_tok = extra->last_tok;
+          int last_paren_tok = extra->last_paren_tok;
+          if (tok == t_CATCH || tok == t_FINALLY || tok == t_IN || tok == t_INSTANCEOF ||
+              (tok == t_ELSE &&
+               ((last_tok == t_RPAREN &&
+                 (last_paren_tok == t_IF || last_paren_tok == t_FOR || last_paren_tok == t_WHILE)) ||
+                last_tok == t_SEMICOLON || last_tok == t_RCURLY)) ||
+              (tok == t_WHILE &&
+               ((last_tok == t_RPAREN &&
+                 (last_paren_tok == t_IF || last_paren_tok == t_FOR || last_paren_tok == t_WHILE)) ||
+                (last_tok == t_RCURLY && extra->last_curly_tok == t_DO) ||
+                last_tok == t_SEMICOLON || last_tok == t_RCURLY))) {
+            lex.p = q;
+            return fbjs_lex_token(lex, tok);
+          }
+          lex.state = FBJS_LEX_INITIAL;
+          if (tok != t_ELSE && tok != t_WHILE && last_tok == t_RPAREN &&
+              (last_paren_tok == t_IF || last_paren_tok == t_DO || last_paren_tok == t_FOR ||
+               (last_paren_tok == t_WHILE && extra->last_curly_tok != t_DO))) {
+            continue;
+          }
+          return t_VIRTUAL_SEMICOLON;
+        } else if (c == '/' && next == '=') {
+          lex.p = p + 2;
+          return fbjs_lex_token(lex, t_DIV_ASSIGN);
+        }
+        lex.state = extra->virtual_semicolon_last_state;
+        continue;
+
+      case FBJS_LEX_DOT:
+        if (c == '\n') {
+          fbjs_lex_newline(lex);
+          continue;
+        } else if (LEX_IS(c, LEX_IDENT)) {
+          lex.p = fbjs_lex_skip_word(p + 1, end);
+          lex.yylval->atom = extra->atoms->intern(p, lex.p - p);
+          return fbjs_lex_token(lex, t_IDENTIFIER);
+        }
+        lex.state = FBJS_LEX_INITIAL;
+        continue;
+
+      case FBJS_LEX_REGEX: {
+        const char* q = fbjs_lex_regex(p, end);
+        if (q == NULL) {
+          if (c == '\n') {
+            extra->line_start = p - lex.input + 1;
+          }
+          lex.p = p + 1;
+          return fbjs_lex_token(lex, t_UNTERMINATED_REGEX_LITERAL);
+        }
+        const char* flags = q;
+        while (*--flags != '/');
+        lex.yylval->atom_duple[0] = extra->atoms->intern(p, flags - p);
+        lex.yylval->atom_duple[1] = extra->atoms->intern(flags + 1, q - flags - 1);
+        lex.p = q;
+
+        // The literal starts at the '/' that got us here
+        lex.start = p - 1;
+        return fbjs_lex_token(lex, t_REGEX);
+      }
+
+      default:
+        break;
+    }
+
+    // INITIAL and IDENTIFIER
+    if (c == '\n') {
+      fbjs_lex_newline(lex);
+      switch (extra->last_tok) {
+        case t_IDENTIFIER:
+        case t_NUMBER:
+        case t_STRING:
+        case t_REGEX:
+        case t_TRUE:
+        case t_FALSE:
+        case t_RPAREN:
+        case t_RCURLY:
+        case t_RBRACKET:
+        case t_NULL:
+        case t_THIS:
+          extra->virtual_semicolon_last_state = lex.state;
+          lex.state = FBJS_LEX_VIRTUAL_SEMICOLON;
+          break;
+      }
+      continue;
+    }
+    unsigned char cls = fbjs_lex_class[static_cast<unsigned char>(c)];
+    if (cls & LEX_IDENT) {
+      const char* q = fbjs_lex_skip_word(p + 1, end);
+      int tok = fbjs_lex_keyword(p, q - p);
+      if (tok == t_FOR || tok == t_DEFAULT) {
+        const char* phrase = tok == t_FOR ? fbjs_lex_phrase(q, end, "each", 4) :
+          fbjs_lex_phrase(q, end, "xml", 3);
+        if (phrase && tok == t_DEFAULT) {
+          phrase = fbjs_lex_phrase(phrase, end, "namespace", 9);
+        }
+        if (phrase) {
+          fbjs_lex_count_lines(lex, q, phrase);
+          lex.p = phrase;
+          return fbjs_lex_token(lex, tok == t_FOR ? t_FOR_EACH : t_XML_DEFAULT_NAMESPACE);
+        }
+      }
+      lex.p = q;
+      if (tok) {
+        return fbjs_lex_token(lex, tok);
+      }
+      lex.yylval->atom = extra->atoms->intern(p, q - p);
+      return fbjs_lex_token(lex, t_IDENTIFIER);
+    } else if ((cls & LEX_DIGIT) || (c == '.' && LEX_IS(next, LEX_DIGIT))) {
+      fbjs_lex_number_enum kind;
+      const char* q = fbjs_lex_number(p, end, &kind);
+      lex.yylval->number = fbjs_lex_number_value(p, q - p, kind);
+      lex.p = q;
+      return fbjs_lex_token(lex, t_NUMBER);
+    }
+    switch (c) {
+      case '\'':
+      case '"':
+        return fbjs_lex_string(lex);
+      case '{':
+        extra->curly_stack.push(extra->last_tok);
+        lex.p = p + 1;
+        return fbjs_lex_token(lex, t_LCURLY);
+      case '}':
+        if (extra->last_tok != t_LCURLY && extra->last_tok != t_SEMICOLON && extra->last_tok != t_VIRTUAL_SEMICOLON) {
+          return fbjs_lex_token(lex, t_VIRTUAL_SEMICOLON);
+        }
+        if (extra->curly_stack.empty()) {
+          extra->last_curly_tok = 0;
+        } else {
+          extra->last_curly_tok = extra->curly_stack.top();
+          extra->curly_stack.pop();
+        }
+        lex.p = p + 1;
+        return fbjs_lex_token(lex, t_RCURLY);
+      case '(':
+        extra->paren_stack.push(extra->last_tok);
+        lex.p = p + 1;
+        return fbjs_lex_token(lex, t_LPAREN);
+      case ')':
+        if (!extra->paren_stack.empty()) {
+          extra->last_paren_tok = extra->paren_stack.top();
+          extra->paren_stack.pop();
+        }
+        lex.p = p + 1;
+        return fbjs_lex_token(lex, t_RPAREN);
+      case '.':
+        if (next == '.') {
+          lex.p = p + 2;
+          return fbjs_lex_token(lex, t_XML_DESCENDENT);
+        }
+        lex.p = p + 1;
+        return fbjs_lex_token(lex, t_PERIOD);
+      case '/':
+        if (lex.state == FBJS_LEX_IDENTIFIER) {
+          lex.p = p + 1;
+          lex.state = FBJS_LEX_REGEX;
+          continue;
+        }
+        break;
+    }
+    int tok = fbjs_lex_punctuator(lex);
+    if (tok) {
+      return tok;
+    }
+
+    // Syntax error!
+    lex.p = p + 1;
+    return c;
+  }
+}
+
+//
+// Scans the next token into `tok` like yylex() would. Returns false without
+// touching anything if the scanner is in a start condition only flex knows.
+bool fbjs_fast_lex(void* scanner, fbjs_parse_extra* extra, YYSTYPE* yylval, YYLTYPE* yylloc, int* tok) {
+  int state = fbjs_lexer_start(scanner);
+  if (state > FBJS_LEX_REGEX) {
+    return false;
+  }
+  fbjs_lexer_t lex;
+  lex.extra = extra;
+  lex.yylval = yylval;
+  lex.yylloc = yylloc;
+  lex.input = extra->input;
+  lex.end = extra->input + extra->input_length;
+  lex.p = lex.start = extra->input + extra->input_pos;
+  lex.start_line_start = extra->line_start;
+  lex.state = state;
+  lex.virtual_newline = false;
+  *tok = fbjs_lex_scan(lex);
+  if (lex.state != state) {
+    fbjs_lexer_begin(scanner, lex.state);
+  }
+
+  // Same range yylex() gives flex's tokens
+  extra->input_pos = lex.p - lex.input;
+  yylloc->last_byte = extra->input_pos;
+  if (*tok) {
+    yylloc->first_byte = lex.start - lex.input;
+    yylloc->first_column = fbjs_input_memory_column(extra, lex.start_line_start, yylloc->first_byte);
+  } else {
+    yylloc->first_byte = yylloc->last_byte;
+    yylloc->first_column = fbjs_input_memory_column(extra, extra->line_start, yylloc->first_byte);
+  }
+  return true;
+}
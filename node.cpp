@@ -19,59 +19,718 @@
 */
 
 #include "node.hpp"
+#include "number.hpp"
+#include "source_map.hpp"
+#include "stats.hpp"
+#include <string.h>
+#include <map>
+#include <memory>
 
-extern "C" char* g_fmt(char*, double);
 using namespace std;
 using namespace fbjs;
 
+//
+// NodeArena: every allocation (arena or heap) is prefixed with a small header
+// recording who owns it, so operator delete can tell the two apart.
+struct node_alloc_header_t {
+  NodeArena* arena;
+  size_t index;
+};
+static const size_t NODE_ALLOC_HEADER_SIZE = (sizeof(node_alloc_header_t) + 15) & ~(size_t)15;
+static const size_t NODE_ARENA_CHUNK_SIZE = 64 * 1024;
+
+static inline node_alloc_header_t* node_alloc_header(const void* ptr) {
+  return reinterpret_cast<node_alloc_header_t*>(const_cast<char*>(static_cast<const char*>(ptr)) - NODE_ALLOC_HEADER_SIZE);
+}
+
+NodeArena::NodeArena() : _cursor(NULL), _limit(NULL), _tearing_down(false) {}
+
+NodeArena::~NodeArena() {
+
+  // Run destructors for everything that wasn't explicitly deleted. ~Node won't
+  // recurse into children owned by a tearing down arena, so this is flat.
+  _tearing_down = true;
+  for (vector<void*>::iterator node = _nodes.begin(); node != _nodes.end(); ++node) {
+    if (*node != NULL) {
+      static_cast<Node*>(*node)->~Node();
+    }
+  }
+  for (vector<char*>::iterator chunk = _chunks.begin(); chunk != _chunks.end(); ++chunk) {
+    free(*chunk);
+  }
+}
+
+void* NodeArena::allocate(size_t size) {
+  size_t total = NODE_ALLOC_HEADER_SIZE + ((size + 15) & ~(size_t)15);
+  if (_cursor == NULL || (size_t)(_limit - _cursor) < total) {
+    size_t chunk_size = total > NODE_ARENA_CHUNK_SIZE ? total : NODE_ARENA_CHUNK_SIZE;
+    char* chunk = static_cast<char*>(malloc(chunk_size));
+    if (chunk == NULL) {
+      throw bad_alloc();
+    }
+    _chunks.push_back(chunk);
+    _cursor = chunk;
+    _limit = chunk + chunk_size;
+  }
+  node_alloc_header_t* header = reinterpret_cast<node_alloc_header_t*>(_cursor);
+  void* ptr = _cursor + NODE_ALLOC_HEADER_SIZE;
+  _nodes.push_back(ptr);
+  header->arena = this;
+  header->index = _nodes.size() - 1;
+  _cursor += total;
+  return ptr;
+}
+
+void NodeArena::reserve(size_t nodes) {
+  _nodes.reserve(_nodes.size() + nodes);
+}
+
+void NodeArena::release(size_t index) {
+  _nodes[index] = NULL;
+}
+
+//
+// From here on ~Node leaves this arena's nodes alone, so heap nodes holding
+// some can be deleted before the arena is
+void NodeArena::beginTeardown() {
+  _tearing_down = true;
+}
+
+bool NodeArena::tearingDown() const {
+  return _tearing_down;
+}
+
+//
+// node_list_t
+node_list_t::node_list_t(const node_list_t& that) : _data(_inline), _size(0), _capacity(inline_capacity) {
+  *this = that;
+}
+
+node_list_t& node_list_t::operator= (const node_list_t& that) {
+  if (this != &that) {
+    this->reserve(that._size);
+    memcpy(_data, that._data, that._size * sizeof(Node*));
+    _size = that._size;
+  }
+  return *this;
+}
+
+void node_list_t::reserve(size_t capacity) {
+  if (capacity <= _capacity) {
+    return;
+  }
+  Node** data = static_cast<Node**>(malloc(capacity * sizeof(Node*)));
+  if (data == NULL) {
+    throw bad_alloc();
+  }
+  memcpy(data, _data, _size * sizeof(Node*));
+  if (_data != _inline) {
+    free(_data);
+  }
+  _data = data;
+  _capacity = capacity;
+}
+
+node_list_t::iterator node_list_t::insert(iterator pos, Node* node) {
+  size_t index = pos._index;
+  if (_size == _capacity) {
+    this->reserve(_capacity * 2);
+  }
+  memmove(_data + index + 1, _data + index, (_size - index) * sizeof(Node*));
+  _data[index] = node;
+  ++_size;
+  return iterator(this, index);
+}
+
+node_list_t::iterator node_list_t::erase(iterator pos) {
+  size_t index = pos._index;
+  memmove(_data + index, _data + index + 1, (_size - index - 1) * sizeof(Node*));
+  --_size;
+  return iterator(this, index);
+}
+
+//
+// node_string_t
+node_string_t::node_string_t(const string& value) : _payload(new payload_t) {
+  _payload->refs = 1;
+  _payload->value = value;
+  NodeStats* stats = NodeStats::current();
+  if (stats != NULL) {
+    stats->string_bytes += value.size();
+  }
+}
+
+node_string_t::node_string_t(const node_string_t& that) : _payload(that._payload) {
+  __sync_add_and_fetch(&_payload->refs, 1);
+}
+
+node_string_t::~node_string_t() {
+  if (__sync_sub_and_fetch(&_payload->refs, 1) == 0) {
+    delete _payload;
+  }
+}
+
+//
+// NodeAtomTable: open addressed set of interned strings
+NodeAtomTable::NodeAtomTable() {
+  slot_t empty = {0, NULL};
+  _slots.resize(256, empty);
+  pthread_mutex_init(&_lock, NULL);
+}
+
+NodeAtomTable::~NodeAtomTable() {
+  pthread_mutex_destroy(&_lock);
+}
+
+static inline size_t node_atom_hash(const char* str, size_t len) {
+  size_t hash = 2166136261u;
+  for (size_t ii = 0; ii < len; ++ii) {
+    hash = (hash ^ (unsigned char)str[ii]) * 16777619u;
+  }
+  return hash;
+}
+
+void NodeAtomTable::grow() {
+  slot_t empty = {0, NULL};
+  vector<slot_t> slots(_slots.size() * 2, empty);
+  size_t mask = slots.size() - 1;
+  for (vector<slot_t>::iterator ii = _slots.begin(); ii != _slots.end(); ++ii) {
+    if (ii->atom != NULL) {
+      size_t jj = ii->hash & mask;
+      while (slots[jj].atom != NULL) {
+        jj = (jj + 1) & mask;
+      }
+      slots[jj] = *ii;
+    }
+  }
+  _slots.swap(slots);
+}
+
+const string* NodeAtomTable::intern(const char* str, size_t len) {
+  size_t hash = node_atom_hash(str, len);
+  size_t mask = _slots.size() - 1;
+  size_t ii = hash & mask;
+  while (_slots[ii].atom != NULL) {
+    const string* atom = _slots[ii].atom;
+    if (_slots[ii].hash == hash && atom->size() == len && memcmp(atom->data(), str, len) == 0) {
+      return atom;
+    }
+    ii = (ii + 1) & mask;
+  }
+
+  // Keep the load factor under 1/2
+  NodeStats* stats = NodeStats::current();
+  if (stats != NULL) {
+    stats->string_bytes += len;
+  }
+  _atoms.push_back(string(str, len));
+  const string* atom = &_atoms.back();
+  _slots[ii].hash = hash;
+  _slots[ii].atom = atom;
+  if (_atoms.size() * 2 > _slots.size()) {
+    this->grow();
+  }
+  return atom;
+}
+
+const string* NodeAtomTable::intern(const string& str) {
+  return this->intern(str.data(), str.size());
+}
+
+const string* NodeAtomTable::internShared(const string& str) {
+  pthread_mutex_lock(&_lock);
+  const string* atom;
+  try {
+    atom = this->intern(str.data(), str.size());
+  } catch (...) {
+    pthread_mutex_unlock(&_lock);
+    throw;
+  }
+  pthread_mutex_unlock(&_lock);
+  return atom;
+}
+
+size_t NodeAtomTable::size() const {
+  return _atoms.size();
+}
+
+//
+// RenderSink
+RenderSink::RenderSink(string& str) : _string(&str), _file(NULL), _callback(NULL), _context(NULL), _pending(0), _len(0),
+  _map(NULL), _stats(NULL), _mark_line(0), _mark_column(0), _offset(0), _scanned(0), _line(1), _line_start(0), _line_surplus(0), _keep_marks(false) {}
+
+RenderSink::RenderSink(FILE* file) : _string(NULL), _file(file), _callback(NULL), _context(NULL), _pending(0), _len(0),
+  _map(NULL), _stats(NULL), _mark_line(0), _mark_column(0), _offset(0), _scanned(0), _line(1), _line_start(0), _line_surplus(0), _keep_marks(false) {}
+
+RenderSink::RenderSink(write_callback_t callback, void* context) : _string(NULL), _file(NULL), _callback(callback), _context(context), _pending(0), _len(0),
+  _map(NULL), _stats(NULL), _mark_line(0), _mark_column(0), _offset(0), _scanned(0), _line(1), _line_start(0), _line_surplus(0), _keep_marks(false) {}
+
+RenderSink::~RenderSink() {
+  try {
+    this->flush();
+  } catch (...) {}
+}
+
+void RenderSink::flush() {
+  if (_len == 0) {
+    return;
+  }
+  size_t len = _len;
+  if (_map) {
+    this->countLines(_buf + _scanned, len - _scanned, _offset + _scanned);
+  }
+  _offset += len;
+  _scanned = 0;
+  _len = 0;
+  if (_string) {
+    _string->append(_buf, len);
+  } else if (_file) {
+    if (fwrite(_buf, 1, len, _file) != len) {
+      throw runtime_error("error writing rendered output");
+    }
+  } else {
+    _callback(_context, _buf, len);
+  }
+}
+
+void RenderSink::writeSlow(const char* data, size_t len) {
+  this->flush();
+  if (len < sizeof(_buf)) {
+    memcpy(_buf, data, len);
+    _len = len;
+    return;
+  }
+  if (_map) {
+    this->countLines(data, len, _offset);
+  }
+  _offset += len;
+  if (_string) {
+    _string->append(data, len);
+  } else if (_file) {
+    if (fwrite(data, 1, len, _file) != len) {
+      throw runtime_error("error writing rendered output");
+    }
+  } else {
+    _callback(_context, data, len);
+  }
+}
+
+void RenderSink::repeat(char c, size_t count) {
+  if (_pending && count) {
+    this->resolvePending(c);
+  }
+  while (count) {
+    if (_len == sizeof(_buf)) {
+      this->flush();
+    }
+    size_t len = min(count, sizeof(_buf) - _len);
+    memset(_buf + _len, c, len);
+    _len += len;
+    count -= len;
+  }
+}
+
+void RenderSink::resolvePending(char next) {
+  unsigned char pending = _pending;
+  _pending = 0;
+  if ((pending & PENDING_SPACE) && next != '{' && next != ' ') {
+    this->put(' ');
+  }
+  if ((pending & PENDING_MARK) && _keep_marks) {
+    kept_mark_t mark = {_offset + _len, _mark_line, _mark_column};
+    _kept_marks.push_back(mark);
+  } else if (pending & PENDING_MARK) {
+    this->countLines(_buf + _scanned, _len - _scanned, _offset + _scanned);
+    _scanned = _len;
+    _map->addMapping(_line, _offset + _len - _line_start - _line_surplus, _mark_line, _mark_column);
+  }
+}
+
+void RenderSink::replay(RenderSink& kept) {
+  kept.flush();
+  const string& data = *kept._string;
+  size_t offset = 0;
+  for (vector<kept_mark_t>::const_iterator ii = kept._kept_marks.begin(); ii != kept._kept_marks.end(); ++ii) {
+    this->write(data.data() + offset, ii->offset - offset);
+    offset = ii->offset;
+    this->mark(ii->line, ii->column);
+  }
+  this->write(data.data() + offset, data.size() - offset);
+  if (kept._pending & PENDING_MARK) {
+    this->mark(kept._mark_line, kept._mark_column);
+  }
+  if (kept._pending & PENDING_SPACE) {
+    this->deferSpace();
+  }
+}
+
+void RenderSink::setSourceMap(SourceMap* map) {
+  _map = map;
+  _pending &= ~PENDING_MARK;
+  _scanned = _len;
+  _line = 1;
+  _line_start = _offset + _len;
+  _line_surplus = 0;
+}
+
+//
+// Advances the output line past any newlines in data, which starts `offset`
+// bytes into the output, and counts the bytes of the last line that aren't a
+// UTF-16 unit of their own
+void RenderSink::countLines(const char* data, size_t len, size_t offset) {
+  const char* end = data + len;
+  const char* line = data;
+  for (const char* ii = data; (ii = static_cast<const char*>(memchr(ii, '\n', end - ii))) != NULL; ++ii) {
+    ++_line;
+    _line_start = offset + (ii - data) + 1;
+    _line_surplus = 0;
+    line = ii + 1;
+  }
+  for (const char* ii = line; ii != end; ++ii) {
+    unsigned char c = *ii;
+    if ((c & 0xc0) == 0x80) {
+      ++_line_surplus;
+    } else if ((c & 0xf8) == 0xf0) {
+      --_line_surplus;
+    }
+  }
+}
+
 //
 // Node: All other nodes inherit from this.
-Node::Node(const unsigned int lineno /* = 0 */) : _lineno(lineno) {}
+Node::Node(const unsigned int lineno /* = 0 */) : _lineno(lineno), _kind(KIND_NODE), _hash_slot(0), _source_begin(0), _source_end(0),
+  _source_line(0), _source_column(0), _hash(0), _hash_epoch(0) {}
+Node::Node(const unsigned int lineno, node_kind_enum kind) : _lineno(lineno), _kind(kind), _hash_slot(0), _source_begin(0), _source_end(0),
+  _source_line(0), _source_column(0), _hash(0), _hash_epoch(0) {}
 
-Node::~Node() {
+//
+// Deleting, cloning and comparing recurse once per level of the tree, but only
+// for the first NODE_RECURSION_LIMIT levels. Below that, the first call on a
+// thread starts an explicit stack and works through it; calls made while it
+// does just push their children on, so no input can run out of native stack.
+static const unsigned int NODE_RECURSION_LIMIT = 256;
+
+struct node_recursion_guard_t {
+  unsigned int& depth;
+  node_recursion_guard_t(unsigned int& depth) : depth(depth) {
+    ++depth;
+  }
+  ~node_recursion_guard_t() {
+    --depth;
+  }
+};
 
-  // Delete all children of this node recursively
+static __thread unsigned int node_delete_depth = 0;
+static __thread vector<Node*>* node_delete_stack = NULL;
+
+Node::~Node() {
+  if (node_delete_depth < NODE_RECURSION_LIMIT) {
+    node_recursion_guard_t guard(node_delete_depth);
+    for (node_list_t::iterator node = this->_childNodes.begin(); node != this->_childNodes.end(); ++node) {
+      NodeArena* arena = Node::arenaOf(*node);
+      if (arena == NULL || !arena->tearingDown()) {
+        delete *node;
+      }
+    }
+    return;
+  }
+  vector<Node*> stack;
+  vector<Node*>* pending = node_delete_stack != NULL ? node_delete_stack : &stack;
   for (node_list_t::iterator node = this->_childNodes.begin(); node != this->_childNodes.end(); ++node) {
-    delete *node;
+    NodeArena* arena = Node::arenaOf(*node);
+    if (*node != NULL && (arena == NULL || !arena->tearingDown())) {
+      pending->push_back(*node);
+    }
+  }
+  if (pending != &stack || stack.empty()) {
+    return;
+  }
+  node_delete_stack = &stack;
+  while (!stack.empty()) {
+    Node* node = stack.back();
+    stack.pop_back();
+    delete node;
+  }
+  node_delete_stack = NULL;
+}
+
+//
+// Set while cloneInto() runs so every clone() under it allocates from the arena
+static __thread NodeArena* node_clone_arena = NULL;
+
+static inline void node_stats_allocated(size_t size) {
+  NodeStats* stats = NodeStats::current();
+  if (stats != NULL) {
+    stats->node_bytes += size;
+  }
+}
+
+void* Node::operator new(size_t size) {
+  node_stats_allocated(size);
+  if (node_clone_arena != NULL) {
+    return node_clone_arena->allocate(size);
+  }
+  node_alloc_header_t* header = static_cast<node_alloc_header_t*>(malloc(NODE_ALLOC_HEADER_SIZE + size));
+  if (header == NULL) {
+    throw bad_alloc();
   }
+  header->arena = NULL;
+  header->index = 0;
+  return reinterpret_cast<char*>(header) + NODE_ALLOC_HEADER_SIZE;
 }
 
+void* Node::operator new(size_t size, NodeArena* arena) {
+  if (arena == NULL) {
+    return Node::operator new(size);
+  }
+  node_stats_allocated(size);
+  return arena->allocate(size);
+}
+
+void Node::operator delete(void* ptr) {
+  if (ptr == NULL) {
+    return;
+  }
+  node_alloc_header_t* header = node_alloc_header(ptr);
+  if (header->arena == NULL) {
+    free(header);
+  } else {
+    header->arena->release(header->index);
+  }
+}
+
+void Node::operator delete(void* ptr, NodeArena* arena) {
+  Node::operator delete(ptr);
+}
+
+NodeArena* Node::arenaOf(const Node* node) {
+  return node == NULL ? NULL : node_alloc_header(node)->arena;
+}
+
+//
+// Past NODE_RECURSION_LIMIT, children are cloned after their parent into NULL
+// placeholders, so a clone() override mustn't look at the children
+// Node::clone() gives it. If a clone() below throws, `node` and whatever was
+// cloned into it so far are deleted.
+struct node_clone_task_t {
+  const Node* source;
+  Node* target;
+  size_t index;
+};
+static __thread unsigned int node_clone_depth = 0;
+static __thread vector<node_clone_task_t>* node_clone_stack = NULL;
+
 Node* Node::clone(Node* node) const {
   if (node == NULL) {
     node = new Node();
   }
-  for (node_list_t::const_iterator i = const_cast<Node*>(this)->childNodes().begin(); i != const_cast<Node*>(this)->childNodes().end(); ++i) {
-    node->appendChild((*i) == NULL ? NULL : (*i)->clone());
+  node->_lineno = this->_lineno;
+  node->_source_begin = this->_source_begin;
+  node->_source_end = this->_source_end;
+  node->_source_line = this->_source_line;
+  node->_source_column = this->_source_column;
+  if (node_clone_depth < NODE_RECURSION_LIMIT) {
+    node_recursion_guard_t guard(node_clone_depth);
+    try {
+      node->_childNodes.reserve(node->_childNodes.size() + this->_childNodes.size());
+      for (node_list_t::const_iterator i = this->_childNodes.begin(); i != this->_childNodes.end(); ++i) {
+        node->appendChild((*i) == NULL ? NULL : (*i)->clone());
+      }
+    } catch (...) {
+      delete node;
+      throw;
+    }
+    return node;
+  }
+  if (this->_childNodes.empty()) {
+    return node;
   }
+  node->invalidateHash();
+
+  // Pushed last to first so the first child is cloned first
+  vector<node_clone_task_t> stack;
+  vector<node_clone_task_t>* pending = node_clone_stack != NULL ? node_clone_stack : &stack;
+  size_t offset = node->_childNodes.size();
+  node->_childNodes.reserve(offset + this->_childNodes.size());
+  for (size_t ii = 0; ii < this->_childNodes.size(); ++ii) {
+    node->_childNodes.push_back(NULL);
+  }
+  for (size_t ii = this->_childNodes.size(); ii > 0; --ii) {
+    if (this->_childNodes[ii - 1] != NULL) {
+      node_clone_task_t task = {this->_childNodes[ii - 1], node, offset + ii - 1};
+      pending->push_back(task);
+    }
+  }
+  if (pending != &stack) {
+    return node;
+  }
+  node_clone_stack = &stack;
+  try {
+    while (!stack.empty()) {
+      node_clone_task_t task = stack.back();
+      stack.pop_back();
+      task.target->_childNodes[task.index] = task.source->clone();
+    }
+  } catch (...) {
+    node_clone_stack = NULL;
+    delete node;
+    throw;
+  }
+  node_clone_stack = NULL;
+  return node;
+}
+
+Node* Node::cloneInto(NodeArena* arena) const {
+  if (arena == NULL) {
+    return this->clone();
+  }
+  arena->reserve(this->subtreeSize());
+  NodeArena* previous = node_clone_arena;
+  node_clone_arena = arena;
+  Node* node;
+  try {
+    node = this->clone();
+  } catch (...) {
+    node_clone_arena = previous;
+    throw;
+  }
+  node_clone_arena = previous;
   return node;
 }
 
+size_t Node::subtreeSize() const {
+  size_t size = 0;
+  vector<const Node*> stack(1, this);
+  while (!stack.empty()) {
+    const Node* node = stack.back();
+    stack.pop_back();
+    ++size;
+    for (size_t ii = 0; ii < node->_childNodes.size(); ++ii) {
+      if (node->_childNodes[ii] != NULL) {
+        stack.push_back(node->_childNodes[ii]);
+      }
+    }
+  }
+  return size;
+}
+
 Node* Node::appendChild(Node* node) {
+  this->invalidateHash();
   this->_childNodes.push_back(node);
   return this;
 }
 
 Node* Node::prependChild(Node* node) {
+  this->invalidateHash();
   this->_childNodes.push_front(node);
   return this;
 }
 
 Node* Node::removeChild(node_list_t::iterator node_pos) {
   Node* node = (*node_pos);
+  this->invalidateHash();
   this->_childNodes.erase(node_pos);
   return node;
 }
 
 Node* Node::replaceChild(Node* node, node_list_t::iterator node_pos) {
-  this->insertBefore(node, node_pos);
-  return this->removeChild(node_pos);
+  Node* old_node = *node_pos;
+  this->invalidateHash();
+  *node_pos = node;
+  return old_node;
 }
 
 Node* Node::insertBefore(Node* node, node_list_t::iterator node_pos) {
+  this->invalidateHash();
   this->_childNodes.insert(node_pos, node);
   return node;
 }
 
+//
+// Hashes are stamped with the epoch they were computed in, and the epoch moves
+// on whenever a hashed node changes. Nodes don't know their parents, so there
+// isn't one epoch per tree but NODE_HASH_SLOTS of them: a tree takes one by
+// where its root is the first time it's hashed, and trees that share a slot
+// only cost each other some rehashing. A subtree's hash is only ever computed
+// after its children's, in the same slot, so if a node's hash is stale so are
+// its ancestors', and unhashed nodes can change without touching an epoch at
+// all. That keeps the cost off the parser, which appends to thousands of
+// unhashed nodes. Slot 0 marks nodes that were never hashed.
+static const unsigned int NODE_HASH_SLOTS = 256;
+static volatile unsigned int node_hash_epochs[NODE_HASH_SLOTS];
+
+static inline unsigned int node_hash_mix(unsigned int hash, unsigned int value) {
+  return (hash ^ value) * 16777619;
+}
+
+static unsigned int node_hash_bytes(unsigned int hash, const char* data, size_t len) {
+  for (size_t ii = 0; ii < len; ++ii) {
+    hash = node_hash_mix(hash, static_cast<unsigned char>(data[ii]));
+  }
+  return hash;
+}
+
+unsigned int Node::hash() const {
+  unsigned char slot = this->_hash_slot;
+  if (slot == 0) {
+    slot = 1 + (reinterpret_cast<size_t>(this) / sizeof(Node)) % (NODE_HASH_SLOTS - 1);
+  }
+  return this->hash(slot, node_hash_epochs[slot]);
+}
+
+//
+// Hashes every stale node under this one, children first, with an explicit
+// stack of the nodes whose children are still being hashed
+struct node_hash_frame_t {
+  const Node* node;
+  size_t next;
+  unsigned int hash;
+};
+
+unsigned int Node::hash(unsigned char slot, unsigned int epoch) const {
+  if (this->_hash_slot == slot && this->_hash_epoch == epoch) {
+    return this->_hash;
+  }
+  node_hash_frame_t root = {this, 0, node_hash_mix(node_hash_mix(2166136261U, this->kind()), this->hashValue())};
+  if (this->_childNodes.empty()) {
+    this->_hash = root.hash;
+    this->_hash_slot = slot;
+    this->_hash_epoch = epoch;
+    return root.hash;
+  }
+  vector<node_hash_frame_t> stack(1, root);
+  while (!stack.empty()) {
+    node_hash_frame_t& frame = stack.back();
+    const node_list_t& children = frame.node->_childNodes;
+    if (frame.next < children.size()) {
+      const Node* child = children[frame.next];
+      if (child == NULL || (child->_hash_slot == slot && child->_hash_epoch == epoch)) {
+        frame.hash = node_hash_mix(frame.hash, child == NULL ? 0 : child->_hash);
+        ++frame.next;
+      } else {
+        node_hash_frame_t next = {child, 0, node_hash_mix(node_hash_mix(2166136261U, child->kind()), child->hashValue())};
+        stack.push_back(next);
+      }
+      continue;
+    }
+    frame.node->_hash = frame.hash;
+    frame.node->_hash_slot = slot;
+    frame.node->_hash_epoch = epoch;
+    stack.pop_back();
+  }
+  return this->_hash;
+}
+
+void Node::invalidateHash() const {
+  if (this->_hash_slot != 0 && this->_hash_epoch == node_hash_epochs[this->_hash_slot]) {
+    __sync_add_and_fetch(&node_hash_epochs[this->_hash_slot], 1);
+  }
+}
+
+unsigned int Node::hashValue() const {
+  return 0;
+}
+
 node_list_t& Node::childNodes() const {
   return const_cast<Node*>(this)->_childNodes;
 }
@@ -85,56 +744,104 @@ rope_t Node::render(node_render_enum opts /* = RENDER_NONE */) const {
 }
 
 rope_t Node::render(int opts) const {
+  string out;
+  RenderSink sink(out);
+  this->render(sink, opts);
+  return rope_t(out.data(), out.size());
+}
+
+void Node::render(RenderSink& sink, int opts /* = RENDER_NONE */) const {
   render_guts_t guts;
   guts.pretty = opts & RENDER_PRETTY;
   guts.sanelineno = opts & RENDER_MAINTAIN_LINENO;
+  guts.sourceorder = opts & RENDER_SOURCE_ORDER;
+  guts.sourcemap = false;
   guts.lineno = 1;
-  return this->render(&guts, 0);
+  guts.sink = &sink;
+  NodeStats* stats = sink.stats();
+  if (stats == NULL) {
+    this->render(&guts, 0);
+    sink.flush();
+    return;
+  }
+  double start = NodeStats::now();
+  size_t written = sink.written();
+  this->render(&guts, 0);
+  sink.flush();
+  stats->rendered_bytes += sink.written() - written;
+  stats->render_seconds += NodeStats::now() - start;
+  ++stats->renders;
 }
 
-rope_t Node::render(render_guts_t* guts, int indentation) const {
-  return this->_childNodes.front()->render(guts, indentation);
+//
+// Render and fill in `map` as we go, there's no need to pad out lines with
+// RENDER_MAINTAIN_LINENO to keep stack traces readable.
+void Node::render(RenderSink& sink, SourceMap& map, int opts /* = RENDER_NONE */) const {
+  render_guts_t guts;
+  guts.pretty = opts & RENDER_PRETTY;
+  guts.sanelineno = opts & RENDER_MAINTAIN_LINENO;
+  guts.sourceorder = opts & RENDER_SOURCE_ORDER;
+  guts.sourcemap = true;
+  guts.lineno = 1;
+  guts.sink = &sink;
+  NodeStats* stats = sink.stats();
+  double start = stats ? NodeStats::now() : 0;
+  size_t written = sink.written();
+  sink.setSourceMap(&map);
+  try {
+    this->renderMapped(&guts, 0);
+    sink.flush();
+  } catch (...) {
+    sink.setSourceMap(NULL);
+    throw;
+  }
+  sink.setSourceMap(NULL);
+  if (stats) {
+    stats->rendered_bytes += sink.written() - written;
+    stats->render_seconds += NodeStats::now() - start;
+    ++stats->renders;
+  }
 }
 
-rope_t Node::renderBlock(bool must, render_guts_t* guts, int indentation) const {
+void Node::render(render_guts_t* guts, int indentation) const {
+  this->_childNodes.front()->renderMapped(guts, indentation);
+}
+
+void Node::renderBlock(bool must, render_guts_t* guts, int indentation) const {
   if (!must && !guts->pretty) {
-    rope_t ret;
     if (guts->sanelineno) {
-      this->renderLinenoCatchup(guts, ret);
+      this->renderLinenoCatchup(guts);
     }
-    ret += this->renderStatement(guts, indentation);
-    return ret;
+    this->renderStatement(guts, indentation);
   } else {
-    rope_t ret(guts->pretty ? " {" : "{");
-    ret += this->renderIndentedStatement(guts, indentation + 1);
+    guts->sink->write(guts->pretty ? " {" : "{");
+    this->renderIndentedStatement(guts, indentation + 1);
     if (guts->pretty || guts->sanelineno) {
       bool newline;
       if (guts->sanelineno) {
-        newline = this->renderLinenoCatchup(guts, ret);
+        newline = this->renderLinenoCatchup(guts);
       } else {
-        ret += "\n";
+        guts->sink->put('\n');
         newline = true;
       }
       if (guts->pretty && newline) {
         for (int i = 0; i < indentation; ++i) {
-          ret += "  ";
+          guts->sink->write("  ");
         }
       }
     }
-    ret += "}";
-    return ret;
+    guts->sink->put('}');
   }
 }
 
-rope_t Node::renderIndentedStatement(render_guts_t* guts, int indentation) const {
+void Node::renderIndentedStatement(render_guts_t* guts, int indentation) const {
   if (guts->pretty || guts->sanelineno) {
-    rope_t ret;
     bool newline = false;
     if (guts->sanelineno) {
-      newline = this->renderLinenoCatchup(guts, ret);
+      newline = this->renderLinenoCatchup(guts);
     } else {
       if (guts->lineno == 2) {
-        ret += "\n";
+        guts->sink->put('\n');
         newline = true;
       } else {
         // Use lineno property to keep track of whether or not we're on the first line,
@@ -144,39 +851,35 @@ rope_t Node::renderIndentedStatement(render_guts_t* guts, int indentation) const
     }
     if (guts->pretty && newline) {
       for (int i = 0; i < indentation; ++i) {
-        ret += "  ";
+        guts->sink->write("  ");
       }
     }
-    return ret + this->renderStatement(guts, indentation);
-  } else {
-    return this->renderStatement(guts, indentation);
   }
+  this->renderStatement(guts, indentation);
 }
 
-rope_t Node::renderStatement(render_guts_t* guts, int indentation) const {
-  return this->render(guts, indentation);
+void Node::renderStatement(render_guts_t* guts, int indentation) const {
+  this->renderMapped(guts, indentation);
 }
 
-rope_t Node::renderImplodeChildren(render_guts_t* guts, int indentation, const char* glue) const {
-  rope_t ret;
+void Node::renderImplodeChildren(render_guts_t* guts, int indentation, const char* glue) const {
   node_list_t::const_iterator i = this->_childNodes.begin();
   while (i != this->_childNodes.end()) {
     if (*i != NULL) {
-      ret += (*i)->render(guts, indentation);
+      (*i)->renderMapped(guts, indentation);
     }
     i++;
     if (i != this->_childNodes.end()) {
-      ret += glue;
+      guts->sink->write(glue);
     }
   }
-  return ret;
 }
 
-bool Node::renderLinenoCatchup(render_guts_t* guts, rope_t &rope) const {
+bool Node::renderLinenoCatchup(render_guts_t* guts) const {
   if (!this->lineno() || guts->lineno >= this->lineno()) {
     return false;
   }
-  rope += rope_t(this->lineno() - guts->lineno, '\n');
+  guts->sink->repeat('\n', this->lineno() - guts->lineno);
   guts->lineno = this->lineno();
   return true;
 }
@@ -185,23 +888,193 @@ unsigned int Node::lineno() const {
   return this->_lineno;
 }
 
+struct fbjs::node_render_lines_t {
+  map<const Node*, bool> known;
+};
+
+render_guts_t::~render_guts_t() {
+  delete lines;
+}
+
+//
+// RENDER_MAINTAIN_LINENO output depends on the order nodes are rendered in,
+// since each line catch-up starts from wherever the last one left off. Nodes
+// of two parts that both might catch up, say a call with a function for its
+// callee and another for an argument, rendered the last part first back when
+// rendering built up strings. To keep that output as it was, the last part
+// goes to a string sink of its own first and is written out after the rest,
+// unless RENDER_SOURCE_ORDER asks for everything in order.
+//
+// Whether a part might catch up is whether it holds a function expression.
+// The answers are kept in guts->lines, so each node is looked at once per
+// render however deep calls nest.
+static bool node_render_has_lines(render_guts_t* guts, const Node* node) {
+  if (!guts->sanelineno || guts->sourceorder || node == NULL) {
+    return false;
+  }
+  if (guts->lines == NULL) {
+    guts->lines = new node_render_lines_t;
+  }
+  map<const Node*, bool>& known = guts->lines->known;
+  map<const Node*, bool>::const_iterator found = known.find(node);
+  if (found != known.end()) {
+    return found->second;
+  }
+
+  // Every node of the subtree not yet known, parents before children; a
+  // function expression holds one whatever is inside it
+  vector<const Node*> order;
+  vector<const Node*> stack(1, node);
+  while (!stack.empty()) {
+    const Node* ii = stack.back();
+    stack.pop_back();
+    order.push_back(ii);
+    if (ii->kind() == KIND_FUNCTION_EXPRESSION) {
+      continue;
+    }
+    for (node_list_t::const_iterator jj = ii->childNodes().begin(); jj != ii->childNodes().end(); ++jj) {
+      if (*jj != NULL && known.find(*jj) == known.end()) {
+        stack.push_back(*jj);
+      }
+    }
+  }
+  bool lines = false;
+  for (vector<const Node*>::reverse_iterator ii = order.rbegin(); ii != order.rend(); ++ii) {
+    lines = (*ii)->kind() == KIND_FUNCTION_EXPRESSION;
+    for (node_list_t::const_iterator jj = (*ii)->childNodes().begin(); !lines && jj != (*ii)->childNodes().end(); ++jj) {
+      lines = *jj != NULL && known[*jj];
+    }
+    known[*ii] = lines;
+  }
+  return lines;
+}
+
+class node_render_later_t {
+  public:
+    // Renders `node` with renderMapped(), now if `needed` and otherwise in write()
+    node_render_later_t(render_guts_t* guts, const Node* node, int indentation, bool needed) :
+        _guts(guts), _node(node), _indentation(indentation), _block(false), _must(false), _kept(NULL) {
+      this->start(needed);
+    }
+
+    // The same with renderBlock(must, ...)
+    node_render_later_t(render_guts_t* guts, const Node* node, int indentation, bool must, bool needed) :
+        _guts(guts), _node(node), _indentation(indentation), _block(true), _must(must), _kept(NULL) {
+      this->start(needed);
+    }
+
+    ~node_render_later_t() {
+      delete _kept;
+    }
+
+    void write() {
+      if (_kept) {
+        _guts->sink->replay(*_kept);
+      } else {
+        this->render();
+      }
+    }
+
+  private:
+    render_guts_t* _guts;
+    const Node* _node;
+    int _indentation;
+    bool _block;
+    bool _must;
+    RenderSink* _kept;
+    string _str;
+
+    void start(bool needed) {
+      if (!needed) {
+        return;
+      }
+      _kept = new RenderSink(_str);
+      _kept->keepMarks();
+      RenderSink* sink = _guts->sink;
+      _guts->sink = _kept;
+      try {
+        this->render();
+      } catch (...) {
+        _guts->sink = sink;
+        delete _kept;
+        _kept = NULL;
+        throw;
+      }
+      _guts->sink = sink;
+    }
+
+    void render() {
+      if (_block) {
+        _node->renderBlock(_must, _guts, _indentation);
+      } else {
+        _node->renderMapped(_guts, _indentation);
+      }
+    }
+
+    node_render_later_t(const node_render_later_t&);
+    node_render_later_t& operator= (const node_render_later_t&);
+};
+
+//
+// Past NODE_RECURSION_LIMIT, children are compared after their parent's own
+// fields, see node_delete_stack
+typedef pair<const Node*, const Node*> node_compare_pair_t;
+static __thread unsigned int node_compare_depth = 0;
+static __thread vector<node_compare_pair_t>* node_compare_stack = NULL;
+
 bool Node::operator== (const Node &that) const {
-  if (typeid(*this) != typeid(that)) {
+  if (this == &that) {
+    return true;
+  }
+  if (this->kind() != that.kind() || typeid(*this) != typeid(that) || this->hash() != that.hash()) {
     return false;
   }
-  node_list_t::iterator jj = that.childNodes().begin();
-  for (node_list_t::iterator ii = this->childNodes().begin(); ii != this->childNodes().end(); ++ii) {
-    if (**jj != **ii) {
-      return false;
+  const node_list_t& these = this->childNodes();
+  const node_list_t& those = that.childNodes();
+  if (these.size() != those.size()) {
+    return false;
+  }
+  if (node_compare_depth < NODE_RECURSION_LIMIT) {
+    node_recursion_guard_t guard(node_compare_depth);
+    for (size_t ii = 0; ii < these.size(); ++ii) {
+      if (these[ii] == NULL || those[ii] == NULL) {
+        if (these[ii] != those[ii]) {
+          return false;
+        }
+      } else if (*these[ii] != *those[ii]) {
+        return false;
+      }
     }
-    if (++jj == that.childNodes().end()) {
-      if (++ii != this->childNodes().end()) {
+    return true;
+  }
+  vector<node_compare_pair_t> stack;
+  vector<node_compare_pair_t>* pending = node_compare_stack != NULL ? node_compare_stack : &stack;
+  for (size_t ii = these.size(); ii > 0; --ii) {
+    if (these[ii - 1] == NULL || those[ii - 1] == NULL) {
+      if (these[ii - 1] != those[ii - 1]) {
         return false;
       }
-      break;
+    } else if (these[ii - 1] != those[ii - 1]) {
+      pending->push_back(node_compare_pair_t(these[ii - 1], those[ii - 1]));
     }
   }
-  return true;
+  if (pending != &stack) {
+    return true;
+  }
+  bool equal = true;
+  node_compare_stack = &stack;
+  try {
+    while (equal && !stack.empty()) {
+      node_compare_pair_t pair = stack.back();
+      stack.pop_back();
+      equal = *pair.first == *pair.second;
+    }
+  } catch (...) {
+    node_compare_stack = NULL;
+    throw;
+  }
+  node_compare_stack = NULL;
+  return equal;
 }
 
 bool Node::operator!= (const Node &that) const {
@@ -210,78 +1083,107 @@ bool Node::operator!= (const Node &that) const {
 
 //
 // NodeProgram: a javascript program
-NodeProgram::NodeProgram() : Node(1) {}
+NodeProgram::NodeProgram() : Node(1, KIND_PROGRAM), _arena(NULL), _atoms(NULL) {}
+
+NodeProgram::~NodeProgram() {
+  this->releaseArena();
+}
+
+NodeArena* NodeProgram::arena() {
+  if (_arena == NULL) {
+    _arena = new NodeArena();
+  }
+  return _arena;
+}
+
+void NodeProgram::releaseArena() {
+  if (_arena == NULL) {
+    return;
+  }
+
+  // Heap nodes may hold arena nodes, so they have to go while the chunks are
+  // still there. Everything of the arena's is left to its destructor.
+  _arena->beginTeardown();
+  for (node_list_t::iterator node = this->_childNodes.begin(); node != this->_childNodes.end(); ++node) {
+    if (Node::arenaOf(*node) == NULL) {
+      delete *node;
+    }
+  }
+  this->_childNodes.clear();
+  delete _arena;
+  _arena = NULL;
+  delete _atoms;
+  _atoms = NULL;
+}
+
 Node* NodeProgram::clone(Node* node) const {
   return Node::clone(new NodeProgram());
 }
 
 //
 // NodeStatementList: a list of statements
-NodeStatementList::NodeStatementList(const unsigned int lineno /* = 0 */) : Node(lineno) {}
+NodeStatementList::NodeStatementList(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_STATEMENT_LIST) {}
 Node* NodeStatementList::clone(Node* node) const {
   return Node::clone(new NodeStatementList());
 }
 
-rope_t NodeStatementList::render(render_guts_t* guts, int indentation) const {
-  rope_t ret;
+void NodeStatementList::render(render_guts_t* guts, int indentation) const {
   for (node_list_t::const_iterator i = this->_childNodes.begin(); i != this->_childNodes.end(); ++i) {
     if (*i != NULL) {
-      ret += (*i)->renderIndentedStatement(guts, indentation);
+      (*i)->renderIndentedStatement(guts, indentation);
     }
   }
-  return ret;
 }
 
-rope_t NodeStatementList::renderBlock(bool must, render_guts_t* guts, int indentation) const {
+void NodeStatementList::renderBlock(bool must, render_guts_t* guts, int indentation) const {
   if (!must && this->empty()) {
-    return rope_t(";");
+    guts->sink->put(';');
   } else if (!must && !guts->pretty && this->_childNodes.front() == this->_childNodes.back()) {
-    rope_t ret;
     if (guts->sanelineno) {
-      this->renderLinenoCatchup(guts, ret);
+      this->renderLinenoCatchup(guts);
     }
-    ret += this->_childNodes.front()->renderBlock(must, guts, indentation);
-    return ret;
+    this->_childNodes.front()->renderBlock(must, guts, indentation);
   } else {
-    rope_t ret(guts->pretty ? " {" : "{");
-    ret += this->renderIndentedStatement(guts, indentation + 1);
+    guts->sink->write(guts->pretty ? " {" : "{");
+    this->renderIndentedStatement(guts, indentation + 1);
     if (guts->pretty || guts->sanelineno) {
       bool newline;
       if (guts->sanelineno) {
-        newline = this->renderLinenoCatchup(guts, ret);
+        newline = this->renderLinenoCatchup(guts);
       } else {
-        ret += "\n";
+        guts->sink->put('\n');
         newline = true;
       }
       if (guts->pretty && newline) {
         for (int i = 0; i < indentation; ++i) {
-          ret += "  ";
+          guts->sink->write("  ");
         }
       }
     }
-    ret += "}";
-    return ret;
+    guts->sink->put('}');
   }
 }
 
-rope_t NodeStatementList::renderIndentedStatement(render_guts_t* guts, int indentation) const {
-  return this->render(guts, indentation);
+void NodeStatementList::renderIndentedStatement(render_guts_t* guts, int indentation) const {
+  this->renderMapped(guts, indentation);
 }
 
-rope_t NodeStatementList::renderStatement(render_guts_t* guts, int indentation) const {
-  return this->render(guts, indentation);
+void NodeStatementList::renderStatement(render_guts_t* guts, int indentation) const {
+  this->renderMapped(guts, indentation);
 }
 
 //
 // NodeExpression
-NodeExpression::NodeExpression(const unsigned int lineno /* = 0 */) : Node(lineno) {}
+NodeExpression::NodeExpression(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_EXPRESSION) {}
+NodeExpression::NodeExpression(const unsigned int lineno, node_kind_enum kind) : Node(lineno, kind) {}
 
 bool NodeExpression::isValidlVal() const {
   return false;
 }
 
-rope_t NodeExpression::renderStatement(render_guts_t* guts, int indentation) const {
-  return this->render(guts, indentation) + ";";
+void NodeExpression::renderStatement(render_guts_t* guts, int indentation) const {
+  this->renderMapped(guts, indentation);
+  guts->sink->put(';');
 }
 
 bool NodeExpression::compare(bool val) const {
@@ -290,16 +1192,16 @@ bool NodeExpression::compare(bool val) const {
 
 //
 // NodeNumericLiteral: it's a number. like 5. or 3.
-NodeNumericLiteral::NodeNumericLiteral(double value, const unsigned int lineno /* = 0 */) : NodeExpression(lineno), value(value) {}
+NodeNumericLiteral::NodeNumericLiteral(double value, const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_NUMERIC_LITERAL), value(value) {}
 
 Node* NodeNumericLiteral::clone(Node* node) const {
-  return new NodeNumericLiteral(this->value);
+  return Node::clone(new NodeNumericLiteral(this->value));
 }
 
-rope_t NodeNumericLiteral::render(render_guts_t* guts, int indentation) const {
+void NodeNumericLiteral::render(render_guts_t* guts, int indentation) const {
   char buf[32];
-  g_fmt(buf, this->value);
-  return rope_t(buf);
+  fbjs_format_number(buf, this->value);
+  guts->sink->write(buf);
 }
 
 bool NodeNumericLiteral::compare(bool val) const {
@@ -307,21 +1209,181 @@ bool NodeNumericLiteral::compare(bool val) const {
 }
 
 bool NodeNumericLiteral::operator== (const Node &that) const {
-  const NodeNumericLiteral* thatLiteral = dynamic_cast<const NodeNumericLiteral*>(&that);
-  return thatLiteral == NULL ? false : this->value == thatLiteral->value;
+  if (that.kind() != KIND_NUMERIC_LITERAL) {
+    return false;
+  }
+  const NodeNumericLiteral* thatLiteral = static_cast<const NodeNumericLiteral*>(&that);
+  return this->value == thatLiteral->value;
+}
+
+unsigned int NodeNumericLiteral::hashValue() const {
+  // 0 == -0, and NaN never equals anything so its bits don't matter
+  double value = this->value == 0 ? 0 : this->value;
+  return node_hash_bytes(0, reinterpret_cast<const char*>(&value), sizeof(value));
 }
 
 //
 // NodeStringLiteral: "Hello."
-NodeStringLiteral::NodeStringLiteral(const string &value, bool quoted, const unsigned int lineno /* = 0 */) : NodeExpression(lineno), value(value), quoted(quoted) {}
+NodeStringLiteral::NodeStringLiteral(const string &value, bool quoted, const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_STRING_LITERAL), value(value), decoded(quoted ? node_string_t(decode(value.data(), value.size())) : this->value), quoted(quoted) {}
+NodeStringLiteral::NodeStringLiteral(const string &value, const string &decoded, bool quoted, const unsigned int lineno) : NodeExpression(lineno, KIND_STRING_LITERAL), value(value), decoded(quoted ? node_string_t(decoded) : this->value), quoted(quoted) {}
+NodeStringLiteral::NodeStringLiteral(const node_string_t &value, const node_string_t &decoded, bool quoted, const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_STRING_LITERAL), value(value), decoded(decoded), quoted(quoted) {}
+
+static inline int node_hex_digit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static int node_hex_value(const char* p, const char* end, int digits) {
+  if (end - p < digits) {
+    return -1;
+  }
+  int value = 0;
+  for (int ii = 0; ii < digits; ++ii) {
+    int digit = node_hex_digit(p[ii]);
+    if (digit < 0) {
+      return -1;
+    }
+    value = value * 16 + digit;
+  }
+  return value;
+}
+
+static void node_put_utf8(string& out, unsigned int code) {
+  if (code < 0x80) {
+    out += (char)code;
+  } else if (code < 0x800) {
+    out += (char)(0xc0 | (code >> 6));
+    out += (char)(0x80 | (code & 0x3f));
+  } else if (code < 0x10000) {
+    out += (char)(0xe0 | (code >> 12));
+    out += (char)(0x80 | ((code >> 6) & 0x3f));
+    out += (char)(0x80 | (code & 0x3f));
+  } else {
+    out += (char)(0xf0 | (code >> 18));
+    out += (char)(0x80 | ((code >> 12) & 0x3f));
+    out += (char)(0x80 | ((code >> 6) & 0x3f));
+    out += (char)(0x80 | (code & 0x3f));
+  }
+}
+
+string NodeStringLiteral::decode(const char* quoted, size_t len) {
+  string out;
+  if (len == 0) {
+    return out;
+  }
+  const char* p = quoted + 1;
+  const char* end = quoted + len;
+  const char quote = *quoted;
+  out.reserve(len);
+
+  // Plain text is copied a run at a time; memchr finds the next stop in bulk,
+  // and each one is only looked for again once we're past it.
+  const char* next_quote = (const char*)memchr(p, quote, end - p);
+  const char* next_escape = (const char*)memchr(p, '\\', end - p);
+  if (next_quote == NULL) next_quote = end;
+  if (next_escape == NULL) next_escape = end;
+  while (true) {
+    if (next_quote < next_escape) {
+      out.append(p, next_quote - p);
+      break;
+    } else if (next_escape == end) {
+      out.append(p, end - p);
+      break;
+    }
+    out.append(p, next_escape - p);
+    p = next_escape + 1;
+    if (p == end) {
+      break;
+    }
+    char c = *p++;
+    switch (c) {
+      case 'b': out += '\b'; break;
+      case 'f': out += '\f'; break;
+      case 'n': out += '\n'; break;
+      case 'r': out += '\r'; break;
+      case 't': out += '\t'; break;
+      case 'v': out += '\v'; break;
+      case '\n': break;
+      case '\r':
+        if (p != end && *p == '\n') {
+          ++p;
+        }
+        break;
+
+      case '0': case '1': case '2': case '3':
+      case '4': case '5': case '6': case '7': {
+        // Octal escapes (\0 being the usual one): up to three digits from
+        // \0-\3, up to two from \4-\7, so the value stays within a byte.
+        unsigned int code = c - '0';
+        int digits = c <= '3' ? 2 : 1;
+        while (digits-- && p != end && *p >= '0' && *p <= '7') {
+          code = code * 8 + (*p++ - '0');
+        }
+        node_put_utf8(out, code);
+        break;
+      }
+
+      case 'x': {
+        int code = node_hex_value(p, end, 2);
+        if (code < 0) {
+          out += c;
+        } else {
+          node_put_utf8(out, code);
+          p += 2;
+        }
+        break;
+      }
+
+      case 'u': {
+        int code = node_hex_value(p, end, 4);
+        if (code < 0) {
+          out += c;
+          break;
+        }
+        p += 4;
+        if (code >= 0xd800 && code <= 0xdbff && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+          // Surrogate pair; a lone surrogate is encoded as it stands
+          int low = node_hex_value(p + 2, end, 4);
+          if (low >= 0xdc00 && low <= 0xdfff) {
+            code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+            p += 6;
+          }
+        }
+        node_put_utf8(out, code);
+        break;
+      }
+
+      case '\xe2':
+        // U+2028 and U+2029 are line terminators too
+        if (end - p >= 2 && p[0] == '\x80' && (p[1] == '\xa8' || p[1] == '\xa9')) {
+          p += 2;
+        } else {
+          out += c;
+        }
+        break;
+
+      default:
+        out += c;
+    }
+    if (p > next_quote) {
+      next_quote = (const char*)memchr(p, quote, end - p);
+      if (next_quote == NULL) next_quote = end;
+    }
+    next_escape = (const char*)memchr(p, '\\', end - p);
+    if (next_escape == NULL) next_escape = end;
+  }
+  return out;
+}
 
 Node* NodeStringLiteral::clone(Node* node) const {
-  return new NodeStringLiteral(this->value, this->quoted);
+  return Node::clone(new NodeStringLiteral(this->value, this->decoded, this->quoted));
 }
 
-rope_t NodeStringLiteral::render(render_guts_t* guts, int indentation) const {
+void NodeStringLiteral::render(render_guts_t* guts, int indentation) const {
   if (this->quoted) {
-    return rope_t(this->value.c_str());
+    guts->sink->write(this->value.c_str());
   } else {
     const char *val = this->value.c_str();
     size_t len = 0;
@@ -339,7 +1401,9 @@ rope_t NodeStringLiteral::render(render_guts_t* guts, int indentation) const {
       }
     }
     if (len == this->value.size()) {
-    return rope_t("\"") + this->value.c_str() + "\"";
+      guts->sink->put('"');
+      guts->sink->write(this->value.c_str());
+      guts->sink->put('"');
     } else {
       char *new_str = new char[len + 1];
       char *ii = new_str;
@@ -374,47 +1438,69 @@ rope_t NodeStringLiteral::render(render_guts_t* guts, int indentation) const {
           ++ii;
         }
       }
-      rope_t ret("\"");
-      ret += new_str;
-      ret += "\"";
+      guts->sink->put('"');
+      guts->sink->write(new_str);
+      guts->sink->put('"');
       delete[] new_str;
-      return ret;
     }
   }
 }
 
+bool NodeStringLiteral::compare(bool val) const {
+  return val != this->decoded.str().empty();
+}
+
 bool NodeStringLiteral::operator== (const Node &that) const {
-  const NodeStringLiteral* thatLiteral = dynamic_cast<const NodeStringLiteral*>(&that);
-  return thatLiteral == NULL ? false : this->value == thatLiteral->value;
+  if (that.kind() != KIND_STRING_LITERAL) {
+    return false;
+  }
+  const NodeStringLiteral* thatLiteral = static_cast<const NodeStringLiteral*>(&that);
+  return this->value == thatLiteral->value;
+}
+
+unsigned int NodeStringLiteral::hashValue() const {
+  return node_hash_bytes(0, this->value.data(), this->value.size());
 }
 
 //
 // NodeRegexLiteral: /foo|bar/
-NodeRegexLiteral::NodeRegexLiteral(const string &value, const string &flags, const unsigned int lineno /* = 0 */) : NodeExpression(lineno), value(value), flags(flags) {}
+NodeRegexLiteral::NodeRegexLiteral(const string &value, const string &flags, const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_REGEX_LITERAL), value(value), flags(flags) {}
+NodeRegexLiteral::NodeRegexLiteral(const node_string_t &value, const node_string_t &flags, const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_REGEX_LITERAL), value(value), flags(flags) {}
 
 Node* NodeRegexLiteral::clone(Node* node) const {
-  return new NodeRegexLiteral(this->value, this->flags);
+  return Node::clone(new NodeRegexLiteral(this->value, this->flags));
 }
 
-rope_t NodeRegexLiteral::render(render_guts_t* guts, int indentation) const {
-  return rope_t("/") + this->value.c_str() + "/" + this->flags.c_str();
+void NodeRegexLiteral::render(render_guts_t* guts, int indentation) const {
+  guts->sink->put('/');
+  guts->sink->write(this->value.c_str());
+  guts->sink->put('/');
+  guts->sink->write(this->flags.c_str());
 }
 
 bool NodeRegexLiteral::operator== (const Node &that) const {
-  const NodeRegexLiteral* thatLiteral = dynamic_cast<const NodeRegexLiteral*>(&that);
-  return thatLiteral == NULL ? false : this->value == thatLiteral->value && this->flags == thatLiteral->flags;
+  if (that.kind() != KIND_REGEX_LITERAL) {
+    return false;
+  }
+  const NodeRegexLiteral* thatLiteral = static_cast<const NodeRegexLiteral*>(&that);
+  return this->value == thatLiteral->value && this->flags == thatLiteral->flags;
+}
+
+unsigned int NodeRegexLiteral::hashValue() const {
+  return node_hash_mix(node_hash_bytes(0, this->value.data(), this->value.size()),
+    node_hash_bytes(0, this->flags.data(), this->flags.size()));
 }
 
 //
 // NodeBooleanLiteral: true or false
-NodeBooleanLiteral::NodeBooleanLiteral(bool value, const unsigned int lineno /* = 0 */) : NodeExpression(lineno), value(value) {}
+NodeBooleanLiteral::NodeBooleanLiteral(bool value, const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_BOOLEAN_LITERAL), value(value) {}
 
-rope_t NodeBooleanLiteral::render(render_guts_t* guts, int indentation) const {
-  return rope_t(this->value ? "true" : "false");
+void NodeBooleanLiteral::render(render_guts_t* guts, int indentation) const {
+  guts->sink->write(this->value ? "true" : "false");
 }
 
 Node* NodeBooleanLiteral::clone(Node* node) const {
-  return new NodeBooleanLiteral(this->value);
+  return Node::clone(new NodeBooleanLiteral(this->value));
 }
 
 bool NodeBooleanLiteral::compare(bool val) const {
@@ -422,200 +1508,403 @@ bool NodeBooleanLiteral::compare(bool val) const {
 }
 
 bool NodeBooleanLiteral::operator== (const Node &that) const {
-  const NodeBooleanLiteral* thatLiteral = dynamic_cast<const NodeBooleanLiteral*>(&that);
-  return thatLiteral == NULL ? false : this->value == thatLiteral->value;
+  if (that.kind() != KIND_BOOLEAN_LITERAL) {
+    return false;
+  }
+  const NodeBooleanLiteral* thatLiteral = static_cast<const NodeBooleanLiteral*>(&that);
+  return this->value == thatLiteral->value;
+}
+
+unsigned int NodeBooleanLiteral::hashValue() const {
+  return this->value;
 }
 
 //
 // NodeNullLiteral: null
-NodeNullLiteral::NodeNullLiteral(const unsigned int lineno /* = 0 */) : NodeExpression(lineno) {}
+NodeNullLiteral::NodeNullLiteral(const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_NULL_LITERAL) {}
 Node* NodeNullLiteral::clone(Node* node) const {
   return Node::clone(new NodeNullLiteral());
 }
 
-rope_t NodeNullLiteral::render(render_guts_t* guts, int indentation) const {
-  return rope_t("null");
+void NodeNullLiteral::render(render_guts_t* guts, int indentation) const {
+  guts->sink->write("null");
+}
+
+bool NodeNullLiteral::compare(bool val) const {
+  return !val;
 }
 
 //
 // NodeThis: this
-NodeThis::NodeThis(const unsigned int lineno /* = 0 */) : NodeExpression(lineno) {}
+NodeThis::NodeThis(const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_THIS) {}
 Node* NodeThis::clone(Node* node) const {
   return Node::clone(new NodeThis());
 }
 
-rope_t NodeThis::render(render_guts_t* guts, int indentation) const {
-  return rope_t("this");
+void NodeThis::render(render_guts_t* guts, int indentation) const {
+  guts->sink->write("this");
 }
 
 //
 // NodeEmptyExpression
-NodeEmptyExpression::NodeEmptyExpression(const unsigned int lineno /* = 0 */) : NodeExpression(lineno) {}
+NodeEmptyExpression::NodeEmptyExpression(const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_EMPTY_EXPRESSION) {}
 Node* NodeEmptyExpression::clone(Node* node) const {
   return Node::clone(new NodeEmptyExpression());
 }
 
-rope_t NodeEmptyExpression::render(render_guts_t* guts, int indentation) const {
-  return rope_t();
+void NodeEmptyExpression::render(render_guts_t* guts, int indentation) const {
 }
 
-rope_t NodeEmptyExpression::renderBlock(bool must, render_guts_t* guts, int indentation) const {
-  return rope_t(";");
+void NodeEmptyExpression::renderBlock(bool must, render_guts_t* guts, int indentation) const {
+  guts->sink->put(';');
 }
 
 //
-// NodeOperator: expression <op> expression
-NodeOperator::NodeOperator(node_operator_t op, const unsigned int lineno /* = 0 */) : NodeExpression(lineno), op(op) {}
-
-Node* NodeOperator::clone(Node* node) const {
-  return Node::clone(new NodeOperator(this->op));
-}
+// Expression rendering. Operators, assignments, unary operators, ternaries,
+// parentheses, calls and member expressions nest as deep as the input does,
+// so past NODE_RECURSION_LIMIT levels they're rendered from one explicit stack
+// of pending nodes and text instead of recursing. Nodes of a subclass with its
+// own render() are still rendered through it.
+static __thread unsigned int node_render_depth = 0;
+
+// One of a node, text, or a part rendered ahead for RENDER_MAINTAIN_LINENO
+struct node_render_item_t {
+  const Node* node;
+  const char* text;
+  node_render_later_t* later;
+};
+
+class node_render_stack_t {
+  public:
+    node_render_stack_t() : _size(0) {}
+    ~node_render_stack_t() {
+      while (!this->empty()) {
+        delete this->pop().later;
+      }
+    }
+    bool empty() const {
+      return _size == 0;
+    }
+    void push(const Node* node, const char* text, node_render_later_t* later = NULL) {
+      node_render_item_t item = {node, text, later};
+      if (_size < NODE_RENDER_STACK_INLINE) {
+        _inline[_size] = item;
+      } else {
+        _spill.push_back(item);
+      }
+      ++_size;
+    }
+    node_render_item_t pop() {
+      if (--_size < NODE_RENDER_STACK_INLINE) {
+        return _inline[_size];
+      }
+      node_render_item_t item = _spill.back();
+      _spill.pop_back();
+      return item;
+    }
 
-rope_t NodeOperator::render(render_guts_t* guts, int indentation) const {
-  rope_t ret;
-  bool padding = true;
-  ret += this->_childNodes.front()->render(guts, indentation);
-  if (guts->pretty) {
-    padding = false;
-    if (this->op != COMMA) {
-    ret += " ";
+  private:
+    enum { NODE_RENDER_STACK_INLINE = 32 };
+    node_render_item_t _inline[NODE_RENDER_STACK_INLINE];
+    vector<node_render_item_t> _spill;
+    size_t _size;
+
+    node_render_stack_t(const node_render_stack_t&);
+    node_render_stack_t& operator= (const node_render_stack_t&);
+};
+
+static const char* node_operator_text(node_operator_t op, bool padding) {
+  switch (op) {
+    case COMMA: return ",";
+    case RSHIFT3: return ">>>";
+    case RSHIFT: return ">>";
+    case LSHIFT: return "<<";
+    case OR: return "||";
+    case AND: return "&&";
+    case BIT_XOR: return "^";
+    case BIT_AND: return "&";
+    case BIT_OR: return "|";
+    case EQUAL: return "==";
+    case NOT_EQUAL: return "!=";
+    case STRICT_EQUAL: return "===";
+    case STRICT_NOT_EQUAL: return "!==";
+    case LESS_THAN_EQUAL: return "<=";
+    case GREATER_THAN_EQUAL: return ">=";
+    case LESS_THAN: return "<";
+    case GREATER_THAN: return ">";
+    case PLUS: return "+";
+    case MINUS: return "-";
+    case DIV: return "/";
+    case MULT: return "*";
+    case MOD: return "%";
+    case IN: return padding ? " in " : "in";
+    case INSTANCEOF: return padding ? " instanceof " : "instanceof";
   }
+  return "";
+}
+
+static const char* node_assignment_text(node_assignment_t op) {
+  switch (op) {
+    case ASSIGN: return "=";
+    case MULT_ASSIGN: return "*=";
+    case DIV_ASSIGN: return "/=";
+    case MOD_ASSIGN: return "%=";
+    case PLUS_ASSIGN: return "+=";
+    case MINUS_ASSIGN: return "-=";
+    case LSHIFT_ASSIGN: return "<<=";
+    case RSHIFT_ASSIGN: return ">>=";
+    case RSHIFT3_ASSIGN: return ">>>=";
+    case BIT_AND_ASSIGN: return "&=";
+    case BIT_XOR_ASSIGN: return "^=";
+    case BIT_OR_ASSIGN: return "|=";
   }
-  switch (this->op) {
-    case COMMA:
-      ret += ",";
-      break;
-
-    case RSHIFT3:
-      ret += ">>>";
-      break;
-
-    case RSHIFT:
-      ret += ">>";
-      break;
-
-    case LSHIFT:
-      ret += "<<";
-      break;
-
-    case OR:
-      ret += "||";
-      break;
-
-    case AND:
-      ret += "&&";
-      break;
-
-    case BIT_XOR:
-      ret += "^";
-      break;
-
-    case BIT_AND:
-      ret += "&";
-      break;
+  return "";
+}
+
+static const char* node_unary_text(node_unary_t op) {
+  switch (op) {
+    case DELETE: return "delete";
+    case VOID: return "void";
+    case TYPEOF: return "typeof";
+    case INCR_UNARY: return "++";
+    case DECR_UNARY: return "--";
+    case PLUS_UNARY: return "+";
+    case MINUS_UNARY: return "-";
+    case BIT_NOT_UNARY: return "~";
+    case NOT_UNARY: return "!";
+  }
+  return "";
+}
+
+// Whether `node` renders exactly like the built-in expression of its kind
+static inline bool node_render_inline(const Node* node) {
+  switch (node->kind()) {
+    case KIND_OPERATOR:
+      return typeid(*node) == typeid(NodeOperator);
+    case KIND_ASSIGNMENT:
+      return typeid(*node) == typeid(NodeAssignment);
+    case KIND_UNARY:
+      return typeid(*node) == typeid(NodeUnary);
+    case KIND_CONDITIONAL_EXPRESSION:
+      return typeid(*node) == typeid(NodeConditionalExpression);
+    case KIND_PARENTHETICAL:
+      return typeid(*node) == typeid(NodeParenthetical);
+    case KIND_FUNCTION_CALL:
+      return typeid(*node) == typeid(NodeFunctionCall);
+    case KIND_FUNCTION_CONSTRUCTOR:
+      return typeid(*node) == typeid(NodeFunctionConstructor);
+    case KIND_STATIC_MEMBER_EXPRESSION:
+      return typeid(*node) == typeid(NodeStaticMemberExpression);
+    case KIND_DYNAMIC_MEMBER_EXPRESSION:
+      return typeid(*node) == typeid(NodeDynamicMemberExpression);
+    case KIND_ARG_LIST:
+      return typeid(*node) == typeid(NodeArgList);
+    default:
+      return false;
+  }
+}
 
-    case BIT_OR:
-      ret += "|";
-      break;
+// Pushes the last part of a call or member expression, rendered ahead of the
+// rest when its render() would do that with node_render_later_t
+static void node_render_push_last(const Node* node, render_guts_t* guts, int indentation, node_render_stack_t& stack) {
+  const Node* last = node->childNodes().back();
+  if (node_render_has_lines(guts, last) && node_render_has_lines(guts, node->childNodes().front())) {
+    auto_ptr<node_render_later_t> later(new node_render_later_t(guts, last, indentation, true));
+    stack.push(NULL, NULL, later.get());
+    later.release();
+  } else {
+    stack.push(last, NULL);
+  }
+}
 
-    case EQUAL:
-      ret += "==";
+// Pushes what `node` renders as, last piece first
+static void node_render_push(const Node* node, render_guts_t* guts, int indentation, node_render_stack_t& stack) {
+  const node_list_t& children = node->childNodes();
+  switch (node->kind()) {
+    case KIND_OPERATOR: {
+      node_operator_t op = static_cast<const NodeOperator*>(node)->operatorType();
+      stack.push(children.back(), NULL);
+      if (guts->pretty) {
+        stack.push(NULL, " ");
+      }
+      stack.push(NULL, node_operator_text(op, !guts->pretty));
+      if (guts->pretty && op != COMMA) {
+        stack.push(NULL, " ");
+      }
+      stack.push(children.front(), NULL);
       break;
+    }
 
-    case NOT_EQUAL:
-      ret += "!=";
+    case KIND_ASSIGNMENT:
+      stack.push(children.back(), NULL);
+      if (guts->pretty) {
+        stack.push(NULL, " ");
+      }
+      stack.push(NULL, node_assignment_text(static_cast<const NodeAssignment*>(node)->operatorType()));
+      if (guts->pretty) {
+        stack.push(NULL, " ");
+      }
+      stack.push(children.front(), NULL);
       break;
 
-    case STRICT_EQUAL:
-      ret += "===";
+    case KIND_UNARY: {
+      node_unary_t op = static_cast<const NodeUnary*>(node)->operatorType();
+      stack.push(children.front(), NULL);
+      if ((op == DELETE || op == VOID || op == TYPEOF) && children.front()->kind() != KIND_PARENTHETICAL) {
+        stack.push(NULL, " ");
+      }
+      stack.push(NULL, node_unary_text(op));
       break;
+    }
 
-    case STRICT_NOT_EQUAL:
-      ret += "!==";
+    case KIND_CONDITIONAL_EXPRESSION:
+      stack.push(children[2], NULL);
+      stack.push(NULL, guts->pretty ? " : " : ":");
+      stack.push(children[1], NULL);
+      stack.push(NULL, guts->pretty ? " ? " : "?");
+      stack.push(children[0], NULL);
       break;
 
-    case LESS_THAN_EQUAL:
-      ret += "<=";
+    case KIND_PARENTHETICAL:
+      stack.push(NULL, ")");
+      stack.push(children.front(), NULL);
+      stack.push(NULL, "(");
       break;
 
-    case GREATER_THAN_EQUAL:
-      ret += ">=";
+    case KIND_FUNCTION_CALL:
+      node_render_push_last(node, guts, indentation, stack);
+      stack.push(children.front(), NULL);
       break;
 
-    case LESS_THAN:
-      ret += "<";
+    case KIND_FUNCTION_CONSTRUCTOR:
+      node_render_push_last(node, guts, indentation, stack);
+      stack.push(children.front(), NULL);
+      stack.push(NULL, "new ");
       break;
 
-    case GREATER_THAN:
-      ret += ">";
+    case KIND_STATIC_MEMBER_EXPRESSION:
+      stack.push(children.back(), NULL);
+      stack.push(NULL, ".");
+      stack.push(children.front(), NULL);
       break;
 
-    case PLUS:
-      ret += "+";
+    case KIND_DYNAMIC_MEMBER_EXPRESSION:
+      stack.push(NULL, "]");
+      node_render_push_last(node, guts, indentation, stack);
+      stack.push(NULL, "[");
+      stack.push(children.front(), NULL);
       break;
 
-    case MINUS:
-      ret += "-";
+    case KIND_ARG_LIST:
+      stack.push(NULL, ")");
+      for (size_t ii = children.size(); ii > 0; --ii) {
+        if (children[ii - 1] != NULL) {
+          stack.push(children[ii - 1], NULL);
+        }
+        if (ii > 1) {
+          stack.push(NULL, guts->pretty ? ", " : ",");
+        }
+      }
+      stack.push(NULL, "(");
       break;
 
-    case DIV:
-      ret += "/";
+    default:
       break;
+  }
+}
 
-    case MULT:
-      ret += "*";
-      break;
+static void node_render_expression(const Node* root, render_guts_t* guts, int indentation) {
+  node_render_stack_t stack;
+  node_render_push(root, guts, indentation, stack);
+  while (!stack.empty()) {
+    node_render_item_t item = stack.pop();
+    if (item.later != NULL) {
+      auto_ptr<node_render_later_t> later(item.later);
+      later->write();
+    } else if (item.node == NULL) {
+      guts->sink->write(item.text);
+    } else if (node_render_inline(item.node)) {
+      if (guts->sourcemap && item.node->sourceLine()) {
+        guts->sink->mark(item.node->sourceLine(), item.node->sourceColumn());
+      }
+      node_render_push(item.node, guts, indentation, stack);
+    } else {
+      item.node->renderMapped(guts, indentation);
+    }
+  }
+}
 
-    case MOD:
-      ret += "%";
-      break;
+//
+// NodeOperator: expression <op> expression
+NodeOperator::NodeOperator(node_operator_t op, const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_OPERATOR), op(op) {}
 
-    case IN:
-      ret += padding ? " in " : "in";
-      break;
+Node* NodeOperator::clone(Node* node) const {
+  return Node::clone(new NodeOperator(this->op));
+}
 
-    case INSTANCEOF:
-      ret += padding ? " instanceof " : "instanceof";
-      break;
+void NodeOperator::render(render_guts_t* guts, int indentation) const {
+  if (node_render_depth >= NODE_RECURSION_LIMIT) {
+    node_render_expression(this, guts, indentation);
+    return;
+  }
+  node_recursion_guard_t guard(node_render_depth);
+  this->_childNodes.front()->renderMapped(guts, indentation);
+  if (guts->pretty && this->op != COMMA) {
+    guts->sink->put(' ');
   }
-  if (!padding) {
-    ret += " ";
+  guts->sink->write(node_operator_text(this->op, !guts->pretty));
+  if (guts->pretty) {
+    guts->sink->put(' ');
   }
-  ret += this->_childNodes.back()->render(guts, indentation);
-  return ret;
+  this->_childNodes.back()->renderMapped(guts, indentation);
 }
 
 bool NodeOperator::operator== (const Node &that) const {
   return Node::operator==(that) && this->op == static_cast<const NodeOperator*>(&that)->op;
 }
 
+unsigned int NodeOperator::hashValue() const {
+  return this->op;
+}
+
 //
 // NodeConditionalExpression: true ? yes() : no()
-NodeConditionalExpression::NodeConditionalExpression(const unsigned int lineno /* = 0 */) : NodeExpression(lineno) {}
+NodeConditionalExpression::NodeConditionalExpression(const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_CONDITIONAL_EXPRESSION) {}
 Node* NodeConditionalExpression::clone(Node* node) const {
   return Node::clone(new NodeConditionalExpression());
 }
 
-rope_t NodeConditionalExpression::render(render_guts_t* guts, int indentation) const {
+void NodeConditionalExpression::render(render_guts_t* guts, int indentation) const {
+  if (node_render_depth >= NODE_RECURSION_LIMIT) {
+    node_render_expression(this, guts, indentation);
+    return;
+  }
+  node_recursion_guard_t guard(node_render_depth);
   node_list_t::const_iterator node = this->_childNodes.begin();
-  rope_t ret((*node)->render(guts, indentation));
-  ret += rope_t(guts->pretty ? " ? " : "?") +
-    (*++node)->render(guts, indentation) +
-    (guts->pretty ? " : " : ":");
-  ret += (*++node)->render(guts, indentation);
-  return ret;
+  (*node)->renderMapped(guts, indentation);
+  guts->sink->write(guts->pretty ? " ? " : "?");
+  (*++node)->renderMapped(guts, indentation);
+  guts->sink->write(guts->pretty ? " : " : ":");
+  (*++node)->renderMapped(guts, indentation);
 }
 
 //
 // NodeParenthetical: an expression in ()'s. This is actually implicit in the AST, but we also make it an explicit
 // node. Otherwise, the renderer would have to be aware of operator precedence which would be cumbersome.
-NodeParenthetical::NodeParenthetical(const unsigned int lineno /* = 0 */) : NodeExpression(lineno) {}
+NodeParenthetical::NodeParenthetical(const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_PARENTHETICAL) {}
 Node* NodeParenthetical::clone(Node* node) const {
   return Node::clone(new NodeParenthetical());
 }
 
-rope_t NodeParenthetical::render(render_guts_t* guts, int indentation) const {
-  return rope_t("(") + this->_childNodes.front()->render(guts, indentation) + ")";
+void NodeParenthetical::render(render_guts_t* guts, int indentation) const {
+  if (node_render_depth >= NODE_RECURSION_LIMIT) {
+    node_render_expression(this, guts, indentation);
+    return;
+  }
+  node_recursion_guard_t guard(node_render_depth);
+  guts->sink->put('(');
+  this->_childNodes.front()->renderMapped(guts, indentation);
+  guts->sink->put(')');
 }
 
 bool NodeParenthetical::isValidlVal() const {
@@ -628,171 +1917,133 @@ bool NodeParenthetical::compare(bool val) const {
 
 //
 // NodeAssignment: identifier = expression
-NodeAssignment::NodeAssignment(node_assignment_t op, const unsigned int lineno /* = 0 */) : NodeExpression(lineno), op(op) {}
+NodeAssignment::NodeAssignment(node_assignment_t op, const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_ASSIGNMENT), op(op) {}
 
 Node* NodeAssignment::clone(Node* node) const {
   return Node::clone(new NodeAssignment(this->op));
 }
 
-rope_t NodeAssignment::render(render_guts_t* guts, int indentation) const {
-  rope_t ret;
-  ret += this->_childNodes.front()->render(guts, indentation);
-  if (guts->pretty) {
-    ret += " ";
+void NodeAssignment::render(render_guts_t* guts, int indentation) const {
+  if (node_render_depth >= NODE_RECURSION_LIMIT) {
+    node_render_expression(this, guts, indentation);
+    return;
   }
-  switch (this->op) {
-    case ASSIGN:
-      ret += "=";
-      break;
-
-    case MULT_ASSIGN:
-      ret += "*=";
-      break;
-
-    case DIV_ASSIGN:
-      ret += "/=";
-      break;
-
-    case MOD_ASSIGN:
-      ret += "%=";
-      break;
-
-    case PLUS_ASSIGN:
-      ret += "+=";
-      break;
-
-    case MINUS_ASSIGN:
-      ret += "-=";
-      break;
-
-    case LSHIFT_ASSIGN:
-      ret += "<<=";
-      break;
-
-    case RSHIFT_ASSIGN:
-      ret += ">>=";
-      break;
-
-    case RSHIFT3_ASSIGN:
-      ret += ">>>=";
-      break;
-
-    case BIT_AND_ASSIGN:
-      ret += "&=";
-      break;
-
-    case BIT_XOR_ASSIGN:
-      ret += "^=";
-      break;
-
-    case BIT_OR_ASSIGN:
-      ret += "|=";
-      break;
+  node_recursion_guard_t guard(node_render_depth);
+  this->_childNodes.front()->renderMapped(guts, indentation);
+  if (guts->pretty) {
+    guts->sink->put(' ');
   }
+  guts->sink->write(node_assignment_text(this->op));
   if (guts->pretty) {
-    ret += " ";
+    guts->sink->put(' ');
   }
-  ret += this->_childNodes.back()->render(guts, indentation);
-  return ret;
+  this->_childNodes.back()->renderMapped(guts, indentation);
 }
 
 bool NodeAssignment::operator== (const Node &that) const {
   return Node::operator==(that) && this->op == static_cast<const NodeAssignment*>(&that)->op;
 }
 
+unsigned int NodeAssignment::hashValue() const {
+  return this->op;
+}
+
 //
 // NodeUnary
-NodeUnary::NodeUnary(node_unary_t op, const unsigned int lineno /* = 0 */) : NodeExpression(lineno), op(op) {}
+NodeUnary::NodeUnary(node_unary_t op, const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_UNARY), op(op) {}
 
 Node* NodeUnary::clone(Node* node) const {
   return Node::clone(new NodeUnary(this->op));
 }
 
-rope_t NodeUnary::render(render_guts_t* guts, int indentation) const {
-  rope_t ret;
-  bool need_space = false;
-  switch(this->op) {
-    case DELETE:
-      ret += "delete";
-      need_space = true;
-      break;
-    case VOID:
-      ret += "void";
-      need_space = true;
-      break;
-    case TYPEOF:
-      ret += "typeof";
-      need_space = true;
-      break;
-    case INCR_UNARY:
-      ret += "++";
-      break;
-    case DECR_UNARY:
-      ret += "--";
-      break;
-    case PLUS_UNARY:
-      ret += "+";
-      break;
-    case MINUS_UNARY:
-      ret += "-";
-      break;
-    case BIT_NOT_UNARY:
-      ret += "~";
-      break;
-    case NOT_UNARY:
-      ret += "!";
-      break;
+void NodeUnary::render(render_guts_t* guts, int indentation) const {
+  if (node_render_depth >= NODE_RECURSION_LIMIT) {
+    node_render_expression(this, guts, indentation);
+    return;
+  }
+  node_recursion_guard_t guard(node_render_depth);
+  guts->sink->write(node_unary_text(this->op));
+  if ((this->op == DELETE || this->op == VOID || this->op == TYPEOF) && this->_childNodes.front()->kind() != KIND_PARENTHETICAL) {
+    guts->sink->put(' ');
   }
-  if (need_space && dynamic_cast<NodeParenthetical*>(this->_childNodes.front()) == NULL) {
-    ret += " ";
+  this->_childNodes.front()->renderMapped(guts, indentation);
+}
+
+bool NodeUnary::compare(bool val) const {
+  const NodeExpression* operand = static_cast<const NodeExpression*>(this->_childNodes.front());
+  switch (this->op) {
+    case NOT_UNARY:
+      return operand->compare(!val);
+
+    // -1 and +1 have the truthiness of 1, but -x could call x's valueOf()
+    case MINUS_UNARY:
+    case PLUS_UNARY:
+      return operand->kind() == KIND_NUMERIC_LITERAL && operand->compare(val);
+
+    default:
+      return false;
   }
-  ret += this->_childNodes.front()->render(guts, indentation);
-  return ret;
 }
 
 bool NodeUnary::operator== (const Node &that) const {
   return Node::operator==(that) && this->op == static_cast<const NodeUnary*>(&that)->op;
 }
 
+unsigned int NodeUnary::hashValue() const {
+  return this->op;
+}
+
 //
 // NodePostfix
-NodePostfix::NodePostfix(node_postfix_t op, const unsigned int lineno /* = 0 */) : NodeExpression(lineno), op(op) {}
+NodePostfix::NodePostfix(node_postfix_t op, const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_POSTFIX), op(op) {}
 
 Node* NodePostfix::clone(Node* node) const {
   return Node::clone(new NodePostfix(this->op));
 }
 
-rope_t NodePostfix::render(render_guts_t* guts, int indentation) const {
-  rope_t ret(this->_childNodes.front()->render(guts, indentation));
+void NodePostfix::render(render_guts_t* guts, int indentation) const {
+  this->_childNodes.front()->renderMapped(guts, indentation);
   switch (this->op) {
     case INCR_POSTFIX:
-      ret += "++";
+      guts->sink->write("++");
       break;
     case DECR_POSTFIX:
-      ret += "--";
+      guts->sink->write("--");
       break;
   }
-  return ret;
 }
 
 bool NodePostfix::operator== (const Node &that) const {
   return Node::operator==(that) && this->op == static_cast<const NodePostfix*>(&that)->op;
 }
 
+unsigned int NodePostfix::hashValue() const {
+  return this->op;
+}
+
 //
 // NodeIdentifier
-NodeIdentifier::NodeIdentifier(const string &name, const unsigned int lineno /* = 0 */) : NodeExpression(lineno), _name(name) {}
+NodeIdentifier::NodeIdentifier(const string &name, const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_IDENTIFIER), _atom(NULL), _atoms(NULL), _name(name) {}
+
+// Identifiers built by an arena parse refer to the program's atom table
+// directly; without a table the name is copied.
+NodeIdentifier::NodeIdentifier(const string* atom, NodeAtomTable* atoms, const unsigned int lineno /* = 0 */) :
+  NodeExpression(lineno, KIND_IDENTIFIER), _atom(atoms ? atom : NULL), _atoms(atoms) {
+  if (atoms == NULL) {
+    this->_name = *atom;
+  }
+}
 
 Node* NodeIdentifier::clone(Node* node) const {
-  return Node::clone(new NodeIdentifier(this->_name));
+  return Node::clone(new NodeIdentifier(this->name()));
 }
 
-rope_t NodeIdentifier::render(render_guts_t* guts, int indentation) const {
-  return rope_t(this->_name.c_str());
+void NodeIdentifier::render(render_guts_t* guts, int indentation) const {
+  guts->sink->write(this->name().c_str());
 }
 
 const string& NodeIdentifier::name() const {
-  return this->_name;
+  return this->_atom ? *this->_atom : this->_name;
 }
 
 bool NodeIdentifier::isValidlVal() const {
@@ -800,101 +2051,138 @@ bool NodeIdentifier::isValidlVal() const {
 }
 
 void NodeIdentifier::rename(const string &str) {
-  this->_name = str;
+  this->invalidateHash();
+  if (this->_atoms) {
+    this->_atom = this->_atoms->internShared(str);
+  } else {
+    this->_name = str;
+  }
 }
 
 bool NodeIdentifier::operator== (const Node &that) const {
-  const NodeIdentifier* thatIdentifier = dynamic_cast<const NodeIdentifier*>(&that);
-  return thatIdentifier == NULL ? false : this->_name == thatIdentifier->_name;
+  if (that.kind() != KIND_IDENTIFIER) {
+    return false;
+  }
+  const NodeIdentifier* thatIdentifier = static_cast<const NodeIdentifier*>(&that);
+  if (this->_atoms && this->_atoms == thatIdentifier->_atoms) {
+    return this->_atom == thatIdentifier->_atom;
+  }
+  return this->name() == thatIdentifier->name();
+}
+
+unsigned int NodeIdentifier::hashValue() const {
+  const string& name = this->name();
+  return node_hash_bytes(0, name.data(), name.size());
 }
 
 //
 // NodeArgList: list of expressions for a function call or definition
-NodeArgList::NodeArgList(const unsigned int lineno /* = 0 */) : Node(lineno) {}
+NodeArgList::NodeArgList(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_ARG_LIST) {}
 Node* NodeArgList::clone(Node* node) const {
   return Node::clone(new NodeArgList());
 }
 
-rope_t NodeArgList::render(render_guts_t* guts, int indentation) const {
-  return rope_t("(") + this->renderImplodeChildren(guts, indentation, guts->pretty ? ", " : ",") + ")";
+void NodeArgList::render(render_guts_t* guts, int indentation) const {
+  if (node_render_depth >= NODE_RECURSION_LIMIT) {
+    node_render_expression(this, guts, indentation);
+    return;
+  }
+  node_recursion_guard_t guard(node_render_depth);
+  guts->sink->put('(');
+  this->renderImplodeChildren(guts, indentation, guts->pretty ? ", " : ",");
+  guts->sink->put(')');
 }
 
 //
 // NodeFunctionDeclaration: brings a function into scope
-NodeFunctionDeclaration::NodeFunctionDeclaration(const unsigned int lineno /* = 0 */) : Node(lineno) {}
+NodeFunctionDeclaration::NodeFunctionDeclaration(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_FUNCTION_DECLARATION) {}
 
 Node* NodeFunctionDeclaration::clone(Node* node) const {
   return Node::clone(new NodeFunctionDeclaration());
 }
 
-rope_t NodeFunctionDeclaration::render(render_guts_t* guts, int indentation) const {
-  rope_t ret;
+void NodeFunctionDeclaration::render(render_guts_t* guts, int indentation) const {
   node_list_t::const_iterator node = this->_childNodes.begin();
 
-  ret += rope_t("function ") + (*node)->render(guts, indentation);
-  ret += (*++node)->render(guts, indentation);
-  ret += (*++node)->renderBlock(true, guts, indentation);
-  return ret;
+  guts->sink->write("function ");
+  (*node)->renderMapped(guts, indentation);
+  (*++node)->renderMapped(guts, indentation);
+  (*++node)->renderBlock(true, guts, indentation);
 }
 
 //
 // NodeFunctionExpression: returns a function
-NodeFunctionExpression::NodeFunctionExpression(const unsigned int lineno /* = 0 */) : NodeExpression(lineno) {}
+NodeFunctionExpression::NodeFunctionExpression(const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_FUNCTION_EXPRESSION) {}
 
 Node* NodeFunctionExpression::clone(Node* node) const {
   return Node::clone(new NodeFunctionExpression());
 }
 
-rope_t NodeFunctionExpression::render(render_guts_t* guts, int indentation) const {
-  rope_t ret;
+void NodeFunctionExpression::render(render_guts_t* guts, int indentation) const {
   node_list_t::const_iterator node = this->_childNodes.begin();
 
-  ret += "function";
+  guts->sink->write("function");
   if (*node != NULL) {
-    ret += rope_t(" ") + (*node)->render(guts, indentation);
+    guts->sink->put(' ');
+    (*node)->renderMapped(guts, indentation);
   }
-  ret += (*++node)->render(guts, indentation);
-  ret += (*++node)->renderBlock(true, guts, indentation);
-  return ret;
+  (*++node)->renderMapped(guts, indentation);
+  (*++node)->renderBlock(true, guts, indentation);
 }
 
 //
 // NodeFunctionCall: foo(1). note: this does not cover new foo(1);
-NodeFunctionCall::NodeFunctionCall(const unsigned int lineno /* = 0 */) : NodeExpression(lineno) {}
+NodeFunctionCall::NodeFunctionCall(const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_FUNCTION_CALL) {}
 Node* NodeFunctionCall::clone(Node* node) const {
   return Node::clone(new NodeFunctionCall());
 }
 
-rope_t NodeFunctionCall::render(render_guts_t* guts, int indentation) const {
-  return rope_t(this->_childNodes.front()->render(guts, indentation)) + this->_childNodes.back()->render(guts, indentation);
+void NodeFunctionCall::render(render_guts_t* guts, int indentation) const {
+  if (node_render_depth >= NODE_RECURSION_LIMIT) {
+    node_render_expression(this, guts, indentation);
+    return;
+  }
+  node_recursion_guard_t guard(node_render_depth);
+  node_render_later_t args(guts, this->_childNodes.back(), indentation, node_render_has_lines(guts, this->_childNodes.back()) &&
+    node_render_has_lines(guts, this->_childNodes.front()));
+  this->_childNodes.front()->renderMapped(guts, indentation);
+  args.write();
 }
 
 //
 // NodeFunctionConstructor: new foo(1)
-NodeFunctionConstructor::NodeFunctionConstructor(const unsigned int lineno /* = 0 */) : NodeExpression(lineno) {}
+NodeFunctionConstructor::NodeFunctionConstructor(const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_FUNCTION_CONSTRUCTOR) {}
 Node* NodeFunctionConstructor::clone(Node* node) const {
   return Node::clone(new NodeFunctionConstructor());
 }
 
-rope_t NodeFunctionConstructor::render(render_guts_t* guts, int indentation) const {
-  return rope_t("new ") + this->_childNodes.front()->render(guts, indentation) + this->_childNodes.back()->render(guts, indentation);
+void NodeFunctionConstructor::render(render_guts_t* guts, int indentation) const {
+  if (node_render_depth >= NODE_RECURSION_LIMIT) {
+    node_render_expression(this, guts, indentation);
+    return;
+  }
+  node_recursion_guard_t guard(node_render_depth);
+  node_render_later_t args(guts, this->_childNodes.back(), indentation, node_render_has_lines(guts, this->_childNodes.back()) &&
+    node_render_has_lines(guts, this->_childNodes.front()));
+  guts->sink->write("new ");
+  this->_childNodes.front()->renderMapped(guts, indentation);
+  args.write();
 }
 
 //
 // NodeIf: if (true) { honk(dazzle); };
-NodeIf::NodeIf(const unsigned int lineno /* = 0 */) : Node(lineno) {}
+NodeIf::NodeIf(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_IF) {}
 Node* NodeIf::clone(Node* node) const {
   return Node::clone(new NodeIf());
 }
 
-rope_t NodeIf::render(render_guts_t* guts, int indentation) const {
-  rope_t ret;
+void NodeIf::render(render_guts_t* guts, int indentation) const {
 
   // Render the conditional expression
   node_list_t::const_iterator node = this->_childNodes.begin();
-  ret += guts->pretty ? "if (" : "if(";
-  ret += (*node)->render(guts, indentation);
-  ret += ")";
+  guts->sink->write(guts->pretty ? "if (" : "if(");
+  (*node)->renderMapped(guts, indentation);
+  guts->sink->put(')');
 
   // Currently we need braces if it has else statement
   // TODO: braces are not needed if no nested-if statement.
@@ -903,186 +2191,195 @@ rope_t NodeIf::render(render_guts_t* guts, int indentation) const {
 
   bool needBraces = guts->pretty || ifBlock->childNodes().empty()
                     || elseBlock != NULL;
-  ret += ifBlock->renderBlock(needBraces, guts, indentation);
+  ifBlock->renderBlock(needBraces, guts, indentation);
 
   // Render else
   if (elseBlock != NULL) {
-    ret += guts->pretty ? " else" : "else";
+    guts->sink->write(guts->pretty ? " else" : "else");
 
     // Special-case for rendering else if's
-    if (typeid(*elseBlock) == typeid(NodeIf)) {
+    if (elseBlock->kind() == KIND_IF) {
       if (guts->sanelineno) {
-        elseBlock->renderLinenoCatchup(guts, ret);
+        elseBlock->renderLinenoCatchup(guts);
       }
-      ret += " ";
-      ret += elseBlock->render(guts, indentation);
+      guts->sink->put(' ');
+      elseBlock->renderMapped(guts, indentation);
     } else {
-      rope_t block = elseBlock->renderBlock(false, guts, indentation);
-      if (block[0] != '{' && block[0] != ' ') {
-        ret += " ";
-      }
-      ret += block;
+      // Separate `else` from the block unless the block opens with a brace or space
+      guts->sink->deferSpace();
+      elseBlock->renderBlock(false, guts, indentation);
+      guts->sink->cancelDeferredSpace();
     }
   }
-  return ret;
 }
 
 //
 // NodeWith: with (foo) { bar(); };
-NodeWith::NodeWith(const unsigned int lineno /* = 0 */) : Node(lineno) {}
+NodeWith::NodeWith(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_WITH) {}
 Node* NodeWith::clone(Node* node) const {
   return Node::clone(new NodeWith());
 }
 
-rope_t NodeWith::render(render_guts_t* guts, int indentation) const {
-  rope_t ret;
+void NodeWith::render(render_guts_t* guts, int indentation) const {
   node_list_t::const_iterator node = this->_childNodes.begin();
-  ret += guts->pretty ? "with (" : "with(";
-  ret += (*node)->render(guts, indentation);
-  ret += ")";
-  ret += (*++node)->renderBlock(false, guts, indentation);
-  return ret;
+  guts->sink->write(guts->pretty ? "with (" : "with(");
+  (*node)->renderMapped(guts, indentation);
+  guts->sink->put(')');
+  (*++node)->renderBlock(false, guts, indentation);
 }
 
 //
 // NodeTry
-NodeTry::NodeTry(const unsigned int lineno /* = 0 */) : Node(lineno) {}
+NodeTry::NodeTry(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_TRY) {}
 Node* NodeTry::clone(Node* node) const {
   return Node::clone(new NodeTry());
 }
 
-rope_t NodeTry::render(render_guts_t* guts, int indentation) const {
-  rope_t ret;
+void NodeTry::render(render_guts_t* guts, int indentation) const {
   node_list_t::const_iterator node = this->_childNodes.begin();
-  ret += "try";
-  ret += (*node)->renderBlock(true, guts, indentation);
+  guts->sink->write("try");
+  (*node)->renderBlock(true, guts, indentation);
   if (*++node != NULL) {
-    ret += (guts->pretty ? " catch (" : "catch(");
-    ret += (*node)->render(guts, indentation) + ")";
-    ret += (*++node)->renderBlock(true, guts, indentation);
+    guts->sink->write(guts->pretty ? " catch (" : "catch(");
+    (*node)->renderMapped(guts, indentation);
+    guts->sink->put(')');
+    (*++node)->renderBlock(true, guts, indentation);
   } else {
     node++;
   }
   if (*++node != NULL) {
-    ret += (guts->pretty ? " finally" : "finally");
-    ret += (*node)->renderBlock(true, guts, indentation);
+    guts->sink->write(guts->pretty ? " finally" : "finally");
+    (*node)->renderBlock(true, guts, indentation);
   }
-  return ret;
 }
 
 //
 // NodeStatement
-NodeStatement::NodeStatement(const unsigned int lineno /* = 0 */) : Node(lineno) {}
-rope_t NodeStatement::renderStatement(render_guts_t* guts, int indentation) const {
-  return this->render(guts, indentation) + ";";
+NodeStatement::NodeStatement(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_STATEMENT) {}
+NodeStatement::NodeStatement(const unsigned int lineno, node_kind_enum kind) : Node(lineno, kind) {}
+void NodeStatement::renderStatement(render_guts_t* guts, int indentation) const {
+  this->renderMapped(guts, indentation);
+  guts->sink->put(';');
 }
 
 //
 // NodeStatementWithExpression: generalized node for return, throw, continue, and break. makes rendering easier and
 // the rewriter doesn't really need anything from the nodes
-NodeStatementWithExpression::NodeStatementWithExpression(node_statement_with_expression_t statement, const unsigned int lineno /* = 0 */) : NodeStatement(lineno), statement(statement) {}
+NodeStatementWithExpression::NodeStatementWithExpression(node_statement_with_expression_t statement, const unsigned int lineno /* = 0 */) : NodeStatement(lineno, KIND_STATEMENT_WITH_EXPRESSION), statement(statement) {}
 
 Node* NodeStatementWithExpression::clone(Node* node) const {
   return Node::clone(new NodeStatementWithExpression(this->statement));
 }
 
-rope_t NodeStatementWithExpression::render(render_guts_t* guts, int indentation) const {
-  rope_t ret;
+void NodeStatementWithExpression::render(render_guts_t* guts, int indentation) const {
   switch (this->statement) {
     case THROW:
-      ret += "throw";
+      guts->sink->write("throw");
       break;
 
     case RETURN:
-      ret += "return";
+      guts->sink->write("return");
       break;
 
     case CONTINUE:
-      ret += "continue";
+      guts->sink->write("continue");
       break;
 
     case BREAK:
-      ret += "break";
+      guts->sink->write("break");
       break;
   }
   if (this->_childNodes.back() != NULL) {
-    ret += " ";
-    ret += this->_childNodes.front()->render(guts, indentation);
+    guts->sink->put(' ');
+    this->_childNodes.front()->renderMapped(guts, indentation);
   }
-  return ret;
 }
 
 bool NodeStatementWithExpression::operator== (const Node &that) const {
   return Node::operator==(that) && this->statement == static_cast<const NodeStatementWithExpression*>(&that)->statement;
 }
 
+unsigned int NodeStatementWithExpression::hashValue() const {
+  return this->statement;
+}
+
 //
 // NodeLabel
-NodeLabel::NodeLabel(const unsigned int lineno /* = 0 */) : Node(lineno) {}
+NodeLabel::NodeLabel(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_LABEL) {}
 Node* NodeLabel::clone(Node* node) const {
   return Node::clone(new NodeLabel());
 }
 
-rope_t NodeLabel::render(render_guts_t* guts, int indentation) const {
-  return rope_t(this->_childNodes.front()->render(guts, indentation)) + (guts->pretty ? ": " : ":") + this->_childNodes.back()->render(guts, indentation);
+void NodeLabel::render(render_guts_t* guts, int indentation) const {
+  this->_childNodes.front()->renderMapped(guts, indentation);
+  guts->sink->write(guts->pretty ? ": " : ":");
+  this->_childNodes.back()->renderMapped(guts, indentation);
 }
 
-rope_t NodeLabel::renderStatement(render_guts_t* guts, int indentation) const {
-  return this->render(guts, indentation) + ";";
+void NodeLabel::renderStatement(render_guts_t* guts, int indentation) const {
+  this->renderMapped(guts, indentation);
+  guts->sink->put(';');
 }
 
 //
 // NodeSwitch
-NodeSwitch::NodeSwitch(const unsigned int lineno /* = 0 */) : Node(lineno) {}
+NodeSwitch::NodeSwitch(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_SWITCH) {}
 Node* NodeSwitch::clone(Node* node) const {
   return Node::clone(new NodeSwitch());
 }
 
-rope_t NodeSwitch::render(render_guts_t* guts, int indentation) const {
-  return rope_t("switch(") + this->_childNodes.front()->render(guts, indentation) + ")" +
-    // Render this with extra indentation, and then in NodeCaseClause we drop lower by 1.
-    this->_childNodes.back()->renderBlock(true, guts, indentation + 1);
+void NodeSwitch::render(render_guts_t* guts, int indentation) const {
+  // Render this with extra indentation, and then in NodeCaseClause we drop lower by 1.
+  node_render_later_t block(guts, this->_childNodes.back(), indentation + 1, true, node_render_has_lines(guts, this->_childNodes.front()));
+  guts->sink->write("switch(");
+  this->_childNodes.front()->renderMapped(guts, indentation);
+  guts->sink->put(')');
+  block.write();
 }
 
 //
 // NodeCaseClause: case: bar();
-NodeCaseClause::NodeCaseClause(const unsigned int lineno /* = 0 */) : Node(lineno) {}
+NodeCaseClause::NodeCaseClause(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_CASE_CLAUSE) {}
+NodeCaseClause::NodeCaseClause(const unsigned int lineno, node_kind_enum kind) : Node(lineno, kind) {}
 Node* NodeCaseClause::clone(Node* node) const {
   return Node::clone(new NodeCaseClause());
 }
 
-rope_t NodeCaseClause::render(render_guts_t* guts, int indentation) const {
-  return rope_t("case ") + this->_childNodes.front()->render(guts, indentation) + ":";
+void NodeCaseClause::render(render_guts_t* guts, int indentation) const {
+  guts->sink->write("case ");
+  this->_childNodes.front()->renderMapped(guts, indentation);
+  guts->sink->put(':');
 }
 
-rope_t NodeCaseClause::renderStatement(render_guts_t* guts, int indentation) const {
-  return this->render(guts, indentation);
+void NodeCaseClause::renderStatement(render_guts_t* guts, int indentation) const {
+  this->renderMapped(guts, indentation);
 }
 
-rope_t NodeCaseClause::renderIndentedStatement(render_guts_t* guts, int indentation) const {
-  return Node::renderIndentedStatement(guts, indentation - 1);
+void NodeCaseClause::renderIndentedStatement(render_guts_t* guts, int indentation) const {
+  Node::renderIndentedStatement(guts, indentation - 1);
 }
 
 //
 // NodeDefaultClause: default: foo();
-NodeDefaultClause::NodeDefaultClause(const unsigned int lineno /* = 0 */) : NodeCaseClause(lineno) {}
+NodeDefaultClause::NodeDefaultClause(const unsigned int lineno /* = 0 */) : NodeCaseClause(lineno, KIND_DEFAULT_CLAUSE) {}
 Node* NodeDefaultClause::clone(Node* node) const {
   return Node::clone(new NodeDefaultClause());
 }
 
-rope_t NodeDefaultClause::render(render_guts_t* guts, int indentation) const {
-  return rope_t("default:");
+void NodeDefaultClause::render(render_guts_t* guts, int indentation) const {
+  guts->sink->write("default:");
 }
 
 //
 // NodeVarDeclaration: a list of identifiers with optional assignments
-NodeVarDeclaration::NodeVarDeclaration(bool iterator /* = false */, const unsigned int lineno /* = 0 */) : NodeStatement(lineno), _iterator(iterator) {}
+NodeVarDeclaration::NodeVarDeclaration(bool iterator /* = false */, const unsigned int lineno /* = 0 */) : NodeStatement(lineno, KIND_VAR_DECLARATION), _iterator(iterator) {}
 Node* NodeVarDeclaration::clone(Node* node) const {
-  return Node::clone(new NodeVarDeclaration());
+  return Node::clone(new NodeVarDeclaration(this->_iterator));
 }
 
-rope_t NodeVarDeclaration::render(render_guts_t* guts, int indentation) const {
-  return rope_t("var ") + this->renderImplodeChildren(guts, indentation, guts->pretty ? ", " : ",");
+void NodeVarDeclaration::render(render_guts_t* guts, int indentation) const {
+  guts->sink->write("var ");
+  this->renderImplodeChildren(guts, indentation, guts->pretty ? ", " : ",");
 }
 
 bool NodeVarDeclaration::iterator() const {
@@ -1096,57 +2393,68 @@ Node* NodeVarDeclaration::setIterator(bool iterator) {
 
 //
 // NodeTypehint: a variable declaration with a typehint
-NodeTypehint::NodeTypehint(const unsigned int lineno /* = 0 */) : Node(lineno) {}
+NodeTypehint::NodeTypehint(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_TYPEHINT) {}
 Node* NodeTypehint::clone(Node* node) const {
   return Node::clone(new NodeTypehint());
 }
 
-rope_t NodeTypehint::render(render_guts_t* guts, int indentation) const {
-  rope_t ret =
-    this->_childNodes.front()->render(guts, indentation) + ":" +
-    this->_childNodes.back()->render(guts, indentation);
-  return ret;
+void NodeTypehint::render(render_guts_t* guts, int indentation) const {
+  this->_childNodes.front()->renderMapped(guts, indentation);
+  guts->sink->put(':');
+  this->_childNodes.back()->renderMapped(guts, indentation);
 }
 
 //
 // NodeObjectLiteral
-NodeObjectLiteral::NodeObjectLiteral(const unsigned int lineno /* = 0 */) : NodeExpression(lineno) {}
+NodeObjectLiteral::NodeObjectLiteral(const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_OBJECT_LITERAL) {}
 Node* NodeObjectLiteral::clone(Node* node) const {
   return Node::clone(new NodeObjectLiteral());
 }
 
-rope_t NodeObjectLiteral::render(render_guts_t* guts, int indentation) const {
-  return rope_t("{") + this->renderImplodeChildren(guts, indentation, guts->pretty ? ", " : ",") + "}";
+void NodeObjectLiteral::render(render_guts_t* guts, int indentation) const {
+  guts->sink->put('{');
+  this->renderImplodeChildren(guts, indentation, guts->pretty ? ", " : ",");
+  guts->sink->put('}');
 }
 
 //
 // NodeObjectLiteralProperty
-NodeObjectLiteralProperty::NodeObjectLiteralProperty(const unsigned int lineno /* = 0 */) : Node(lineno) {}
+NodeObjectLiteralProperty::NodeObjectLiteralProperty(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_OBJECT_LITERAL_PROPERTY) {}
 Node* NodeObjectLiteralProperty::clone(Node* node) const {
   return Node::clone(new NodeObjectLiteralProperty());
 }
 
-rope_t NodeObjectLiteralProperty::render(render_guts_t* guts, int indentation) const {
-  return rope_t(this->_childNodes.front()->render(guts, indentation)) + (guts->pretty ? ": " : ":") +
-    this->_childNodes.back()->render(guts, indentation);
+void NodeObjectLiteralProperty::render(render_guts_t* guts, int indentation) const {
+  this->_childNodes.front()->renderMapped(guts, indentation);
+  guts->sink->write(guts->pretty ? ": " : ":");
+  this->_childNodes.back()->renderMapped(guts, indentation);
 }
 
 //
 // NodeArrayLiteral
-NodeArrayLiteral::NodeArrayLiteral(const unsigned int lineno /* = 0 */) : NodeExpression(lineno) {}
+NodeArrayLiteral::NodeArrayLiteral(const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_ARRAY_LITERAL) {}
 Node* NodeArrayLiteral::clone(Node* node) const {
   return Node::clone(new NodeArrayLiteral());
 }
 
-rope_t NodeArrayLiteral::render(render_guts_t* guts, int indentation) const {
-  return rope_t("[") + this->renderImplodeChildren(guts, indentation, guts->pretty ? ", " : ",") + "]";
+void NodeArrayLiteral::render(render_guts_t* guts, int indentation) const {
+  guts->sink->put('[');
+  this->renderImplodeChildren(guts, indentation, guts->pretty ? ", " : ",");
+  guts->sink->put(']');
 }
 
 //
 // NodeStaticMemberExpression: object access via foo.bar
-NodeStaticMemberExpression::NodeStaticMemberExpression(const unsigned int lineno /* = 0 */) : NodeExpression(lineno) {}
-rope_t NodeStaticMemberExpression::render(render_guts_t* guts, int indentation) const {
-  return rope_t(this->_childNodes.front()->render(guts, indentation)) + "." + this->_childNodes.back()->render(guts, indentation);
+NodeStaticMemberExpression::NodeStaticMemberExpression(const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_STATIC_MEMBER_EXPRESSION) {}
+void NodeStaticMemberExpression::render(render_guts_t* guts, int indentation) const {
+  if (node_render_depth >= NODE_RECURSION_LIMIT) {
+    node_render_expression(this, guts, indentation);
+    return;
+  }
+  node_recursion_guard_t guard(node_render_depth);
+  this->_childNodes.front()->renderMapped(guts, indentation);
+  guts->sink->put('.');
+  this->_childNodes.back()->renderMapped(guts, indentation);
 }
 
 Node* NodeStaticMemberExpression::clone(Node* node) const {
@@ -1159,15 +2467,24 @@ bool NodeStaticMemberExpression::isValidlVal() const {
 
 //
 // NodeDynamicMemberExpression: object access via foo['bar']
-NodeDynamicMemberExpression::NodeDynamicMemberExpression(const unsigned int lineno /* = 0 */) : NodeExpression(lineno) {}
+NodeDynamicMemberExpression::NodeDynamicMemberExpression(const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_DYNAMIC_MEMBER_EXPRESSION) {}
 
 Node* NodeDynamicMemberExpression::clone(Node* node) const {
   return Node::clone(new NodeDynamicMemberExpression());
 }
 
-rope_t NodeDynamicMemberExpression::render(render_guts_t* guts, int indentation) const {
-  return rope_t(this->_childNodes.front()->render(guts, indentation)) +
-    "[" + this->_childNodes.back()->render(guts, indentation) + "]";
+void NodeDynamicMemberExpression::render(render_guts_t* guts, int indentation) const {
+  if (node_render_depth >= NODE_RECURSION_LIMIT) {
+    node_render_expression(this, guts, indentation);
+    return;
+  }
+  node_recursion_guard_t guard(node_render_depth);
+  node_render_later_t member(guts, this->_childNodes.back(), indentation, node_render_has_lines(guts, this->_childNodes.back()) &&
+    node_render_has_lines(guts, this->_childNodes.front()));
+  this->_childNodes.front()->renderMapped(guts, indentation);
+  guts->sink->put('[');
+  member.write();
+  guts->sink->put(']');
 }
 
 bool NodeDynamicMemberExpression::isValidlVal() const {
@@ -1176,110 +2493,119 @@ bool NodeDynamicMemberExpression::isValidlVal() const {
 
 //
 // NodeForLoop: only for(;;); loops, not for in
-NodeForLoop::NodeForLoop(const unsigned int lineno /* = 0 */) : Node(lineno) {}
+NodeForLoop::NodeForLoop(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_FOR_LOOP) {}
 Node* NodeForLoop::clone(Node* node) const {
   return Node::clone(new NodeForLoop());
 }
 
-rope_t NodeForLoop::render(render_guts_t* guts, int indentation) const {
+void NodeForLoop::render(render_guts_t* guts, int indentation) const {
   node_list_t::const_iterator node = this->_childNodes.begin();
-  rope_t ret(guts->pretty ? "for (" : "for(");
-  ret += (*node)->render(guts, indentation) + (guts->pretty ? "; " : ";");
-  ret += (*++node)->render(guts, indentation) + (guts->pretty ? "; " : ";");
-  ret += (*++node)->render(guts, indentation) + ")";
-  ret += (*++node)->renderBlock(false, guts, indentation);
-  return ret;
+  guts->sink->write(guts->pretty ? "for (" : "for(");
+  (*node)->renderMapped(guts, indentation);
+  guts->sink->write(guts->pretty ? "; " : ";");
+  (*++node)->renderMapped(guts, indentation);
+  guts->sink->write(guts->pretty ? "; " : ";");
+  (*++node)->renderMapped(guts, indentation);
+  guts->sink->put(')');
+  (*++node)->renderBlock(false, guts, indentation);
 }
 
 //
 // NodeForIn
-NodeForIn::NodeForIn(const unsigned int lineno /* = 0 */) : Node(lineno) {}
+NodeForIn::NodeForIn(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_FOR_IN) {}
 Node* NodeForIn::clone(Node* node) const {
   return Node::clone(new NodeForIn());
 }
 
-rope_t NodeForIn::render(render_guts_t* guts, int indentation) const {
+void NodeForIn::render(render_guts_t* guts, int indentation) const {
   node_list_t::const_iterator node = this->_childNodes.begin();
-  rope_t ret(guts->pretty ? "for (" : "for(");
-  ret += (*node)->render(guts, indentation) + " in ";
-  ret += (*++node)->render(guts, indentation) + ")";
-  ret += (*++node)->renderBlock(false, guts, indentation);
-  return ret;
+  guts->sink->write(guts->pretty ? "for (" : "for(");
+  (*node)->renderMapped(guts, indentation);
+  guts->sink->write(" in ");
+  (*++node)->renderMapped(guts, indentation);
+  guts->sink->put(')');
+  (*++node)->renderBlock(false, guts, indentation);
 }
 
 //
 // NodeForEachIn
-NodeForEachIn::NodeForEachIn(const unsigned int lineno /* = 0 */) : Node(lineno) {}
+NodeForEachIn::NodeForEachIn(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_FOR_EACH_IN) {}
 Node* NodeForEachIn::clone(Node* node) const {
   return Node::clone(new NodeForEachIn());
 }
 
-rope_t NodeForEachIn::render(render_guts_t* guts, int indentation) const {
+void NodeForEachIn::render(render_guts_t* guts, int indentation) const {
   node_list_t::const_iterator node = this->_childNodes.begin();
-  rope_t ret(guts->pretty ? "for each (" : "for each(");
-  ret += (*node)->render(guts, indentation) + " in ";
-  ret += (*++node)->render(guts, indentation) + ")";
-  ret += (*++node)->renderBlock(false, guts, indentation);
-  return ret;
+  guts->sink->write(guts->pretty ? "for each (" : "for each(");
+  (*node)->renderMapped(guts, indentation);
+  guts->sink->write(" in ");
+  (*++node)->renderMapped(guts, indentation);
+  guts->sink->put(')');
+  (*++node)->renderBlock(false, guts, indentation);
 }
 
 //
 // NodeWhile
-NodeWhile::NodeWhile(const unsigned int lineno /* = 0 */) : Node(lineno) {}
+NodeWhile::NodeWhile(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_WHILE) {}
 Node* NodeWhile::clone(Node* node) const {
   return Node::clone(new NodeWhile());
 }
 
-rope_t NodeWhile::render(render_guts_t* guts, int indentation) const {
-  return rope_t(guts->pretty ? "while (" : "while(") +
-    this->_childNodes.front()->render(guts, indentation) + ")" +
-    this->_childNodes.back()->renderBlock(false, guts, indentation);
+void NodeWhile::render(render_guts_t* guts, int indentation) const {
+  node_render_later_t block(guts, this->_childNodes.back(), indentation, false, node_render_has_lines(guts, this->_childNodes.front()));
+  guts->sink->write(guts->pretty ? "while (" : "while(");
+  this->_childNodes.front()->renderMapped(guts, indentation);
+  guts->sink->put(')');
+  block.write();
 }
 
 //
 // NodeDoWhile
-NodeDoWhile::NodeDoWhile(const unsigned int lineno /* = 0 */) : NodeStatement(lineno) {}
+NodeDoWhile::NodeDoWhile(const unsigned int lineno /* = 0 */) : NodeStatement(lineno, KIND_DO_WHILE) {}
 Node* NodeDoWhile::clone(Node* node) const {
   return Node::clone(new NodeDoWhile());
 }
 
-rope_t NodeDoWhile::render(render_guts_t* guts, int indentation) const {
-  rope_t ret("do");
+void NodeDoWhile::render(render_guts_t* guts, int indentation) const {
+  guts->sink->write("do");
   // Technically this shouldn't be renderBlock(true, ...) but requiring braces makes it easier to render it all...
-  ret += this->_childNodes.front()->renderBlock(true, guts, indentation);
+  this->_childNodes.front()->renderBlock(true, guts, indentation);
   if (guts->sanelineno) {
-    this->_childNodes.back()->renderLinenoCatchup(guts, ret);
+    this->_childNodes.back()->renderLinenoCatchup(guts);
   }
-  ret += (guts->pretty ? " while (" : "while(") ;
-  ret += this->_childNodes.back()->render(guts, indentation) + ")";
-  return ret;
+  guts->sink->write(guts->pretty ? " while (" : "while(");
+  this->_childNodes.back()->renderMapped(guts, indentation);
+  guts->sink->put(')');
 }
 
 //
 // NodeXMLDefaultNamespace
-NodeXMLDefaultNamespace::NodeXMLDefaultNamespace(const unsigned int lineno /* = 0 */) : NodeStatement(lineno) {}
+NodeXMLDefaultNamespace::NodeXMLDefaultNamespace(const unsigned int lineno /* = 0 */) : NodeStatement(lineno, KIND_XML_DEFAULT_NAMESPACE) {}
 
 Node* NodeXMLDefaultNamespace::clone(Node* node) const {
   return Node::clone(new NodeXMLDefaultNamespace());
 }
 
-rope_t NodeXMLDefaultNamespace::render(render_guts_t* guts, int indentation) const {
-  return rope_t("default xml namespace = ") + this->_childNodes.front()->render(guts, indentation);
+void NodeXMLDefaultNamespace::render(render_guts_t* guts, int indentation) const {
+  guts->sink->write("default xml namespace = ");
+  this->_childNodes.front()->renderMapped(guts, indentation);
 }
 
 //
 // NodeXMLName
-NodeXMLName::NodeXMLName(const string &ns, const string &name, const unsigned int lineno /* = 0 */) : Node(lineno), _ns(ns), _name(name) {}
+NodeXMLName::NodeXMLName(const string &ns, const string &name, const unsigned int lineno /* = 0 */) : Node(lineno, KIND_XML_NAME), _ns(ns), _name(name) {}
 
 Node* NodeXMLName::clone(Node* node) const {
   return Node::clone(new NodeXMLName(this->_ns, this->_name));
 }
 
-rope_t NodeXMLName::render(render_guts_t* guts, int indentation) const {
+void NodeXMLName::render(render_guts_t* guts, int indentation) const {
   if (this->_ns.empty()) {
-    return rope_t(this->_name.c_str());
+    guts->sink->write(this->_name.c_str());
   } else {
-    return rope_t(this->_ns.c_str()) + rope_t(":") + rope_t(this->_name.c_str());
+    guts->sink->write(this->_ns.c_str());
+    guts->sink->put(':');
+    guts->sink->write(this->_name.c_str());
   }
 }
 
@@ -1291,104 +2617,136 @@ const string NodeXMLName::name() const {
   return this->_name;
 }
 
+bool NodeXMLName::operator== (const Node &that) const {
+  if (that.kind() != KIND_XML_NAME) {
+    return false;
+  }
+  const NodeXMLName* thatName = static_cast<const NodeXMLName*>(&that);
+  return this->_ns == thatName->_ns && this->_name == thatName->_name;
+}
+
+unsigned int NodeXMLName::hashValue() const {
+  return node_hash_mix(node_hash_bytes(0, this->_ns.data(), this->_ns.size()),
+    node_hash_bytes(0, this->_name.data(), this->_name.size()));
+}
+
 //
 // NodeXMLElement
-NodeXMLElement::NodeXMLElement(const unsigned int lineno /* = 0 */) : NodeExpression(lineno) {}
+NodeXMLElement::NodeXMLElement(const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_XML_ELEMENT) {}
 
 Node* NodeXMLElement::clone(Node* node) const {
   return Node::clone(new NodeXMLElement());
 }
 
-rope_t NodeXMLElement::render(render_guts_t* guts, int indentation) const {
-  rope_t ret("<");
+void NodeXMLElement::render(render_guts_t* guts, int indentation) const {
+  guts->sink->put('<');
   node_list_t::const_iterator ii = this->_childNodes.begin();
   if (*ii != NULL) {
-    ret += (*ii)->render(guts, indentation);
+    (*ii)->renderMapped(guts, indentation);
   } else {
     // xml list
     ii++;
-    ret += ">";
-    ret += (*++ii)->render(guts, indentation);
-    ret += "</>";
-    return ret;
+    guts->sink->put('>');
+    (*++ii)->renderMapped(guts, indentation);
+    guts->sink->write("</>");
+    return;
   }
   ++ii;
   if (!(*ii)->empty()) {
-    ret += " ";
-    ret += (*ii)->render(guts, indentation);
+    guts->sink->put(' ');
+    (*ii)->renderMapped(guts, indentation);
   }
   ++ii;
   if (!(*ii)->empty()) {
-    ret += ">";
-    ret += (*ii)->render(guts, indentation);
-    ret += "</";
-    ret += (*++ii)->render(guts, indentation);
-    ret += ">";
+    guts->sink->put('>');
+    (*ii)->renderMapped(guts, indentation);
+    guts->sink->write("</");
+    (*++ii)->renderMapped(guts, indentation);
+    guts->sink->put('>');
   } else {
     if ((*++ii) == NULL) {
-      ret += "/>";
+      guts->sink->write("/>");
     } else {
-      ret += "</";
-      ret += (*ii)->render(guts, indentation);
-      ret += ">";
+      guts->sink->write("</");
+      (*ii)->renderMapped(guts, indentation);
+      guts->sink->put('>');
     }
   }
-  return ret;
 }
 
 //
 // NodeXMLComment
-NodeXMLComment::NodeXMLComment(const string &comment, const unsigned int lineno /* = 0 */) : Node(lineno), _comment(comment) {}
+NodeXMLComment::NodeXMLComment(const string &comment, const unsigned int lineno /* = 0 */) : Node(lineno, KIND_XML_COMMENT), _comment(comment) {}
 
 Node* NodeXMLComment::clone(Node* node) const {
   return Node::clone(new NodeXMLComment(this->_comment));
 }
 
-rope_t NodeXMLComment::render(render_guts_t* guts, int indentation) const {
-  rope_t ret("<!--");
-  ret += rope_t(this->_comment.c_str());
-  ret += "-->";
-  return ret;
+void NodeXMLComment::render(render_guts_t* guts, int indentation) const {
+  guts->sink->write("<!--");
+  guts->sink->write(this->_comment.c_str());
+  guts->sink->write("-->");
 }
 
 const string NodeXMLComment::comment() const {
   return this->_comment;
 }
 
+bool NodeXMLComment::operator== (const Node &that) const {
+  if (that.kind() != KIND_XML_COMMENT) {
+    return false;
+  }
+  return this->_comment == static_cast<const NodeXMLComment*>(&that)->_comment;
+}
+
+unsigned int NodeXMLComment::hashValue() const {
+  return node_hash_bytes(0, this->_comment.data(), this->_comment.size());
+}
+
 //
 // NodeXMLPI
-NodeXMLPI::NodeXMLPI(const string &data, const unsigned int lineno /* = 0 */) : Node(lineno), _data(data) {}
+NodeXMLPI::NodeXMLPI(const string &data, const unsigned int lineno /* = 0 */) : Node(lineno, KIND_XML_PI), _data(data) {}
 
 Node* NodeXMLPI::clone(Node* node) const {
   return Node::clone(new NodeXMLPI(this->_data));
 }
 
-rope_t NodeXMLPI::render(render_guts_t* guts, int indentation) const {
-  rope_t ret("<?");
-  ret += rope_t(this->_data.c_str());
-  ret += "?>";
-  return ret;
+void NodeXMLPI::render(render_guts_t* guts, int indentation) const {
+  guts->sink->write("<?");
+  guts->sink->write(this->_data.c_str());
+  guts->sink->write("?>");
 }
 
 const string NodeXMLPI::data() const {
   return this->_data;
 }
 
+bool NodeXMLPI::operator== (const Node &that) const {
+  if (that.kind() != KIND_XML_PI) {
+    return false;
+  }
+  return this->_data == static_cast<const NodeXMLPI*>(&that)->_data;
+}
+
+unsigned int NodeXMLPI::hashValue() const {
+  return node_hash_bytes(0, this->_data.data(), this->_data.size());
+}
+
 //
 // NodeXMLContentList
-NodeXMLContentList::NodeXMLContentList(const unsigned int lineno /* = 0 */) : Node(lineno) {}
+NodeXMLContentList::NodeXMLContentList(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_XML_CONTENT_LIST) {}
 
 Node* NodeXMLContentList::clone(Node* node) const {
   return Node::clone(new NodeXMLContentList());
 }
 
-rope_t NodeXMLContentList::render(render_guts_t* guts, int indentation) const {
-  return this->renderImplodeChildren(guts, indentation, "");
+void NodeXMLContentList::render(render_guts_t* guts, int indentation) const {
+  this->renderImplodeChildren(guts, indentation, "");
 }
 
 //
 // NodeXMLTextData
-NodeXMLTextData::NodeXMLTextData(const unsigned int lineno /* = 0 */) : Node(lineno), whitespace(true) {}
+NodeXMLTextData::NodeXMLTextData(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_XML_TEXT_DATA), whitespace(true) {}
 
 Node* NodeXMLTextData::clone(Node* node) const {
   NodeXMLTextData* new_node = new NodeXMLTextData();
@@ -1396,11 +2754,16 @@ Node* NodeXMLTextData::clone(Node* node) const {
   return Node::clone(new_node);
 }
 
-rope_t NodeXMLTextData::render(render_guts_t* guts, int indentation) const {
-  return this->_data;
+void NodeXMLTextData::render(render_guts_t* guts, int indentation) const {
+  guts->sink->write(this->_data.c_str(), this->_data.size());
 }
 
 void NodeXMLTextData::appendData(rope_t str, bool isWhitespace /* = false */) {
+  this->invalidateHash();
+  NodeStats* stats = NodeStats::current();
+  if (stats != NULL) {
+    stats->rope_bytes += str.size();
+  }
   this->_data += str;
   if (!isWhitespace) {
     this->whitespace = false;
@@ -1415,63 +2778,75 @@ const char* NodeXMLTextData::data() const {
   return this->_data.c_str();
 }
 
+bool NodeXMLTextData::operator== (const Node &that) const {
+  if (that.kind() != KIND_XML_TEXT_DATA) {
+    return false;
+  }
+  return this->_data == static_cast<const NodeXMLTextData*>(&that)->_data;
+}
+
+unsigned int NodeXMLTextData::hashValue() const {
+  return node_hash_bytes(0, this->_data.c_str(), this->_data.size());
+}
+
 //
 // NodeXMLEmbeddedExpression
-NodeXMLEmbeddedExpression::NodeXMLEmbeddedExpression(const unsigned int lineno /* = 0 */) : Node(lineno) {}
+NodeXMLEmbeddedExpression::NodeXMLEmbeddedExpression(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_XML_EMBEDDED_EXPRESSION) {}
 
 Node* NodeXMLEmbeddedExpression::clone(Node* node) const {
   return Node::clone(new NodeXMLEmbeddedExpression());
 }
 
-rope_t NodeXMLEmbeddedExpression::render(render_guts_t* guts, int indentation) const {
-  return rope_t("{") + this->_childNodes.front()->render(guts, indentation) + "}";
+void NodeXMLEmbeddedExpression::render(render_guts_t* guts, int indentation) const {
+  guts->sink->put('{');
+  this->_childNodes.front()->renderMapped(guts, indentation);
+  guts->sink->put('}');
 }
 
 //
 // NodeXMLAttributeList
-NodeXMLAttributeList::NodeXMLAttributeList(const unsigned int lineno /* = 0 */) : Node(lineno) {}
+NodeXMLAttributeList::NodeXMLAttributeList(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_XML_ATTRIBUTE_LIST) {}
 
 Node* NodeXMLAttributeList::clone(Node* node) const {
   return Node::clone(new NodeXMLAttributeList());
 }
 
-rope_t NodeXMLAttributeList::render(render_guts_t* guts, int indentation) const {
-  return this->renderImplodeChildren(guts, indentation, " ");
+void NodeXMLAttributeList::render(render_guts_t* guts, int indentation) const {
+  this->renderImplodeChildren(guts, indentation, " ");
 }
 
 //
 // NodeXMLAttribute
-NodeXMLAttribute::NodeXMLAttribute(const unsigned int lineno /* = 0 */) : Node(lineno) {}
+NodeXMLAttribute::NodeXMLAttribute(const unsigned int lineno /* = 0 */) : Node(lineno, KIND_XML_ATTRIBUTE) {}
 
 Node* NodeXMLAttribute::clone(Node* node) const {
   return Node::clone(new NodeXMLAttribute());
 }
 
-rope_t NodeXMLAttribute::render(render_guts_t* guts, int indentation) const {
-  rope_t ret = this->_childNodes.front()->render(guts, indentation);
-  ret += "=";
+void NodeXMLAttribute::render(render_guts_t* guts, int indentation) const {
+  this->_childNodes.front()->renderMapped(guts, indentation);
+  guts->sink->put('=');
   Node* val = this->_childNodes.back();
-  if (typeid(*val) == typeid(NodeXMLTextData)) {
+  if (val->kind() == KIND_XML_TEXT_DATA) {
     // TODO: Escape value, <foo bar="&amp;" /> will render to <foo bar="&" />
-    ret += "\"";
-    ret += val->render(guts, indentation);
-    ret += "\"";
+    guts->sink->put('"');
+    val->renderMapped(guts, indentation);
+    guts->sink->put('"');
   } else {
-    ret += val->render(guts, indentation);
+    val->renderMapped(guts, indentation);
   }
-  return ret;
 }
 
 //
 // NodeWildcardIdentifier
-NodeWildcardIdentifier::NodeWildcardIdentifier(const unsigned int lineno /* = 0 */) : NodeExpression(lineno) {}
+NodeWildcardIdentifier::NodeWildcardIdentifier(const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_WILDCARD_IDENTIFIER) {}
 
 Node* NodeWildcardIdentifier::clone(Node* node) const {
   return Node::clone(new NodeWildcardIdentifier());
 }
 
-rope_t NodeWildcardIdentifier::render(render_guts_t* guts, int indentation) const {
-  return rope_t("*");
+void NodeWildcardIdentifier::render(render_guts_t* guts, int indentation) const {
+  guts->sink->put('*');
 }
 
 bool NodeWildcardIdentifier::isValidlVal() const {
@@ -1480,14 +2855,15 @@ bool NodeWildcardIdentifier::isValidlVal() const {
 
 //
 // NodeStaticAttributeIdentifier
-NodeStaticAttributeIdentifier::NodeStaticAttributeIdentifier(const unsigned int lineno /* = 0 */) : NodeExpression(lineno) {}
+NodeStaticAttributeIdentifier::NodeStaticAttributeIdentifier(const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_STATIC_ATTRIBUTE_IDENTIFIER) {}
 
 Node* NodeStaticAttributeIdentifier::clone(Node* node) const {
   return Node::clone(new NodeStaticAttributeIdentifier());
 }
 
-rope_t NodeStaticAttributeIdentifier::render(render_guts_t* guts, int indentation) const {
-  return rope_t("@") + this->_childNodes.front()->render(guts, indentation);
+void NodeStaticAttributeIdentifier::render(render_guts_t* guts, int indentation) const {
+  guts->sink->put('@');
+  this->_childNodes.front()->renderMapped(guts, indentation);
 }
 
 bool NodeStaticAttributeIdentifier::isValidlVal() const {
@@ -1496,14 +2872,16 @@ bool NodeStaticAttributeIdentifier::isValidlVal() const {
 
 //
 // NodeDynamicAttributeIdentifier
-NodeDynamicAttributeIdentifier::NodeDynamicAttributeIdentifier(const unsigned int lineno /* = 0 */) : NodeExpression(lineno) {}
+NodeDynamicAttributeIdentifier::NodeDynamicAttributeIdentifier(const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_DYNAMIC_ATTRIBUTE_IDENTIFIER) {}
 
 Node* NodeDynamicAttributeIdentifier::clone(Node* node) const {
   return Node::clone(new NodeDynamicAttributeIdentifier());
 }
 
-rope_t NodeDynamicAttributeIdentifier::render(render_guts_t* guts, int indentation) const {
-  return rope_t("@[") + this->_childNodes.front()->render(guts, indentation) + "]";
+void NodeDynamicAttributeIdentifier::render(render_guts_t* guts, int indentation) const {
+  guts->sink->write("@[");
+  this->_childNodes.front()->renderMapped(guts, indentation);
+  guts->sink->put(']');
 }
 
 bool NodeDynamicAttributeIdentifier::isValidlVal() const {
@@ -1512,16 +2890,16 @@ bool NodeDynamicAttributeIdentifier::isValidlVal() const {
 
 //
 // NodeStaticQualifiedIdentifier
-NodeStaticQualifiedIdentifier::NodeStaticQualifiedIdentifier(const unsigned int lineno /* = 0 */) : NodeExpression(lineno) {}
+NodeStaticQualifiedIdentifier::NodeStaticQualifiedIdentifier(const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_STATIC_QUALIFIED_IDENTIFIER) {}
 
 Node* NodeStaticQualifiedIdentifier::clone(Node* node) const {
   return Node::clone(new NodeStaticQualifiedIdentifier());
 }
 
-rope_t NodeStaticQualifiedIdentifier::render(render_guts_t* guts, int indentation) const {
-  return
-    this->_childNodes.front()->render(guts, indentation) + "::" +
-    this->_childNodes.back()->render(guts, indentation);
+void NodeStaticQualifiedIdentifier::render(render_guts_t* guts, int indentation) const {
+  this->_childNodes.front()->renderMapped(guts, indentation);
+  guts->sink->write("::");
+  this->_childNodes.back()->renderMapped(guts, indentation);
 }
 
 bool NodeStaticQualifiedIdentifier::isValidlVal() const {
@@ -1530,16 +2908,19 @@ bool NodeStaticQualifiedIdentifier::isValidlVal() const {
 
 //
 // NodeDynamicQualifiedIdentifier
-NodeDynamicQualifiedIdentifier::NodeDynamicQualifiedIdentifier(const unsigned int lineno /* = 0 */) : NodeExpression(lineno) {}
+NodeDynamicQualifiedIdentifier::NodeDynamicQualifiedIdentifier(const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_DYNAMIC_QUALIFIED_IDENTIFIER) {}
 
 Node* NodeDynamicQualifiedIdentifier::clone(Node* node) const {
   return Node::clone(new NodeDynamicQualifiedIdentifier());
 }
 
-rope_t NodeDynamicQualifiedIdentifier::render(render_guts_t* guts, int indentation) const {
-  return
-    this->_childNodes.front()->render(guts, indentation) + "::[" +
-    this->_childNodes.back()->render(guts, indentation) + "]";
+void NodeDynamicQualifiedIdentifier::render(render_guts_t* guts, int indentation) const {
+  node_render_later_t name(guts, this->_childNodes.back(), indentation, node_render_has_lines(guts, this->_childNodes.back()) &&
+    node_render_has_lines(guts, this->_childNodes.front()));
+  this->_childNodes.front()->renderMapped(guts, indentation);
+  guts->sink->write("::[");
+  name.write();
+  guts->sink->put(']');
 }
 
 bool NodeDynamicQualifiedIdentifier::isValidlVal() const {
@@ -1548,16 +2929,19 @@ bool NodeDynamicQualifiedIdentifier::isValidlVal() const {
 
 //
 // NodeFilteringPredicate
-NodeFilteringPredicate::NodeFilteringPredicate(const unsigned int lineno /* = 0 */) : NodeExpression(lineno) {}
+NodeFilteringPredicate::NodeFilteringPredicate(const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_FILTERING_PREDICATE) {}
 
 Node* NodeFilteringPredicate::clone(Node* node) const {
   return Node::clone(new NodeFilteringPredicate());
 }
 
-rope_t NodeFilteringPredicate::render(render_guts_t* guts, int indentation) const {
-  return
-    this->_childNodes.front()->render(guts, indentation) + ".(" +
-    this->_childNodes.back()->render(guts, indentation) + ")";
+void NodeFilteringPredicate::render(render_guts_t* guts, int indentation) const {
+  node_render_later_t predicate(guts, this->_childNodes.back(), indentation, node_render_has_lines(guts, this->_childNodes.back()) &&
+    node_render_has_lines(guts, this->_childNodes.front()));
+  this->_childNodes.front()->renderMapped(guts, indentation);
+  guts->sink->write(".(");
+  predicate.write();
+  guts->sink->put(')');
 }
 
 bool NodeFilteringPredicate::isValidlVal() const {
@@ -1566,10 +2950,12 @@ bool NodeFilteringPredicate::isValidlVal() const {
 
 //
 // NodeDescendantExpression
-NodeDescendantExpression::NodeDescendantExpression(const unsigned int lineno /* = 0 */) : NodeExpression(lineno) {}
+NodeDescendantExpression::NodeDescendantExpression(const unsigned int lineno /* = 0 */) : NodeExpression(lineno, KIND_DESCENDANT_EXPRESSION) {}
 
-rope_t NodeDescendantExpression::render(render_guts_t* guts, int indentation) const {
-  return rope_t(this->_childNodes.front()->render(guts, indentation)) + ".." + this->_childNodes.back()->render(guts, indentation);
+void NodeDescendantExpression::render(render_guts_t* guts, int indentation) const {
+  this->_childNodes.front()->renderMapped(guts, indentation);
+  guts->sink->write("..");
+  this->_childNodes.back()->renderMapped(guts, indentation);
 }
 
 Node* NodeDescendantExpression::clone(Node* node) const {
@@ -19,35 +19,400 @@
 */
 
 #pragma once
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdexcept>
 #include <sstream>
 #include <list>
 #include <memory>
+#include <vector>
+#include <deque>
+#include <string>
 #include <ext/rope>
 
 #define NODE_WALKER_ACCEPT_DECL virtual void accept(class NodeWalker& walker)
 typedef __gnu_cxx::rope<char> rope_t;
 
+struct fbjs_parse_extra;
+
 namespace fbjs {
   class Node;
-  typedef std::list<Node*> node_list_t;
+  class NodeProgram;
+  class SourceMap;
+  class NodeStats;
+  class ParseException;
+
+  //
+  // node_list_t: child storage for nodes. Most nodes have a small, fixed arity
+  // so the first few children live inline and larger lists spill to the heap.
+  // Iterators are (list, index) pairs; they survive reallocation but, like
+  // vector iterators, insert() and erase() shift everything after pos.
+  class node_list_t {
+    public:
+      typedef Node* value_type;
+      typedef size_t size_type;
+      static const size_t inline_capacity = 3;
+
+      class iterator {
+        protected:
+          node_list_t* _list;
+          size_t _index;
+          friend class node_list_t;
+
+        public:
+          iterator() : _list(NULL), _index(0) {}
+          iterator(node_list_t* list, size_t index) : _list(list), _index(index) {}
+          Node*& operator* () const { return (*_list)[_index]; }
+          iterator& operator++ () { ++_index; return *this; }
+          iterator& operator-- () { --_index; return *this; }
+          iterator operator++ (int) { iterator tmp(*this); ++_index; return tmp; }
+          iterator operator-- (int) { iterator tmp(*this); --_index; return tmp; }
+          bool operator== (const iterator& that) const { return _index == that._index && _list == that._list; }
+          bool operator!= (const iterator& that) const { return !(*this == that); }
+          size_t index() const { return _index; }
+      };
+
+      class const_iterator {
+        protected:
+          const node_list_t* _list;
+          size_t _index;
+
+        public:
+          const_iterator() : _list(NULL), _index(0) {}
+          const_iterator(const node_list_t* list, size_t index) : _list(list), _index(index) {}
+          const_iterator(const iterator& that) : _list(that._list), _index(that._index) {}
+          Node* operator* () const { return (*_list)[_index]; }
+          const_iterator& operator++ () { ++_index; return *this; }
+          const_iterator& operator-- () { --_index; return *this; }
+          const_iterator operator++ (int) { const_iterator tmp(*this); ++_index; return tmp; }
+          const_iterator operator-- (int) { const_iterator tmp(*this); --_index; return tmp; }
+          bool operator== (const const_iterator& that) const { return _index == that._index && _list == that._list; }
+          bool operator!= (const const_iterator& that) const { return !(*this == that); }
+          size_t index() const { return _index; }
+      };
+
+      node_list_t() : _data(_inline), _size(0), _capacity(inline_capacity) {}
+      node_list_t(const node_list_t& that);
+      node_list_t& operator= (const node_list_t& that);
+      ~node_list_t() {
+        if (_data != _inline) {
+          free(_data);
+        }
+      }
+
+      iterator begin() { return iterator(this, 0); }
+      iterator end() { return iterator(this, _size); }
+      const_iterator begin() const { return const_iterator(this, 0); }
+      const_iterator end() const { return const_iterator(this, _size); }
+
+      bool empty() const { return _size == 0; }
+      size_t size() const { return _size; }
+      Node*& operator[] (size_t index) { return _data[index]; }
+      Node* operator[] (size_t index) const { return _data[index]; }
+      Node*& front() { return _data[0]; }
+      Node* front() const { return _data[0]; }
+      Node*& back() { return _data[_size - 1]; }
+      Node* back() const { return _data[_size - 1]; }
+
+      void push_back(Node* node) {
+        if (_size == _capacity) {
+          this->reserve(_capacity * 2);
+        }
+        _data[_size++] = node;
+      }
+      void push_front(Node* node) { this->insert(this->begin(), node); }
+      iterator insert(iterator pos, Node* node);
+      iterator erase(iterator pos);
+      void clear() { _size = 0; }
+      void reserve(size_t capacity);
+
+    protected:
+      Node** _data;
+      size_t _size;
+      size_t _capacity;
+      Node* _inline[inline_capacity];
+  };
   enum node_render_enum {
     RENDER_NONE = 0,
     RENDER_PRETTY = 1,
     RENDER_MAINTAIN_LINENO = 2,
+    // With RENDER_MAINTAIN_LINENO, catch up lines in source order throughout;
+    // otherwise some nodes render their last part first, as they always have
+    RENDER_SOURCE_ORDER = 4,
+  };
+  //
+  // Concrete type of a node, one per class. Classes extending these outside of
+  // libfbjs share the kind of the class they extend.
+  enum node_kind_enum {
+    KIND_NODE,
+    KIND_PROGRAM,
+    KIND_STATEMENT_LIST,
+    KIND_EXPRESSION,
+    KIND_NUMERIC_LITERAL,
+    KIND_STRING_LITERAL,
+    KIND_REGEX_LITERAL,
+    KIND_BOOLEAN_LITERAL,
+    KIND_NULL_LITERAL,
+    KIND_THIS,
+    KIND_EMPTY_EXPRESSION,
+    KIND_OPERATOR,
+    KIND_CONDITIONAL_EXPRESSION,
+    KIND_PARENTHETICAL,
+    KIND_ASSIGNMENT,
+    KIND_UNARY,
+    KIND_POSTFIX,
+    KIND_IDENTIFIER,
+    KIND_FUNCTION_CALL,
+    KIND_FUNCTION_CONSTRUCTOR,
+    KIND_OBJECT_LITERAL,
+    KIND_ARRAY_LITERAL,
+    KIND_STATIC_MEMBER_EXPRESSION,
+    KIND_DYNAMIC_MEMBER_EXPRESSION,
+    KIND_STATEMENT,
+    KIND_STATEMENT_WITH_EXPRESSION,
+    KIND_VAR_DECLARATION,
+    KIND_TYPEHINT,
+    KIND_FUNCTION_DECLARATION,
+    KIND_FUNCTION_EXPRESSION,
+    KIND_ARG_LIST,
+    KIND_IF,
+    KIND_WITH,
+    KIND_TRY,
+    KIND_LABEL,
+    KIND_CASE_CLAUSE,
+    KIND_SWITCH,
+    KIND_DEFAULT_CLAUSE,
+    KIND_OBJECT_LITERAL_PROPERTY,
+    KIND_FOR_LOOP,
+    KIND_FOR_IN,
+    KIND_FOR_EACH_IN,
+    KIND_WHILE,
+    KIND_DO_WHILE,
+    KIND_XML_DEFAULT_NAMESPACE,
+    KIND_XML_NAME,
+    KIND_XML_ELEMENT,
+    KIND_XML_COMMENT,
+    KIND_XML_PI,
+    KIND_XML_CONTENT_LIST,
+    KIND_XML_TEXT_DATA,
+    KIND_XML_EMBEDDED_EXPRESSION,
+    KIND_XML_ATTRIBUTE_LIST,
+    KIND_XML_ATTRIBUTE,
+    KIND_WILDCARD_IDENTIFIER,
+    KIND_STATIC_ATTRIBUTE_IDENTIFIER,
+    KIND_DYNAMIC_ATTRIBUTE_IDENTIFIER,
+    KIND_STATIC_QUALIFIED_IDENTIFIER,
+    KIND_DYNAMIC_QUALIFIED_IDENTIFIER,
+    KIND_FILTERING_PREDICATE,
+    KIND_DESCENDANT_EXPRESSION,
+    KIND_COUNT,
   };
   enum node_parse_enum {
     PARSE_NONE = 0,
     PARSE_TYPEHINT = 1,
     PARSE_OBJECT_LITERAL_ELISON = 2,
     PARSE_E4X = 4,
+    PARSE_ARENA = 8,
+    PARSE_FAST_LEXER = 16,
+    PARSE_RECOVER = 32,
+  };
+
+  //
+  // RenderSink: destination for rendered code. Output is collected in a small
+  // buffer and handed off in chunks to a string, a FILE*, or a write callback.
+  // With a SourceMap attached it also keeps track of the output position, and
+  // mark() maps wherever the next byte lands; both settle on the next write,
+  // so a deferred space goes before the mapped byte.
+  class RenderSink {
+    public:
+      typedef void (*write_callback_t)(void* context, const char* data, size_t len);
+
+      RenderSink(std::string& str);
+      RenderSink(FILE* file);
+      RenderSink(write_callback_t callback, void* context);
+      ~RenderSink();
+
+      void write(const char* data, size_t len) {
+        if (_pending && len) {
+          this->resolvePending(data[0]);
+        }
+        if (len > sizeof(_buf) - _len) {
+          this->writeSlow(data, len);
+          return;
+        }
+        memcpy(_buf + _len, data, len);
+        _len += len;
+      }
+      void write(const char* str) { this->write(str, strlen(str)); }
+      void write(const std::string& str) { this->write(str.data(), str.size()); }
+      void put(char c) { this->write(&c, 1); }
+      void repeat(char c, size_t count);
+
+      // Emit a space before the next byte written unless that byte is '{' or ' '
+      void deferSpace() { _pending |= PENDING_SPACE; }
+      void cancelDeferredSpace() { _pending &= ~PENDING_SPACE; }
+      void flush();
+
+      // Output positions are counted from when the map is attached
+      void setSourceMap(SourceMap* map);
+
+      // Node::render() records how long it took and what it wrote in `stats`
+      void setStats(NodeStats* stats) { _stats = stats; }
+      NodeStats* stats() const { return _stats; }
+
+      // Bytes written so far, flushed or not
+      size_t written() const { return _offset + _len; }
+      void mark(unsigned int line, unsigned int column) {
+        _pending |= PENDING_MARK;
+        _mark_line = line;
+        _mark_column = column;
+      }
+
+      // Keep marks for replay() instead of mapping them; for string sinks only
+      void keepMarks() { _keep_marks = true; }
+
+      // Writes out what `kept`, a string sink keeping its marks, was given,
+      // along with those marks and any space or mark still pending on it
+      void replay(RenderSink& kept);
+
+    protected:
+      enum pending_enum {
+        PENDING_SPACE = 1,
+        PENDING_MARK = 2,
+      };
+      struct kept_mark_t {
+        size_t offset;
+        unsigned int line;
+        unsigned int column;
+      };
+      std::string* _string;
+      FILE* _file;
+      write_callback_t _callback;
+      void* _context;
+      unsigned char _pending;
+      size_t _len;
+      char _buf[4096];
+      SourceMap* _map;
+      NodeStats* _stats;
+      unsigned int _mark_line;
+      unsigned int _mark_column;
+      size_t _offset;
+      size_t _scanned;
+      size_t _line;
+      size_t _line_start;
+      size_t _line_surplus; // bytes since _line_start past its length in UTF-16
+      bool _keep_marks;
+      std::vector<kept_mark_t> _kept_marks;
+      void resolvePending(char next);
+      void writeSlow(const char* data, size_t len);
+      void countLines(const char* data, size_t len, size_t offset);
+
+    private:
+      RenderSink(const RenderSink&);
+      RenderSink& operator= (const RenderSink&);
   };
+
+  struct node_render_lines_t;
   struct render_guts_t {
     unsigned int lineno;
     bool pretty;
     bool sanelineno;
+    bool sourceorder;
+    bool sourcemap;
+    RenderSink* sink;
+
+    // Which nodes hold a function expression, worked out once for the render
+    node_render_lines_t* lines;
+
+    render_guts_t() : lines(NULL) {}
+    ~render_guts_t();
+
+    private:
+      render_guts_t(const render_guts_t&);
+      render_guts_t& operator= (const render_guts_t&);
+  };
+
+  //
+  // NodeArena: bump allocator for nodes created by the parser. Every live node
+  // in the arena is destroyed when the arena is, without walking the tree.
+  // Nodes allocated from an arena must not outlive it; clone() them instead.
+  class NodeArena {
+    protected:
+      std::vector<char*> _chunks;
+      std::vector<void*> _nodes;
+      char* _cursor;
+      char* _limit;
+      bool _tearing_down;
+
+    public:
+      NodeArena();
+      ~NodeArena();
+      void* allocate(size_t size);
+      void reserve(size_t nodes);
+      void release(size_t index);
+      void beginTeardown();
+      bool tearingDown() const;
+
+    private:
+      NodeArena(const NodeArena&);
+      NodeArena& operator= (const NodeArena&);
+  };
+
+  //
+  // node_string_t: an immutable string shared by reference count, so cloned
+  // literals don't each copy their text
+  class node_string_t {
+    protected:
+      struct payload_t {
+        volatile int refs;
+        std::string value;
+      };
+      payload_t* _payload;
+
+    public:
+      explicit node_string_t(const std::string& value);
+      node_string_t(const node_string_t& that);
+      ~node_string_t();
+      const std::string& str() const { return _payload->value; }
+      operator const std::string& () const { return _payload->value; }
+      const char* c_str() const { return _payload->value.c_str(); }
+      const char* data() const { return _payload->value.data(); }
+      size_t size() const { return _payload->value.size(); }
+      bool operator== (const node_string_t& that) const { return _payload == that._payload || str() == that.str(); }
+
+    private:
+      node_string_t& operator= (const node_string_t&);
+  };
+
+  //
+  // NodeAtomTable: interned strings for a parse. Each distinct string is stored
+  // once and handed out as a stable pointer, so equal atoms from the same table
+  // compare by address. intern() is not thread-safe; internShared() is, for
+  // walkers renaming identifiers from several threads at once.
+  class NodeAtomTable {
+    protected:
+      struct slot_t {
+        size_t hash;
+        const std::string* atom;
+      };
+      std::deque<std::string> _atoms;
+      std::vector<slot_t> _slots;
+      pthread_mutex_t _lock;
+      void grow();
+
+    public:
+      NodeAtomTable();
+      ~NodeAtomTable();
+      const std::string* intern(const char* str, size_t len);
+      const std::string* intern(const std::string& str);
+      const std::string* internShared(const std::string& str);
+      size_t size() const;
+
+    private:
+      NodeAtomTable(const NodeAtomTable&);
+      NodeAtomTable& operator= (const NodeAtomTable&);
   };
 
   //
@@ -55,8 +420,18 @@ namespace fbjs {
   class Node {
     protected:
       node_list_t _childNodes;
-      rope_t renderImplodeChildren(render_guts_t* guts, int indentation, const char* glue) const;
+      void renderImplodeChildren(render_guts_t* guts, int indentation, const char* glue) const;
       unsigned int _lineno;
+      unsigned char _kind;
+      mutable unsigned char _hash_slot;
+      unsigned int _source_begin;
+      unsigned int _source_end;
+      unsigned int _source_line;
+      unsigned int _source_column;
+      mutable unsigned int _hash;
+      mutable unsigned int _hash_epoch;
+      Node(const unsigned int lineno, node_kind_enum kind);
+      unsigned int hash(unsigned char slot, unsigned int epoch) const;
 
     public:
       NODE_WALKER_ACCEPT_DECL;
@@ -64,12 +439,46 @@ namespace fbjs {
       virtual ~Node();
       virtual Node* clone(Node* node = NULL) const;
 
+      static void* operator new(size_t size);
+      static void* operator new(size_t size, NodeArena* arena);
+      static void operator delete(void* ptr);
+      static void operator delete(void* ptr, NodeArena* arena);
+      static NodeArena* arenaOf(const Node* node);
+
+      // Copies this subtree into `arena` in one pass, which is much faster than
+      // clone() for big trees. The copy must not outlive the arena.
+      Node* cloneInto(NodeArena* arena) const;
+      size_t subtreeSize() const;
+
       bool empty() const;
       unsigned int lineno() const;
+      node_kind_enum kind() const { return static_cast<node_kind_enum>(_kind); }
       void setLineno(const unsigned int lineno) { _lineno = lineno; }
+
+      // Bytes [begin, end) of the source this node was parsed from, and the
+      // line and column (from 0, in UTF-16 units) where they start. Unlike
+      // lineno() these are exact. Nodes built by hand have an empty range and
+      // line 0.
+      unsigned int sourceBegin() const { return _source_begin; }
+      unsigned int sourceEnd() const { return _source_end; }
+      unsigned int sourceLine() const { return _source_line; }
+      unsigned int sourceColumn() const { return _source_column; }
+      bool hasSourceRange() const { return _source_end > _source_begin; }
+      void setSourceRange(unsigned int begin, unsigned int end) { _source_begin = begin; _source_end = end; }
+      void setSourcePosition(unsigned int line, unsigned int column) { _source_line = line; _source_column = column; }
       virtual bool operator== (const Node&) const;
       virtual bool operator!= (const Node&) const;
 
+      // Structural hash of this subtree, consistent with operator==. It's
+      // cached on every node it covers and dropped when the tree is changed
+      // through the calls below or rename(). Code that edits childNodes()
+      // directly must call invalidateHash() on the node it edited. Caching
+      // writes to the nodes, so hash() is no more thread-safe than an edit:
+      // other threads must not use the tree while it runs.
+      unsigned int hash() const;
+      void invalidateHash() const;
+      virtual unsigned int hashValue() const;
+
       node_list_t& childNodes() const;
       Node* appendChild(Node* node);
       Node* prependChild(Node* node);
@@ -79,22 +488,113 @@ namespace fbjs {
 
       rope_t render(node_render_enum opts = RENDER_NONE) const;
       rope_t render(int opts) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
-      virtual rope_t renderBlock(bool must, render_guts_t* guts, int indentation) const;
-      virtual rope_t renderStatement(render_guts_t* guts, int indentation) const;
-      virtual rope_t renderIndentedStatement(render_guts_t* guts, int indentation) const;
-      bool renderLinenoCatchup(render_guts_t* guts, rope_t &rope) const;
+      void render(RenderSink& sink, int opts = RENDER_NONE) const;
+      void render(RenderSink& sink, SourceMap& map, int opts = RENDER_NONE) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
+      virtual void renderBlock(bool must, render_guts_t* guts, int indentation) const;
+      virtual void renderStatement(render_guts_t* guts, int indentation) const;
+      virtual void renderIndentedStatement(render_guts_t* guts, int indentation) const;
+      bool renderLinenoCatchup(render_guts_t* guts) const;
+
+      // Parents render their children through here so source maps see every node
+      void renderMapped(render_guts_t* guts, int indentation) const {
+        if (guts->sourcemap && _source_line) {
+          guts->sink->mark(_source_line, _source_column);
+        }
+        this->render(guts, indentation);
+      }
+  };
+
+  //
+  // Hash and equality on whole subtrees, for keying hash maps by structure
+  struct node_hash_t {
+    size_t operator() (const Node* node) const { return node->hash(); }
+  };
+  struct node_equal_t {
+    bool operator() (const Node* left, const Node* right) const { return *left == *right; }
   };
 
   //
   // NodeProgram
   class NodeProgram: public Node {
+    protected:
+      NodeArena* _arena;
+      NodeAtomTable* _atoms;
+      void releaseArena();
+      friend class Parser;
+      friend class NodeImage;
+
     public:
       NODE_WALKER_ACCEPT_DECL;
       NodeProgram();
       NodeProgram(const char* code, node_parse_enum opts = PARSE_NONE);
+      NodeProgram(const char* data, size_t len, node_parse_enum opts = PARSE_NONE);
       NodeProgram(FILE* file, node_parse_enum opts = PARSE_NONE);
+      virtual ~NodeProgram();
+      static NodeProgram* parseFile(const char* path, node_parse_enum opts = PARSE_NONE);
       virtual Node* clone(Node* node = NULL) const;
+
+      // The arena this program's nodes are freed with, created on first use
+      NodeArena* arena();
+  };
+
+  //
+  // Parser: owns a scanner and its state so they can be reused. Resetting
+  // between inputs keeps the scanner's buffers and the stacks' storage, which
+  // makes parsing many small programs much cheaper than constructing a
+  // NodeProgram for each. reparse() updates a program after an edit to its
+  // source by reparsing as little of it as it safely can. A Parser must only
+  // be used by one thread at a time.
+  class Parser {
+    public:
+      Parser();
+      ~Parser();
+
+      // Every parse from here on adds to `stats`, until it's set back to NULL
+      void setStats(NodeStats* stats);
+      NodeStats* stats() const;
+      NodeProgram* parse(const char* code, node_parse_enum opts = PARSE_NONE);
+      NodeProgram* parse(const char* data, size_t len, node_parse_enum opts = PARSE_NONE);
+      NodeProgram* parse(FILE* file, node_parse_enum opts = PARSE_NONE);
+      NodeProgram* parseFile(const char* path, node_parse_enum opts = PARSE_NONE);
+      Node* reparse(NodeProgram* program, std::string& source, size_t offset, size_t removed,
+        const std::string& inserted, node_parse_enum opts = PARSE_NONE);
+
+      // Streaming parse: each top-level statement goes to `callback` as soon
+      // as it's parsed, instead of into a program, so only one is ever held
+      // in memory. The callback owns the statement and returns false to stop
+      // the parse there; it must not throw. Statements handed over before a
+      // ParseException stay the callback's. PARSE_ARENA is ignored.
+      typedef bool (*statement_callback_t)(void* context, Node* statement);
+      void parseStatements(const char* data, size_t len, statement_callback_t callback, void* context,
+        node_parse_enum opts = PARSE_NONE);
+      void parseStatements(FILE* file, statement_callback_t callback, void* context,
+        node_parse_enum opts = PARSE_NONE);
+
+      // With PARSE_RECOVER a syntax error doesn't throw. The statement it's in
+      // is dropped, parsing resumes after the next semicolon, and the program
+      // holds whatever parsed. errors() lists what went wrong in the last
+      // parse; an error the parser can't get past, like an unterminated string
+      // or the end of the input, ends the parse and is listed last.
+      const std::vector<ParseException>& errors() const;
+
+    protected:
+      fbjs_parse_extra* _extra;
+      void* _scanner;
+      void parseInto(NodeProgram* program, const char* data, size_t len, FILE* file, node_parse_enum opts,
+        statement_callback_t callback = NULL, void* context = NULL);
+      void parseStreamInto(NodeProgram* program, FILE* file, node_parse_enum opts,
+        statement_callback_t callback = NULL, void* context = NULL);
+      Node* parseFragment(const char* data, size_t len, node_parse_enum opts);
+      Node* reparseStatement(Node* statement, const std::string& source, const std::string& text,
+        size_t offset, size_t removed, node_parse_enum opts, unsigned int& list_lineno);
+      Node* reparseBody(Node* body, const std::string& source, const std::string& text,
+        size_t offset, size_t removed, node_parse_enum opts);
+      friend class NodeProgram;
+
+    private:
+      Parser(const Parser&);
+      Parser& operator= (const Parser&);
   };
 
   //
@@ -104,21 +604,27 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeStatementList(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
-      virtual rope_t renderBlock(bool must, render_guts_t* guts, int indentation) const;
-      virtual rope_t renderStatement(render_guts_t* guts, int indentation) const;
-      virtual rope_t renderIndentedStatement(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
+      virtual void renderBlock(bool must, render_guts_t* guts, int indentation) const;
+      virtual void renderStatement(render_guts_t* guts, int indentation) const;
+      virtual void renderIndentedStatement(render_guts_t* guts, int indentation) const;
   };
 
   //
   // NodeExpression (abstract)
   class NodeExpression: public Node {
+    protected:
+      NodeExpression(const unsigned int lineno, node_kind_enum kind);
+
     public:
       NODE_WALKER_ACCEPT_DECL;
       NodeExpression(const unsigned int lineno = 0);
       virtual bool isValidlVal() const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const = 0;
-      virtual rope_t renderStatement(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const = 0;
+      virtual void renderStatement(render_guts_t* guts, int indentation) const;
+
+      // True if this is known to convert to `val` as a boolean, which it
+      // only is when evaluating it has no side effects
       virtual bool compare(bool val) const;
   };
 
@@ -130,43 +636,61 @@ namespace fbjs {
     public:
       NODE_WALKER_ACCEPT_DECL;
       NodeNumericLiteral(double value, const unsigned int lineno = 0);
+      double numericValue() const { return value; }
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       virtual bool compare(bool val) const;
       virtual bool operator== (const Node&) const;
+      virtual unsigned int hashValue() const;
   };
 
   //
   // NodeStringLiteral
   class NodeStringLiteral: public NodeExpression {
     protected:
-      const std::string value;
+      const node_string_t value;
+      const node_string_t decoded;
       bool quoted;
+      NodeStringLiteral(const node_string_t& value, const node_string_t& decoded, bool quoted, const unsigned int lineno = 0);
     public:
       NODE_WALKER_ACCEPT_DECL;
       NodeStringLiteral(const std::string& value, bool quoted, const unsigned int lineno = 0);
-      std::string unquoted_value() const {
-        if (!quoted) return value;
-        return value.substr(1, value.size() - 2);
-      }
+      NodeStringLiteral(const std::string& value, const std::string& decoded, bool quoted, const unsigned int lineno);
+
+      //
+      // Turns the source text of a quoted literal, quotes and all, into the
+      // string it stands for: escapes are decoded (\x and \u to UTF-8) and line
+      // continuations dropped. Decoding stops at the closing quote.
+      static std::string decode(const char* quoted, size_t len);
+
+      std::string unquoted_value() const { return decoded; }
+      const std::string& decodedValue() const { return decoded; }
+      const std::string& stringValue() const { return value; }
+      bool isQuoted() const { return quoted; }
 
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
+      virtual bool compare(bool val) const;
       virtual bool operator== (const Node&) const;
+      virtual unsigned int hashValue() const;
   };
 
   //
   // NodeRegexLiteral
   class NodeRegexLiteral: public NodeExpression {
     protected:
-      const std::string value;
-      const std::string flags;
+      const node_string_t value;
+      const node_string_t flags;
+      NodeRegexLiteral(const node_string_t& value, const node_string_t& flags, const unsigned int lineno = 0);
     public:
       NODE_WALKER_ACCEPT_DECL;
       NodeRegexLiteral(const std::string& value, const std::string& flags, const unsigned int lineno = 0);
+      const std::string& regexValue() const { return value; }
+      const std::string& regexFlags() const { return flags; }
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       virtual bool operator== (const Node&) const;
+      virtual unsigned int hashValue() const;
   };
 
   //
@@ -177,10 +701,12 @@ namespace fbjs {
     public:
       NODE_WALKER_ACCEPT_DECL;
       NodeBooleanLiteral(bool value, const unsigned int lineno = 0);
+      bool booleanValue() const { return value; }
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       virtual bool compare(bool val) const;
       virtual bool operator== (const Node&) const;
+      virtual unsigned int hashValue() const;
   };
 
   //
@@ -190,7 +716,8 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeNullLiteral(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
+      virtual bool compare(bool val) const;
   };
 
   //
@@ -200,7 +727,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeThis(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -210,8 +737,8 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeEmptyExpression(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
-      virtual rope_t renderBlock(bool must, render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
+      virtual void renderBlock(bool must, render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -233,9 +760,10 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeOperator(node_operator_t op, const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       const node_operator_t operatorType() const { return op; };
       virtual bool operator== (const Node&) const;
+      virtual unsigned int hashValue() const;
   };
 
   //
@@ -245,7 +773,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeConditionalExpression(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -255,7 +783,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeParenthetical(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       virtual bool isValidlVal() const;
       virtual bool compare(bool val) const;
   };
@@ -275,9 +803,10 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeAssignment(node_assignment_t op, const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       const node_assignment_t operatorType() const { return op; };
       virtual bool operator== (const Node&) const;
+      virtual unsigned int hashValue() const;
   };
 
   //
@@ -295,9 +824,11 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeUnary(node_unary_t op, const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
+      virtual bool compare(bool val) const;
       const node_unary_t operatorType() const { return op; };
       virtual bool operator== (const Node&) const;
+      virtual unsigned int hashValue() const;
   };
 
   //
@@ -312,24 +843,30 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodePostfix(node_postfix_t op, const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
+      const node_postfix_t operatorType() const { return op; };
       virtual bool operator== (const Node&) const;
+      virtual unsigned int hashValue() const;
   };
 
   //
   // NodeIdentifier
   class NodeIdentifier: public NodeExpression {
     protected:
+      const std::string* _atom;
+      NodeAtomTable* _atoms;
       std::string _name;
     public:
       NODE_WALKER_ACCEPT_DECL;
       NodeIdentifier(const std::string& name, const unsigned int lineno = 0);
+      NodeIdentifier(const std::string* atom, NodeAtomTable* atoms, const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       const std::string& name() const;
       virtual bool isValidlVal() const;
       void rename(const std::string &str);
       virtual bool operator== (const Node&) const;
+      virtual unsigned int hashValue() const;
   };
 
   //
@@ -338,7 +875,7 @@ namespace fbjs {
     public:
       NODE_WALKER_ACCEPT_DECL;
       NodeFunctionCall(const unsigned int lineno = 0);
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       virtual Node* clone(Node* node = NULL) const;
   };
 
@@ -349,7 +886,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeFunctionConstructor(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -359,7 +896,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeObjectLiteral(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -369,7 +906,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeArrayLiteral(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -379,7 +916,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeStaticMemberExpression(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       virtual bool isValidlVal() const;
   };
 
@@ -390,18 +927,21 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeDynamicMemberExpression(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       virtual bool isValidlVal() const;
   };
 
   //
   // NodeStatement (abstract)
   class NodeStatement: public Node {
+    protected:
+      NodeStatement(const unsigned int lineno, node_kind_enum kind);
+
     public:
       NODE_WALKER_ACCEPT_DECL;
       NodeStatement(const unsigned int lineno = 0);
-      virtual rope_t render(render_guts_t* guts, int indentation) const = 0;
-      virtual rope_t renderStatement(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const = 0;
+      virtual void renderStatement(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -415,9 +955,11 @@ namespace fbjs {
     public:
       NODE_WALKER_ACCEPT_DECL;
       NodeStatementWithExpression(node_statement_with_expression_t statement, const unsigned int lineno = 0);
+      node_statement_with_expression_t statementType() const { return statement; }
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       virtual bool operator== (const Node&) const;
+      virtual unsigned int hashValue() const;
   };
 
   //
@@ -429,7 +971,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeVarDeclaration(bool iterator = false, const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       bool iterator() const; // TODO: kill this
       Node* setIterator(bool iterator);
   };
@@ -441,7 +983,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeTypehint(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -451,7 +993,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeFunctionDeclaration(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -461,7 +1003,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeFunctionExpression(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -471,7 +1013,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeArgList(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -481,7 +1023,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeIf(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -491,7 +1033,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeWith(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -501,7 +1043,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeTry(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -511,20 +1053,23 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeLabel(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
-      virtual rope_t renderStatement(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
+      virtual void renderStatement(render_guts_t* guts, int indentation) const;
   };
 
   //
   // NodeCaseClause
   class NodeCaseClause: public Node {
+    protected:
+      NodeCaseClause(const unsigned int lineno, node_kind_enum kind);
+
     public:
       NODE_WALKER_ACCEPT_DECL;
       NodeCaseClause(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
-      virtual rope_t renderStatement(render_guts_t* guts, int indentation) const;
-      virtual rope_t renderIndentedStatement(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
+      virtual void renderStatement(render_guts_t* guts, int indentation) const;
+      virtual void renderIndentedStatement(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -534,7 +1079,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeSwitch(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -544,7 +1089,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeDefaultClause(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -554,7 +1099,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeObjectLiteralProperty(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -564,7 +1109,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeForLoop(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -574,7 +1119,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeForIn(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -584,7 +1129,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeForEachIn(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -594,7 +1139,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeWhile(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -604,7 +1149,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeDoWhile(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -615,7 +1160,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeXMLDefaultNamespace(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -629,9 +1174,11 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeXMLName(const std::string &ns, const std::string &name, const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       virtual const std::string ns() const;
       virtual const std::string name() const;
+      virtual bool operator== (const Node&) const;
+      virtual unsigned int hashValue() const;
   };
 
   //
@@ -646,7 +1193,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeXMLElement(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -659,8 +1206,10 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeXMLComment(const std::string &comment, const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       virtual const std::string comment() const;
+      virtual bool operator== (const Node&) const;
+      virtual unsigned int hashValue() const;
   };
 
   //
@@ -673,8 +1222,10 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeXMLPI(const std::string &data, const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       virtual const std::string data() const;
+      virtual bool operator== (const Node&) const;
+      virtual unsigned int hashValue() const;
   };
 
   //
@@ -685,7 +1236,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeXMLContentList(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -699,10 +1250,12 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeXMLTextData(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       virtual void appendData(rope_t str, bool isWhitespace = false);
       virtual bool isWhitespace() const;
       const char* data() const;
+      virtual bool operator== (const Node&) const;
+      virtual unsigned int hashValue() const;
   };
 
   //
@@ -713,7 +1266,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeXMLEmbeddedExpression(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -724,7 +1277,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeXMLAttributeList(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -735,7 +1288,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeXMLAttribute(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -746,7 +1299,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeWildcardIdentifier(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       virtual bool isValidlVal() const;
   };
 
@@ -758,7 +1311,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeStaticAttributeIdentifier(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       virtual bool isValidlVal() const;
   };
 
@@ -770,7 +1323,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeDynamicAttributeIdentifier(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       virtual bool isValidlVal() const;
   };
 
@@ -782,7 +1335,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeStaticQualifiedIdentifier(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       virtual bool isValidlVal() const;
   };
 
@@ -794,7 +1347,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeDynamicQualifiedIdentifier(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       virtual bool isValidlVal() const;
   };
 
@@ -806,7 +1359,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeFilteringPredicate(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
       virtual bool isValidlVal() const;
   };
 
@@ -817,7 +1370,7 @@ namespace fbjs {
       NODE_WALKER_ACCEPT_DECL;
       NodeDescendantExpression(const unsigned int lineno = 0);
       virtual Node* clone(Node* node = NULL) const;
-      virtual rope_t render(render_guts_t* guts, int indentation) const;
+      virtual void render(render_guts_t* guts, int indentation) const;
   };
 
   //
@@ -829,6 +1382,14 @@ namespace fbjs {
     public:
       ParseException(const std::string& what_arg, const int lineno) : std::runtime_error(what_arg), lineno(lineno) {}
       ~ParseException() throw() {}
+
+      // The line and the message without it, as given to the constructor
+      int line() const {
+        return lineno;
+      }
+      const char* message() const throw() {
+        return std::runtime_error::what();
+      }
       const char* what() const throw() {
         if (wut.empty()) {
           wut =
@@ -0,0 +1,397 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#include "number.hpp"
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+//
+// Shortest round-trip digit generation. Integers which fit in a double's
+// significand are printed directly; everything else runs Grisu3 (Loitsch,
+// "Printing Floating-Point Numbers Quickly and Accurately with Integers"),
+// and the rare values it can't prove shortest go to dtoa. Either way the
+// digits and decimal point position are the same ones dtoa mode 0 returns, and
+// they're laid out the way g_fmt lays them out.
+
+extern "C" char* g_fmt(char*, double);
+
+// dtoa keeps its big number pools in globals, so only one thread may be in it
+static pthread_mutex_t fbjs_dtoa_lock = PTHREAD_MUTEX_INITIALIZER;
+
+namespace fbjs {
+
+  // 64-bit significand and binary exponent, value = f * 2^e
+  struct diy_fp_t {
+    uint64_t f;
+    int e;
+  };
+
+  // Normalized 10^k for k = -348, -340, ..., 340
+  struct cached_power_t {
+    uint64_t significand;
+    int16_t binary_exponent;
+    int16_t decimal_exponent;
+  };
+
+  static const cached_power_t cached_powers[] = {
+    {0xfa8fd5a0081c0288ULL, -1220, -348},
+    {0xbaaee17fa23ebf76ULL, -1193, -340},
+    {0x8b16fb203055ac76ULL, -1166, -332},
+    {0xcf42894a5dce35eaULL, -1140, -324},
+    {0x9a6bb0aa55653b2dULL, -1113, -316},
+    {0xe61acf033d1a45dfULL, -1087, -308},
+    {0xab70fe17c79ac6caULL, -1060, -300},
+    {0xff77b1fcbebcdc4fULL, -1034, -292},
+    {0xbe5691ef416bd60cULL, -1007, -284},
+    {0x8dd01fad907ffc3cULL, -980, -276},
+    {0xd3515c2831559a83ULL, -954, -268},
+    {0x9d71ac8fada6c9b5ULL, -927, -260},
+    {0xea9c227723ee8bcbULL, -901, -252},
+    {0xaecc49914078536dULL, -874, -244},
+    {0x823c12795db6ce57ULL, -847, -236},
+    {0xc21094364dfb5637ULL, -821, -228},
+    {0x9096ea6f3848984fULL, -794, -220},
+    {0xd77485cb25823ac7ULL, -768, -212},
+    {0xa086cfcd97bf97f4ULL, -741, -204},
+    {0xef340a98172aace5ULL, -715, -196},
+    {0xb23867fb2a35b28eULL, -688, -188},
+    {0x84c8d4dfd2c63f3bULL, -661, -180},
+    {0xc5dd44271ad3cdbaULL, -635, -172},
+    {0x936b9fcebb25c996ULL, -608, -164},
+    {0xdbac6c247d62a584ULL, -582, -156},
+    {0xa3ab66580d5fdaf6ULL, -555, -148},
+    {0xf3e2f893dec3f126ULL, -529, -140},
+    {0xb5b5ada8aaff80b8ULL, -502, -132},
+    {0x87625f056c7c4a8bULL, -475, -124},
+    {0xc9bcff6034c13053ULL, -449, -116},
+    {0x964e858c91ba2655ULL, -422, -108},
+    {0xdff9772470297ebdULL, -396, -100},
+    {0xa6dfbd9fb8e5b88fULL, -369, -92},
+    {0xf8a95fcf88747d94ULL, -343, -84},
+    {0xb94470938fa89bcfULL, -316, -76},
+    {0x8a08f0f8bf0f156bULL, -289, -68},
+    {0xcdb02555653131b6ULL, -263, -60},
+    {0x993fe2c6d07b7facULL, -236, -52},
+    {0xe45c10c42a2b3b06ULL, -210, -44},
+    {0xaa242499697392d3ULL, -183, -36},
+    {0xfd87b5f28300ca0eULL, -157, -28},
+    {0xbce5086492111aebULL, -130, -20},
+    {0x8cbccc096f5088ccULL, -103, -12},
+    {0xd1b71758e219652cULL, -77, -4},
+    {0x9c40000000000000ULL, -50, 4},
+    {0xe8d4a51000000000ULL, -24, 12},
+    {0xad78ebc5ac620000ULL, 3, 20},
+    {0x813f3978f8940984ULL, 30, 28},
+    {0xc097ce7bc90715b3ULL, 56, 36},
+    {0x8f7e32ce7bea5c70ULL, 83, 44},
+    {0xd5d238a4abe98068ULL, 109, 52},
+    {0x9f4f2726179a2245ULL, 136, 60},
+    {0xed63a231d4c4fb27ULL, 162, 68},
+    {0xb0de65388cc8ada8ULL, 189, 76},
+    {0x83c7088e1aab65dbULL, 216, 84},
+    {0xc45d1df942711d9aULL, 242, 92},
+    {0x924d692ca61be758ULL, 269, 100},
+    {0xda01ee641a708deaULL, 295, 108},
+    {0xa26da3999aef774aULL, 322, 116},
+    {0xf209787bb47d6b85ULL, 348, 124},
+    {0xb454e4a179dd1877ULL, 375, 132},
+    {0x865b86925b9bc5c2ULL, 402, 140},
+    {0xc83553c5c8965d3dULL, 428, 148},
+    {0x952ab45cfa97a0b3ULL, 455, 156},
+    {0xde469fbd99a05fe3ULL, 481, 164},
+    {0xa59bc234db398c25ULL, 508, 172},
+    {0xf6c69a72a3989f5cULL, 534, 180},
+    {0xb7dcbf5354e9beceULL, 561, 188},
+    {0x88fcf317f22241e2ULL, 588, 196},
+    {0xcc20ce9bd35c78a5ULL, 614, 204},
+    {0x98165af37b2153dfULL, 641, 212},
+    {0xe2a0b5dc971f303aULL, 667, 220},
+    {0xa8d9d1535ce3b396ULL, 694, 228},
+    {0xfb9b7cd9a4a7443cULL, 720, 236},
+    {0xbb764c4ca7a44410ULL, 747, 244},
+    {0x8bab8eefb6409c1aULL, 774, 252},
+    {0xd01fef10a657842cULL, 800, 260},
+    {0x9b10a4e5e9913129ULL, 827, 268},
+    {0xe7109bfba19c0c9dULL, 853, 276},
+    {0xac2820d9623bf429ULL, 880, 284},
+    {0x80444b5e7aa7cf85ULL, 907, 292},
+    {0xbf21e44003acdd2dULL, 933, 300},
+    {0x8e679c2f5e44ff8fULL, 960, 308},
+    {0xd433179d9c8cb841ULL, 986, 316},
+    {0x9e19db92b4e31ba9ULL, 1013, 324},
+    {0xeb96bf6ebadf77d9ULL, 1039, 332},
+    {0xaf87023b9bf0ee6bULL, 1066, 340},  };
+  static const int cached_powers_offset = 348;
+  static const int cached_powers_distance = 8;
+
+  // Product digits fall in [2^-60, 2^-32) of the scaled value, see Grisu3
+  static const int minimal_target_exponent = -60;
+
+  static const char digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+  static diy_fp_t diy_fp(uint64_t f, int e) {
+    diy_fp_t fp = {f, e};
+    return fp;
+  }
+
+  static diy_fp_t diy_fp_normalize(diy_fp_t fp) {
+    while (!(fp.f & 0xffc0000000000000ULL)) {
+      fp.f <<= 10;
+      fp.e -= 10;
+    }
+    while (!(fp.f & 0x8000000000000000ULL)) {
+      fp.f <<= 1;
+      --fp.e;
+    }
+    return fp;
+  }
+
+  // Upper 64 bits of the product, rounded
+  static diy_fp_t diy_fp_multiply(diy_fp_t x, diy_fp_t y) {
+    const uint64_t mask = 0xffffffffULL;
+    uint64_t a = x.f >> 32, b = x.f & mask, c = y.f >> 32, d = y.f & mask;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t tmp = (bd >> 32) + (ad & mask) + (bc & mask) + (1ULL << 31);
+    return diy_fp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64);
+  }
+
+  //
+  // Strips trailing zeros from `value` and writes its digits. Returns the digit
+  // count and sets `decpt` to the position of the decimal point, as dtoa would.
+  static int integer_digits(uint64_t value, char* digits, int* decpt) {
+    char tmp[20];
+    char* p = tmp + sizeof(tmp);
+    while (value >= 100) {
+      const char* pair = digit_pairs + (value % 100) * 2;
+      value /= 100;
+      *--p = pair[1];
+      *--p = pair[0];
+    }
+    if (value >= 10) {
+      const char* pair = digit_pairs + value * 2;
+      *--p = pair[1];
+      *--p = pair[0];
+    } else {
+      *--p = '0' + static_cast<char>(value);
+    }
+    int length = tmp + sizeof(tmp) - p;
+    *decpt = length;
+    while (p[length - 1] == '0') {
+      --length;
+    }
+    memcpy(digits, p, length);
+    return length;
+  }
+
+  //
+  // Walks the last digit down towards `w` while that stays inside the interval,
+  // then checks the result is the closest one and safely inside. Returns false
+  // when the imprecision of `w` means we can't tell.
+  static bool round_weed(char* digits, int length, uint64_t distance_too_high_w, uint64_t unsafe_interval,
+                         uint64_t rest, uint64_t ten_kappa, uint64_t unit) {
+    uint64_t small_distance = distance_too_high_w - unit;
+    uint64_t big_distance = distance_too_high_w + unit;
+    while (rest < small_distance && unsafe_interval - rest >= ten_kappa &&
+           (rest + ten_kappa < small_distance || small_distance - rest >= rest + ten_kappa - small_distance)) {
+      --digits[length - 1];
+      rest += ten_kappa;
+    }
+    if (rest < big_distance && unsafe_interval - rest >= ten_kappa &&
+        (rest + ten_kappa < big_distance || big_distance - rest > rest + ten_kappa - big_distance)) {
+      return false;
+    }
+    return 2 * unit <= rest && rest <= unsafe_interval - 4 * unit;
+  }
+
+  //
+  // Generates the shortest digits in (low, high), all scaled so that the
+  // exponent is in [-60, -32]. Sets kappa to the power of ten of the last digit.
+  static bool digit_gen(diy_fp_t low, diy_fp_t w, diy_fp_t high, char* digits, int* length, int* kappa) {
+    uint64_t unit = 1;
+    uint64_t too_low = low.f - unit;
+    uint64_t too_high = high.f + unit;
+    uint64_t unsafe_interval = too_high - too_low;
+    const int shift = -w.e;
+    const uint64_t one = 1ULL << shift;
+    uint32_t integrals = static_cast<uint32_t>(too_high >> shift);
+    uint64_t fractionals = too_high & (one - 1);
+
+    uint32_t divisor = 0;
+    *kappa = 0;
+    for (uint32_t power = 1; integrals >= power; ) {
+      divisor = power;
+      ++*kappa;
+      if (power > 429496729) {
+        break;
+      }
+      power *= 10;
+    }
+
+    *length = 0;
+    while (*kappa > 0) {
+      digits[(*length)++] = '0' + static_cast<char>(integrals / divisor);
+      integrals %= divisor;
+      --*kappa;
+      uint64_t rest = (static_cast<uint64_t>(integrals) << shift) + fractionals;
+      if (rest < unsafe_interval) {
+        return round_weed(digits, *length, too_high - w.f, unsafe_interval, rest,
+                          static_cast<uint64_t>(divisor) << shift, unit);
+      }
+      divisor /= 10;
+    }
+
+    for (;;) {
+      fractionals *= 10;
+      unit *= 10;
+      unsafe_interval *= 10;
+      digits[(*length)++] = '0' + static_cast<char>(fractionals >> shift);
+      fractionals &= one - 1;
+      --*kappa;
+      if (fractionals < unsafe_interval) {
+        return round_weed(digits, *length, (too_high - w.f) * unit, unsafe_interval, fractionals, one, unit);
+      }
+    }
+  }
+
+  //
+  // Grisu3 for a finite, positive double. Returns false if it couldn't prove
+  // the digits are the shortest and closest.
+  static bool grisu3(double value, char* digits, int* length, int* decpt) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint64_t hidden_bit = 0x0010000000000000ULL;
+    uint64_t fraction = bits & (hidden_bit - 1);
+    int biased_exponent = static_cast<int>(bits >> 52);
+    diy_fp_t v = biased_exponent ?
+      diy_fp(fraction + hidden_bit, biased_exponent - 1075) :
+      diy_fp(fraction, -1074);
+
+    // Boundaries halfway to the neighboring doubles. The lower one is closer
+    // when v is a power of two (other than the smallest normal).
+    diy_fp_t plus = diy_fp_normalize(diy_fp((v.f << 1) + 1, v.e - 1));
+    diy_fp_t minus = (fraction == 0 && biased_exponent > 1) ?
+      diy_fp((v.f << 2) - 1, v.e - 2) :
+      diy_fp((v.f << 1) - 1, v.e - 1);
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+    diy_fp_t w = diy_fp_normalize(v);
+
+    // Find a cached 10^-k which brings w's exponent into the target range
+    static const double d_1_log2_10 = 0.30102999566398114;
+    int min_exponent = minimal_target_exponent - (w.e + 64);
+    double k = (min_exponent + 63) * d_1_log2_10;
+    int ki = static_cast<int>(k);
+    if (ki < k) {
+      ++ki;
+    }
+    const cached_power_t& cached = cached_powers[(cached_powers_offset + ki - 1) / cached_powers_distance + 1];
+    diy_fp_t ten_mk = diy_fp(cached.significand, cached.binary_exponent);
+
+    int kappa;
+    if (!digit_gen(diy_fp_multiply(minus, ten_mk), diy_fp_multiply(w, ten_mk), diy_fp_multiply(plus, ten_mk),
+                   digits, length, &kappa)) {
+      return false;
+    }
+    while (*length > 1 && digits[*length - 1] == '0') {
+      --*length;
+      ++kappa;
+    }
+    *decpt = *length + kappa - cached.decimal_exponent;
+    return true;
+  }
+
+  char* fbjs_format_number(char* buf, double value) {
+    char digits[24];
+    int length, decpt;
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bool negative = bits >> 63;
+    double magnitude = negative ? -value : value;
+
+    // 0, Infinity and NaN and Grisu3's failures all go to dtoa
+    if (magnitude < 9007199254740992.0 && magnitude >= 1 && magnitude == static_cast<double>(static_cast<uint64_t>(magnitude))) {
+      length = integer_digits(static_cast<uint64_t>(magnitude), digits, &decpt);
+    } else if (!(magnitude > 0 && magnitude <= 1.7976931348623157e308) || !grisu3(magnitude, digits, &length, &decpt)) {
+      pthread_mutex_lock(&fbjs_dtoa_lock);
+      g_fmt(buf, value);
+      pthread_mutex_unlock(&fbjs_dtoa_lock);
+      return buf;
+    }
+
+    // Notation from g_fmt
+    char* b = buf;
+    if (negative) {
+      *b++ = '-';
+    }
+    if (decpt <= -4 || decpt > length + 5) {
+      *b++ = digits[0];
+      if (length > 1) {
+        *b++ = '.';
+        memcpy(b, digits + 1, length - 1);
+        b += length - 1;
+      }
+      *b++ = 'e';
+      int exponent = decpt - 1;
+      if (exponent < 0) {
+        *b++ = '-';
+        exponent = -exponent;
+      } else {
+        *b++ = '+';
+      }
+      // At least two exponent digits, like printf's %+.2d
+      if (exponent >= 100) {
+        *b++ = '0' + exponent / 100;
+        exponent %= 100;
+      }
+      *b++ = digit_pairs[exponent * 2];
+      *b++ = digit_pairs[exponent * 2 + 1];
+    } else if (decpt <= 0) {
+      *b++ = '.';
+      for (; decpt < 0; ++decpt) {
+        *b++ = '0';
+      }
+      memcpy(b, digits, length);
+      b += length;
+    } else {
+      for (int ii = 0; ii < length; ++ii) {
+        *b++ = digits[ii];
+        if (--decpt == 0 && ii + 1 < length) {
+          *b++ = '.';
+        }
+      }
+      for (; decpt > 0; --decpt) {
+        *b++ = '0';
+      }
+    }
+    *b = 0;
+    return buf;
+  }
+}
@@ -0,0 +1,30 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#pragma once
+
+namespace fbjs {
+
+  //
+  // Formats `value` into `buf` exactly as dmg_fp's g_fmt() does: the shortest
+  // digits which read back as `value`, in the same notation. Like g_fmt, buf
+  // should be at least 32 bytes. Returns buf.
+  char* fbjs_format_number(char* buf, double value);
+}
@@ -0,0 +1,124 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#include "parallel_render.hpp"
+#include "stats.hpp"
+#include <typeinfo>
+using namespace std;
+using namespace fbjs;
+
+// Enough chunks per thread for the pool's stealing to even out statements of
+// very different sizes
+static const size_t PARALLEL_RENDER_CHUNKS_PER_THREAD = 8;
+
+ParallelRenderer::ParallelRenderer(unsigned int threads /* = 0 */) : _pool(threads) {}
+
+//
+// Renders statements [begin, end) the way NodeStatementList::render() would,
+// starting from `lineno`, and returns the lineno it left off at
+unsigned int ParallelRenderer::renderStatements(const node_list_t& statements, size_t begin, size_t end,
+  RenderSink& sink, int opts, unsigned int lineno) {
+  render_guts_t guts;
+  guts.pretty = opts & RENDER_PRETTY;
+  guts.sanelineno = opts & RENDER_MAINTAIN_LINENO;
+  guts.sourceorder = opts & RENDER_SOURCE_ORDER;
+  guts.sourcemap = false;
+  guts.lineno = lineno;
+  guts.sink = &sink;
+  for (size_t ii = begin; ii < end; ++ii) {
+    if (statements[ii] != NULL) {
+      statements[ii]->renderIndentedStatement(&guts, 0);
+    }
+  }
+  return guts.lineno;
+}
+
+void ParallelRenderer::renderChunk(void* context, unsigned int worker, size_t index) {
+  job_t* job = static_cast<job_t*>(context);
+  chunk_t& chunk = (*job->chunks)[index];
+  unsigned int lineno = 1;
+  if (index != 0) {
+    if (job->opts & RENDER_MAINTAIN_LINENO) {
+      lineno = chunk.first_lineno;
+    } else if (job->opts & RENDER_PRETTY) {
+      lineno = 2;
+    }
+  }
+  RenderSink sink(chunk.output);
+  chunk.end_lineno = ParallelRenderer::renderStatements(*job->statements, chunk.begin, chunk.end, sink, job->opts, lineno);
+  sink.flush();
+}
+
+void ParallelRenderer::render(const Node* program, RenderSink& sink, int opts /* = RENDER_NONE */) {
+  const node_list_t& children = program->childNodes();
+  if (typeid(*program) != typeid(NodeProgram) || children.size() != 1 || children.front() == NULL ||
+      typeid(*children.front()) != typeid(NodeStatementList) || _pool.size() < 2) {
+    program->render(sink, opts);
+    return;
+  }
+
+  // Chunks begin on a statement so each renders something
+  const node_list_t& statements = children.front()->childNodes();
+  vector<size_t> starts;
+  for (size_t ii = 0; ii < statements.size(); ++ii) {
+    if (statements[ii] != NULL) {
+      starts.push_back(ii);
+    }
+  }
+  size_t count = min(starts.size(), _pool.size() * PARALLEL_RENDER_CHUNKS_PER_THREAD);
+  if (count < 2) {
+    program->render(sink, opts);
+    return;
+  }
+  vector<chunk_t> chunks(count);
+  for (size_t ii = 0; ii < count; ++ii) {
+    chunks[ii].begin = starts[starts.size() * ii / count];
+    chunks[ii].end = ii + 1 == count ? statements.size() : starts[starts.size() * (ii + 1) / count];
+    chunks[ii].first_lineno = statements[chunks[ii].begin]->lineno();
+    chunks[ii].end_lineno = 1;
+  }
+
+  NodeStats* stats = sink.stats();
+  double start = stats ? NodeStats::now() : 0;
+  size_t written = sink.written();
+  job_t job = {&statements, &chunks, opts};
+  _pool.run(ParallelRenderer::renderChunk, &job, count);
+
+  unsigned int lineno = 1;
+  for (size_t ii = 0; ii < count; ++ii) {
+    chunk_t& chunk = chunks[ii];
+    if (ii != 0 && (opts & RENDER_MAINTAIN_LINENO)) {
+      if (!chunk.first_lineno || lineno > chunk.first_lineno) {
+        lineno = ParallelRenderer::renderStatements(statements, chunk.begin, chunk.end, sink, opts, lineno);
+        continue;
+      }
+      sink.repeat('\n', chunk.first_lineno - lineno);
+    }
+    sink.write(chunk.output);
+    lineno = chunk.end_lineno;
+    string().swap(chunk.output);
+  }
+  sink.flush();
+  if (stats) {
+    stats->rendered_bytes += sink.written() - written;
+    stats->render_seconds += NodeStats::now() - start;
+    ++stats->renders;
+  }
+}
@@ -0,0 +1,73 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#pragma once
+#include <string>
+#include <vector>
+#include "node.hpp"
+#include "thread_pool.hpp"
+
+namespace fbjs {
+
+  //
+  // ParallelRenderer: renders a program's top-level statements in chunks across
+  // a thread pool and writes the chunks out in order. The output is byte for
+  // byte what program->render(sink, opts) writes.
+  //
+  // The only state one statement's render leaves for the next is
+  // render_guts_t::lineno. Under RENDER_PRETTY it just says whether anything
+  // has been rendered yet, which is known for every chunk but the first. Under
+  // RENDER_MAINTAIN_LINENO it's the output line, and each top-level statement
+  // begins by padding out to its own line. So a chunk is rendered as if it
+  // already started on its first statement's line, and the join pads the
+  // newlines in front of it. A chunk whose first statement has no line number,
+  // or starts on a line the previous chunk already went past, is rendered again
+  // in place once the previous chunk's end is known.
+  //
+  // Programs that aren't a plain NodeProgram around a NodeStatementList, or
+  // that have too few statements to split, are rendered serially.
+  class ParallelRenderer {
+    public:
+      ParallelRenderer(unsigned int threads = 0);
+      void render(const Node* program, RenderSink& sink, int opts = RENDER_NONE);
+
+    protected:
+      struct chunk_t {
+        size_t begin;
+        size_t end;
+        unsigned int first_lineno;
+        unsigned int end_lineno;
+        std::string output;
+      };
+      struct job_t {
+        const node_list_t* statements;
+        std::vector<chunk_t>* chunks;
+        int opts;
+      };
+      ThreadPool _pool;
+      static unsigned int renderStatements(const node_list_t& statements, size_t begin, size_t end,
+        RenderSink& sink, int opts, unsigned int lineno);
+      static void renderChunk(void* context, unsigned int worker, size_t index);
+
+    private:
+      ParallelRenderer(const ParallelRenderer&);
+      ParallelRenderer& operator= (const ParallelRenderer&);
+  };
+}
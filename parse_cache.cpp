@@ -0,0 +1,338 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#include "parse_cache.hpp"
+#include "image.hpp"
+#include <errno.h>
+#include <fcntl.h>
+#include <memory>
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+using namespace fbjs;
+
+// Options that only change how the tree is allocated stay out of the key
+static const int parse_cache_opts = PARSE_TYPEHINT | PARSE_OBJECT_LITERAL_ELISON | PARSE_E4X | PARSE_RECOVER;
+
+static inline uint64_t parse_cache_rotl(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t parse_cache_finish(uint64_t value) {
+  value ^= value >> 33;
+  value *= 0xff51afd7ed558ccdULL;
+  value ^= value >> 33;
+  value *= 0xc4ceb9fe1a85ec53ULL;
+  value ^= value >> 33;
+  return value;
+}
+
+//
+// An entry is the image, then the errors a PARSE_RECOVER parse got past, each
+// a line number, a length and the message, and last the size of the errors
+static void parse_cache_put(string& entry, uint32_t value) {
+  entry.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static uint32_t parse_cache_get(const string& entry, size_t& offset, size_t end) {
+  uint32_t value;
+  if (end - offset < sizeof(value)) {
+    throw runtime_error("corrupt cache entry");
+  }
+  memcpy(&value, entry.data() + offset, sizeof(value));
+  offset += sizeof(value);
+  return value;
+}
+
+static void parse_cache_put_errors(string& entry, const vector<ParseException>& errors) {
+  size_t start = entry.size();
+  for (vector<ParseException>::const_iterator ii = errors.begin(); ii != errors.end(); ++ii) {
+    size_t len = strlen(ii->message());
+    parse_cache_put(entry, ii->line());
+    parse_cache_put(entry, len);
+    entry.append(ii->message(), len);
+  }
+  parse_cache_put(entry, entry.size() - start);
+}
+
+// Reads the errors into `errors` if given and returns the size of the image
+static size_t parse_cache_get_errors(const string& entry, vector<ParseException>* errors) {
+  size_t end = entry.size(), offset = end < sizeof(uint32_t) ? 0 : end - sizeof(uint32_t);
+  size_t len = parse_cache_get(entry, offset, end);
+  end -= sizeof(uint32_t);
+  if (len > end) {
+    throw runtime_error("corrupt cache entry");
+  }
+  size_t image = end - len;
+  if (errors) {
+    errors->clear();
+    offset = image;
+    while (offset < end) {
+      int line = parse_cache_get(entry, offset, end);
+      size_t message = parse_cache_get(entry, offset, end);
+      if (message > end - offset) {
+        throw runtime_error("corrupt cache entry");
+      }
+      errors->push_back(ParseException(entry.substr(offset, message), line));
+      offset += message;
+    }
+  }
+  return image;
+}
+
+ParseCache::ParseCache(size_t budget, const string& directory /* = "" */) : _budget(budget), _size(0),
+  _hits(0), _misses(0), _directory(directory) {
+  pthread_mutex_init(&_lock, NULL);
+}
+
+ParseCache::~ParseCache() {
+  pthread_mutex_destroy(&_lock);
+}
+
+//
+// Two 64-bit lanes over the input's words make a 128-bit key. It's not a
+// cryptographic hash, only enough that unrelated inputs won't share an entry.
+string ParseCache::key(const char* data, size_t len, node_parse_enum opts) {
+  uint64_t first = 0x9e3779b97f4a7c15ULL ^ len;
+  uint64_t second = 0xc2b2ae3d27d4eb4fULL + len;
+  size_t ii = 0;
+  for (; ii + 8 <= len; ii += 8) {
+    uint64_t word;
+    memcpy(&word, data + ii, sizeof(word));
+    first = parse_cache_rotl(first ^ (word * 0x87c37b91114253d5ULL), 31) * 0x4cf5ad432745937fULL;
+    second = parse_cache_rotl(second + word, 27) * 0x9e3779b97f4a7c15ULL + first;
+  }
+  uint64_t tail = 0;
+  memcpy(&tail, data + ii, len - ii);
+  first = parse_cache_finish(first ^ (tail * 0x87c37b91114253d5ULL));
+  second = parse_cache_finish(second + tail + first);
+
+  char key[64];
+  snprintf(key, sizeof(key), "%016llx%016llx-%x-", static_cast<unsigned long long>(first),
+    static_cast<unsigned long long>(second), opts & parse_cache_opts);
+  return key + NodeImage::buildId();
+}
+
+NodeProgram* ParseCache::parse(const char* data, size_t len, node_parse_enum opts /* = PARSE_NONE */,
+    Parser* parser /* = NULL */, vector<ParseException>* errors /* = NULL */) {
+  string key = ParseCache::key(data, len, opts);
+  string entry;
+  bool memory = this->find(key, entry);
+  if (memory || this->readFile(key, entry)) {
+    try {
+      size_t image = parse_cache_get_errors(entry, errors);
+      auto_ptr<NodeProgram> program(NodeImage(entry.data(), image).load());
+
+      // A file only goes in memory once it's known to load
+      if (!memory) {
+        this->insert(key, entry);
+      }
+      pthread_mutex_lock(&_lock);
+      ++_hits;
+      pthread_mutex_unlock(&_lock);
+      return program.release();
+    } catch (const runtime_error&) {
+      // A damaged entry, drop it and parse again; the new image replaces it
+      this->erase(key);
+    }
+  }
+
+  pthread_mutex_lock(&_lock);
+  ++_misses;
+  pthread_mutex_unlock(&_lock);
+  auto_ptr<Parser> owned(parser ? NULL : new Parser());
+  if (parser == NULL) {
+    parser = owned.get();
+  }
+  auto_ptr<NodeProgram> program(parser->parse(data, len, opts));
+  if (errors) {
+    *errors = parser->errors();
+  }
+  NodeImage::write(program.get(), entry);
+  parse_cache_put_errors(entry, parser->errors());
+  this->insert(key, entry);
+  this->writeFile(key, entry);
+  return program.release();
+}
+
+NodeProgram* ParseCache::parseFile(const char* path, node_parse_enum opts /* = PARSE_NONE */,
+    Parser* parser /* = NULL */, vector<ParseException>* errors /* = NULL */) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    throw runtime_error(string("unable to open ") + path + ": " + strerror(errno));
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw runtime_error(string("unable to stat ") + path + ": " + strerror(errno));
+  }
+  size_t len = st.st_size;
+  void* map = len ? mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+  close(fd);
+  if (map == MAP_FAILED) {
+    throw runtime_error(string("unable to map ") + path);
+  }
+  NodeProgram* program;
+  try {
+    program = this->parse(map ? static_cast<const char*>(map) : "", len, opts, parser, errors);
+  } catch (...) {
+    if (map) {
+      munmap(map, len);
+    }
+    throw;
+  }
+  if (map) {
+    munmap(map, len);
+  }
+  return program;
+}
+
+//
+// Looks in memory only, and copies the image out so it can be loaded without
+// holding the lock
+bool ParseCache::find(const string& key, string& image) {
+  pthread_mutex_lock(&_lock);
+  map<string, lru_t::iterator>::iterator ii = _index.find(key);
+  if (ii == _index.end()) {
+    pthread_mutex_unlock(&_lock);
+    return false;
+  }
+  _lru.splice(_lru.begin(), _lru, ii->second);
+  image = ii->second->image;
+  pthread_mutex_unlock(&_lock);
+  return true;
+}
+
+void ParseCache::insert(const string& key, const string& image) {
+  if (image.size() > _budget) {
+    return;
+  }
+  pthread_mutex_lock(&_lock);
+  map<string, lru_t::iterator>::iterator ii = _index.find(key);
+  if (ii != _index.end()) {
+    // Another thread got here first
+    _lru.splice(_lru.begin(), _lru, ii->second);
+    pthread_mutex_unlock(&_lock);
+    return;
+  }
+  _lru.push_front(entry_t());
+  _lru.front().key = key;
+  _lru.front().image = image;
+  _index[key] = _lru.begin();
+  _size += image.size();
+  while (_size > _budget) {
+    _size -= _lru.back().image.size();
+    _index.erase(_lru.back().key);
+    _lru.pop_back();
+  }
+  pthread_mutex_unlock(&_lock);
+}
+
+void ParseCache::erase(const string& key) {
+  pthread_mutex_lock(&_lock);
+  map<string, lru_t::iterator>::iterator ii = _index.find(key);
+  if (ii != _index.end()) {
+    _size -= ii->second->image.size();
+    _lru.erase(ii->second);
+    _index.erase(ii);
+  }
+  pthread_mutex_unlock(&_lock);
+}
+
+bool ParseCache::readFile(const string& key, string& image) const {
+  if (_directory.empty()) {
+    return false;
+  }
+  FILE* file = fopen((_directory + "/" + key + ".ast").c_str(), "rb");
+  if (file == NULL) {
+    return false;
+  }
+  image.clear();
+  char buf[16384];
+  size_t len;
+  while ((len = fread(buf, 1, sizeof(buf), file)) > 0) {
+    image.append(buf, len);
+  }
+  bool failed = ferror(file);
+  fclose(file);
+  return !failed;
+}
+
+//
+// The disk tier is only an optimization, so failing to write to it is ignored
+void ParseCache::writeFile(const string& key, const string& image) const {
+  if (_directory.empty()) {
+    return;
+  }
+  string path = _directory + "/" + key + ".ast";
+  string temp = path + ".XXXXXX";
+  int fd = mkstemp(&temp[0]);
+  if (fd < 0) {
+    return;
+  }
+  const char* data = image.data();
+  size_t left = image.size();
+  while (left) {
+    ssize_t written = ::write(fd, data, left);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    } else if (written <= 0) {
+      break;
+    }
+    data += written;
+    left -= written;
+  }
+  if (close(fd) != 0 || left || rename(temp.c_str(), path.c_str()) != 0) {
+    unlink(temp.c_str());
+  }
+}
+
+size_t ParseCache::size() const {
+  pthread_mutex_lock(&_lock);
+  size_t size = _size;
+  pthread_mutex_unlock(&_lock);
+  return size;
+}
+
+size_t ParseCache::hits() const {
+  pthread_mutex_lock(&_lock);
+  size_t hits = _hits;
+  pthread_mutex_unlock(&_lock);
+  return hits;
+}
+
+size_t ParseCache::misses() const {
+  pthread_mutex_lock(&_lock);
+  size_t misses = _misses;
+  pthread_mutex_unlock(&_lock);
+  return misses;
+}
+
+void ParseCache::clear() {
+  pthread_mutex_lock(&_lock);
+  _lru.clear();
+  _index.clear();
+  _size = 0;
+  pthread_mutex_unlock(&_lock);
+}
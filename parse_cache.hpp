@@ -0,0 +1,87 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#pragma once
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include "node.hpp"
+
+namespace fbjs {
+
+  //
+  // ParseCache: memoizes parses by a hash of the input bytes, the options that
+  // change the tree and NodeImage::buildId(). Entries are NodeImage bytes, kept
+  // in memory up to `budget` bytes with the least recently used dropped first,
+  // and optionally in `directory` as well. Any number of processes can share a
+  // directory, even when they run different builds, since entries are written
+  // to a temporary name and renamed into place and each build has its own
+  // names. An entry that doesn't load is parsed again and replaced.
+  // Each hit loads a new tree, which keeps line numbers and source positions
+  // like a fresh parse would. Entries keep the errors a PARSE_RECOVER parse
+  // got past along with the tree. A ParseCache can be shared between threads.
+  class ParseCache {
+    public:
+      ParseCache(size_t budget, const std::string& directory = "");
+      ~ParseCache();
+
+      // Caller owns the returned program. `parser` is used for misses if given.
+      // `errors`, if given, gets what Parser::errors() had after the parse,
+      // whether it was this one or the one that filled the entry.
+      NodeProgram* parse(const char* data, size_t len, node_parse_enum opts = PARSE_NONE, Parser* parser = NULL,
+        std::vector<ParseException>* errors = NULL);
+      NodeProgram* parseFile(const char* path, node_parse_enum opts = PARSE_NONE, Parser* parser = NULL,
+        std::vector<ParseException>* errors = NULL);
+
+      size_t size() const;
+      size_t hits() const;
+      size_t misses() const;
+      void clear();
+
+    protected:
+      struct entry_t {
+        std::string key;
+        std::string image;
+      };
+      typedef std::list<entry_t> lru_t;
+      size_t _budget;
+      size_t _size;
+      size_t _hits;
+      size_t _misses;
+      std::string _directory;
+      lru_t _lru;
+      std::map<std::string, lru_t::iterator> _index;
+      mutable pthread_mutex_t _lock;
+      static std::string key(const char* data, size_t len, node_parse_enum opts);
+      bool find(const std::string& key, std::string& image);
+      void insert(const std::string& key, const std::string& image);
+      void erase(const std::string& key);
+      bool readFile(const std::string& key, std::string& image) const;
+      void writeFile(const std::string& key, const std::string& image) const;
+
+    private:
+      ParseCache(const ParseCache&);
+      ParseCache& operator= (const ParseCache&);
+  };
+}
@@ -20,27 +20,38 @@
 
 #include "node.hpp"
 #include "parser.hpp"
+#include "stats.hpp"
+#include <errno.h>
+#include <pthread.h>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #ifdef DEBUG_BISON
 extern int yydebug;
 #endif
 using namespace std;
 using namespace fbjs;
 
+#ifdef DEBUG_BISON
+static pthread_once_t fbjs_yydebug_once = PTHREAD_ONCE_INIT;
+static void fbjs_enable_yydebug() {
+  yydebug = 1;
+}
+#endif
+
 void* fbjs_init_parser(fbjs_parse_extra* extra) {
 
   // Initialize the scanner.
   void* scanner;
-  yylex_init_extra(extra, &scanner);
   extra->error = NULL;
-  extra->error_line = 0;
-  extra->terminated = false;
-  extra->lineno = 1;
-  extra->last_tok = 0;
-  extra->last_paren_tok = 0;
+  extra->stats = NULL;
+  extra->statement_callback = NULL;
+  yylex_init_extra(extra, &scanner);
+  fbjs_reset_parser(extra, scanner);
 
-  // Debug stuff
+  // Debug stuff. yydebug is the only global bison state, only set it once.
 #ifdef DEBUG_BISON
-  yydebug = 1;
+  pthread_once(&fbjs_yydebug_once, fbjs_enable_yydebug);
 #endif
 #ifdef DEBUG_FLEX
   yyset_debug(1, scanner);
@@ -49,33 +60,771 @@ void* fbjs_init_parser(fbjs_parse_extra* extra) {
   return scanner;
 }
 
-void fbjs_cleanup_parser(fbjs_parse_extra* extra, void* scanner) {
-  yylex_destroy(scanner);
+// Empty a stack in place; constructing a fresh one allocates
+static void fbjs_clear_stack(stack<int>& values) {
+  while (!values.empty()) {
+    values.pop();
+  }
+}
+
+void fbjs_reset_parser(fbjs_parse_extra* extra, void* scanner) {
   if (extra->error != NULL) {
-    string error(extra->error);
     free(extra->error);
-    throw ParseException(error, extra->error_line);
   }
+  extra->error = NULL;
+  extra->error_line = 0;
+  extra->terminated = false;
+  extra->errors.clear();
+  fbjs_clear_stack(extra->paren_stack);
+  fbjs_clear_stack(extra->curly_stack);
+  fbjs_clear_stack(extra->pre_xml_stack);
+  extra->lineno = 1;
+  extra->virtual_semicolon_last_state = 0;
+  extra->last_tok = 0;
+  extra->last_tok_xml = false;
+  extra->last_paren_tok = 0;
+  extra->last_curly_tok = 0;
+  extra->arena = NULL;
+  extra->atoms = NULL;
+  extra->input = NULL;
+  extra->input_length = 0;
+  extra->input_pos = 0;
+  extra->window = NULL;
+  extra->window_offset = 0;
+  extra->newlines.clear();
+  extra->column_shifts.clear();
+  extra->line_start = 0;
+  extra->column_pos = 0;
+  extra->line_shift = 0;
+  extra->fast_lexer = false;
+  extra->statement_callback = NULL;
+  extra->statement_context = NULL;
+  fbjs_reset_lexer(scanner);
+}
+
+size_t fbjs_read_input(fbjs_parse_extra* extra, char* buf, size_t max_size, FILE* file) {
+
+  // input_pos counts every byte handed to flex so far, see fbjs_input_offset
+  extra->window = buf;
+  extra->window_offset = extra->input_pos;
+
+  // In-memory source. Flex only scans its own buffer, so this copies the next
+  // window of at most max_size bytes into it; the whole input is never copied
+  // at once, but every byte flex scans is copied once. Only PARSE_FAST_LEXER
+  // scans the caller's buffer in place.
+  size_t len;
+  if (extra->input != NULL) {
+    len = extra->input_length - extra->input_pos;
+    if (len > max_size) {
+      len = max_size;
+    }
+    memcpy(buf, extra->input + extra->input_pos, len);
+  } else {
+
+    // Otherwise behave like flex's default non-interactive YY_INPUT
+    errno = 0;
+    while ((len = fread(buf, 1, max_size, file)) == 0 && ferror(file)) {
+      if (errno != EINTR) {
+        if (extra->error == NULL) {
+          extra->error = strdup("input in flex scanner failed");
+          extra->error_line = extra->lineno;
+        }
+        return 0;
+      }
+      errno = 0;
+      clearerr(file);
+    }
+  }
+  extra->input_pos += len;
+
+  // Flex may drop this chunk before the tokens after a newline are scanned,
+  // so note where lines start now, and the bytes that count as other than one
+  // column. See fbjs_input_column.
+  const char* end = buf + len;
+  for (const char* ii = buf; (ii = static_cast<const char*>(memchr(ii, '\n', end - ii))) != NULL; ++ii) {
+    extra->newlines.push_back(extra->window_offset + (ii - buf));
+  }
+  for (const char* ii = buf; ii != end; ++ii) {
+    unsigned char c = *ii;
+    if ((c & 0xc0) == 0x80) {
+      extra->column_shifts.push_back(make_pair(extra->window_offset + (ii - buf), -1));
+    } else if ((c & 0xf8) == 0xf0) {
+      extra->column_shifts.push_back(make_pair(extra->window_offset + (ii - buf), 1));
+    }
+  }
+  return len;
+}
+
+//
+// Column of the byte at `offset`, in UTF-16 units. Offsets must never go
+// backwards.
+int fbjs_input_column(fbjs_parse_extra* extra, size_t offset) {
+  while (!extra->newlines.empty() && extra->newlines.front() < offset) {
+    extra->line_start = extra->newlines.front() + 1;
+    extra->line_shift = 0;
+    extra->newlines.pop_front();
+  }
+  while (!extra->column_shifts.empty() && extra->column_shifts.front().first < offset) {
+    if (extra->column_shifts.front().first >= extra->line_start) {
+      extra->line_shift += extra->column_shifts.front().second;
+    }
+    extra->column_shifts.pop_front();
+  }
+  return offset - extra->line_start + extra->line_shift;
+}
+
+//
+// Column of the byte at `offset` of in-memory input, on the line starting at
+// `line_start`, in UTF-16 units. What the bytes before column_pos on the same
+// line came to is kept, so a line is only scanned once as tokens move along it.
+int fbjs_input_memory_column(fbjs_parse_extra* extra, size_t line_start, size_t offset) {
+  if (extra->column_pos < line_start || extra->column_pos > offset) {
+    extra->column_pos = line_start;
+    extra->line_shift = 0;
+  }
+  const unsigned char* end = reinterpret_cast<const unsigned char*>(extra->input) + offset;
+  for (const unsigned char* ii = reinterpret_cast<const unsigned char*>(extra->input) + extra->column_pos; ii != end; ++ii) {
+    if ((*ii & 0xc0) == 0x80) {
+      --extra->line_shift;
+    } else if ((*ii & 0xf8) == 0xf0) {
+      ++extra->line_shift;
+    }
+  }
+  extra->column_pos = offset;
+  return offset - line_start + extra->line_shift;
+}
+
+Parser::Parser() : _extra(new fbjs_parse_extra) {
+  _scanner = fbjs_init_parser(_extra);
+}
+
+Parser::~Parser() {
+  yylex_destroy(_scanner);
+  if (_extra->error != NULL) {
+    free(_extra->error);
+  }
+  delete _extra;
+}
+
+void Parser::setStats(NodeStats* stats) {
+  _extra->stats = stats;
+}
+
+NodeStats* Parser::stats() const {
+  return _extra->stats;
+}
+
+//
+// Parse into `program`, or hand its statements to `callback` if there is one.
+// The scanner is reset first, whatever state the last parse left it in.
+void Parser::parseInto(NodeProgram* program, const char* data, size_t len, FILE* file, node_parse_enum opts,
+  statement_callback_t callback /* = NULL */, void* context /* = NULL */) {
+  if (opts & (PARSE_E4X | PARSE_TYPEHINT) & ~fbjs_grammar_features) {
+    throw invalid_argument(opts & PARSE_E4X & ~fbjs_grammar_features ?
+      "libfbjs was built without E4X" : "libfbjs was built without typehints");
+  }
+  fbjs_parse_extra* extra = _extra;
+  fbjs_reset_parser(extra, _scanner);
+  NodeStats* stats = extra->stats;
+  NodeStatsScope stats_scope(stats);
+  double start = stats ? NodeStats::now() : 0;
+  NodeAtomTable atoms;
+  extra->opts = opts;
+  extra->atoms = &atoms;
+  extra->input = data;
+  extra->input_length = len;
+  extra->fast_lexer = data != NULL && (opts & PARSE_FAST_LEXER) && !(opts & PARSE_E4X);
+  extra->statement_callback = callback;
+  extra->statement_context = context;
+  if (opts & PARSE_ARENA) {
+    extra->arena = program->_arena = new NodeArena();
+    extra->atoms = program->_atoms = new NodeAtomTable();
+  }
+  size_t children = program->childNodes().size();
+  try {
+    yyrestart(file, _scanner);
+    yyparse(_scanner, program);
+    if (extra->error != NULL) {
+      string error(extra->error);
+      free(extra->error);
+      extra->error = NULL;
+      if (!(opts & PARSE_RECOVER)) {
+        throw ParseException(error, extra->error_line);
+      }
+      extra->errors.push_back(ParseException(error, extra->error_line));
+    }
+    program->setSourceRange(0, extra->input_pos);
+    program->setSourcePosition(1, 0);
+    if (stats) {
+      stats->parse_seconds += NodeStats::now() - start;
+      ++stats->parses;
+      if (callback == NULL) {
+        stats->countTree(program);
+      }
+    }
+  } catch (...) {
+    // Bison has freed everything it was still holding, but what parsed before
+    // the error is in `program`. ~NodeProgram won't run if it's being
+    // constructed, so that goes here, along with the arena.
+    extra->atoms = NULL;
+    extra->arena = NULL;
+    extra->statement_callback = NULL;
+    while (program->childNodes().size() > children) {
+      delete program->removeChild(node_list_t::iterator(&program->childNodes(), children));
+    }
+    program->releaseArena();
+    throw;
+  }
+  extra->atoms = NULL;
+  extra->arena = NULL;
+  extra->statement_callback = NULL;
+}
+
+const vector<ParseException>& Parser::errors() const {
+  return _extra->errors;
+}
+
+//
+// Regular files are mapped and scanned like an in-memory source: in place by
+// PARSE_FAST_LEXER, copied through flex's bounded window otherwise. Anything
+// else goes through stdio
+void Parser::parseStreamInto(NodeProgram* program, FILE* file, node_parse_enum opts,
+  statement_callback_t callback /* = NULL */, void* context /* = NULL */) {
+  struct stat st;
+  long pos;
+  if (fstat(fileno(file), &st) == 0 && S_ISREG(st.st_mode) &&
+      (pos = ftell(file)) >= 0 && pos <= st.st_size) {
+    size_t len = st.st_size - pos;
+    void* map = len ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0) : NULL;
+    if (map != MAP_FAILED) {
+      try {
+        this->parseInto(program, map ? static_cast<const char*>(map) + pos : "", len, NULL, opts, callback, context);
+      } catch (...) {
+        if (map) {
+          munmap(map, st.st_size);
+        }
+        throw;
+      }
+      if (map) {
+        munmap(map, st.st_size);
+      }
+      fseek(file, 0, SEEK_END);
+      return;
+    }
+  }
+  this->parseInto(program, NULL, 0, file, opts, callback, context); // read from file
+}
+
+NodeProgram* Parser::parse(const char* code, node_parse_enum opts /* = PARSE_NONE */) {
+  return this->parse(code, strlen(code), opts);
+}
+
+NodeProgram* Parser::parse(const char* data, size_t len, node_parse_enum opts /* = PARSE_NONE */) {
+  auto_ptr<NodeProgram> program(new NodeProgram());
+  this->parseInto(program.get(), data, len, NULL, opts);
+  return program.release();
+}
+
+NodeProgram* Parser::parse(FILE* file, node_parse_enum opts /* = PARSE_NONE */) {
+  auto_ptr<NodeProgram> program(new NodeProgram());
+  this->parseStreamInto(program.get(), file, opts);
+  return program.release();
+}
+
+//
+// The statements go to the callback, so the program they'd have been parsed
+// into only ever holds an empty statement list
+void Parser::parseStatements(const char* data, size_t len, statement_callback_t callback, void* context,
+  node_parse_enum opts /* = PARSE_NONE */) {
+  NodeProgram program;
+  this->parseInto(&program, data, len, NULL, static_cast<node_parse_enum>(opts & ~PARSE_ARENA), callback, context);
+}
+
+void Parser::parseStatements(FILE* file, statement_callback_t callback, void* context,
+  node_parse_enum opts /* = PARSE_NONE */) {
+  NodeProgram program;
+  this->parseStreamInto(&program, file, static_cast<node_parse_enum>(opts & ~PARSE_ARENA), callback, context);
+}
+
+//
+// Parse the file at `path`. Caller owns the returned program.
+NodeProgram* Parser::parseFile(const char* path, node_parse_enum opts /* = PARSE_NONE */) {
+  FILE* file = fopen(path, "r");
+  if (file == NULL) {
+    throw runtime_error(string("unable to open ") + path + ": " + strerror(errno));
+  }
+  NodeProgram* program;
+  try {
+    program = this->parse(file, opts);
+  } catch (...) {
+    fclose(file);
+    throw;
+  }
+  fclose(file);
+  return program;
+}
+
+//
+// Incremental reparsing. An edit replaces `removed` bytes at `offset` of the
+// old source; everything here is in old source coordinates unless noted.
+struct fbjs_edit_t {
+  size_t offset;
+  size_t end;
+  size_t delta;
+  unsigned int line;
+  unsigned int line_delta;
+  unsigned int column_delta;
+};
+
+static unsigned int fbjs_count_lines(const char* begin, const char* end) {
+  unsigned int lines = 0;
+  while ((begin = static_cast<const char*>(memchr(begin, '\n', end - begin))) != NULL) {
+    ++lines;
+    ++begin;
+  }
+  return lines;
+}
+
+//
+// Where the first backslash ending a line is, or npos. In a string literal
+// that continues the string on the next line, and the lexer doesn't count
+// that line break, so lines counted with fbjs_count_lines() go wrong after it.
+static size_t fbjs_find_line_continuation(const string& text) {
+  for (size_t ii = text.find('\\'); ii != string::npos; ii = text.find('\\', ii + 1)) {
+    if (text.compare(ii + 1, 1, "\n") == 0 || text.compare(ii + 1, 2, "\r\n") == 0) {
+      return ii;
+    }
+  }
+  return string::npos;
+}
+
+static size_t fbjs_line_start(const string& text, size_t offset) {
+  size_t newline = offset ? text.rfind('\n', offset - 1) : string::npos;
+  return newline == string::npos ? 0 : newline + 1;
+}
+
+//
+// Column of the byte at `offset` in UTF-16 units, the way the lexer counts it
+static unsigned int fbjs_column(const string& text, size_t offset) {
+  unsigned int column = 0;
+  for (size_t ii = fbjs_line_start(text, offset); ii < offset; ++ii) {
+    unsigned char c = text[ii];
+    column += ((c & 0xc0) != 0x80) + ((c & 0xf8) == 0xf0);
+  }
+  return column;
+}
+
+//
+// Where the first token at or after `offset` starts, skipping whitespace and
+// comments the way the lexer does. The end of the text if there isn't one.
+static size_t fbjs_next_token(const string& text, size_t offset) {
+  while (offset < text.size()) {
+    char c = text[offset];
+    if (c == ' ' || c == '\t' || c == '\v' || c == '\f' || c == '\r' || c == '\n' || c == '\xa0') {
+      ++offset;
+    } else if (text.compare(offset, 2, "//") == 0 || text.compare(offset, 4, "<!--") == 0) {
+      offset = text.find('\n', offset);
+      if (offset == string::npos) {
+        return text.size();
+      }
+    } else if (text.compare(offset, 2, "/*") == 0) {
+      offset = text.find("*/", offset + 2);
+      if (offset == string::npos) {
+        return text.size();
+      }
+      offset += 2;
+    } else {
+      break;
+    }
+  }
+  return offset;
+}
+
+//
+// Does this statement end with a `}' that nothing after it could extend? An
+// expression statement ending in a function literal without a semicolon would
+// turn into a call if the next line started with `('.
+static bool fbjs_ends_with_block(const Node* node) {
+  switch (node->kind()) {
+    case KIND_STATEMENT_LIST:
+    case KIND_FUNCTION_DECLARATION:
+    case KIND_SWITCH:
+    case KIND_TRY:
+      return true;
+
+    case KIND_IF:
+    case KIND_WITH:
+    case KIND_LABEL:
+    case KIND_FOR_LOOP:
+    case KIND_FOR_IN:
+    case KIND_FOR_EACH_IN:
+    case KIND_WHILE:
+      for (size_t ii = node->childNodes().size(); ii > 0; --ii) {
+        if (node->childNodes()[ii - 1] != NULL) {
+          return fbjs_ends_with_block(node->childNodes()[ii - 1]);
+        }
+      }
+      return false;
+
+    default:
+      return false;
+  }
+}
+
+//
+// Does a regex literal start in [from, to)? The lexer takes the longest regex
+// it can find on a line, so one on the line a fragment starts or ends on might
+// run into or past the fragment in the whole source.
+static bool fbjs_has_regex_between(const Node* node, size_t from, size_t to) {
+  if (node->hasSourceRange() && (node->sourceEnd() <= from || node->sourceBegin() >= to)) {
+    return false;
+  } else if (node->kind() == KIND_REGEX_LITERAL && node->sourceBegin() >= from) {
+    return true;
+  }
+  for (node_list_t::const_iterator ii = node->childNodes().begin(); ii != node->childNodes().end(); ++ii) {
+    if (*ii != NULL && fbjs_has_regex_between(*ii, from, to)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+//
+// A switch keeps its clauses in a statement list too, along with the lists of
+// statements under them, and none of those are statements
+static bool fbjs_is_case_block(const Node* list) {
+  for (node_list_t::const_iterator ii = list->childNodes().begin(); ii != list->childNodes().end(); ++ii) {
+    if (*ii != NULL && ((*ii)->kind() == KIND_CASE_CLAUSE || (*ii)->kind() == KIND_DEFAULT_CLAUSE)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+//
+// Every ranged node containing the edit, outermost first, as (parent, index)
+static void fbjs_find_reparse_sites(Node* node, const fbjs_edit_t& edit, vector<pair<Node*, size_t> >& sites) {
+  node_list_t& children = node->childNodes();
+  for (size_t ii = 0; ii < children.size(); ++ii) {
+    Node* child = children[ii];
+    if (child == NULL) {
+      continue;
+    }
+    if (child->hasSourceRange()) {
+      if (child->sourceBegin() > edit.offset || child->sourceEnd() < edit.end) {
+        continue;
+      }
+      sites.push_back(make_pair(node, ii));
+    }
+    fbjs_find_reparse_sites(child, edit, sites);
+  }
+}
+
+//
+// Moves a subtree parsed on its own, from `skip` bytes into what was parsed,
+// to `offset` in the new source. Its first line starts `column` bytes into a
+// line there.
+static void fbjs_place_subtree(Node* node, size_t skip, size_t offset, unsigned int lines, unsigned int column) {
+  if (node->hasSourceRange()) {
+    node->setSourceRange(node->sourceBegin() - skip + offset, node->sourceEnd() - skip + offset);
+  }
+  if (node->sourceLine()) {
+    node->setSourcePosition(node->sourceLine() + lines,
+      node->sourceLine() == 1 ? node->sourceColumn() - skip + column : node->sourceColumn());
+  }
+  node->setLineno(node->lineno() + lines);
+  for (node_list_t::iterator ii = node->childNodes().begin(); ii != node->childNodes().end(); ++ii) {
+    if (*ii != NULL) {
+      fbjs_place_subtree(*ii, skip, offset, lines, column);
+    }
+  }
+}
+
+//
+// Gives the nodes with line number `from` line number `to` instead
+static void fbjs_move_lineno(Node* node, unsigned int from, unsigned int to) {
+  if (node->lineno() == from) {
+    node->setLineno(to);
+  }
+  for (node_list_t::iterator ii = node->childNodes().begin(); ii != node->childNodes().end(); ++ii) {
+    if (*ii != NULL) {
+      fbjs_move_lineno(*ii, from, to);
+    }
+  }
+}
+
+//
+// A node's line number is the line of the last token the parser had read when
+// it was made, which may be the one after the node. Nodes ending before the
+// edit read no further than the statement being reparsed starts, and nodes
+// after it read tokens after it. That leaves the nodes around the edit and
+// those without a range: on the edit's line there is no telling which side of
+// it their token was. Returns whether every line number can be shifted right.
+static bool fbjs_shift_is_exact(const Node* node, const Node* skip, const fbjs_edit_t& edit) {
+  if (node == skip) {
+    return true;
+  }
+  if (node->hasSourceRange() && (node->sourceEnd() <= edit.offset || node->sourceBegin() >= edit.end)) {
+    return true;
+  }
+  if (node->lineno() == edit.line && edit.line_delta) {
+    return false;
+  }
+  for (node_list_t::const_iterator ii = node->childNodes().begin(); ii != node->childNodes().end(); ++ii) {
+    if (*ii != NULL && !fbjs_shift_is_exact(*ii, skip, edit)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//
+// Shifts the ranges and line numbers of nodes the edit moved, see
+// fbjs_shift_is_exact. Everything inside a node after the edit is after it
+// too. The subtree at `skip` is about to be replaced so its children are left
+// alone.
+static void fbjs_shift_subtree(Node* node, const Node* skip, const fbjs_edit_t& edit, bool after = false) {
+  if (!after && node->hasSourceRange()) {
+    if (node->sourceEnd() <= edit.offset) {
+      return;
+    }
+    after = node->sourceBegin() >= edit.end;
+  }
+  if (node->hasSourceRange()) {
+    size_t begin = node->sourceBegin(), end = node->sourceEnd();
+    if (after) {
+      node->setSourceRange(begin + edit.delta, end + edit.delta);
+      node->setSourcePosition(node->sourceLine() + edit.line_delta,
+        node->sourceColumn() + (node->sourceLine() == edit.line ? edit.column_delta : 0));
+    } else {
+      node->setSourceRange(begin, end + edit.delta);
+    }
+  }
+  if (node->lineno() > edit.line || (after && node->lineno() == edit.line)) {
+    node->setLineno(node->lineno() + edit.line_delta);
+  }
+  if (node == skip) {
+    return;
+  }
+  for (node_list_t::iterator ii = node->childNodes().begin(); ii != node->childNodes().end(); ++ii) {
+    if (*ii != NULL) {
+      fbjs_shift_subtree(*ii, skip, edit, after);
+    }
+  }
+}
+
+//
+// Parses `len` bytes of `data` on their own and hands back the statement list,
+// or NULL if they don't parse.
+Node* Parser::parseFragment(const char* data, size_t len, node_parse_enum opts) {
+  NodeProgram program;
+  try {
+    this->parseInto(&program, data, len, NULL, static_cast<node_parse_enum>(opts & ~PARSE_ARENA));
+  } catch (ParseException& e) {
+    return NULL;
+  }
+  if (program.childNodes().size() != 1) {
+    return NULL;
+  }
+  return program.removeChild(program.childNodes().begin());
+}
+
+//
+// Reparses a statement of a statement list in place, if that would give the
+// same tree as reparsing everything. Returns the new statement or NULL, and in
+// `list_lineno` the line number of a statement list made along with it.
+Node* Parser::reparseStatement(Node* statement, const string& source, const string& text,
+  size_t offset, size_t removed, node_parse_enum opts, unsigned int& list_lineno) {
+  size_t begin = statement->sourceBegin(), end = statement->sourceEnd();
+  if (offset <= begin || offset + removed >= end || end > source.size()) {
+    return NULL;
+  }
+
+  // The statement has to keep its explicit terminator, otherwise semicolon
+  // insertion could join it with whatever follows
+  char terminator = source[end - 1];
+  if (terminator != ';' && terminator != '}') {
+    return NULL;
+  }
+
+  // It's parsed in a block whose `}' is on a line of its own: a string or
+  // comment running past the statement would take the `}' with it, and
+  // without its terminator the statement would end at the `}' instead
+  size_t len = end + text.size() - source.size() - begin;
+  string block("{");
+  block.append(text, begin, len);
+  block.append("\n}");
+  auto_ptr<Node> list(this->parseFragment(block.data(), block.size(), opts));
+  if (list.get() == NULL || list->childNodes().size() != 1 || list->childNodes().front()->childNodes().size() != 1) {
+    return NULL;
+  }
+  Node* inner = list->childNodes().front();
+  Node* replacement = inner->childNodes().front();
+  if (replacement->sourceEnd() != 1 + len || (terminator == '}' && !fbjs_ends_with_block(replacement))) {
+    return NULL;
+  }
+  inner->removeChild(inner->childNodes().begin());
+
+  // Whatever looked past the statement read the `}', where the whole source
+  // has the next token. The block's list was made with the statement.
+  size_t next = fbjs_next_token(text, begin + len);
+  unsigned int from = 2 + fbjs_count_lines(block.data(), block.data() + block.size() - 2);
+  unsigned int to = 1 + fbjs_count_lines(text.data() + begin, text.data() + next);
+  unsigned int lines = fbjs_count_lines(text.data(), text.data() + begin);
+  fbjs_move_lineno(replacement, from, to);
+  list_lineno = (inner->lineno() == from ? to : inner->lineno()) + lines;
+  fbjs_place_subtree(replacement, 1, begin, lines, fbjs_column(text, begin));
+  if (fbjs_has_regex_between(replacement, fbjs_line_start(text, begin + len - 1), begin + len)) {
+    delete replacement;
+    return NULL;
+  }
+  return replacement;
+}
+
+//
+// Reparses a function's body, braces and all, so that a string or comment
+// can't run past it. Returns the new body or NULL.
+Node* Parser::reparseBody(Node* body, const string& source, const string& text,
+  size_t offset, size_t removed, node_parse_enum opts) {
+  size_t begin = body->sourceBegin(), end = body->sourceEnd();
+  if (offset <= begin || offset + removed >= end || end > source.size()) {
+    return NULL;
+  }
+  size_t len = end + text.size() - source.size() - begin;
+  auto_ptr<Node> list(this->parseFragment(text.data() + begin, len, opts));
+  if (list.get() == NULL || list->childNodes().size() != 1 ||
+      list->childNodes().front()->kind() != KIND_STATEMENT_LIST || list->childNodes().front()->sourceEnd() != len) {
+    return NULL;
+  }
+  Node* replacement = list->removeChild(list->childNodes().begin());
+  fbjs_place_subtree(replacement, 0, begin, fbjs_count_lines(text.data(), text.data() + begin), fbjs_column(text, begin));
+  if (fbjs_has_regex_between(replacement, fbjs_line_start(text, begin + len - 1), begin + len)) {
+    delete replacement;
+    return NULL;
+  }
+  return replacement;
+}
+
+//
+// Applies an edit to `source`, the text `program` was parsed from, and brings
+// `program` up to date with it. Only the innermost statement or function body
+// containing the edit is reparsed when it can be done without changing the
+// result, otherwise the whole program is. Returns the node that was replaced
+// in the tree, or `program` itself. Throws ParseException if the new source
+// doesn't parse, in which case neither `program` nor `source` is changed.
+// PARSE_RECOVER is ignored.
+Node* Parser::reparse(NodeProgram* program, string& source, size_t offset, size_t removed,
+  const string& inserted, node_parse_enum opts /* = PARSE_NONE */) {
+  if (offset > source.size() || removed > source.size() - offset) {
+    throw out_of_range("edit is outside of the source");
+  }
+  opts = static_cast<node_parse_enum>(opts & ~PARSE_RECOVER);
+  string text(source, 0, offset);
+  text.append(inserted);
+  text.append(source, offset + removed, string::npos);
+
+  fbjs_edit_t edit;
+  edit.offset = offset;
+  edit.end = offset + removed;
+  edit.delta = inserted.size() - removed;
+  edit.line = 1 + fbjs_count_lines(source.data(), source.data() + edit.end);
+  edit.line_delta = fbjs_count_lines(inserted.data(), inserted.data() + inserted.size()) -
+    fbjs_count_lines(source.data() + offset, source.data() + edit.end);
+  edit.column_delta = fbjs_column(text, offset + inserted.size()) - fbjs_column(source, edit.end);
+
+  size_t continued = fbjs_find_line_continuation(source), text_continued = fbjs_find_line_continuation(text);
+
+  vector<pair<Node*, size_t> > sites;
+  fbjs_find_reparse_sites(program, edit, sites);
+  for (vector<pair<Node*, size_t> >::reverse_iterator ii = sites.rbegin(); ii != sites.rend(); ++ii) {
+    Node* parent = ii->first;
+    node_list_t::iterator pos(&parent->childNodes(), ii->second);
+    Node* node = *pos;
+    Node* replacement = NULL;
+    unsigned int list_lineno = 0;
+    if (fbjs_has_regex_between(program, fbjs_line_start(source, node->sourceBegin()), node->sourceBegin())) {
+      // A regex before it on the same line might now run into it
+    } else if (continued < node->sourceEnd() || text_continued < node->sourceEnd() + edit.delta) {
+      // Its lines, or those before it, can't be counted by '\n's
+    } else if (parent->kind() == KIND_STATEMENT_LIST && !fbjs_is_case_block(parent)) {
+      replacement = this->reparseStatement(node, source, text, offset, removed, opts, list_lineno);
+    } else if ((parent->kind() == KIND_FUNCTION_DECLARATION || parent->kind() == KIND_FUNCTION_EXPRESSION) &&
+        ii->second == 2) {
+      replacement = this->reparseBody(node, source, text, offset, removed, opts);
+    }
+    if (replacement == NULL) {
+      continue;
+    }
+    bool exact = true;
+    for (node_list_t::iterator jj = program->childNodes().begin(); jj != program->childNodes().end(); ++jj) {
+      exact = exact && fbjs_shift_is_exact(*jj, node, edit);
+    }
+    if (!exact) {
+      delete replacement;
+      continue;
+    }
+    // A statement list is made when its first statement is reduced, after
+    // the same lookahead; the top level's starts at that statement, a block's
+    // at its `{'
+    size_t list_begin = parent->sourceBegin();
+    bool made_with = ii->second == 0 && parent->hasSourceRange() && (list_begin == node->sourceBegin() ||
+      (source[list_begin] == '{' && fbjs_next_token(source, list_begin + 1) == node->sourceBegin()));
+    for (node_list_t::iterator jj = program->childNodes().begin(); jj != program->childNodes().end(); ++jj) {
+      fbjs_shift_subtree(*jj, node, edit);
+    }
+    delete parent->replaceChild(replacement, pos);
+    if (list_lineno && made_with) {
+      parent->setLineno(list_lineno);
+    }
+
+    // A function expression with no name or parameters has its body's line
+    if (parent->kind() == KIND_FUNCTION_EXPRESSION && parent->childNodes()[0] == NULL &&
+        parent->childNodes()[1]->childNodes().empty()) {
+      parent->setLineno(replacement->lineno());
+    }
+    program->setSourceRange(0, text.size());
+    source.swap(text);
+    return replacement;
+  }
+
+  // Nothing smaller would do, swap in a whole new tree
+  NodeProgram replacement;
+  this->parseInto(&replacement, text.data(), text.size(), NULL, opts);
+  program->invalidateHash();
+  node_list_t children(program->_childNodes);
+  program->_childNodes = replacement._childNodes;
+  replacement._childNodes = children;
+  swap(program->_arena, replacement._arena);
+  swap(program->_atoms, replacement._atoms);
+  program->setSourceRange(0, text.size());
+  source.swap(text);
+  return program;
 }
 
 //
 // Parse from a file
-NodeProgram::NodeProgram(FILE* file, node_parse_enum opts /* = PARSE_NONE */) : Node(1) {
-  fbjs_parse_extra extra;
-  void* scanner = fbjs_init_parser(&extra);
-  extra.opts = opts;
-  yyrestart(file, scanner); // read from file
-  yyparse(scanner, this);
-  fbjs_cleanup_parser(&extra, scanner);
-}
-
-//
-// Parser from a string
-NodeProgram::NodeProgram(const char* str, node_parse_enum opts /* = PARSE_NONE */) : Node(1) {
-  fbjs_parse_extra extra;
-  void* scanner = fbjs_init_parser(&extra);
-  extra.opts = opts;
-  yy_scan_string(str, scanner); // read from string
-  yyparse(scanner, this);
-  fbjs_cleanup_parser(&extra, scanner);
+NodeProgram::NodeProgram(FILE* file, node_parse_enum opts /* = PARSE_NONE */) : Node(1, KIND_PROGRAM), _arena(NULL), _atoms(NULL) {
+  Parser parser;
+  parser.parseStreamInto(this, file, opts);
+}
+
+//
+// Parse from a string
+NodeProgram::NodeProgram(const char* str, node_parse_enum opts /* = PARSE_NONE */) : Node(1, KIND_PROGRAM), _arena(NULL), _atoms(NULL) {
+  Parser parser;
+  parser.parseInto(this, str, strlen(str), NULL, opts);
+}
+
+//
+// Parse from a buffer owned by the caller, which need not be NUL terminated
+NodeProgram::NodeProgram(const char* data, size_t len, node_parse_enum opts /* = PARSE_NONE */) : Node(1, KIND_PROGRAM), _arena(NULL), _atoms(NULL) {
+  Parser parser;
+  parser.parseInto(this, data, len, NULL, opts);
+}
+
+//
+// Parse the file at `path`. Caller owns the returned program.
+NodeProgram* NodeProgram::parseFile(const char* path, node_parse_enum opts /* = PARSE_NONE */) {
+  Parser parser;
+  return parser.parseFile(path, opts);
 }
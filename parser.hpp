@@ -21,7 +21,9 @@
 #pragma once
 #include <stdio.h>
 #include <string.h>
+#include <deque>
 #include <stack>
+#include <utility>
 
 //#define DEBUG_FLEX
 //#define DEBUG_BISON
@@ -31,6 +33,23 @@
 
 #include "node.hpp"
 
+// Bison's default location plus the byte range of the token or rule, which is
+// [first_byte, last_byte). first_line doubles as the lexer's running line count
+// and first_column is where first_byte is on its line, in UTF-16 units like
+// JavaScript's own columns: continuation bytes add nothing and 4-byte
+// sequences add 2.
+struct fbjs_location_t {
+  int first_line;
+  int first_column;
+  int last_line;
+  int last_column;
+  size_t first_byte;
+  size_t last_byte;
+};
+#define YYLTYPE fbjs_location_t
+#define YYLTYPE_IS_DECLARED 1
+#define YYLTYPE_IS_TRIVIAL 1
+
 #ifdef NOT_FBMAKE
 #include "parser.yacc.hpp"
 #else
@@ -41,6 +60,7 @@ struct fbjs_parse_extra {
   char* error;
   int error_line;
   bool terminated;
+  std::vector<fbjs::ParseException> errors;
   std::stack<int> paren_stack;
   std::stack<int> curly_stack;
   std::stack<int> pre_xml_stack;
@@ -51,8 +71,60 @@ struct fbjs_parse_extra {
   int last_curly_tok;
   int lineno;
   fbjs::node_parse_enum opts;
+  fbjs::NodeArena* arena;
+  fbjs::NodeAtomTable* atoms;
+  const char* input;
+  size_t input_length;
+  size_t input_pos;
+  const char* window;
+  size_t window_offset;
+  std::deque<size_t> newlines;
+  std::deque<std::pair<size_t, int> > column_shifts;
+  size_t line_start;
+  size_t column_pos;
+  int line_shift;
+  bool fast_lexer;
+  fbjs::NodeStats* stats;
+  fbjs::Parser::statement_callback_t statement_callback;
+  void* statement_context;
 };
 
+// Feeds the scanner from extra->input if it is set, otherwise from the FILE.
+// Either way flex gets a copy, one buffer-sized window at a time.
+#define YY_INPUT(buf, result, max_size) result = fbjs_read_input(yyextra, buf, max_size, yyin)
+size_t fbjs_read_input(fbjs_parse_extra* extra, char* buf, size_t max_size, FILE* file);
+
+// Whatever flex keeps in its buffer is one contiguous run of the input, so the
+// position of the last chunk read maps any pointer into it to a byte offset.
+inline size_t fbjs_input_offset(const fbjs_parse_extra* extra, const char* ptr) {
+  return extra->window_offset + (ptr - extra->window);
+}
+int fbjs_input_column(fbjs_parse_extra* extra, size_t offset);
+int fbjs_input_memory_column(fbjs_parse_extra* extra, size_t line_start, size_t offset);
+
+// The start conditions lexer.cpp handles, in flex's numbering; parser.ll checks
+// they agree. With extra->fast_lexer set yylex() goes to fbjs_fast_lex() first.
+enum fbjs_lex_state_enum {
+  FBJS_LEX_INITIAL,
+  FBJS_LEX_IDENTIFIER,
+  FBJS_LEX_DOT,
+  FBJS_LEX_VIRTUAL_SEMICOLON,
+  FBJS_LEX_NO_LINEBREAK,
+  FBJS_LEX_REGEX,
+};
+int fbjs_lexer_start(void* scanner);
+void fbjs_lexer_begin(void* scanner, int state);
+bool fbjs_fast_lex(void* scanner, fbjs_parse_extra* extra, YYSTYPE* yylval, YYLTYPE* yylloc, int* tok);
+
+// The node_parse_enum options the grammar was built to parse, see parser.yy
+extern const int fbjs_grammar_features;
+
+// A scanner and its fbjs_parse_extra belong to one thread at a time; apart
+// from yydebug (DEBUG_BISON only) there is no global flex or bison state.
+void* fbjs_init_parser(fbjs_parse_extra* extra);
+void fbjs_reset_parser(fbjs_parse_extra* extra, void* scanner);
+void fbjs_reset_lexer(void* scanner);
+
 // Why the hell doesn't flex provide a header file?
 // edit: actually I think it does I just can't find it on this damn system.
 int yylex(YYSTYPE* param, YYLTYPE* yylloc, void* scanner);
@@ -65,6 +137,3 @@ void yyset_debug(int bdebug, void* yyscanner);
 void yyrestart(FILE* input_file, void* yyscanner);
 int yyparse(void* yyscanner, fbjs::Node* root);
 const char* yytokname(int tok);
-#ifndef FLEX_SCANNER
-void* yy_scan_string(const char *yy_str, void* yyscanner);
-#endif
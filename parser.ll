@@ -23,6 +23,7 @@
 
 #ifdef NOT_FBMAKE
 #include "parser.hpp"
+#include "stats.hpp"
 #else
 /**
  * This is a temporary workaround a drawback of fbconfig/fbmake.
@@ -33,6 +34,7 @@
  *   fbmake dbg CXX_FLAGS=-I./libfbjs
  */
 #include "libfbjs/parser.hpp"
+#include "libfbjs/stats.hpp"
 #endif
 
 using namespace fbjs;
@@ -60,12 +62,14 @@ using namespace fbjs;
     case REGEX: \
       fprintf(stderr, "BEGIN(REGEX)\n"); \
       break; \
+/* FBJS_E4X { */ \
     case XML: \
       fprintf(stderr, "BEGIN(XML)\n"); \
       break; \
     case XML_CDATA: \
       fprintf(stderr, "BEGIN(XML_CDATA)\n"); \
       break; \
+/* } FBJS_E4X */ \
     default: \
       fprintf(stderr, "BEGIN(%d)\n", a); \
   } \
@@ -77,6 +81,10 @@ using namespace fbjs;
 #define parsertok(a) parsertok_(yyg, a);
 #define parsertok_xml(a) parsertok_(yyg, a, true);
 
+// The scanner proper, yylex() wraps it to record where each token came from
+#define YY_DECL int fbjs_lex(YYSTYPE* yylval_param, YYLTYPE* yylloc_param, void* yyscanner)
+YY_DECL;
+
 int parsertok_(void*, int, bool = false);
 void terminate(void* yyscanner, const char* str);
 %}
@@ -91,9 +99,11 @@ void terminate(void* yyscanner, const char* str);
 %x VIRTUAL_SEMICOLON
 %s NO_LINEBREAK
 %x REGEX
+/* FBJS_E4X { */
 %x XML
 %x XML_CDATA
 %x XML_PI
+/* } FBJS_E4X */
 FBJSBEGIN(IDENTIFIER);
 
 /* ECMA-262 and ECMA-357 disagree on the definition of whitespace. Note: both
@@ -203,6 +213,7 @@ XML_WHITESPACE [ \t\r]*
   "case"  return parsertok(t_CASE);
   "continue"  return parsertok(t_CONTINUE);
   "default"  return parsertok(t_DEFAULT);
+  /* FBJS_E4X { */
   "default"({JS_WHITESPACE}|\n)+"xml"({JS_WHITESPACE}|\n)+"namespace" {
     while (*++yytext) {
       if (*yytext == '\n') {
@@ -211,10 +222,12 @@ XML_WHITESPACE [ \t\r]*
     }
     return parsertok(t_XML_DEFAULT_NAMESPACE);
   }
+  /* } FBJS_E4X */
   "delete"  return parsertok(t_DELETE);
   "do"  return parsertok(t_DO);
   "else"  return parsertok(t_ELSE);
   "for"  return parsertok(t_FOR);
+  /* FBJS_E4X { */
   "for"({JS_WHITESPACE}|\n)+"each" {
     while (*++yytext) {
       if (*yytext == '\n') {
@@ -223,6 +236,7 @@ XML_WHITESPACE [ \t\r]*
     }
     return parsertok(t_FOR_EACH);
   }
+  /* } FBJS_E4X */
   "function" return parsertok(t_FUNCTION);
   "if"  return parsertok(t_IF);
   "new"  return parsertok(t_NEW);
@@ -266,7 +280,7 @@ XML_WHITESPACE [ \t\r]*
   return parsertok(t_NUMBER);
 }
 <INITIAL,IDENTIFIER,DOT>[a-zA-Z$_][a-zA-Z$_0-9]* {
-  yylval->string = strdup(yytext);
+  yylval->atom = yyextra->atoms->intern(yytext, yyleng);
   return parsertok(t_IDENTIFIER);
 }
 <DOT>{
@@ -310,7 +324,8 @@ XML_WHITESPACE [ \t\r]*
       break;
     }
   }
-  yylval->string = strdup(str.c_str());
+  yylval->atom_duple[0] = yyextra->atoms->intern(str);
+  yylval->atom_duple[1] = yyextra->atoms->intern(NodeStringLiteral::decode(str.data(), str.size()));
   return parsertok(t_STRING);
 }
 <IDENTIFIER>"/" FBJSBEGIN(REGEX);
@@ -322,13 +337,10 @@ XML_WHITESPACE [ \t\r]*
       --flag_pos;
     }
     // regex
-    yylval->string_duple[0] = (char*)malloc(flag_pos + 1);
-    memcpy(yylval->string_duple[0], yytext, flag_pos);
-    yylval->string_duple[0][flag_pos] = 0;
+    yylval->atom_duple[0] = yyextra->atoms->intern(yytext, flag_pos);
 
     // flags
-    yylval->string_duple[1] = (char*)malloc(len - flag_pos);
-    memcpy(yylval->string_duple[1], yytext + flag_pos + 1, len - flag_pos);
+    yylval->atom_duple[1] = yyextra->atoms->intern(yytext + flag_pos + 1, len - flag_pos - 1);
 
     return parsertok(t_REGEX);
   }
@@ -409,6 +421,7 @@ XML_WHITESPACE [ \t\r]*
 "!"    return parsertok(t_NOT);
 "~"    return parsertok(t_BIT_NOT);
 "="    return parsertok(t_ASSIGN);
+  /* FBJS_E4X { */
 "@"    return parsertok(t_XML_ATTRIBUTE);
 ".."   return parsertok(t_XML_DESCENDENT);
 "::"   return parsertok(t_XML_QUALIFIER);
@@ -514,6 +527,7 @@ XML_WHITESPACE [ \t\r]*
     return t_XML_PI;
   }
 }
+  /* } FBJS_E4X */
 \n {
   ++yylloc->first_line;
   if (yyextra->last_tok == t_IDENTIFIER || yyextra->last_tok == t_NUMBER || yyextra->last_tok == t_STRING ||
@@ -542,7 +556,10 @@ XML_WHITESPACE [ \t\r]*
 
 int parsertok_(void* guts, int tok, bool was_xml) {
   yyguts_t *yyg = (struct yyguts_t*)guts;
-  if (YY_START != XML) {
+  /* FBJS_E4X { */
+  if (YY_START != XML)
+  /* } FBJS_E4X */
+  {
   switch (tok) {
     case t_IDENTIFIER:
     case t_NUMBER:
@@ -583,6 +600,7 @@ int parsertok_(void* guts, int tok, bool was_xml) {
   return tok;
 }
 
+/* FBJS_E4X { */
 void fbjs_push_xml_state(void* guts) {
   yyguts_t *yyg = static_cast<yyguts_t*>(guts);
   yyextra->pre_xml_stack.push(YY_START);
@@ -600,3 +618,73 @@ void fbjs_pop_xml_state(void* guts) {
   FBJSBEGIN(yyextra->pre_xml_stack.top());
   yyextra->pre_xml_stack.pop();
 }
+/* } FBJS_E4X */
+
+//
+// Every token reaches bison through yylex(). The range runs from yytext to where
+// the scanner stopped, so it covers text eaten with yyinput() and leaves out
+// anything given back with yyless(); a virtual semicolon comes out empty.
+static int fbjs_next_token(YYSTYPE* yylval_param, YYLTYPE* yylloc_param, void* guts) {
+  yyguts_t *yyg = static_cast<yyguts_t*>(guts);
+  int tok;
+  bool fresh = false;
+  int line = yylloc_param->first_line;
+  if (yyextra->fast_lexer) {
+    if (fbjs_fast_lex(guts, yyextra, yylval_param, yylloc_param, &tok)) {
+      return tok;
+    }
+
+    // Flex picks up at input_pos for the rest of the parse
+    yyextra->fast_lexer = false;
+    fresh = !yyg->yy_init;
+  }
+  tok = fbjs_lex(yylval_param, yylloc_param, guts);
+  if (fresh) {
+    // YY_USER_INIT just reset the line count
+    yylloc_param->first_line += line - 1;
+  }
+  yylloc_param->last_byte = fbjs_input_offset(yyextra, yyg->yy_c_buf_p);
+  yylloc_param->first_byte = tok ? fbjs_input_offset(yyextra, yytext) : yylloc_param->last_byte;
+  if (tok == t_REGEX) {
+    // The literal starts at the '/' that got us to REGEX
+    --yylloc_param->first_byte;
+  }
+  yylloc_param->first_column = fbjs_input_column(yyextra, yylloc_param->first_byte);
+  return tok;
+}
+
+int yylex(YYSTYPE* yylval_param, YYLTYPE* yylloc_param, void* guts) {
+  yyguts_t *yyg = static_cast<yyguts_t*>(guts);
+  NodeStats* stats = yyextra->stats;
+  if (stats == NULL) {
+    return fbjs_next_token(yylval_param, yylloc_param, guts);
+  }
+  double start = NodeStats::now();
+  int tok = fbjs_next_token(yylval_param, yylloc_param, guts);
+  stats->lex_seconds += NodeStats::now() - start;
+  stats->tokens += tok != 0;
+  return tok;
+}
+
+void fbjs_reset_lexer(void* guts) {
+  yyguts_t *yyg = static_cast<yyguts_t*>(guts);
+  BEGIN(INITIAL);
+}
+
+// lexer.cpp shares flex's start conditions, so they had better line up
+typedef char fbjs_lex_state_check[INITIAL == FBJS_LEX_INITIAL && IDENTIFIER == FBJS_LEX_IDENTIFIER &&
+  DOT == FBJS_LEX_DOT && VIRTUAL_SEMICOLON == FBJS_LEX_VIRTUAL_SEMICOLON &&
+  NO_LINEBREAK == FBJS_LEX_NO_LINEBREAK && REGEX == FBJS_LEX_REGEX ? 1 : -1];
+/* FBJS_E4X { */
+typedef char fbjs_lex_xml_state_check[XML > REGEX && XML_CDATA > REGEX && XML_PI > REGEX ? 1 : -1];
+/* } FBJS_E4X */
+
+int fbjs_lexer_start(void* guts) {
+  yyguts_t *yyg = static_cast<yyguts_t*>(guts);
+  return YY_START;
+}
+
+void fbjs_lexer_begin(void* guts, int state) {
+  yyguts_t *yyg = static_cast<yyguts_t*>(guts);
+  FBJSBEGIN(state);
+}
@@ -21,16 +21,19 @@
   #include <string.h>
   #ifdef NOT_FBMAKE
   #include "parser.hpp"
+  #include "stats.hpp"
   #else
   // Work around fbconfig/fbmake issue. See parser.ll for explanation
   #include "libfbjs/parser.hpp"
+  #include "libfbjs/stats.hpp"
   #endif
 %}
 
 %union {
   double number;
   char* string;
-  char* string_duple[2];
+  const std::string* atom;
+  const std::string* atom_duple[2];
   fbjs::node_assignment_t assignment;
   size_t size;
   fbjs::Node* node;
@@ -41,17 +44,59 @@
   extern int yydebug;
   using namespace fbjs;
   #define yylineno (unsigned int)(yylloc.first_line)
+  #define NODE_ARENA (yyget_extra(yyscanner)->arena)
+  #define NODE_ATOMS (NODE_ARENA ? yyget_extra(yyscanner)->atoms : NULL)
   #define parsererror(str) yyerror(&yylloc, yyscanner, NULL, str)
+
+  // Every node built by a rule is stamped with where the rule matched; a few
+  // rules widen that with NODE_RANGE, e.g. function bodies take their braces.
+  #define NODE_RANGE(node, first, last) \
+    ((node)->setSourceRange((first).first_byte, (last).last_byte), \
+     (node)->setSourcePosition((first).first_line, (first).first_column))
+  #define NODE_LOCATE(node, loc) \
+    do { \
+      if (node) { \
+        NODE_RANGE(node, loc, loc); \
+      } \
+    } while (0)
+
+  // Same as bison's, but carries the byte range along too
+  #define YYLLOC_DEFAULT(Current, Rhs, N) \
+    do { \
+      if (N) { \
+        (Current).first_line = YYRHSLOC(Rhs, 1).first_line; \
+        (Current).first_column = YYRHSLOC(Rhs, 1).first_column; \
+        (Current).first_byte = YYRHSLOC(Rhs, 1).first_byte; \
+        (Current).last_line = YYRHSLOC(Rhs, N).last_line; \
+        (Current).last_column = YYRHSLOC(Rhs, N).last_column; \
+        (Current).last_byte = YYRHSLOC(Rhs, N).last_byte; \
+      } else { \
+        (Current).first_line = (Current).last_line = YYRHSLOC(Rhs, 0).last_line; \
+        (Current).first_column = (Current).last_column = YYRHSLOC(Rhs, 0).last_column; \
+        (Current).first_byte = (Current).last_byte = YYRHSLOC(Rhs, 0).last_byte; \
+      } \
+    } while (0)
   #define require_support(flag, error) \
     if (!(yyget_extra(yyscanner)->opts & flag)) { \
       terminate(yyscanner, error); \
-      break; \
     }
 
   void fbjs_push_xml_state(void* guts);
   void fbjs_push_xml_embedded_expression_state(void* guts);
   void fbjs_pop_xml_state(void* guts);
 
+  // What this grammar parses beyond plain Javascript. `make libfbjs_js.a`
+  // builds it, and the scanner, with everything between FBJS_E4X and
+  // FBJS_TYPEHINT markers cut out; Parser throws if asked for those instead.
+  const int fbjs_grammar_features = PARSE_OBJECT_LITERAL_ELISON
+  /* FBJS_E4X { */
+    | PARSE_E4X
+  /* } FBJS_E4X */
+  /* FBJS_TYPEHINT { */
+    | PARSE_TYPEHINT
+  /* } FBJS_TYPEHINT */
+    ;
+
   void terminate(void* yyscanner, const char* str) {
     fbjs_parse_extra* extra = yyget_extra(yyscanner);
     if (!extra->terminated) {
@@ -62,8 +107,35 @@
     }
   }
 
+  // With PARSE_RECOVER a syntax error is only noted, and the `error' rule in
+  // statement picks the parse up again after the next semicolon
   void yyerror(YYLTYPE* yyloc, void* yyscanner, void* node, const char* str) {
-    terminate(yyscanner, str);
+    fbjs_parse_extra* extra = yyget_extra(yyscanner);
+    if ((extra->opts & PARSE_RECOVER) && !extra->terminated) {
+      extra->errors.push_back(ParseException(str, yyloc->first_line));
+    } else {
+      terminate(yyscanner, str);
+    }
+  }
+
+  // Adds a top-level statement to `list`, or hands it to the callback of a
+  // streaming parse. False means the callback wants the parse to stop.
+  static bool fbjs_take_statement(void* yyscanner, Node* list, Node* statement) {
+    fbjs_parse_extra* extra = yyget_extra(yyscanner);
+
+    // See statement_list
+    if (dynamic_cast<NodeEmptyExpression*>(statement) != NULL) {
+      delete statement;
+      return true;
+    }
+    if (extra->statement_callback == NULL || extra->terminated) {
+      list->appendChild(statement);
+      return true;
+    }
+    if (extra->stats) {
+      extra->stats->countTree(statement);
+    }
+    return extra->statement_callback(extra->statement_context, statement);
   }
 
 %}
@@ -74,6 +146,9 @@
 %parse-param { Node* root }
 %lex-param { void* yyscanner }
 %error-verbose
+%initial-action {
+  @$.first_byte = @$.last_byte = 0;
+}
 
 // Basic tokens
 %token t_LCURLY t_RCURLY
@@ -91,8 +166,8 @@
 
 // Tokens with a value
 %token<number> t_NUMBER
-%token<string> t_IDENTIFIER t_STRING
-%token<string_duple> t_REGEX
+%token<atom> t_IDENTIFIER
+%token<atom_duple> t_STRING t_REGEX
 %token<string> t_XML_NAME_FRAGMENT t_XML_CDATA t_XML_WHITESPACE t_XML_COMMENT t_XML_PI
 
 // Operators + associativity
@@ -128,7 +203,7 @@
 %type<size> elison
 
 // Statements
-%type<node> statement block statement_list source_element
+%type<node> statement block statement_list program_statement_list source_element
 %type<node> variable_statement variable_declaration_list variable_declaration identifier_typehint_permitted initializer
 %type<node> variable_declaration_list_no_in variable_declaration_no_in initializer_no_in
 %type<node> empty_statement expression_statement if_statement iteration_statement continue_statement break_statement return_statement with_statement switch_statement
@@ -140,6 +215,7 @@
 // Functions
 %type<node> function_expression function_declaration formal_parameter_list function_body
 
+/* FBJS_E4X { */
 // E4X / XML
 %type<node> xml_literal
 %type<node> xml_element xml_element_content xml_element_content_tag
@@ -149,18 +225,67 @@
 %type<string> xml_cdata_fragment xml_cdata_fragment_attr
 %type<node> xml_embedded_expression
 %type<node> property_identifier attribute_identifier property_selector qualified_identifier wildcard_identifier
+/* } FBJS_E4X */
 
 // Errors
 %token t_UNTERMINATED_REGEX_LITERAL
 
+// Whatever is left on the stack when the parse stops early. Atoms belong to
+// the atom table, and program_statement_list is already in root.
+%destructor { delete $$; }
+  null_literal boolean_literal numeric_literal regex_literal string_literal array_literal element_list
+  object_literal property_name property_name_and_value_list primary_expression_no_statement
+  primary_expression member_expression new_expression call_expression left_hand_side_expression
+  pre_in_expression post_in_expression conditional_expression assignment_expression expression
+  expression_opt post_in_expression_no_in conditional_expression_no_in assignment_expression_no_in
+  expression_no_in expression_no_in_opt member_expression_no_statement new_expression_no_statement
+  call_expression_no_statement left_hand_side_expression_no_statement pre_in_expression_no_statement
+  post_in_expression_no_statement conditional_expression_no_statement
+  assignment_expression_no_statement expression_no_statement identifier arguments argument_list
+  statement block statement_list source_element variable_statement variable_declaration_list
+  variable_declaration identifier_typehint_permitted initializer variable_declaration_list_no_in
+  variable_declaration_no_in initializer_no_in empty_statement expression_statement if_statement
+  iteration_statement continue_statement break_statement return_statement with_statement
+  switch_statement case_block case_clauses_opt case_clauses labelled_statement throw_statement
+  try_statement finally function_expression function_declaration formal_parameter_list function_body
+%destructor { delete $$[0]; delete $$[1]; } case_clause default_clause catch
+%destructor { free($$); } t_XML_NAME_FRAGMENT t_XML_CDATA t_XML_WHITESPACE t_XML_COMMENT t_XML_PI
+/* FBJS_E4X { */
+%destructor { delete $$; }
+  xml_literal xml_element xml_element_content xml_element_content_tag xml_tag_content xml_name
+  xml_tag_name xml_attribute_list_opt xml_attribute_list xml_attribute_value xml_cdata_no_quote
+  xml_cdata_no_apos xml_cdata_xml_content xml_embedded_expression property_identifier
+  attribute_identifier property_selector qualified_identifier wildcard_identifier
+%destructor { free($$); } xml_cdata_fragment xml_cdata_fragment_attr
+/* } FBJS_E4X */
+
 %start program
 %%
 
 //
 // Big fancy reductions
 program:
-    statement_list {
-      root->appendChild($1);
+    program_statement_list
+;
+
+// statement_list, for the top level only so a streaming parse can take each
+// statement as soon as it's reduced. The list goes into root right away, so
+// whatever was parsed before an error is still there afterwards.
+program_statement_list:
+    source_element {
+      $$ = new (NODE_ARENA) NodeStatementList(yylineno);
+      root->appendChild($$);
+      if (!fbjs_take_statement(yyscanner, $$, $1)) {
+        YYACCEPT;
+      }
+      NODE_LOCATE($$, @$);
+    }
+|   program_statement_list source_element {
+      $$ = $1;
+      if (!fbjs_take_statement(yyscanner, $$, $2)) {
+        YYACCEPT;
+      }
+      NODE_LOCATE($$, @$);
     }
 ;
 
@@ -174,11 +299,12 @@ statement_list:
       // Silly hack since my awesome lexer sticks `t_VIRTUAL_SEMICOLON's all
       // over the place which ends up creating tons of `NodeEmptyExpression's
       if (dynamic_cast<NodeEmptyExpression*>($1) == NULL) {
-        $$ = (new NodeStatementList(yylineno))->appendChild($1);
+        $$ = (new (NODE_ARENA) NodeStatementList(yylineno))->appendChild($1);
       } else {
         delete $1;
-        $$ = new NodeStatementList(yylineno);
+        $$ = new (NODE_ARENA) NodeStatementList(yylineno);
       }
+      NODE_LOCATE($$, @$);
     }
 |   statement_list source_element {
       $$ = $1;
@@ -187,6 +313,7 @@ statement_list:
       } else {
         delete $2;
       }
+      NODE_LOCATE($$, @$);
     }
 ;
 
@@ -199,78 +326,88 @@ source_element:
 // Literal reductions
 null_literal:
     t_NULL {
-      $$ = new NodeNullLiteral(yylineno);
+      $$ = new (NODE_ARENA) NodeNullLiteral(yylineno);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 boolean_literal:
     t_TRUE {
-      $$ = new NodeBooleanLiteral(true, yylineno);
+      $$ = new (NODE_ARENA) NodeBooleanLiteral(true, yylineno);
+      NODE_LOCATE($$, @$);
     }
 |   t_FALSE {
-      $$ = new NodeBooleanLiteral(false, yylineno);
+      $$ = new (NODE_ARENA) NodeBooleanLiteral(false, yylineno);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 numeric_literal:
     t_NUMBER {
-      $$ = new NodeNumericLiteral($1, yylineno);
+      $$ = new (NODE_ARENA) NodeNumericLiteral($1, yylineno);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 regex_literal:
     t_REGEX {
-      $$ = new NodeRegexLiteral($1[0], $1[1], yylineno);
-      free($1[0]);
-      free($1[1]);
+      $$ = new (NODE_ARENA) NodeRegexLiteral(*$1[0], *$1[1], yylineno);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 string_literal:
     t_STRING {
-      $$ = new NodeStringLiteral($1, true, yylineno);
-      free($1);
+      $$ = new (NODE_ARENA) NodeStringLiteral(*$1[0], *$1[1], true, yylineno);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 array_literal:
     t_LBRACKET elison t_RBRACKET {
-      $$ = (new NodeArrayLiteral(yylineno));
+      $$ = (new (NODE_ARENA) NodeArrayLiteral(yylineno));
       for (size_t i = 0; i < $2 + 1; i++) {
-        $$->appendChild(new NodeEmptyExpression(yylineno));
+        $$->appendChild(new (NODE_ARENA) NodeEmptyExpression(yylineno));
       }
+      NODE_LOCATE($$, @$);
     }
 |   t_LBRACKET t_RBRACKET {
-      $$ = new NodeArrayLiteral(yylineno);
+      $$ = new (NODE_ARENA) NodeArrayLiteral(yylineno);
+      NODE_LOCATE($$, @$);
     }
 |   t_LBRACKET element_list t_RBRACKET {
       $$ = $2;
+      NODE_LOCATE($$, @$);
     }
 |   t_LBRACKET element_list elison t_RBRACKET {
        $$ = $2;
        for (size_t i = 0; i < $3; i++) {
-         $$->appendChild(new NodeEmptyExpression(yylineno));
+         $$->appendChild(new (NODE_ARENA) NodeEmptyExpression(yylineno));
        }
+      NODE_LOCATE($$, @$);
     }
 ;
 
 element_list:
     elison assignment_expression {
-      $$ = (new NodeArrayLiteral(yylineno));
+      $$ = (new (NODE_ARENA) NodeArrayLiteral(yylineno));
       for (size_t i = 0; i < $1; i++) {
-        $$->appendChild(new NodeEmptyExpression(yylineno));
+        $$->appendChild(new (NODE_ARENA) NodeEmptyExpression(yylineno));
       }
       $$->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   assignment_expression {
-      $$ = (new NodeArrayLiteral(yylineno))->appendChild($1);
+      $$ = (new (NODE_ARENA) NodeArrayLiteral(yylineno))->appendChild($1);
+      NODE_LOCATE($$, @$);
     }
 |   element_list elison assignment_expression {
       $$ = $1;
       for (size_t i = 1; i < $2; i++) {
-        $$->appendChild(new NodeEmptyExpression(yylineno));
+        $$->appendChild(new (NODE_ARENA) NodeEmptyExpression(yylineno));
       }
       $$->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
@@ -285,14 +422,17 @@ elison:
 
 object_literal:
     t_LCURLY t_RCURLY {
-      $$ = new NodeObjectLiteral(yylineno);
+      $$ = new (NODE_ARENA) NodeObjectLiteral(yylineno);
+      NODE_LOCATE($$, @$);
     }
 |   t_LCURLY property_name_and_value_list t_VIRTUAL_SEMICOLON t_RCURLY { /* note the t_VIRTUAL_SEMICOLON hack */
       $$ = $2;
+      NODE_LOCATE($$, @$);
     }
 |   t_LCURLY property_name_and_value_list t_COMMA t_VIRTUAL_SEMICOLON t_RCURLY {
       require_support(PARSE_OBJECT_LITERAL_ELISON, "object literal elisons not supported");
       $$ = $2;
+      NODE_LOCATE($$, @$);
     }
 
 ;
@@ -305,10 +445,12 @@ property_name:
 
 property_name_and_value_list:
     property_name t_COLON assignment_expression {
-      $$ = (new NodeObjectLiteral(yylineno))->appendChild((new NodeObjectLiteralProperty(yylineno))->appendChild($1)->appendChild($3));
+      $$ = (new (NODE_ARENA) NodeObjectLiteral(yylineno))->appendChild((new (NODE_ARENA) NodeObjectLiteralProperty(yylineno))->appendChild($1)->appendChild($3));
+      NODE_LOCATE($$, @$);
     }
 |   property_name_and_value_list t_COMMA property_name t_COLON assignment_expression {
-      $$ = $1->appendChild((new NodeObjectLiteralProperty(yylineno))->appendChild($3)->appendChild($5));
+      $$ = $1->appendChild((new (NODE_ARENA) NodeObjectLiteralProperty(yylineno))->appendChild($3)->appendChild($5));
+      NODE_LOCATE($$, @$);
     }
 ;
 
@@ -316,26 +458,30 @@ property_name_and_value_list:
 // Shared expression primitives
 identifier:
     t_IDENTIFIER {
-      $$ = new NodeIdentifier($1, yylineno);
-      free($1);
+      $$ = new (NODE_ARENA) NodeIdentifier($1, NODE_ATOMS, yylineno);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 arguments:
     t_LPAREN t_RPAREN {
-      $$ = new NodeArgList(yylineno);
+      $$ = new (NODE_ARENA) NodeArgList(yylineno);
+      NODE_LOCATE($$, @$);
     }
 |   t_LPAREN argument_list t_RPAREN {
       $$ = $2;
+      NODE_LOCATE($$, @$);
     }
 ;
 
 argument_list:
     assignment_expression {
-      $$ = (new NodeArgList(yylineno))->appendChild($1);
+      $$ = (new (NODE_ARENA) NodeArgList(yylineno))->appendChild($1);
+      NODE_LOCATE($$, @$);
     }
 |   argument_list t_COMMA assignment_expression {
       $$ = $1->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
@@ -382,7 +528,8 @@ assignment_operator:
 // Expression reductions
 primary_expression_no_statement:
     t_THIS {
-      $$ = new NodeThis(yylineno);
+      $$ = new (NODE_ARENA) NodeThis(yylineno);
+      NODE_LOCATE($$, @$);
     }
 |   identifier
 |   null_literal
@@ -392,7 +539,8 @@ primary_expression_no_statement:
 |   regex_literal /* this isn't an expansion of literal in ECMA-262... mistake? */
 |   array_literal
 |   t_LPAREN expression t_RPAREN {
-      $$ = (new NodeParenthetical(yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeParenthetical(yylineno))->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 ;
 
@@ -401,41 +549,50 @@ primary_expression:
 |   object_literal
 |   function_expression {
       $$ = $1;
+      NODE_LOCATE($$, @$);
     }
 ;
 
 member_expression:
     primary_expression
 |   member_expression t_LBRACKET expression t_RBRACKET {
-      $$ = (new NodeDynamicMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeDynamicMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   member_expression t_PERIOD identifier {
-      $$ = (new NodeStaticMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeStaticMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   t_NEW member_expression arguments {
-      $$ = (new NodeFunctionConstructor(yylineno))->appendChild($2)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeFunctionConstructor(yylineno))->appendChild($2)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 new_expression:
     member_expression
 |   t_NEW new_expression {
-      $$ = (new NodeFunctionConstructor(yylineno))->appendChild($2)->appendChild(new NodeArgList(yylineno));
+      $$ = (new (NODE_ARENA) NodeFunctionConstructor(yylineno))->appendChild($2)->appendChild(new (NODE_ARENA) NodeArgList(yylineno));
+      NODE_LOCATE($$, @$);
     }
 ;
 
 call_expression:
     member_expression arguments {
-      $$ = (new NodeFunctionCall(yylineno))->appendChild($1)->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeFunctionCall(yylineno))->appendChild($1)->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   call_expression arguments {
-      $$ = (new NodeFunctionCall(yylineno))->appendChild($1)->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeFunctionCall(yylineno))->appendChild($1)->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   call_expression t_LBRACKET expression t_RBRACKET {
-      $$ = (new NodeDynamicMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeDynamicMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   call_expression t_PERIOD identifier {
-      $$ = (new NodeStaticMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeStaticMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
@@ -447,125 +604,162 @@ left_hand_side_expression:
 pre_in_expression:
     left_hand_side_expression
 |   pre_in_expression t_INCR %prec p_POSTFIX {
-      $$ = (new NodePostfix(INCR_POSTFIX, yylineno))->appendChild($1);
+      $$ = (new (NODE_ARENA) NodePostfix(INCR_POSTFIX, yylineno))->appendChild($1);
+      NODE_LOCATE($$, @$);
     }
 |   pre_in_expression t_DECR %prec p_POSTFIX {
-      $$ = (new NodePostfix(DECR_POSTFIX, yylineno))->appendChild($1);
+      $$ = (new (NODE_ARENA) NodePostfix(DECR_POSTFIX, yylineno))->appendChild($1);
+      NODE_LOCATE($$, @$);
     }
 |   t_DELETE pre_in_expression {
-      $$ = (new NodeUnary(DELETE, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeUnary(DELETE, yylineno))->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   t_VOID pre_in_expression {
-      $$ = (new NodeUnary(VOID, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeUnary(VOID, yylineno))->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   t_TYPEOF pre_in_expression {
-      $$ = (new NodeUnary(TYPEOF, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeUnary(TYPEOF, yylineno))->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   t_INCR pre_in_expression {
-      $$ = (new NodeUnary(INCR_UNARY, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeUnary(INCR_UNARY, yylineno))->appendChild($2);
       if (!static_cast<NodeExpression*>($2)->isValidlVal()) {
         parsererror("invalid increment operand");
+        delete $$;
         $$ = NULL;
       }
+      NODE_LOCATE($$, @$);
     }
 |   t_DECR pre_in_expression {
-      $$ = (new NodeUnary(DECR_UNARY, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeUnary(DECR_UNARY, yylineno))->appendChild($2);
       if (!static_cast<NodeExpression*>($2)->isValidlVal()) {
         parsererror("invalid decrement operand");
+        delete $$;
         $$ = NULL;
       }
+      NODE_LOCATE($$, @$);
     }
 |   t_PLUS pre_in_expression {
-      $$ = (new NodeUnary(PLUS_UNARY, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeUnary(PLUS_UNARY, yylineno))->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   t_MINUS pre_in_expression {
-      $$ = (new NodeUnary(MINUS_UNARY, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeUnary(MINUS_UNARY, yylineno))->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   t_BIT_NOT pre_in_expression {
-      $$ = (new NodeUnary(BIT_NOT_UNARY, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeUnary(BIT_NOT_UNARY, yylineno))->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   t_NOT pre_in_expression {
-      $$ = (new NodeUnary(NOT_UNARY, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeUnary(NOT_UNARY, yylineno))->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   pre_in_expression t_MULT pre_in_expression {
-      $$ = (new NodeOperator(MULT, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(MULT, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   pre_in_expression t_DIV pre_in_expression {
-      $$ = (new NodeOperator(DIV, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(DIV, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   pre_in_expression t_MOD pre_in_expression {
-      $$ = (new NodeOperator(MOD, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(MOD, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   pre_in_expression t_PLUS pre_in_expression {
-      $$ = (new NodeOperator(PLUS, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(PLUS, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   pre_in_expression t_MINUS pre_in_expression {
-      $$ = (new NodeOperator(MINUS, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(MINUS, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   pre_in_expression t_LSHIFT pre_in_expression {
-      $$ = (new NodeOperator(LSHIFT, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(LSHIFT, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   pre_in_expression t_RSHIFT pre_in_expression {
-      $$ = (new NodeOperator(RSHIFT, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(RSHIFT, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   pre_in_expression t_RSHIFT3 pre_in_expression {
-      $$ = (new NodeOperator(RSHIFT3, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(RSHIFT3, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 post_in_expression:
     pre_in_expression
 |   post_in_expression t_LESS_THAN post_in_expression {
-      $$ = (new NodeOperator(LESS_THAN, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(LESS_THAN, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression t_GREATER_THAN post_in_expression {
-      $$ = (new NodeOperator(GREATER_THAN, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(GREATER_THAN, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression t_LESS_THAN_EQUAL post_in_expression {
-      $$ = (new NodeOperator(LESS_THAN_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(LESS_THAN_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression t_GREATER_THAN_EQUAL post_in_expression {
-      $$ = (new NodeOperator(GREATER_THAN_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(GREATER_THAN_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression t_INSTANCEOF post_in_expression {
-      $$ = (new NodeOperator(INSTANCEOF, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(INSTANCEOF, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression t_IN post_in_expression {
-      $$ = (new NodeOperator(IN, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(IN, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression t_EQUAL post_in_expression {
-      $$ = (new NodeOperator(EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression t_NOT_EQUAL post_in_expression {
-      $$ = (new NodeOperator(NOT_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(NOT_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression t_STRICT_EQUAL post_in_expression {
-      $$ = (new NodeOperator(STRICT_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(STRICT_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression t_STRICT_NOT_EQUAL post_in_expression {
-      $$ = (new NodeOperator(STRICT_NOT_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(STRICT_NOT_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression t_BIT_AND post_in_expression {
-      $$ = (new NodeOperator(BIT_AND, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(BIT_AND, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression t_BIT_XOR post_in_expression {
-      $$ = (new NodeOperator(BIT_XOR, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(BIT_XOR, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression t_BIT_OR post_in_expression {
-      $$ = (new NodeOperator(BIT_OR, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(BIT_OR, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression t_AND post_in_expression {
-      $$ = (new NodeOperator(AND, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(AND, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression t_OR post_in_expression {
-      $$ = (new NodeOperator(OR, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(OR, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 conditional_expression:
     post_in_expression
 |   post_in_expression t_PLING assignment_expression t_COLON assignment_expression {
-      $$ = (new NodeConditionalExpression(yylineno))->appendChild($1)->appendChild($3)->appendChild($5);
+      $$ = (new (NODE_ARENA) NodeConditionalExpression(yylineno))->appendChild($1)->appendChild($3)->appendChild($5);
+      NODE_LOCATE($$, @$);
     }
 ;
 
@@ -574,23 +768,28 @@ assignment_expression:
 |   left_hand_side_expression assignment_operator assignment_expression {
       if (!static_cast<NodeExpression*>($1)->isValidlVal()) {
         parsererror("invalid assignment left-hand side");
+        delete $1;
+        delete $3;
         $$ = NULL;
       } else {
-        $$ = (new NodeAssignment($2, yylineno))->appendChild($1)->appendChild($3);
+        $$ = (new (NODE_ARENA) NodeAssignment($2, yylineno))->appendChild($1)->appendChild($3);
       }
+      NODE_LOCATE($$, @$);
     }
 ;
 
 expression:
     assignment_expression
 |   expression t_COMMA assignment_expression {
-      $$ = (new NodeOperator(COMMA, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(COMMA, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 expression_opt:
     /* empty */ {
-      $$ = new NodeEmptyExpression(yylineno);
+      $$ = new (NODE_ARENA) NodeEmptyExpression(yylineno);
+      NODE_LOCATE($$, @$);
     }
 |   expression
 ;
@@ -600,53 +799,68 @@ expression_opt:
 post_in_expression_no_in:
     pre_in_expression
 |   post_in_expression_no_in t_LESS_THAN post_in_expression {
-      $$ = (new NodeOperator(LESS_THAN, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(LESS_THAN, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_in t_GREATER_THAN post_in_expression {
-      $$ = (new NodeOperator(GREATER_THAN, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(GREATER_THAN, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_in t_LESS_THAN_EQUAL post_in_expression {
-      $$ = (new NodeOperator(LESS_THAN_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(LESS_THAN_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_in t_GREATER_THAN_EQUAL post_in_expression {
-      $$ = (new NodeOperator(GREATER_THAN_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(GREATER_THAN_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_in t_INSTANCEOF post_in_expression {
-      $$ = (new NodeOperator(INSTANCEOF, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(INSTANCEOF, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_in t_EQUAL post_in_expression {
-      $$ = (new NodeOperator(EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_in t_NOT_EQUAL post_in_expression {
-      $$ = (new NodeOperator(NOT_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(NOT_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_in t_STRICT_EQUAL post_in_expression {
-      $$ = (new NodeOperator(STRICT_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(STRICT_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_in t_STRICT_NOT_EQUAL post_in_expression {
-      $$ = (new NodeOperator(STRICT_NOT_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(STRICT_NOT_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_in t_BIT_AND post_in_expression {
-      $$ = (new NodeOperator(BIT_AND, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(BIT_AND, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_in t_BIT_XOR post_in_expression {
-      $$ = (new NodeOperator(BIT_XOR, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(BIT_XOR, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_in t_BIT_OR post_in_expression {
-      $$ = (new NodeOperator(BIT_OR, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(BIT_OR, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_in t_AND post_in_expression {
-      $$ = (new NodeOperator(AND, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(AND, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_in t_OR post_in_expression {
-      $$ = (new NodeOperator(OR, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(OR, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 conditional_expression_no_in:
     post_in_expression_no_in
 |   post_in_expression_no_in t_PLING assignment_expression_no_in t_COLON assignment_expression_no_in {
-      $$ = (new NodeConditionalExpression(yylineno))->appendChild($1)->appendChild($3)->appendChild($5);
+      $$ = (new (NODE_ARENA) NodeConditionalExpression(yylineno))->appendChild($1)->appendChild($3)->appendChild($5);
+      NODE_LOCATE($$, @$);
     }
 ;
 
@@ -655,23 +869,28 @@ assignment_expression_no_in:
 |   left_hand_side_expression assignment_operator assignment_expression_no_in {
       if (!static_cast<NodeExpression*>($1)->isValidlVal()) {
         parsererror("invalid assignment left-hand side");
+        delete $1;
+        delete $3;
         $$ = NULL;
       } else {
-        $$ = (new NodeAssignment($2, yylineno))->appendChild($1)->appendChild($3);
+        $$ = (new (NODE_ARENA) NodeAssignment($2, yylineno))->appendChild($1)->appendChild($3);
       }
+      NODE_LOCATE($$, @$);
     }
 ;
 
 expression_no_in:
     assignment_expression_no_in
 |   expression_no_in t_COMMA assignment_expression_no_in {
-      $$ = (new NodeOperator(COMMA, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(COMMA, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 expression_no_in_opt:
     /* empty */ {
-      $$ = new NodeEmptyExpression(yylineno);
+      $$ = new (NODE_ARENA) NodeEmptyExpression(yylineno);
+      NODE_LOCATE($$, @$);
     }
 |   expression_no_in
 ;
@@ -681,35 +900,43 @@ expression_no_in_opt:
 member_expression_no_statement:
     primary_expression_no_statement
 |   member_expression_no_statement t_LBRACKET expression t_RBRACKET {
-      $$ = (new NodeDynamicMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeDynamicMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   member_expression_no_statement t_PERIOD identifier {
-      $$ = (new NodeStaticMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeStaticMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   t_NEW member_expression arguments {
-      $$ = (new NodeFunctionConstructor(yylineno))->appendChild($2)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeFunctionConstructor(yylineno))->appendChild($2)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 new_expression_no_statement:
     member_expression_no_statement
 |   t_NEW new_expression {
-      $$ = (new NodeFunctionConstructor(yylineno))->appendChild($2)->appendChild(new NodeArgList(yylineno));
+      $$ = (new (NODE_ARENA) NodeFunctionConstructor(yylineno))->appendChild($2)->appendChild(new (NODE_ARENA) NodeArgList(yylineno));
+      NODE_LOCATE($$, @$);
     }
 ;
 
 call_expression_no_statement:
     member_expression_no_statement arguments {
-      $$ = (new NodeFunctionCall(yylineno))->appendChild($1)->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeFunctionCall(yylineno))->appendChild($1)->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   call_expression_no_statement arguments {
-      $$ = (new NodeFunctionCall(yylineno))->appendChild($1)->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeFunctionCall(yylineno))->appendChild($1)->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   call_expression_no_statement t_LBRACKET expression t_RBRACKET {
-      $$ = (new NodeDynamicMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeDynamicMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   call_expression_no_statement t_PERIOD identifier {
-      $$ = (new NodeStaticMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeStaticMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
@@ -721,125 +948,162 @@ left_hand_side_expression_no_statement:
 pre_in_expression_no_statement:
     left_hand_side_expression_no_statement
 |   pre_in_expression_no_statement t_INCR {
-      $$ = (new NodePostfix(INCR_POSTFIX, yylineno))->appendChild($1);
+      $$ = (new (NODE_ARENA) NodePostfix(INCR_POSTFIX, yylineno))->appendChild($1);
+      NODE_LOCATE($$, @$);
     }
 |   pre_in_expression_no_statement t_DECR {
-      $$ = (new NodePostfix(DECR_POSTFIX, yylineno))->appendChild($1);
+      $$ = (new (NODE_ARENA) NodePostfix(DECR_POSTFIX, yylineno))->appendChild($1);
+      NODE_LOCATE($$, @$);
     }
 |   t_DELETE pre_in_expression {
-      $$ = (new NodeUnary(DELETE, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeUnary(DELETE, yylineno))->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   t_VOID pre_in_expression {
-      $$ = (new NodeUnary(VOID, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeUnary(VOID, yylineno))->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   t_TYPEOF pre_in_expression {
-      $$ = (new NodeUnary(TYPEOF, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeUnary(TYPEOF, yylineno))->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   t_INCR pre_in_expression {
-      $$ = (new NodeUnary(INCR_UNARY, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeUnary(INCR_UNARY, yylineno))->appendChild($2);
       if (!static_cast<NodeExpression*>($2)->isValidlVal()) {
         parsererror("invalid increment operand");
+        delete $$;
         $$ = NULL;
       }
+      NODE_LOCATE($$, @$);
     }
 |   t_DECR pre_in_expression {
-      $$ = (new NodeUnary(DECR_UNARY, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeUnary(DECR_UNARY, yylineno))->appendChild($2);
       if (!static_cast<NodeExpression*>($2)->isValidlVal()) {
         parsererror("invalid decrement operand");
+        delete $$;
         $$ = NULL;
       }
+      NODE_LOCATE($$, @$);
     }
 |   t_PLUS pre_in_expression {
-      $$ = (new NodeUnary(PLUS_UNARY, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeUnary(PLUS_UNARY, yylineno))->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   t_MINUS pre_in_expression {
-      $$ = (new NodeUnary(MINUS_UNARY, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeUnary(MINUS_UNARY, yylineno))->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   t_BIT_NOT pre_in_expression {
-      $$ = (new NodeUnary(BIT_NOT_UNARY, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeUnary(BIT_NOT_UNARY, yylineno))->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   t_NOT pre_in_expression {
-      $$ = (new NodeUnary(NOT_UNARY, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeUnary(NOT_UNARY, yylineno))->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   pre_in_expression_no_statement t_MULT pre_in_expression {
-      $$ = (new NodeOperator(MULT, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(MULT, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   pre_in_expression_no_statement t_DIV pre_in_expression {
-      $$ = (new NodeOperator(DIV, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(DIV, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   pre_in_expression_no_statement t_MOD pre_in_expression {
-      $$ = (new NodeOperator(MOD, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(MOD, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   pre_in_expression_no_statement t_PLUS pre_in_expression {
-      $$ = (new NodeOperator(PLUS, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(PLUS, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   pre_in_expression_no_statement t_MINUS pre_in_expression {
-      $$ = (new NodeOperator(MINUS, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(MINUS, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   pre_in_expression_no_statement t_LSHIFT pre_in_expression {
-      $$ = (new NodeOperator(LSHIFT, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(LSHIFT, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   pre_in_expression_no_statement t_RSHIFT pre_in_expression {
-      $$ = (new NodeOperator(RSHIFT, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(RSHIFT, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   pre_in_expression_no_statement t_RSHIFT3 pre_in_expression {
-      $$ = (new NodeOperator(RSHIFT3, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(RSHIFT3, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 post_in_expression_no_statement:
     pre_in_expression_no_statement
 |   post_in_expression_no_statement t_LESS_THAN post_in_expression {
-      $$ = (new NodeOperator(LESS_THAN, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(LESS_THAN, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_statement t_GREATER_THAN post_in_expression {
-      $$ = (new NodeOperator(GREATER_THAN, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(GREATER_THAN, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_statement t_LESS_THAN_EQUAL post_in_expression {
-      $$ = (new NodeOperator(LESS_THAN_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(LESS_THAN_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_statement t_GREATER_THAN_EQUAL post_in_expression {
-      $$ = (new NodeOperator(GREATER_THAN_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(GREATER_THAN_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_statement t_INSTANCEOF post_in_expression {
-      $$ = (new NodeOperator(INSTANCEOF, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(INSTANCEOF, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_statement t_IN post_in_expression {
-      $$ = (new NodeOperator(IN, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(IN, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_statement t_EQUAL post_in_expression {
-      $$ = (new NodeOperator(EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_statement t_NOT_EQUAL post_in_expression {
-      $$ = (new NodeOperator(NOT_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(NOT_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_statement t_STRICT_EQUAL post_in_expression {
-      $$ = (new NodeOperator(STRICT_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(STRICT_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_statement t_STRICT_NOT_EQUAL post_in_expression {
-      $$ = (new NodeOperator(STRICT_NOT_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(STRICT_NOT_EQUAL, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_statement t_BIT_AND post_in_expression {
-      $$ = (new NodeOperator(BIT_AND, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(BIT_AND, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_statement t_BIT_XOR post_in_expression {
-      $$ = (new NodeOperator(BIT_XOR, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(BIT_XOR, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_statement t_BIT_OR post_in_expression {
-      $$ = (new NodeOperator(BIT_OR, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(BIT_OR, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_statement t_AND post_in_expression {
-      $$ = (new NodeOperator(AND, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(AND, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   post_in_expression_no_statement t_OR post_in_expression {
-      $$ = (new NodeOperator(OR, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(OR, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 conditional_expression_no_statement:
     post_in_expression_no_statement
 |   post_in_expression_no_statement t_PLING assignment_expression t_COLON assignment_expression {
-      $$ = (new NodeConditionalExpression(yylineno))->appendChild($1)->appendChild($3)->appendChild($5);
+      $$ = (new (NODE_ARENA) NodeConditionalExpression(yylineno))->appendChild($1)->appendChild($3)->appendChild($5);
+      NODE_LOCATE($$, @$);
     }
 ;
 
@@ -848,17 +1112,21 @@ assignment_expression_no_statement:
 |   left_hand_side_expression_no_statement assignment_operator assignment_expression {
       if (!static_cast<NodeExpression*>($1)->isValidlVal()) {
         parsererror("invalid assignment left-hand side");
+        delete $1;
+        delete $3;
         $$ = NULL;
       } else {
-        $$ = (new NodeAssignment($2, yylineno))->appendChild($1)->appendChild($3);
+        $$ = (new (NODE_ARENA) NodeAssignment($2, yylineno))->appendChild($1)->appendChild($3);
       }
+      NODE_LOCATE($$, @$);
     }
 ;
 
 expression_no_statement:
     assignment_expression_no_statement
 |   expression_no_statement t_COMMA assignment_expression {
-      $$ = (new NodeOperator(COMMA, yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeOperator(COMMA, yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
@@ -879,65 +1147,83 @@ statement:
 |   switch_statement
 |   throw_statement
 |   try_statement
+|   error semicolon {
+      yyerrok;
+      $$ = new (NODE_ARENA) NodeEmptyExpression(yylineno);
+      NODE_LOCATE($$, @$);
+    }
 ;
 
 block:
     t_LCURLY statement_list t_RCURLY {
       $$ = $2;
+      NODE_LOCATE($$, @$);
     }
 |   t_LCURLY t_RCURLY {
-      $$ = new NodeStatementList(yylineno);
+      $$ = new (NODE_ARENA) NodeStatementList(yylineno);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 variable_statement:
     t_VAR variable_declaration_list semicolon {
       $$ = $2;
+      NODE_LOCATE($$, @$);
     }
 ;
 
 variable_declaration_list:
     variable_declaration {
-      $$ = (new NodeVarDeclaration(false, yylineno))->appendChild($1);
+      $$ = (new (NODE_ARENA) NodeVarDeclaration(false, yylineno))->appendChild($1);
+      NODE_LOCATE($$, @$);
     }
 |   variable_declaration_list t_COMMA variable_declaration {
-      $$->appendChild($3);
+      $$ = $1->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 variable_declaration:
     identifier_typehint_permitted initializer {
-      $$ = (new NodeAssignment(ASSIGN, yylineno))->appendChild($1)->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeAssignment(ASSIGN, yylineno))->appendChild($1)->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   identifier_typehint_permitted
 ;
 
 identifier_typehint_permitted:
     identifier
+/* FBJS_TYPEHINT { */
 |   identifier t_COLON identifier {
       require_support(PARSE_TYPEHINT, "typehints not supported");
-      $$ = (new NodeTypehint(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeTypehint(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
+/* } FBJS_TYPEHINT */
 ;
 
 initializer:
     t_ASSIGN assignment_expression {
       $$ = $2;
+      NODE_LOCATE($$, @$);
     }
 ;
 
 variable_declaration_list_no_in:
     variable_declaration_no_in {
-      $$ = (new NodeVarDeclaration(false, yylineno))->appendChild($1);
+      $$ = (new (NODE_ARENA) NodeVarDeclaration(false, yylineno))->appendChild($1);
+      NODE_LOCATE($$, @$);
     }
 |   variable_declaration_list_no_in t_COMMA variable_declaration_no_in {
-      $$->appendChild($3);
+      $$ = $1->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 variable_declaration_no_in:
     identifier initializer_no_in {
-      $$ = (new NodeAssignment(ASSIGN, yylineno))->appendChild($1)->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeAssignment(ASSIGN, yylineno))->appendChild($1)->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   identifier
 ;
@@ -945,178 +1231,215 @@ variable_declaration_no_in:
 initializer_no_in:
     t_ASSIGN assignment_expression_no_in {
       $$ = $2;
+      NODE_LOCATE($$, @$);
     }
 ;
 
 empty_statement:
     semicolon {
-      $$ = new NodeEmptyExpression(yylineno);
+      $$ = new (NODE_ARENA) NodeEmptyExpression(yylineno);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 expression_statement:
     expression_no_statement semicolon {
       $$ = $1;
+      NODE_LOCATE($$, @$);
     }
 ;
 
 if_statement:
     t_IF t_LPAREN expression t_RPAREN statement t_ELSE statement {
-      $$ = (new NodeIf($3->lineno()))->appendChild($3)->appendChild($5)->appendChild($7);
+      $$ = (new (NODE_ARENA) NodeIf($3->lineno()))->appendChild($3)->appendChild($5)->appendChild($7);
+      NODE_LOCATE($$, @$);
     }
 |   t_IF t_LPAREN expression t_RPAREN statement %prec p_IF {
-      $$ = (new NodeIf($3->lineno()))->appendChild($3)->appendChild($5)->appendChild(NULL);
+      $$ = (new (NODE_ARENA) NodeIf($3->lineno()))->appendChild($3)->appendChild($5)->appendChild(NULL);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 iteration_statement:
     t_DO statement t_WHILE t_LPAREN expression t_RPAREN semicolon {
-      $$ = (new NodeDoWhile($2->lineno()))->appendChild($2)->appendChild($5);
+      $$ = (new (NODE_ARENA) NodeDoWhile($2->lineno()))->appendChild($2)->appendChild($5);
+      NODE_LOCATE($$, @$);
     }
 |   t_WHILE t_LPAREN expression t_RPAREN statement {
-      $$ = (new NodeWhile($3->lineno()))->appendChild($3)->appendChild($5);
+      $$ = (new (NODE_ARENA) NodeWhile($3->lineno()))->appendChild($3)->appendChild($5);
+      NODE_LOCATE($$, @$);
     }
 |   t_FOR t_LPAREN expression_no_in_opt t_SEMICOLON expression_opt t_SEMICOLON expression_opt t_RPAREN statement {
-      $$ = (new NodeForLoop($3->lineno()))->appendChild($3)->appendChild($5)->appendChild($7)->appendChild($9);
+      $$ = (new (NODE_ARENA) NodeForLoop($3->lineno()))->appendChild($3)->appendChild($5)->appendChild($7)->appendChild($9);
+      NODE_LOCATE($$, @$);
     }
 |   t_FOR t_LPAREN t_VAR variable_declaration_list_no_in t_SEMICOLON expression_opt t_SEMICOLON expression_opt t_RPAREN statement {
-      $$ = (new NodeForLoop($4->lineno()))->appendChild($4)->appendChild($6)->appendChild($8)->appendChild($10);
+      $$ = (new (NODE_ARENA) NodeForLoop($4->lineno()))->appendChild($4)->appendChild($6)->appendChild($8)->appendChild($10);
+      NODE_LOCATE($$, @$);
     }
 |   t_FOR t_LPAREN left_hand_side_expression t_IN expression t_RPAREN statement {
-      $$ = (new NodeForIn($3->lineno()))->appendChild($3)->appendChild($5)->appendChild($7);
+      $$ = (new (NODE_ARENA) NodeForIn($3->lineno()))->appendChild($3)->appendChild($5)->appendChild($7);
+      NODE_LOCATE($$, @$);
     }
 |   t_FOR t_LPAREN t_VAR variable_declaration_list_no_in t_IN expression t_RPAREN statement {
-      $$ = (new NodeForIn($4->lineno()))->appendChild(static_cast<NodeVarDeclaration*>($4)->setIterator(true))->appendChild($6)->appendChild($8);
+      $$ = (new (NODE_ARENA) NodeForIn($4->lineno()))->appendChild(static_cast<NodeVarDeclaration*>($4)->setIterator(true))->appendChild($6)->appendChild($8);
+      NODE_LOCATE($$, @$);
     }
+/* FBJS_E4X { */
 |   t_FOR_EACH t_LPAREN left_hand_side_expression t_IN expression t_RPAREN statement {
       require_support(PARSE_E4X, "E4X not supported");
-      $$ = (new NodeForEachIn($3->lineno()))->appendChild($3)->appendChild($5)->appendChild($7);
+      $$ = (new (NODE_ARENA) NodeForEachIn($3->lineno()))->appendChild($3)->appendChild($5)->appendChild($7);
+      NODE_LOCATE($$, @$);
     }
 |   t_FOR_EACH t_LPAREN t_VAR variable_declaration_list_no_in t_IN expression t_RPAREN statement {
       require_support(PARSE_E4X, "E4X not supported");
-      $$ = (new NodeForEachIn($4->lineno()))->appendChild(static_cast<NodeVarDeclaration*>($4)->setIterator(true))->appendChild($6)->appendChild($8);
+      $$ = (new (NODE_ARENA) NodeForEachIn($4->lineno()))->appendChild(static_cast<NodeVarDeclaration*>($4)->setIterator(true))->appendChild($6)->appendChild($8);
+      NODE_LOCATE($$, @$);
     }
+/* } FBJS_E4X */
 ;
 
 continue_statement:
     t_CONTINUE identifier semicolon {
-      $$ = (new NodeStatementWithExpression(CONTINUE, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeStatementWithExpression(CONTINUE, yylineno))->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   t_CONTINUE semicolon {
-      $$ = (new NodeStatementWithExpression(CONTINUE, yylineno))->appendChild(NULL);
+      $$ = (new (NODE_ARENA) NodeStatementWithExpression(CONTINUE, yylineno))->appendChild(NULL);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 break_statement:
     t_BREAK identifier semicolon {
-      $$ = (new NodeStatementWithExpression(BREAK, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeStatementWithExpression(BREAK, yylineno))->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   t_BREAK semicolon {
-      $$ = (new NodeStatementWithExpression(BREAK, yylineno))->appendChild(NULL);
+      $$ = (new (NODE_ARENA) NodeStatementWithExpression(BREAK, yylineno))->appendChild(NULL);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 return_statement:
     t_RETURN expression semicolon {
-      $$ = (new NodeStatementWithExpression(RETURN, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeStatementWithExpression(RETURN, yylineno))->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   t_RETURN semicolon {
-      $$ = (new NodeStatementWithExpression(RETURN, yylineno))->appendChild(NULL);
+      $$ = (new (NODE_ARENA) NodeStatementWithExpression(RETURN, yylineno))->appendChild(NULL);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 with_statement:
     t_WITH t_LPAREN expression t_RPAREN statement {
-      $$ = (new NodeWith($3->lineno()))->appendChild($3)->appendChild($5);
+      $$ = (new (NODE_ARENA) NodeWith($3->lineno()))->appendChild($3)->appendChild($5);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 switch_statement:
     t_SWITCH t_LPAREN expression t_RPAREN case_block {
-      $$ = (new NodeSwitch($3->lineno()))->appendChild($3)->appendChild($5);
+      $$ = (new (NODE_ARENA) NodeSwitch($3->lineno()))->appendChild($3)->appendChild($5);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 case_block:
     t_LCURLY case_clauses_opt t_RCURLY {
       $$ = $2;
+      NODE_LOCATE($$, @$);
     }
 |   t_LCURLY case_clauses_opt default_clause case_clauses_opt t_RCURLY {
-      $$ = (new NodeStatementList(yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeStatementList(yylineno))->appendChild($2);
       $$->appendChild($3[0]);
       if ($3[1] != NULL) {
         $$->appendChild($3[1]);
       }
       $$->appendChild($4);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 
 case_clauses_opt:
     /* nothing */ {
-      $$ = new NodeStatementList(yylineno);
+      $$ = new (NODE_ARENA) NodeStatementList(yylineno);
+      NODE_LOCATE($$, @$);
     }
 |   case_clauses
 ;
 
 case_clauses:
     case_clause {
-      $$ = (new NodeStatementList(yylineno))->appendChild($1[0]);
+      $$ = (new (NODE_ARENA) NodeStatementList(yylineno))->appendChild($1[0]);
       if ($1[1] != NULL) {
         $$->appendChild($1[1]);
       }
+      NODE_LOCATE($$, @$);
     }
 |   case_clauses case_clause {
       $$ = $1->appendChild($2[0]);
       if ($2[1] != NULL) {
         $$->appendChild($2[1]);
       }
+      NODE_LOCATE($$, @$);
     }
 ;
 
 
 case_clause:
     t_CASE expression t_COLON statement_list {
-      $$[0] = (new NodeCaseClause($2->lineno()))->appendChild($2);
+      $$[0] = (new (NODE_ARENA) NodeCaseClause($2->lineno()))->appendChild($2);
+      NODE_LOCATE($$[0], @$);
       $$[1] = $4;
     }
 |   t_CASE expression t_COLON {
-      $$[0] = (new NodeCaseClause($2->lineno()))->appendChild($2);
+      $$[0] = (new (NODE_ARENA) NodeCaseClause($2->lineno()))->appendChild($2);
+      NODE_LOCATE($$[0], @$);
       $$[1] = NULL;
     }
 ;
 
 default_clause:
     t_DEFAULT t_COLON {
-      $$[0] = new NodeDefaultClause(yylineno);
+      $$[0] = new (NODE_ARENA) NodeDefaultClause(yylineno);
+      NODE_LOCATE($$[0], @$);
       $$[1] = NULL;
     }
 |   t_DEFAULT t_COLON statement_list {
-      $$[0] = new NodeDefaultClause(yylineno);
+      $$[0] = new (NODE_ARENA) NodeDefaultClause(yylineno);
+      NODE_LOCATE($$[0], @$);
       $$[1] = $3;
 };
 
 labelled_statement:
     identifier t_COLON statement {
-      $$ = (new NodeLabel(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeLabel(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 throw_statement:
     t_THROW expression semicolon {
-      $$ = (new NodeStatementWithExpression(THROW, yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeStatementWithExpression(THROW, yylineno))->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 try_statement:
     t_TRY block catch {
-      $$ = (new NodeTry($2->lineno()))->appendChild($2)->appendChild($3[0])->appendChild($3[1])->appendChild(NULL);
+      $$ = (new (NODE_ARENA) NodeTry($2->lineno()))->appendChild($2)->appendChild($3[0])->appendChild($3[1])->appendChild(NULL);
+      NODE_LOCATE($$, @$);
     }
 |   t_TRY block finally {
-      $$ = (new NodeTry($2->lineno()))->appendChild($2)->appendChild(NULL)->appendChild(NULL)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeTry($2->lineno()))->appendChild($2)->appendChild(NULL)->appendChild(NULL)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   t_TRY block catch finally {
-      $$ = (new NodeTry($2->lineno()))->appendChild($2)->appendChild($3[0])->appendChild($3[1])->appendChild($4);
+      $$ = (new (NODE_ARENA) NodeTry($2->lineno()))->appendChild($2)->appendChild($3[0])->appendChild($3[1])->appendChild($4);
+      NODE_LOCATE($$, @$);
     }
 ;
 
@@ -1130,6 +1453,7 @@ catch:
 finally:
     t_FINALLY block {
       $$ = $2;
+      NODE_LOCATE($$, @$);
     }
 ;
 
@@ -1137,50 +1461,67 @@ finally:
 // Functions
 function_declaration:
     t_FUNCTION identifier t_LPAREN formal_parameter_list t_RPAREN t_LCURLY function_body t_RCURLY {
-      $$ = (new NodeFunctionDeclaration($2->lineno()))->appendChild($2)->appendChild($4)->appendChild($7);
+      $$ = (new (NODE_ARENA) NodeFunctionDeclaration($2->lineno()))->appendChild($2)->appendChild($4)->appendChild($7);
+      NODE_RANGE($7, @6, @8);
+      NODE_LOCATE($$, @$);
     }
 |   t_FUNCTION identifier t_LPAREN t_RPAREN t_LCURLY function_body t_RCURLY {
-      $$ = (new NodeFunctionDeclaration($2->lineno()))->appendChild($2)->appendChild(new NodeArgList(yylineno))->appendChild($6);
+      $$ = (new (NODE_ARENA) NodeFunctionDeclaration($2->lineno()))->appendChild($2)->appendChild(new (NODE_ARENA) NodeArgList(yylineno))->appendChild($6);
+      NODE_RANGE($6, @5, @7);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 function_expression:
     t_FUNCTION identifier t_LPAREN formal_parameter_list t_RPAREN t_LCURLY function_body t_RCURLY {
-      $$ = (new NodeFunctionExpression($2->lineno()))->appendChild($2)->appendChild($4)->appendChild($7);
+      $$ = (new (NODE_ARENA) NodeFunctionExpression($2->lineno()))->appendChild($2)->appendChild($4)->appendChild($7);
+      NODE_RANGE($7, @6, @8);
+      NODE_LOCATE($$, @$);
     }
 |   t_FUNCTION identifier t_LPAREN t_RPAREN t_LCURLY function_body t_RCURLY {
-      $$ = (new NodeFunctionExpression($2->lineno()))->appendChild($2)->appendChild(new NodeArgList(yylineno))->appendChild($6);
+      $$ = (new (NODE_ARENA) NodeFunctionExpression($2->lineno()))->appendChild($2)->appendChild(new (NODE_ARENA) NodeArgList(yylineno))->appendChild($6);
+      NODE_RANGE($6, @5, @7);
+      NODE_LOCATE($$, @$);
     }
 |   t_FUNCTION t_LPAREN formal_parameter_list t_RPAREN t_LCURLY function_body t_RCURLY {
-      $$ = (new NodeFunctionExpression($3->lineno()))->appendChild(NULL)->appendChild($3)->appendChild($6);
+      $$ = (new (NODE_ARENA) NodeFunctionExpression($3->lineno()))->appendChild(NULL)->appendChild($3)->appendChild($6);
+      NODE_RANGE($6, @5, @7);
+      NODE_LOCATE($$, @$);
     }
 |   t_FUNCTION t_LPAREN t_RPAREN t_LCURLY function_body t_RCURLY {
-      $$ = (new NodeFunctionExpression($5->lineno()))->appendChild(NULL)->appendChild(new NodeArgList(yylineno))->appendChild($5);
+      $$ = (new (NODE_ARENA) NodeFunctionExpression($5->lineno()))->appendChild(NULL)->appendChild(new (NODE_ARENA) NodeArgList(yylineno))->appendChild($5);
+      NODE_RANGE($5, @4, @6);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 formal_parameter_list:
     identifier_typehint_permitted {
-      $$ = (new NodeArgList(yylineno))->appendChild($1);
+      $$ = (new (NODE_ARENA) NodeArgList(yylineno))->appendChild($1);
+      NODE_LOCATE($$, @$);
     }
 |   formal_parameter_list t_COMMA identifier_typehint_permitted {
       $$ = $1->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 function_body:
     /* empty */ {
-      $$ = new NodeStatementList(yylineno);
+      $$ = new (NODE_ARENA) NodeStatementList(yylineno);
+      NODE_LOCATE($$, @$);
     }
 |   statement_list;
 ;
 
+/* FBJS_E4X { */
 //
 // E4X XML literals
 primary_expression_no_statement:
     xml_literal {
       require_support(PARSE_E4X, "E4X not supported");
       $$ = $1;
+      NODE_LOCATE($$, @$);
     }
 ;
 
@@ -1188,25 +1529,29 @@ xml_literal:
     xml_element
 |   xml_lt t_GREATER_THAN xml_element_content t_XML_LT_DIV t_GREATER_THAN {
         fbjs_pop_xml_state(yyscanner);
-        $$ = (new NodeXMLElement(yylineno))
+        $$ = (new (NODE_ARENA) NodeXMLElement(yylineno))
           ->appendChild(NULL)->appendChild(NULL)->appendChild($3)->appendChild(NULL);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 xml_element:
     xml_tag_content t_DIV t_GREATER_THAN {
       fbjs_pop_xml_state(yyscanner);
-      $$ = $1->appendChild(new NodeXMLContentList(yylineno))->appendChild(NULL);
+      $$ = $1->appendChild(new (NODE_ARENA) NodeXMLContentList(yylineno))->appendChild(NULL);
+      NODE_LOCATE($$, @$);
     }
 |   xml_tag_content t_GREATER_THAN xml_element_content t_XML_LT_DIV xml_tag_name xml_ws_opt t_GREATER_THAN {
       fbjs_pop_xml_state(yyscanner);
       $$ = $1->appendChild($3)->appendChild($5);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 xml_tag_content:
     xml_lt xml_tag_name xml_attribute_list_opt {
-      $$ = (new NodeXMLElement(yylineno))->appendChild($2)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeXMLElement(yylineno))->appendChild($2)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
@@ -1218,10 +1563,12 @@ xml_lt:
 
 xml_name:
     t_XML_NAME_FRAGMENT {
-      $$ = new NodeXMLName("", $1, yylineno);
+      $$ = new (NODE_ARENA) NodeXMLName("", $1, yylineno);
+      NODE_LOCATE($$, @$);
     }
 |   t_XML_NAME_FRAGMENT t_COLON t_XML_NAME_FRAGMENT {
-      $$ = new NodeXMLName($1, $3, yylineno);
+      $$ = new (NODE_ARENA) NodeXMLName($1, $3, yylineno);
+      NODE_LOCATE($$, @$);
     }
 ;
 
@@ -1232,16 +1579,20 @@ xml_tag_name:
 
 xml_element_content:
     /* empty */ {
-      $$ = new NodeXMLContentList(yylineno);
+      $$ = new (NODE_ARENA) NodeXMLContentList(yylineno);
+      NODE_LOCATE($$, @$);
     }
 |   xml_cdata_xml_content {
-      $$ = (new NodeXMLContentList(yylineno))->appendChild($1);
+      $$ = (new (NODE_ARENA) NodeXMLContentList(yylineno))->appendChild($1);
+      NODE_LOCATE($$, @$);
     }
 |   xml_element_content xml_element_content_tag xml_cdata_xml_content {
       $$ = $1->appendChild($2)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   xml_element_content xml_element_content_tag {
       $$ = $1->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 ;
 
@@ -1249,110 +1600,136 @@ xml_element_content_tag:
     xml_element
 |   xml_embedded_expression
 |   t_XML_COMMENT {
-      $$ = new NodeXMLComment($1, yylineno);
+      $$ = new (NODE_ARENA) NodeXMLComment($1, yylineno);
       free($1);
+      NODE_LOCATE($$, @$);
     }
 |   t_XML_PI {
-      $$ = new NodeXMLPI($1, yylineno);
+      $$ = new (NODE_ARENA) NodeXMLPI($1, yylineno);
       free($1);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 xml_attribute_list_opt:
     /* empty */ {
-      $$ = new NodeXMLAttributeList(yylineno);
+      $$ = new (NODE_ARENA) NodeXMLAttributeList(yylineno);
+      NODE_LOCATE($$, @$);
     }
 |   xml_attribute_list
 ;
 
 xml_attribute_list:
     t_XML_WHITESPACE {
-      $$ = new NodeXMLAttributeList(yylineno);
+      free($1);
+      $$ = new (NODE_ARENA) NodeXMLAttributeList(yylineno);
+      NODE_LOCATE($$, @$);
+    }
+|   xml_attribute_list t_XML_WHITESPACE {
+      free($2);
+      $$ = $1;
     }
-|   xml_attribute_list t_XML_WHITESPACE
 |   xml_attribute_list xml_name t_ASSIGN xml_attribute_value {
-      $$ = $1->appendChild((new NodeXMLAttribute(yylineno))->appendChild($2)->appendChild($4));
+      $$ = $1->appendChild((new (NODE_ARENA) NodeXMLAttribute(yylineno))->appendChild($2)->appendChild($4));
+      NODE_LOCATE($$, @$);
     }
 ;
 
 xml_attribute_value:
     t_XML_APOS xml_cdata_no_apos t_XML_APOS {
       $$ = $2;
+      NODE_LOCATE($$, @$);
     }
 |   t_XML_QUOTE xml_cdata_no_quote t_XML_QUOTE {
       $$ = $2;
+      NODE_LOCATE($$, @$);
     }
 |   xml_embedded_expression {
       $$ = $1;
+      NODE_LOCATE($$, @$);
     }
 ;
 
 xml_cdata_no_quote:
     /* empty */ {
-      $$ = new NodeXMLTextData();
+      $$ = new (NODE_ARENA) NodeXMLTextData();
+      NODE_LOCATE($$, @$);
     }
 |   xml_cdata_no_quote xml_cdata_fragment_attr {
       $$ = $1;
       static_cast<NodeXMLTextData*>($$)->appendData($2);
       free($2);
+      NODE_LOCATE($$, @$);
     }
 |   xml_cdata_no_quote t_XML_APOS {
       $$ = $1;
       static_cast<NodeXMLTextData*>($$)->appendData("'");
+      NODE_LOCATE($$, @$);
     }
 ;
 
 xml_cdata_no_apos:
     /* empty */ {
-      $$ = new NodeXMLTextData();
+      $$ = new (NODE_ARENA) NodeXMLTextData();
+      NODE_LOCATE($$, @$);
     }
 |   xml_cdata_no_apos xml_cdata_fragment_attr {
       $$ = $1;
       static_cast<NodeXMLTextData*>($$)->appendData($2);
       free($2);
+      NODE_LOCATE($$, @$);
     }
 |   xml_cdata_no_apos t_XML_QUOTE {
       $$ = $1;
       static_cast<NodeXMLTextData*>($$)->appendData("\"");
+      NODE_LOCATE($$, @$);
     }
 ;
 
 xml_cdata_xml_content:
     xml_cdata_fragment {
-      $$ = new NodeXMLTextData(yylineno);
+      $$ = new (NODE_ARENA) NodeXMLTextData(yylineno);
       static_cast<NodeXMLTextData*>($$)->appendData($1);
       free($1);
+      NODE_LOCATE($$, @$);
     }
 |   t_XML_APOS {
-      $$ = new NodeXMLTextData(yylineno);
+      $$ = new (NODE_ARENA) NodeXMLTextData(yylineno);
       static_cast<NodeXMLTextData*>($$)->appendData("'");
+      NODE_LOCATE($$, @$);
     }
 |   t_XML_QUOTE {
-      $$ = new NodeXMLTextData(yylineno);
+      $$ = new (NODE_ARENA) NodeXMLTextData(yylineno);
       static_cast<NodeXMLTextData*>($$)->appendData("\"");
+      NODE_LOCATE($$, @$);
     }
 |   t_XML_WHITESPACE {
-      $$ = new NodeXMLTextData(yylineno);
+      $$ = new (NODE_ARENA) NodeXMLTextData(yylineno);
       static_cast<NodeXMLTextData*>($$)->appendData($1, true);
       free($1);
+      NODE_LOCATE($$, @$);
     }
 |   xml_cdata_xml_content xml_cdata_fragment {
       $$ = $1;
       static_cast<NodeXMLTextData*>($$)->appendData($2);
       free($2);
+      NODE_LOCATE($$, @$);
     }
 |   xml_cdata_xml_content t_XML_APOS {
       $$ = $1;
       static_cast<NodeXMLTextData*>($$)->appendData("'");
+      NODE_LOCATE($$, @$);
     }
 |   xml_cdata_xml_content t_XML_QUOTE {
       $$ = $1;
       static_cast<NodeXMLTextData*>($$)->appendData("\"");
+      NODE_LOCATE($$, @$);
     }
 |   xml_cdata_xml_content t_XML_WHITESPACE {
       $$ = $1;
       static_cast<NodeXMLTextData*>($$)->appendData($2, true);
       free($2);
+      NODE_LOCATE($$, @$);
     }
 ;
 
@@ -1392,13 +1769,16 @@ xml_cdata_fragment_attr:
 xml_embedded_expression:
     t_LCURLY { fbjs_push_xml_embedded_expression_state(yyscanner); } expression t_VIRTUAL_SEMICOLON t_RCURLY {
       fbjs_pop_xml_state(yyscanner);
-      $$ = (new NodeXMLEmbeddedExpression($3->lineno()))->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeXMLEmbeddedExpression($3->lineno()))->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 xml_ws_opt:
     /* empty */
-|   t_XML_WHITESPACE
+|   t_XML_WHITESPACE {
+      free($1);
+    }
 ;
 
 //
@@ -1406,13 +1786,15 @@ xml_ws_opt:
 statement:
     t_XML_DEFAULT_NAMESPACE t_ASSIGN expression semicolon {
       require_support(PARSE_E4X, "E4X not supported");
-      $$ = (new NodeXMLDefaultNamespace(yylineno))->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeXMLDefaultNamespace(yylineno))->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 primary_expression_no_statement:
     property_identifier {
       require_support(PARSE_E4X, "E4X not supported");
       $$ = $1;
+      NODE_LOCATE($$, @$);
     }
 ;
 
@@ -1424,13 +1806,16 @@ property_identifier:
 
 attribute_identifier:
     t_XML_ATTRIBUTE property_selector {
-      $$ = (new NodeStaticAttributeIdentifier(yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeStaticAttributeIdentifier(yylineno))->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   t_XML_ATTRIBUTE qualified_identifier {
-      $$ = (new NodeStaticAttributeIdentifier(yylineno))->appendChild($2);
+      $$ = (new (NODE_ARENA) NodeStaticAttributeIdentifier(yylineno))->appendChild($2);
+      NODE_LOCATE($$, @$);
     }
 |   t_XML_ATTRIBUTE t_LBRACKET expression t_RBRACKET {
-      $$ = (new NodeDynamicAttributeIdentifier(yylineno))->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeDynamicAttributeIdentifier(yylineno))->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
@@ -1441,94 +1826,114 @@ property_selector:
 
 qualified_identifier:
     property_selector t_XML_QUALIFIER property_selector {
-      $$ = (new NodeStaticQualifiedIdentifier($1->lineno()))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeStaticQualifiedIdentifier($1->lineno()))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   property_selector t_XML_QUALIFIER t_LBRACKET expression t_RBRACKET {
-      $$ = (new NodeDynamicQualifiedIdentifier($1->lineno()))->appendChild($1)->appendChild($4);
+      $$ = (new (NODE_ARENA) NodeDynamicQualifiedIdentifier($1->lineno()))->appendChild($1)->appendChild($4);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 wildcard_identifier:
     t_MULT {
-      $$ = new NodeWildcardIdentifier(yylineno);
+      $$ = new (NODE_ARENA) NodeWildcardIdentifier(yylineno);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 member_expression:
     member_expression t_PERIOD property_identifier {
       require_support(PARSE_E4X, "E4X not supported");
-      $$ = (new NodeStaticMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeStaticMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   member_expression t_PERIOD t_LPAREN expression t_RPAREN {
       require_support(PARSE_E4X, "E4X not supported");
-      $$ = (new NodeFilteringPredicate(yylineno))->appendChild($1)->appendChild($4);
+      $$ = (new (NODE_ARENA) NodeFilteringPredicate(yylineno))->appendChild($1)->appendChild($4);
+      NODE_LOCATE($$, @$);
     }
 |   member_expression t_XML_DESCENDENT identifier {
       require_support(PARSE_E4X, "E4X not supported");
-      $$ = (new NodeDescendantExpression(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeDescendantExpression(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   member_expression t_XML_DESCENDENT property_identifier {
       require_support(PARSE_E4X, "E4X not supported");
-      $$ = (new NodeDescendantExpression(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeDescendantExpression(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 member_expression_no_statement:
     member_expression_no_statement t_PERIOD property_identifier {
       require_support(PARSE_E4X, "E4X not supported");
-      $$ = (new NodeStaticMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeStaticMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   member_expression_no_statement t_PERIOD t_LPAREN expression t_RPAREN {
       require_support(PARSE_E4X, "E4X not supported");
-      $$ = (new NodeFilteringPredicate(yylineno))->appendChild($1)->appendChild($4);
+      $$ = (new (NODE_ARENA) NodeFilteringPredicate(yylineno))->appendChild($1)->appendChild($4);
+      NODE_LOCATE($$, @$);
     }
 |   member_expression_no_statement t_XML_DESCENDENT identifier {
       require_support(PARSE_E4X, "E4X not supported");
-      $$ = (new NodeDescendantExpression(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeDescendantExpression(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   member_expression_no_statement t_XML_DESCENDENT property_identifier {
       require_support(PARSE_E4X, "E4X not supported");
-      $$ = (new NodeDescendantExpression(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeDescendantExpression(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 call_expression:
     call_expression t_PERIOD property_identifier {
       require_support(PARSE_E4X, "E4X not supported");
-      $$ = (new NodeStaticMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeStaticMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   call_expression t_PERIOD t_LPAREN expression t_RPAREN {
       require_support(PARSE_E4X, "E4X not supported");
-      $$ = (new NodeFilteringPredicate(yylineno))->appendChild($1)->appendChild($4);
+      $$ = (new (NODE_ARENA) NodeFilteringPredicate(yylineno))->appendChild($1)->appendChild($4);
+      NODE_LOCATE($$, @$);
     }
 |   call_expression t_XML_DESCENDENT identifier {
       require_support(PARSE_E4X, "E4X not supported");
-      $$ = (new NodeDescendantExpression(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeDescendantExpression(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   call_expression t_XML_DESCENDENT property_identifier {
       require_support(PARSE_E4X, "E4X not supported");
-      $$ = (new NodeDescendantExpression(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeDescendantExpression(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
 
 call_expression_no_statement:
     call_expression_no_statement t_PERIOD property_identifier {
       require_support(PARSE_E4X, "E4X not supported");
-      $$ = (new NodeStaticMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeStaticMemberExpression(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   call_expression_no_statement t_PERIOD t_LPAREN expression t_RPAREN {
       require_support(PARSE_E4X, "E4X not supported");
-      $$ = (new NodeFilteringPredicate(yylineno))->appendChild($1)->appendChild($4);
+      $$ = (new (NODE_ARENA) NodeFilteringPredicate(yylineno))->appendChild($1)->appendChild($4);
+      NODE_LOCATE($$, @$);
     }
 |   call_expression_no_statement t_XML_DESCENDENT identifier {
       require_support(PARSE_E4X, "E4X not supported");
-      $$ = (new NodeDescendantExpression(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeDescendantExpression(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 |   call_expression_no_statement t_XML_DESCENDENT property_identifier {
       require_support(PARSE_E4X, "E4X not supported");
-      $$ = (new NodeDescendantExpression(yylineno))->appendChild($1)->appendChild($3);
+      $$ = (new (NODE_ARENA) NodeDescendantExpression(yylineno))->appendChild($1)->appendChild($3);
+      NODE_LOCATE($$, @$);
     }
 ;
+/* } FBJS_E4X */
 
 %%
 
@@ -0,0 +1,142 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#include "pipeline.hpp"
+#include <stdexcept>
+using namespace std;
+using namespace fbjs;
+
+Pipeline::Pipeline(unsigned int threads /* = 0 */) : _pool(threads) {}
+
+Pipeline::~Pipeline() {
+  for (vector<pass_t>::iterator ii = _passes.begin(); ii != _passes.end(); ++ii) {
+    delete ii->walker;
+  }
+}
+
+void Pipeline::addPass(NodeWalker* walker, pipeline_pass_enum scope /* = PASS_PROGRAM */) {
+  pass_t pass = {walker, scope};
+  _passes.push_back(pass);
+}
+
+void Pipeline::run(NodeProgram* program) {
+  const pass_t* ii = _passes.empty() ? NULL : &_passes[0];
+  const pass_t* end = ii + _passes.size();
+  while (ii != end) {
+    if (ii->scope == PASS_PROGRAM) {
+      ii->walker->walk(program);
+      ++ii;
+    } else {
+      const pass_t* first = ii;
+      while (ii != end && ii->scope == PASS_SCOPE_LOCAL) {
+        ++ii;
+      }
+      this->runScopeLocal(program, first, ii);
+    }
+  }
+}
+
+//
+// Runs passes [first, last) over every function body, deepest first, and then
+// over what's left outside of any function.
+void Pipeline::runScopeLocal(NodeProgram* program, const pass_t* first, const pass_t* last) {
+  vector<vector<Node*> > levels;
+  Pipeline::collectFunctions(program, 0, levels);
+
+  stage_t stage;
+  stage.first = first;
+  stage.last = last;
+  stage.failed = false;
+  pthread_mutex_init(&stage.lock, NULL);
+  for (size_t depth = levels.size(); depth > 0 && !stage.failed; --depth) {
+    stage.functions = &levels[depth - 1];
+    _pool.run(Pipeline::runFunction, &stage, stage.functions->size());
+  }
+  pthread_mutex_destroy(&stage.lock);
+  if (stage.failed) {
+    throw runtime_error(stage.error);
+  }
+  Node* root = program;
+  Pipeline::walkScoped(first, last, root);
+}
+
+//
+// Walks `root` with scoped clones of the passes, fused into one traversal when
+// there's more than one
+void Pipeline::walkScoped(const pass_t* first, const pass_t* last, Node*& root) {
+  auto_ptr<NodeWalker> walker;
+  if (last - first == 1) {
+    walker.reset(first->walker->clone());
+  } else {
+    CompositeWalker* composite = new CompositeWalker();
+    walker.reset(composite);
+    for (const pass_t* ii = first; ii != last; ++ii) {
+      composite->add(ii->walker->clone());
+    }
+  }
+  walker->_scoped = true;
+  root = walker->walk(root);
+}
+
+void Pipeline::collectFunctions(Node* node, size_t depth, vector<vector<Node*> >& levels) {
+  node_list_t& children = node->childNodes();
+  bool function = node->kind() == KIND_FUNCTION_DECLARATION || node->kind() == KIND_FUNCTION_EXPRESSION;
+  for (size_t ii = 0; ii < children.size(); ++ii) {
+    if (children[ii] == NULL) {
+      continue;
+    }
+    if (function && ii + 1 == children.size()) {
+      if (levels.size() <= depth) {
+        levels.resize(depth + 1);
+      }
+      levels[depth].push_back(node);
+      Pipeline::collectFunctions(children[ii], depth + 1, levels);
+    } else {
+      Pipeline::collectFunctions(children[ii], depth, levels);
+    }
+  }
+}
+
+void Pipeline::runFunction(void* context, unsigned int worker, size_t index) {
+  stage_t* stage = static_cast<stage_t*>(context);
+  Node* function = (*stage->functions)[index];
+  Node*& body = function->childNodes()[function->childNodes().size() - 1];
+  try {
+    Pipeline::walkScoped(stage->first, stage->last, body);
+    if (body == NULL) {
+      body = new NodeStatementList(function->lineno());
+    }
+    function->invalidateHash();
+  } catch (const exception& e) {
+    pthread_mutex_lock(&stage->lock);
+    if (!stage->failed) {
+      stage->failed = true;
+      stage->error = e.what();
+    }
+    pthread_mutex_unlock(&stage->lock);
+  } catch (...) {
+    pthread_mutex_lock(&stage->lock);
+    if (!stage->failed) {
+      stage->failed = true;
+      stage->error = "unknown error in pipeline pass";
+    }
+    pthread_mutex_unlock(&stage->lock);
+  }
+}
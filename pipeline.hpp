@@ -0,0 +1,84 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#pragma once
+#include <string>
+#include <vector>
+#include "node.hpp"
+#include "walker.hpp"
+#include "thread_pool.hpp"
+
+namespace fbjs {
+
+  //
+  enum pipeline_pass_enum {
+    PASS_PROGRAM = 0,
+    PASS_SCOPE_LOCAL = 1,
+  };
+
+  //
+  // Pipeline: runs an ordered list of walkers over a program. Program passes
+  // walk the whole tree, one after the other, on the calling thread. Each run
+  // of consecutive scope-local passes is applied to every function body on its
+  // own, with the bodies spread over a thread pool.
+  //
+  // A scope-local pass only looks at the function body it was started on: it
+  // sees nested functions' names and arguments but not their bodies, which get
+  // their own turn first. Innermost bodies are done before the bodies enclosing
+  // them, so a pass may replace or remove whole functions. Consecutive
+  // scope-local passes are fused with a CompositeWalker into a single traversal
+  // of each body, so they must follow its rules. Scope-local walkers are
+  // clone()d for every body, must implement clone() even if they're in-place
+  // and must not touch anything outside the body they were given. No pass may
+  // replace the program itself.
+  class Pipeline {
+    public:
+      Pipeline(unsigned int threads = 0);
+      ~Pipeline();
+
+      // Takes ownership of `walker`
+      void addPass(NodeWalker* walker, pipeline_pass_enum scope = PASS_PROGRAM);
+      void run(NodeProgram* program);
+
+    protected:
+      struct pass_t {
+        NodeWalker* walker;
+        pipeline_pass_enum scope;
+      };
+      struct stage_t {
+        const pass_t* first;
+        const pass_t* last;
+        const std::vector<Node*>* functions;
+        pthread_mutex_t lock;
+        std::string error;
+        bool failed;
+      };
+      ThreadPool _pool;
+      std::vector<pass_t> _passes;
+      void runScopeLocal(NodeProgram* program, const pass_t* first, const pass_t* last);
+      static void walkScoped(const pass_t* first, const pass_t* last, Node*& root);
+      static void collectFunctions(Node* node, size_t depth, std::vector<std::vector<Node*> >& levels);
+      static void runFunction(void* context, unsigned int worker, size_t index);
+
+    private:
+      Pipeline(const Pipeline&);
+      Pipeline& operator= (const Pipeline&);
+  };
+}
@@ -0,0 +1,460 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#include "scope.hpp"
+#include <algorithm>
+#include <string.h>
+using namespace std;
+using namespace fbjs;
+
+// Reserved words and the few names which mean something without a binding,
+// sorted for binary search. Mangled names are never any of these.
+static const char* const scope_reserved[] = {
+  "abstract", "arguments", "boolean", "break", "byte", "case", "catch", "char",
+  "class", "const", "continue", "debugger", "default", "delete", "do",
+  "double", "else", "enum", "eval", "export", "extends", "false", "final",
+  "finally", "float", "for", "function", "goto", "if", "implements", "import",
+  "in", "instanceof", "int", "interface", "let", "long", "native", "new",
+  "null", "package", "private", "protected", "public", "return", "short",
+  "static", "super", "switch", "synchronized", "this", "throw", "throws",
+  "transient", "true", "try", "typeof", "var", "void", "volatile", "while",
+  "with", "yield",
+};
+
+static bool scope_reserved_less(const char* left, const char* right) {
+  return strcmp(left, right) < 0;
+}
+
+static bool scope_is_reserved(const string& name) {
+  const char* const* end = scope_reserved + sizeof(scope_reserved) / sizeof(scope_reserved[0]);
+  return binary_search(scope_reserved, end, name.c_str(), scope_reserved_less);
+}
+
+//
+// Binding
+Binding::Binding(Scope* scope, const string& name, binding_kind_enum kind) : _scope(scope), _name(name), _kind(kind),
+  _pinned(kind == BINDING_ARGUMENTS || kind == BINDING_IMPLICIT) {}
+
+bool Binding::renameable() const {
+  return !_pinned && !_declarations.empty() && !_scope->dynamic();
+}
+
+//
+// Scope
+Scope::Scope(scope_kind_enum kind, Node* node, Scope* parent) : _kind(kind), _node(node), _parent(parent),
+  _with(false), _eval(false), _dynamic(false) {
+  if (parent) {
+    parent->_children.push_back(this);
+  }
+}
+
+Scope::~Scope() {
+  for (vector<Scope*>::iterator ii = _children.begin(); ii != _children.end(); ++ii) {
+    delete *ii;
+  }
+  for (vector<Binding*>::iterator ii = _bindings.begin(); ii != _bindings.end(); ++ii) {
+    delete *ii;
+  }
+}
+
+Binding* Scope::declare(const string& name, binding_kind_enum kind) {
+  map<string, Binding*>::iterator ii = _index.find(name);
+  if (ii != _index.end()) {
+    // A parameter or var of the same name hides a function expression's own
+    // name. Either way it's one binding, since every use resolves to it.
+    if (ii->second->_kind == BINDING_CALLEE) {
+      ii->second->_kind = kind;
+    }
+    return ii->second;
+  }
+  Binding* binding = new Binding(this, name, kind);
+  try {
+    _bindings.push_back(binding);
+  } catch (...) {
+    delete binding;
+    throw;
+  }
+  _index[name] = binding;
+  return binding;
+}
+
+Binding* Scope::find(const string& name) const {
+  map<string, Binding*>::const_iterator ii = _index.find(name);
+  return ii == _index.end() ? NULL : ii->second;
+}
+
+Binding* Scope::lookup(const string& name) const {
+  for (const Scope* scope = this; scope; scope = scope->_parent) {
+    Binding* binding = scope->find(name);
+    if (binding) {
+      return binding;
+    }
+  }
+  return NULL;
+}
+
+// Renames bindings of this scope all at once, so one can take a name another
+// is giving up.
+void Scope::rename(const vector<pair<Binding*, string> >& names) {
+  for (vector<pair<Binding*, string> >::const_iterator ii = names.begin(); ii != names.end(); ++ii) {
+    _index.erase(ii->first->_name);
+  }
+  for (vector<pair<Binding*, string> >::const_iterator ii = names.begin(); ii != names.end(); ++ii) {
+    Binding* binding = ii->first;
+    binding->_name = ii->second;
+    for (vector<NodeIdentifier*>::iterator jj = binding->_declarations.begin(); jj != binding->_declarations.end(); ++jj) {
+      (*jj)->rename(ii->second);
+    }
+    for (vector<NodeIdentifier*>::iterator jj = binding->_references.begin(); jj != binding->_references.end(); ++jj) {
+      (*jj)->rename(ii->second);
+    }
+    _index[ii->second] = binding;
+  }
+}
+
+//
+// ScopeBuilder: the traversal behind ScopeAnalysis. Declarations are bound as
+// they're seen; every other identifier is kept with the scope it was found in
+// and resolved at the end, when each scope has all of its declarations.
+namespace fbjs {
+  class ScopeBuilder: public StaticNodeWalker<ScopeBuilder> {
+    protected:
+      struct use_t {
+        NodeIdentifier* identifier;
+        Scope* scope;
+      };
+      ScopeAnalysis& _analysis;
+      Scope* _scope;
+      vector<use_t> _uses;
+
+      Scope* enter(scope_kind_enum kind, Node* node) {
+        Scope* scope = new Scope(kind, node, _scope);
+        _analysis._scopes[node] = scope;
+        return scope;
+      }
+
+      // Where var and function declarations go
+      Scope* hoisted() const {
+        Scope* scope = _scope;
+        while (scope->_kind == SCOPE_CATCH) {
+          scope = scope->_parent;
+        }
+        return scope;
+      }
+
+      void use(NodeIdentifier* identifier) {
+        use_t use = {identifier, _scope};
+        _uses.push_back(use);
+      }
+
+      // Marks `binding` as used from `from` in each scope between the two
+      static void useFrom(Binding* binding, Scope* from) {
+        for (Scope* scope = from; scope != binding->_scope; scope = scope->_parent) {
+          if (!scope->_outer.insert(binding).second) {
+            // Already there, and so in every scope above it too
+            break;
+          }
+        }
+      }
+
+      void declare(Node* node, binding_kind_enum kind, Scope* scope) {
+        if (node && node->kind() == KIND_TYPEHINT) {
+          node = node->childNodes().front();
+        }
+        if (node == NULL || node->kind() != KIND_IDENTIFIER) {
+          return;
+        }
+        NodeIdentifier* identifier = static_cast<NodeIdentifier*>(node);
+        Binding* binding = scope->declare(identifier->name(), kind);
+        for (Scope* ii = _scope; ii != scope; ii = ii->_parent) {
+          Binding* shadow = ii->find(identifier->name());
+          if (shadow) {
+            // `var e = 1` in catch (e) declares a variable of the function but
+            // assigns to the exception. Neither name can change.
+            shadow->_pinned = binding->_pinned = true;
+            use(identifier);
+            return;
+          }
+        }
+        binding->_declarations.push_back(identifier);
+        _analysis._identifiers[identifier] = binding;
+        useFrom(binding, _scope);
+      }
+
+      void function(Node& node, Node* callee) {
+        node_list_t& children = node.childNodes();
+        Scope* outer = _scope;
+        _scope = enter(SCOPE_FUNCTION, &node);
+        declare(callee, BINDING_CALLEE, _scope);
+        node_list_t& args = children[1]->childNodes();
+        for (size_t ii = 0; ii < args.size(); ++ii) {
+          declare(args[ii], BINDING_PARAMETER, _scope);
+        }
+        dispatch(children[2]);
+        _scope = outer;
+      }
+
+      // Property names after a `.` aren't variables, though E4X selectors
+      // can have some in them
+      void property(Node* node) {
+        if (node && node->kind() != KIND_IDENTIFIER) {
+          dispatch(node);
+        }
+      }
+
+    public:
+      using StaticNodeWalker<ScopeBuilder>::visit;
+
+      ScopeBuilder(ScopeAnalysis& analysis, Scope* root) : _analysis(analysis), _scope(root) {}
+
+      void resolve() {
+        for (vector<use_t>::iterator ii = _uses.begin(); ii != _uses.end(); ++ii) {
+          const string& name = ii->identifier->name();
+          Binding* binding = NULL;
+          for (Scope* scope = ii->scope; binding == NULL; scope = scope->_parent) {
+            binding = scope->find(name);
+            if (binding == NULL && scope->_kind == SCOPE_FUNCTION && name == "arguments") {
+              binding = scope->declare(name, BINDING_ARGUMENTS);
+            } else if (binding == NULL && scope->_parent == NULL) {
+              binding = scope->declare(name, BINDING_IMPLICIT);
+            }
+          }
+          binding->_references.push_back(ii->identifier);
+          _analysis._identifiers[ii->identifier] = binding;
+          useFrom(binding, ii->scope);
+        }
+      }
+
+      void visit(NodeIdentifier& node) {
+        use(&node);
+      }
+
+      void visit(NodeFunctionDeclaration& node) {
+        declare(node.childNodes()[0], BINDING_FUNCTION, hoisted());
+        function(node, NULL);
+      }
+
+      void visit(NodeFunctionExpression& node) {
+        function(node, node.childNodes()[0]);
+      }
+
+      void visit(NodeVarDeclaration& node) {
+        node_list_t& children = node.childNodes();
+        for (size_t ii = 0; ii < children.size(); ++ii) {
+          Node* child = children[ii];
+          if (child && child->kind() == KIND_ASSIGNMENT) {
+            declare(child->childNodes()[0], BINDING_VAR, hoisted());
+            dispatch(child->childNodes()[1]);
+          } else {
+            declare(child, BINDING_VAR, hoisted());
+          }
+        }
+      }
+
+      void visit(NodeTypehint& node) {
+        dispatch(node.childNodes()[0]);
+      }
+
+      void visit(NodeTry& node) {
+        node_list_t& children = node.childNodes();
+        dispatch(children[0]);
+        if (children[1]) {
+          Scope* outer = _scope;
+          _scope = enter(SCOPE_CATCH, &node);
+          declare(children[1], BINDING_CATCH, _scope);
+          dispatch(children[2]);
+          _scope = outer;
+        }
+        dispatch(children[3]);
+      }
+
+      void visit(NodeWith& node) {
+        _scope->_with = true;
+        visitChildren(node);
+      }
+
+      void visit(NodeFilteringPredicate& node) {
+        // Names in the predicate are looked up on each XML item first
+        _scope->_with = true;
+        visitChildren(node);
+      }
+
+      void visit(NodeFunctionCall& node) {
+        Node* callee = node.childNodes()[0];
+        if (callee && callee->kind() == KIND_IDENTIFIER && static_cast<NodeIdentifier*>(callee)->name() == "eval") {
+          _scope->_eval = true;
+        }
+        visitChildren(node);
+      }
+
+      void visit(NodeStaticMemberExpression& node) {
+        dispatch(node.childNodes()[0]);
+        property(node.childNodes()[1]);
+      }
+
+      void visit(NodeDescendantExpression& node) {
+        dispatch(node.childNodes()[0]);
+        property(node.childNodes()[1]);
+      }
+
+      void visit(NodeStaticAttributeIdentifier& node) {
+        property(node.childNodes()[0]);
+      }
+
+      void visit(NodeStaticQualifiedIdentifier& node) {
+        dispatch(node.childNodes()[0]);
+        property(node.childNodes()[1]);
+      }
+
+      void visit(NodeObjectLiteralProperty& node) {
+        dispatch(node.childNodes()[1]);
+      }
+
+      void visit(NodeLabel& node) {
+        dispatch(node.childNodes()[1]);
+      }
+
+      void visit(NodeStatementWithExpression& node) {
+        if (node.statementType() != BREAK && node.statementType() != CONTINUE) {
+          visitChildren(node);
+        }
+      }
+  };
+}
+
+//
+// ScopeAnalysis
+ScopeAnalysis::ScopeAnalysis(Node* root) : _root(new Scope(SCOPE_PROGRAM, root, NULL)) {
+  try {
+    _scopes[root] = _root;
+    ScopeBuilder builder(*this, _root);
+    builder.dispatch(root);
+    builder.resolve();
+  } catch (...) {
+    delete _root;
+    throw;
+  }
+
+  // Whatever dynamic lookups can see, they can see from nested scopes too
+  for (map<const Node*, Scope*>::iterator ii = _scopes.begin(); ii != _scopes.end(); ++ii) {
+    Scope* scope = ii->second;
+    if (scope->_with || scope->_eval) {
+      for (; scope && !scope->_dynamic; scope = scope->_parent) {
+        scope->_dynamic = true;
+      }
+    }
+  }
+  for (map<const Node*, Scope*>::iterator ii = _scopes.begin(); ii != _scopes.end(); ++ii) {
+    const vector<Binding*>& bindings = ii->second->_bindings;
+    for (vector<Binding*>::const_iterator jj = bindings.begin(); jj != bindings.end(); ++jj) {
+      if ((*jj)->pinned()) {
+        for (Scope* scope = ii->second->_parent; scope; scope = scope->_parent) {
+          scope->_pinned_below.insert((*jj)->name());
+        }
+      }
+    }
+  }
+}
+
+ScopeAnalysis::~ScopeAnalysis() {
+  delete _root;
+}
+
+Scope* ScopeAnalysis::scope(const Node* node) const {
+  map<const Node*, Scope*>::const_iterator ii = _scopes.find(node);
+  return ii == _scopes.end() ? NULL : ii->second;
+}
+
+Binding* ScopeAnalysis::binding(const NodeIdentifier* identifier) const {
+  map<const NodeIdentifier*, Binding*>::const_iterator ii = _identifiers.find(identifier);
+  return ii == _identifiers.end() ? NULL : ii->second;
+}
+
+//
+// IdentifierMangler
+IdentifierMangler::IdentifierMangler(bool toplevel /* = false */) : _toplevel(toplevel), _renamed(0) {}
+
+Node* IdentifierMangler::walk(Node* root) {
+  ScopeAnalysis analysis(root);
+  this->mangle(analysis);
+  return root;
+}
+
+void IdentifierMangler::mangle(ScopeAnalysis& analysis) {
+  _renamed = 0;
+  this->mangleScope(analysis.root());
+}
+
+// The `index`th name in order of length: a-z, A-Z, $ and _, then the same
+// followed by any of those or a digit, and so on
+static string mangler_name(size_t index) {
+  static const char first[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ$_";
+  static const char rest[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ$_0123456789";
+  static const size_t first_size = sizeof(first) - 1;
+  static const size_t rest_size = sizeof(rest) - 1;
+  string name(1, first[index % first_size]);
+  index /= first_size;
+  while (index) {
+    --index;
+    name += rest[index % rest_size];
+    index /= rest_size;
+  }
+  return name;
+}
+
+static bool mangler_more_uses(const Binding* left, const Binding* right) {
+  return left->uses() > right->uses();
+}
+
+void IdentifierMangler::mangleScope(Scope* scope) {
+  if (!scope->_dynamic && (scope->_kind != SCOPE_PROGRAM || _toplevel)) {
+    // Enclosing scopes are done, so the names to stay clear of are final
+    set<string> taken(scope->_pinned_below);
+    for (set<Binding*>::const_iterator ii = scope->_outer.begin(); ii != scope->_outer.end(); ++ii) {
+      taken.insert((*ii)->name());
+    }
+    vector<Binding*> bindings;
+    for (vector<Binding*>::const_iterator ii = scope->_bindings.begin(); ii != scope->_bindings.end(); ++ii) {
+      if ((*ii)->renameable()) {
+        bindings.push_back(*ii);
+      } else {
+        taken.insert((*ii)->name());
+      }
+    }
+    stable_sort(bindings.begin(), bindings.end(), mangler_more_uses);
+
+    vector<pair<Binding*, string> > names;
+    size_t next = 0;
+    for (vector<Binding*>::const_iterator ii = bindings.begin(); ii != bindings.end(); ++ii) {
+      string name;
+      do {
+        name = mangler_name(next++);
+      } while (scope_is_reserved(name) || taken.find(name) != taken.end());
+      if (name != (*ii)->name()) {
+        names.push_back(make_pair(*ii, name));
+      }
+    }
+    scope->rename(names);
+    _renamed += names.size();
+  }
+  for (vector<Scope*>::const_iterator ii = scope->_children.begin(); ii != scope->_children.end(); ++ii) {
+    this->mangleScope(*ii);
+  }
+}
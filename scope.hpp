@@ -0,0 +1,201 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#pragma once
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "node.hpp"
+#include "walker.hpp"
+
+namespace fbjs {
+
+  class Scope;
+  class ScopeAnalysis;
+  class IdentifierMangler;
+
+  //
+  enum scope_kind_enum {
+    SCOPE_PROGRAM,
+    SCOPE_FUNCTION,
+    SCOPE_CATCH,
+  };
+
+  //
+  enum binding_kind_enum {
+    BINDING_VAR,
+    BINDING_FUNCTION,
+    BINDING_PARAMETER,
+    BINDING_CATCH,
+    BINDING_CALLEE, // name of a function expression, bound inside of it
+    BINDING_ARGUMENTS,
+    BINDING_IMPLICIT, // used but never declared, which makes it a global
+  };
+
+  //
+  // Binding: a name declared in a scope, with every identifier which declares
+  // it or refers to it. A binding is pinned when it can't be renamed no matter
+  // where it lives: implicit ones, and the odd `var e` inside of `catch (e)`
+  // which declares one name and assigns to another.
+  class Binding {
+    protected:
+      Scope* _scope;
+      std::string _name;
+      binding_kind_enum _kind;
+      bool _pinned;
+      std::vector<NodeIdentifier*> _declarations;
+      std::vector<NodeIdentifier*> _references;
+      friend class Scope;
+      friend class ScopeBuilder;
+      Binding(Scope* scope, const std::string& name, binding_kind_enum kind);
+
+    public:
+      Scope* scope() const { return _scope; }
+      const std::string& name() const { return _name; }
+      binding_kind_enum kind() const { return _kind; }
+      bool pinned() const { return _pinned; }
+      const std::vector<NodeIdentifier*>& declarations() const { return _declarations; }
+      const std::vector<NodeIdentifier*>& references() const { return _references; }
+      size_t uses() const { return _declarations.size() + _references.size(); }
+
+      // Whether renaming this binding everywhere keeps the program's meaning,
+      // which it does unless it's pinned or its scope is dynamic.
+      bool renameable() const;
+
+    private:
+      Binding(const Binding&);
+      Binding& operator= (const Binding&);
+  };
+
+  //
+  // Scope: the program, a function, or the block of a catch clause, which
+  // binds only the exception. var and function declarations belong to the
+  // nearest function (or the program) as they do at runtime. A scope is
+  // dynamic when names in it can be looked up at runtime by something the
+  // analysis can't see: a `with` or filtering predicate, or a call to eval,
+  // in it or in a scope nested in it.
+  class Scope {
+    protected:
+      scope_kind_enum _kind;
+      Node* _node;
+      Scope* _parent;
+      std::vector<Scope*> _children;
+      std::vector<Binding*> _bindings;
+      std::map<std::string, Binding*> _index;
+      std::set<Binding*> _outer;
+      std::set<std::string> _pinned_below; // names of pinned bindings nested in here
+      bool _with;
+      bool _eval;
+      bool _dynamic;
+      friend class ScopeAnalysis;
+      friend class ScopeBuilder;
+      friend class IdentifierMangler;
+      Scope(scope_kind_enum kind, Node* node, Scope* parent);
+      ~Scope();
+      Binding* declare(const std::string& name, binding_kind_enum kind);
+      void rename(const std::vector<std::pair<Binding*, std::string> >& names);
+
+    public:
+      scope_kind_enum kind() const { return _kind; }
+
+      // NodeProgram (or whatever was analysed), a function, or a NodeTry
+      Node* node() const { return _node; }
+      Scope* parent() const { return _parent; }
+      const std::vector<Scope*>& children() const { return _children; }
+
+      // Every binding, in the order they were first declared
+      const std::vector<Binding*>& bindings() const { return _bindings; }
+
+      // A binding of this scope alone, and one visible from here
+      Binding* find(const std::string& name) const;
+      Binding* lookup(const std::string& name) const;
+
+      // Bindings of enclosing scopes, globals included, which are used in this
+      // scope or in one nested in it. Nothing declared here may be named like
+      // them without changing what those uses refer to.
+      const std::set<Binding*>& outerBindings() const { return _outer; }
+
+      bool containsWith() const { return _with; }
+      bool callsEval() const { return _eval; }
+      bool dynamic() const { return _dynamic; }
+
+    private:
+      Scope(const Scope&);
+      Scope& operator= (const Scope&);
+  };
+
+  //
+  // ScopeAnalysis: builds the scope tree of a program and an index from each
+  // identifier naming a variable to its binding, in a single traversal.
+  // Property names, labels and the like aren't variables, so they're in
+  // neither. References are resolved once the whole tree has been seen, so
+  // hoisting needs no extra pass. The analysis describes the tree as it was;
+  // rebuild it after changing the tree other than through IdentifierMangler.
+  class ScopeAnalysis {
+    protected:
+      Scope* _root;
+      std::map<const Node*, Scope*> _scopes;
+      std::map<const NodeIdentifier*, Binding*> _identifiers;
+      friend class ScopeBuilder;
+
+    public:
+      ScopeAnalysis(Node* root);
+      ~ScopeAnalysis();
+      Scope* root() const { return _root; }
+
+      // The scope started by a program, function or try node, if any
+      Scope* scope(const Node* node) const;
+
+      // The binding an identifier declares or refers to, if it's a variable
+      Binding* binding(const NodeIdentifier* identifier) const;
+
+    private:
+      ScopeAnalysis(const ScopeAnalysis&);
+      ScopeAnalysis& operator= (const ScopeAnalysis&);
+  };
+
+  //
+  // IdentifierMangler: renames every binding it safely can to the shortest
+  // name available, scope by scope from the outside in. The bindings used
+  // most get the shortest names, and names are reused freely across scopes
+  // which can't see each other. Dynamic scopes are left alone; so is the
+  // program's own scope unless `toplevel` is set, since its bindings are
+  // globals other scripts may depend on. It can run as a PASS_PROGRAM pass
+  // of a Pipeline.
+  class IdentifierMangler: public InPlaceNodeWalker {
+    protected:
+      bool _toplevel;
+      size_t _renamed;
+      void mangleScope(Scope* scope);
+
+    public:
+      IdentifierMangler(bool toplevel = false);
+
+      // Analyses the tree and mangles it
+      using NodeWalker::walk;
+      virtual Node* walk(Node* root);
+      void mangle(ScopeAnalysis& analysis);
+
+      // How many bindings the last run renamed
+      size_t renamed() const { return _renamed; }
+  };
+}
@@ -0,0 +1,98 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#include "source_map.hpp"
+using namespace std;
+using namespace fbjs;
+
+static const char base64_digits[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+SourceMap::SourceMap(const string& source) : _source(source), _generated_line(1), _generated_column(0),
+  _line_empty(true), _line(0), _column(0) {}
+
+//
+// Mappings must come in output order. Each segment is stored relative to the
+// one before it: generated column, source index (always 0), line, column.
+void SourceMap::addMapping(size_t generated_line, size_t generated_column, unsigned int line, unsigned int column) {
+  if (generated_line > _generated_line) {
+    _mappings.append(generated_line - _generated_line, ';');
+    _generated_line = generated_line;
+    _generated_column = 0;
+    _line_empty = true;
+  }
+  if (!_line_empty) {
+    _mappings += ',';
+  }
+  _line_empty = false;
+  this->appendVLQ(static_cast<long>(generated_column) - static_cast<long>(_generated_column));
+  this->appendVLQ(0);
+  this->appendVLQ(static_cast<long>(line) - 1 - _line);
+  this->appendVLQ(static_cast<long>(column) - _column);
+  _generated_column = generated_column;
+  _line = line - 1;
+  _column = column;
+}
+
+void SourceMap::appendVLQ(long value) {
+  unsigned long vlq = value < 0 ? ((unsigned long)-value << 1) | 1 : (unsigned long)value << 1;
+  do {
+    unsigned int digit = vlq & 31;
+    vlq >>= 5;
+    if (vlq) {
+      digit |= 32;
+    }
+    _mappings += base64_digits[digit];
+  } while (vlq);
+}
+
+const string& SourceMap::mappings() const {
+  return _mappings;
+}
+
+static void json_quote(string& out, const string& str) {
+  static const char hex[] = "0123456789abcdef";
+  out += '"';
+  for (string::const_iterator ii = str.begin(); ii != str.end(); ++ii) {
+    unsigned char c = *ii;
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (c < 0x20) {
+      out += "\\u00";
+      out += hex[c >> 4];
+      out += hex[c & 15];
+    } else {
+      out += c;
+    }
+  }
+  out += '"';
+}
+
+string SourceMap::json(const string& file /* = "" */) const {
+  string out("{\"version\":3,\"file\":");
+  json_quote(out, file);
+  out += ",\"sources\":[";
+  json_quote(out, _source);
+  out += "],\"names\":[],\"mappings\":\"";
+  out += _mappings;
+  out += "\"}";
+  return out;
+}
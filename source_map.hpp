@@ -0,0 +1,50 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#pragma once
+#include <stddef.h>
+#include <string>
+
+namespace fbjs {
+
+  //
+  // SourceMap: a version 3 source map for one rendered program. Node::render
+  // adds a mapping wherever a node with a known position starts, in output
+  // order, and each is encoded as it arrives so the map is ready as soon as
+  // rendering is done. Lines are from 1 and columns from 0 in UTF-16 units,
+  // as on Node.
+  class SourceMap {
+    public:
+      SourceMap(const std::string& source);
+      void addMapping(size_t generated_line, size_t generated_column, unsigned int line, unsigned int column);
+      const std::string& mappings() const;
+      std::string json(const std::string& file = "") const;
+
+    protected:
+      std::string _source;
+      std::string _mappings;
+      size_t _generated_line;
+      size_t _generated_column;
+      bool _line_empty;
+      long _line;
+      long _column;
+      void appendVLQ(long value);
+  };
+}
@@ -0,0 +1,117 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#include "stats.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+using namespace std;
+using namespace fbjs;
+
+__thread NodeStats* NodeStats::_current = NULL;
+
+NodeStats::NodeStats() {
+  this->clear();
+}
+
+void NodeStats::clear() {
+  parses = walks = renders = 0;
+  tokens = 0;
+  nodes = depth = 0;
+  memset(nodes_by_kind, 0, sizeof(nodes_by_kind));
+  node_bytes = string_bytes = rope_bytes = rendered_bytes = 0;
+  lex_seconds = parse_seconds = walk_seconds = render_seconds = 0;
+}
+
+void NodeStats::merge(const NodeStats& that) {
+  parses += that.parses;
+  walks += that.walks;
+  renders += that.renders;
+  tokens += that.tokens;
+  nodes += that.nodes;
+  for (size_t ii = 0; ii < KIND_COUNT; ++ii) {
+    nodes_by_kind[ii] += that.nodes_by_kind[ii];
+  }
+  if (that.depth > depth) {
+    depth = that.depth;
+  }
+  node_bytes += that.node_bytes;
+  string_bytes += that.string_bytes;
+  rope_bytes += that.rope_bytes;
+  rendered_bytes += that.rendered_bytes;
+  lex_seconds += that.lex_seconds;
+  parse_seconds += that.parse_seconds;
+  walk_seconds += that.walk_seconds;
+  render_seconds += that.render_seconds;
+}
+
+//
+// Counts the nodes under `root` and notes its depth. This is a walk of its
+// own, so the parser only does it for a finished tree.
+static size_t node_stats_count(NodeStats& stats, const Node* node) {
+  if (node == NULL) {
+    return 0;
+  }
+  ++stats.nodes;
+  ++stats.nodes_by_kind[node->kind()];
+  size_t depth = 0;
+  const node_list_t& children = node->childNodes();
+  for (node_list_t::const_iterator ii = children.begin(); ii != children.end(); ++ii) {
+    size_t child_depth = node_stats_count(stats, *ii);
+    if (child_depth > depth) {
+      depth = child_depth;
+    }
+  }
+  return depth + 1;
+}
+
+void NodeStats::countTree(const Node* root) {
+  size_t tree_depth = node_stats_count(*this, root);
+  if (tree_depth > depth) {
+    depth = tree_depth;
+  }
+}
+
+//
+// One JSON object. nodes_by_kind is indexed by node_kind_enum.
+string NodeStats::json() const {
+  char buf[512];
+  snprintf(buf, sizeof(buf),
+    "{\"parses\":%lu,\"walks\":%lu,\"renders\":%lu,\"tokens\":%lu,\"nodes\":%lu,\"depth\":%lu,"
+    "\"node_bytes\":%lu,\"string_bytes\":%lu,\"rope_bytes\":%lu,\"rendered_bytes\":%lu,"
+    "\"lex_seconds\":%.9f,\"parse_seconds\":%.9f,\"walk_seconds\":%.9f,\"render_seconds\":%.9f,"
+    "\"nodes_by_kind\":[",
+    (unsigned long)parses, (unsigned long)walks, (unsigned long)renders, (unsigned long)tokens,
+    (unsigned long)nodes, (unsigned long)depth, (unsigned long)node_bytes, (unsigned long)string_bytes,
+    (unsigned long)rope_bytes, (unsigned long)rendered_bytes, lex_seconds, parse_seconds, walk_seconds,
+    render_seconds);
+  string out(buf);
+  for (size_t ii = 0; ii < KIND_COUNT; ++ii) {
+    snprintf(buf, sizeof(buf), "%s%lu", ii ? "," : "", (unsigned long)nodes_by_kind[ii]);
+    out += buf;
+  }
+  return out + "]}";
+}
+
+double NodeStats::now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,97 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#pragma once
+#include <stddef.h>
+#include <string>
+#include "node.hpp"
+
+namespace fbjs {
+
+  //
+  // NodeStats: where a parse, walk or render spent its time and memory. Attach
+  // one with Parser::setStats(), RenderSink::setStats() or
+  // NodeWalker::walk(root, stats) and every call made through it adds to the
+  // counts. Nothing is recorded without one, and the only cost then is a
+  // pointer test. A NodeStats isn't thread-safe; give each thread its own and
+  // merge() them afterwards.
+  class NodeStats {
+    public:
+      size_t parses;
+      size_t walks;
+      size_t renders;
+
+      // Tokens bison was handed, virtual semicolons included
+      size_t tokens;
+
+      // Nodes in the trees parsed, by kind, and the deepest of those trees
+      size_t nodes;
+      size_t nodes_by_kind[KIND_COUNT];
+      size_t depth;
+
+      // Bytes allocated while parsing or walking, for nodes, for identifiers and
+      // string literals, and for E4X text
+      size_t node_bytes;
+      size_t string_bytes;
+      size_t rope_bytes;
+      size_t rendered_bytes;
+
+      // Wall time. lex_seconds is part of parse_seconds, the rest of which is
+      // spent in bison's reductions.
+      double lex_seconds;
+      double parse_seconds;
+      double walk_seconds;
+      double render_seconds;
+
+      NodeStats();
+      void clear();
+      void merge(const NodeStats& that);
+      void countTree(const Node* root);
+      std::string json() const;
+      static double now();
+
+      // The stats allocations on this thread are counted into, if any
+      static NodeStats* current() { return _current; }
+
+    protected:
+      static __thread NodeStats* _current;
+      friend class NodeStatsScope;
+  };
+
+  //
+  // NodeStatsScope: counts allocations on this thread into `stats`, which may
+  // be NULL, until it goes out of scope
+  class NodeStatsScope {
+    protected:
+      NodeStats* _previous;
+
+    public:
+      explicit NodeStatsScope(NodeStats* stats) : _previous(NodeStats::_current) {
+        NodeStats::_current = stats;
+      }
+      ~NodeStatsScope() {
+        NodeStats::_current = _previous;
+      }
+
+    private:
+      NodeStatsScope(const NodeStatsScope&);
+      NodeStatsScope& operator= (const NodeStatsScope&);
+  };
+}
@@ -0,0 +1,193 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#include "thread_pool.hpp"
+#include <stdexcept>
+#include <unistd.h>
+using namespace std;
+using namespace fbjs;
+
+ThreadPool::ThreadPool(unsigned int threads /* = 0 */) : _task(NULL), _context(NULL), _busy(0),
+  _generation(0), _stopping(false) {
+  if (threads == 0) {
+    threads = ThreadPool::hardwareConcurrency();
+  }
+  pthread_mutex_init(&_mutex, NULL);
+  pthread_cond_init(&_wake, NULL);
+  pthread_cond_init(&_done, NULL);
+  _slices.resize(threads);
+  for (unsigned int ii = 0; ii < threads; ++ii) {
+    pthread_mutex_init(&_slices[ii].lock, NULL);
+    _slices[ii].begin = _slices[ii].end = 0;
+  }
+
+  // Workers hold pointers into _workers so it must never reallocate
+  _workers.resize(threads);
+  for (unsigned int ii = 0; ii < threads; ++ii) {
+    _workers[ii].pool = this;
+    _workers[ii].id = ii;
+    if (pthread_create(&_workers[ii].thread, NULL, ThreadPool::main, &_workers[ii]) != 0) {
+      _workers.resize(ii);
+      this->shutdown();
+      throw runtime_error("unable to start thread pool");
+    }
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  this->shutdown();
+}
+
+void ThreadPool::shutdown() {
+  pthread_mutex_lock(&_mutex);
+  _stopping = true;
+  pthread_cond_broadcast(&_wake);
+  pthread_mutex_unlock(&_mutex);
+  for (vector<worker_t>::iterator ii = _workers.begin(); ii != _workers.end(); ++ii) {
+    pthread_join(ii->thread, NULL);
+  }
+  _workers.clear();
+  for (vector<slice_t>::iterator ii = _slices.begin(); ii != _slices.end(); ++ii) {
+    pthread_mutex_destroy(&ii->lock);
+  }
+  _slices.clear();
+  pthread_cond_destroy(&_done);
+  pthread_cond_destroy(&_wake);
+  pthread_mutex_destroy(&_mutex);
+}
+
+unsigned int ThreadPool::size() const {
+  return _workers.size();
+}
+
+unsigned int ThreadPool::hardwareConcurrency() {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return cpus > 0 ? cpus : 1;
+}
+
+void ThreadPool::run(task_t task, void* context, size_t count) {
+  if (count == 0) {
+    return;
+  }
+  pthread_mutex_lock(&_mutex);
+  _task = task;
+  _context = context;
+  size_t workers = _workers.size();
+  for (size_t ii = 0; ii < workers; ++ii) {
+    _slices[ii].begin = count * ii / workers;
+    _slices[ii].end = count * (ii + 1) / workers;
+  }
+  _busy = workers;
+  ++_generation;
+  pthread_cond_broadcast(&_wake);
+  while (_busy) {
+    pthread_cond_wait(&_done, &_mutex);
+  }
+  _task = NULL;
+  _context = NULL;
+  pthread_mutex_unlock(&_mutex);
+}
+
+void* ThreadPool::main(void* arg) {
+  worker_t* worker = static_cast<worker_t*>(arg);
+  worker->pool->work(worker->id);
+  return NULL;
+}
+
+void ThreadPool::work(unsigned int worker) {
+  unsigned long generation = 0;
+  pthread_mutex_lock(&_mutex);
+  while (true) {
+    while (!_stopping && generation == _generation) {
+      pthread_cond_wait(&_wake, &_mutex);
+    }
+    if (_stopping) {
+      break;
+    }
+    generation = _generation;
+    task_t task = _task;
+    void* context = _context;
+    pthread_mutex_unlock(&_mutex);
+
+    size_t index;
+    while (this->claim(worker, &index)) {
+      task(context, worker, index);
+    }
+
+    pthread_mutex_lock(&_mutex);
+    if (--_busy == 0) {
+      pthread_cond_signal(&_done);
+    }
+  }
+  pthread_mutex_unlock(&_mutex);
+}
+
+//
+// Takes the next index from this worker's slice, or steals the top half of the
+// largest slice left. Returns false once there's nothing left to take.
+bool ThreadPool::claim(unsigned int worker, size_t* index) {
+  slice_t& own = _slices[worker];
+  pthread_mutex_lock(&own.lock);
+  if (own.begin < own.end) {
+    *index = own.begin++;
+    pthread_mutex_unlock(&own.lock);
+    return true;
+  }
+  pthread_mutex_unlock(&own.lock);
+
+  while (true) {
+    slice_t* victim = NULL;
+    size_t most = 0;
+    for (vector<slice_t>::iterator ii = _slices.begin(); ii != _slices.end(); ++ii) {
+      if (&*ii == &own) {
+        continue;
+      }
+      pthread_mutex_lock(&ii->lock);
+      size_t left = ii->end - ii->begin;
+      pthread_mutex_unlock(&ii->lock);
+      if (left > most) {
+        most = left;
+        victim = &*ii;
+      }
+    }
+    if (victim == NULL) {
+      return false;
+    }
+
+    pthread_mutex_lock(&victim->lock);
+    size_t left = victim->end - victim->begin;
+    if (left == 0) {
+      // Someone else got there first
+      pthread_mutex_unlock(&victim->lock);
+      continue;
+    }
+    size_t take = left > 1 ? left / 2 : 1;
+    victim->end -= take;
+    size_t begin = victim->end;
+    pthread_mutex_unlock(&victim->lock);
+
+    pthread_mutex_lock(&own.lock);
+    own.begin = begin + 1;
+    own.end = begin + take;
+    pthread_mutex_unlock(&own.lock);
+    *index = begin;
+    return true;
+  }
+}
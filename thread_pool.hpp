@@ -0,0 +1,74 @@
+/**
+* Copyright (c) 2008-2009 Facebook
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* See accompanying file LICENSE.txt.
+*
+* @author Marcel Laverdet 
+*/
+
+#pragma once
+#include <pthread.h>
+#include <stddef.h>
+#include <vector>
+
+namespace fbjs {
+
+  //
+  // ThreadPool: a fixed set of worker threads that run a task over a range of
+  // indices. Each worker starts on its own contiguous slice of the range and,
+  // when that runs out, steals half of the largest slice left, so uneven
+  // inputs balance themselves. run() blocks until every index is processed.
+  class ThreadPool {
+    public:
+      // Tasks must not throw; `worker` is stable for the life of the pool.
+      typedef void (*task_t)(void* context, unsigned int worker, size_t index);
+
+      ThreadPool(unsigned int threads = 0);
+      ~ThreadPool();
+      unsigned int size() const;
+      void run(task_t task, void* context, size_t count);
+      static unsigned int hardwareConcurrency();
+
+    protected:
+      struct worker_t {
+        ThreadPool* pool;
+        unsigned int id;
+        pthread_t thread;
+      };
+      struct slice_t {
+        pthread_mutex_t lock;
+        size_t begin;
+        size_t end;
+      };
+      std::vector<worker_t> _workers;
+      std::vector<slice_t> _slices;
+      pthread_mutex_t _mutex;
+      pthread_cond_t _wake;
+      pthread_cond_t _done;
+      task_t _task;
+      void* _context;
+      unsigned int _busy;
+      unsigned long _generation;
+      bool _stopping;
+      static void* main(void* arg);
+      void work(unsigned int worker);
+      bool claim(unsigned int worker, size_t* index);
+      void shutdown();
+
+    private:
+      ThreadPool(const ThreadPool&);
+      ThreadPool& operator= (const ThreadPool&);
+  };
+}
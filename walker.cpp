@@ -19,6 +19,7 @@
 */
 
 #include "walker.hpp"
+#include <deque>
 using namespace fbjs;
 
 void Node::accept(NodeWalker& walker) {
@@ -84,3 +85,273 @@ NODE_WALKER_ACCEPT_IMPL(NodeStaticQualifiedIdentifier, NodeExpression);
 NODE_WALKER_ACCEPT_IMPL(NodeDynamicQualifiedIdentifier, NodeExpression);
 NODE_WALKER_ACCEPT_IMPL(NodeFilteringPredicate, NodeExpression);
 NODE_WALKER_ACCEPT_IMPL(NodeDescendantExpression, NodeExpression);
+
+//
+// The explicit-stack half of visitEachChild(). Each child is visited as
+// visitChildAt() would, but with _deferring set, so if it gets the default
+// visit(Node&) that only asks for a descent. The descent then goes on the
+// stack, and the child's updateChild() waits until its children are done.
+// In-place walkers keep each level's frame_t in the deque, as CompositeWalker
+// does; cloning walkers keep the clone which visited the node.
+void NodeWalker::visitEachChildIteratively() {
+  Node* node = _node;
+  const frame_t* frame = _frame;
+  bool remove = _remove, skip_delete = _skip_delete, descend = _descend;
+  std::deque<descent_t> levels;
+  descent_t root = {this, {node, frame}, 0, 0, NULL, 0, false, false};
+  levels.push_back(root);
+  try {
+    while (true) {
+      descent_t& level = levels.back();
+      NodeWalker* walker = level.walker;
+      if (_in_place) {
+        _node = level.frame.node;
+        _frame = level.frame.parent;
+      }
+      node_list_t& children = level.frame.node->childNodes();
+      if (level.index >= children.size()) {
+        if (levels.size() == 1) {
+          break;
+        }
+        descent_t done = level;
+        levels.pop_back();
+        if (done.walker != this) {
+          delete done.walker;
+        }
+        descent_t& up = levels.back();
+        if (_in_place) {
+          _node = up.frame.node;
+          _frame = up.frame.parent;
+        }
+        node_list_t::iterator ii(&up.frame.node->childNodes(), done.at);
+        up.index = up.walker->updateChild(ii, done.visited, done.size, done.frame.node, done.remove,
+          done.skip_delete).index();
+        continue;
+      }
+      node_list_t::iterator ii(&children, level.index);
+      if (walker->skipChild(ii)) {
+        ++level.index;
+        continue;
+      }
+
+      Node* visited = *ii;
+      size_t size = children.size();
+      std::auto_ptr<NodeWalker> clone;
+      NodeWalker* visitor = this;
+      if (_in_place) {
+        _frame = &level.frame;
+        _node = visited;
+        _remove = false;
+        _skip_delete = false;
+      } else {
+        clone.reset(walker->clone());
+        visitor = clone.get();
+        visitor->_parent = walker;
+        visitor->_node = visited;
+        visitor->_scoped = walker->_scoped;
+        visitor->_depth = walker->_depth + 1;
+      }
+      visitor->_descend = false;
+      visitor->_deferring = true;
+      if (visited == NULL) {
+        visitor->visit();
+      } else {
+        visited->accept(*visitor);
+      }
+      visitor->_deferring = false;
+      Node* child = visitor->_node;
+      bool child_remove = visitor->_remove, child_skip_delete = visitor->_skip_delete;
+      if (_in_place) {
+        _node = level.frame.node;
+        _frame = level.frame.parent;
+      }
+
+      if (visitor->_descend && child != NULL) {
+        descent_t next = {visitor, {child, &level.frame}, 0, ii.index(), visited, size, child_remove, child_skip_delete};
+        levels.push_back(next);
+        clone.release();
+      } else {
+        level.index = walker->updateChild(ii, visited, size, child, child_remove, child_skip_delete).index();
+      }
+    }
+  } catch (...) {
+    for (std::deque<descent_t>::iterator ii = levels.begin(); ii != levels.end(); ++ii) {
+      if (ii->walker != this) {
+        delete ii->walker;
+      }
+    }
+    _node = node;
+    _frame = frame;
+    _remove = remove;
+    _skip_delete = skip_delete;
+    _descend = descend;
+    _deferring = false;
+    throw;
+  }
+  _node = node;
+  _frame = frame;
+  _remove = remove;
+  _skip_delete = skip_delete;
+  _descend = descend;
+}
+
+//
+// CompositeWalker
+CompositeWalker::CompositeWalker() : _active(0) {}
+
+CompositeWalker::~CompositeWalker() {
+  for (std::vector<NodeWalker*>::iterator ii = _walkers.begin(); ii != _walkers.end(); ++ii) {
+    delete *ii;
+  }
+}
+
+void CompositeWalker::add(NodeWalker* walker) {
+  if (_walkers.size() == 64) {
+    delete walker;
+    throw std::runtime_error("too many walkers for CompositeWalker");
+  }
+  _active |= static_cast<uint64_t>(1) << _walkers.size();
+  _walkers.push_back(walker);
+}
+
+size_t CompositeWalker::size() const {
+  return _walkers.size();
+}
+
+NodeWalker* CompositeWalker::clone() const {
+  std::auto_ptr<CompositeWalker> walker(new CompositeWalker());
+  for (std::vector<NodeWalker*>::const_iterator ii = _walkers.begin(); ii != _walkers.end(); ++ii) {
+    walker->add((*ii)->clone());
+  }
+  return walker.release();
+}
+
+void CompositeWalker::visit() {
+  this->visitNode(NULL);
+}
+
+void CompositeWalker::visit(Node& node) {
+  this->visitNode(&node);
+}
+
+//
+// Runs the active walkers on `original`, a child of frame->node, and reports
+// what they left in its place. Returns the walkers which asked to descend.
+uint64_t CompositeWalker::visitWalkers(Node* original, const frame_t* frame, uint64_t active,
+  Node*& result, bool& remove, bool& skip_delete) {
+  Node* node = original;
+  bool skip_original = false;
+  uint64_t descend = 0;
+  result = original;
+  remove = false;
+  skip_delete = false;
+  for (size_t ii = 0; ii < _walkers.size(); ++ii) {
+    uint64_t bit = static_cast<uint64_t>(1) << ii;
+    if (!(active & bit)) {
+      continue;
+    }
+    NodeWalker* walker = _walkers[ii];
+    walker->_frame = frame;
+    walker->_node = node;
+    walker->_remove = false;
+    walker->_skip_delete = false;
+    walker->_fused = true;
+    walker->_descend = false;
+    try {
+      if (node == NULL) {
+        walker->visit();
+      } else {
+        node->accept(*walker);
+      }
+    } catch (...) {
+      walker->_fused = false;
+      throw;
+    }
+    walker->_fused = false;
+    if (walker->_descend) {
+      descend |= bit;
+    }
+
+    if (walker->_remove) {
+      // The original is still in the tree and goes with the removal, anything
+      // an earlier walker put in its place is ours to delete
+      remove = true;
+      if (node == original) {
+        skip_delete = walker->_skip_delete;
+      } else {
+        if (!walker->_skip_delete) {
+          delete node;
+        }
+        skip_delete = skip_original;
+      }
+      return 0;
+    } else if (walker->_node != node) {
+      if (node == original) {
+        skip_original = walker->_skip_delete;
+      } else if (!walker->_skip_delete) {
+        delete node;
+      }
+      node = walker->_node;
+    }
+  }
+  result = node;
+  skip_delete = skip_original;
+  return node == NULL ? 0 : descend;
+}
+
+//
+// Descends with an explicit stack of levels rather than through accept() for
+// each one, so a deep tree doesn't take a native stack frame per level. A
+// level's frame_t is what walkers below it see as their parents, hence the
+// deque: it doesn't move elements when it grows.
+void CompositeWalker::visitNode(Node* original) {
+  Node* node;
+  bool remove, skip_delete;
+  uint64_t descend = this->visitWalkers(original, _frame, _active, node, remove, skip_delete);
+  if (remove) {
+    this->remove(skip_delete);
+    return;
+  } else if (node != original) {
+    this->replace(node, skip_delete);
+  }
+  if (!descend) {
+    return;
+  } else if (_fused) {
+    this->visitEachChild();
+    return;
+  }
+
+  std::deque<level_t> levels;
+  level_t root = {{node, _frame}, 0, descend};
+  levels.push_back(root);
+  try {
+    while (!levels.empty()) {
+      level_t& level = levels.back();
+      _node = level.frame.node;
+      node_list_t& children = _node->childNodes();
+      if (level.index == children.size()) {
+        levels.pop_back();
+        continue;
+      }
+      node_list_t::iterator ii(&children, level.index);
+      if (this->skipChild(ii)) {
+        ++level.index;
+        continue;
+      }
+
+      Node* visited = *ii;
+      size_t size = children.size();
+      Node* child;
+      descend = this->visitWalkers(visited, &level.frame, level.active, child, remove, skip_delete);
+      level.index = this->updateChild(ii, visited, size, child, remove, skip_delete).index();
+      if (descend) {
+        level_t next = {{child, &level.frame}, 0, descend};
+        levels.push_back(next);
+      }
+    }
+  } catch (...) {
+    _node = node;
+    throw;
+  }
+  _node = node;
+}
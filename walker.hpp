@@ -2,13 +2,26 @@
 #include <memory>
 #include <utility>
 #include <boost/ptr_container/ptr_vector.hpp>
+#include <stdint.h>
+#include <vector>
 #include "node.hpp"
+#include "stats.hpp"
 
 #define NODE_WALKER_VISIT_IMPL(TYPE, FALLBACK) \
   virtual void visit(TYPE& node) { \
     visit(static_cast<FALLBACK&>(node)); \
   }
 
+#define STATIC_NODE_WALKER_VISIT_IMPL(TYPE, FALLBACK) \
+  void visit(TYPE& node) { \
+    self().visit(static_cast<FALLBACK&>(node)); \
+  }
+
+#define STATIC_NODE_WALKER_DISPATCH_CASE(KIND, TYPE) \
+  case KIND: \
+    self().visit(static_cast<TYPE&>(*node)); \
+    break
+
 #define NODE_WALKER_ACCEPT_IMPL(TYPE, FALLBACK) \
   void TYPE::accept(NodeWalker& walker) { \
     walker.visit(*this); \
@@ -17,19 +30,39 @@
 namespace fbjs {
   class NodeWalker {
     private:
+      // Where an in-place walker keeps the state of the levels above it
+      struct frame_t {
+        Node* node;
+        const frame_t* parent;
+      };
+
       NodeWalker* _parent;
+      const frame_t* _frame;
       Node* _node;
       bool _remove;
       bool _skip_delete;
+      bool _in_place;
+      bool _scoped;
+      bool _fused;
+      bool _descend;
+      bool _deferring;
+      unsigned int _depth;
+      friend class Pipeline;
+      friend class CompositeWalker;
 
     protected:
       typedef boost::ptr_vector<NodeWalker> ptr_vector;
 
+      NodeWalker(bool in_place) : _parent(NULL), _frame(NULL), _node(NULL),
+        _remove(false), _skip_delete(false), _in_place(in_place), _scoped(false), _fused(false), _descend(false),
+        _deferring(false), _depth(0) {};
+
     public:
       typedef std::auto_ptr<NodeWalker> ptr;
 
-      NodeWalker() : _parent(NULL), _node(NULL), _remove(false),
-        _skip_delete(false) {};
+      NodeWalker() : _parent(NULL), _frame(NULL), _node(NULL), _remove(false),
+        _skip_delete(false), _in_place(false), _scoped(false), _fused(false),
+        _descend(false), _deferring(false), _depth(0) {};
       virtual ~NodeWalker() {};
       virtual NodeWalker* clone() const = 0;
       virtual Node* walk(Node* root) {
@@ -37,6 +70,17 @@ namespace fbjs {
         return _node;
       }
 
+      // walk(), timed into `stats`, which also gets the bytes of any nodes
+      // the walker creates
+      Node* walk(Node* root, NodeStats& stats) {
+        NodeStatsScope scope(&stats);
+        double start = NodeStats::now();
+        Node* node = walk(root);
+        stats.walk_seconds += NodeStats::now() - start;
+        ++stats.walks;
+        return node;
+      }
+
       NodeWalker* parent() const {
         return _parent;
       }
@@ -45,6 +89,14 @@ namespace fbjs {
         return _node;
       }
 
+      // The node one level up, for cloned and in-place walkers alike
+      Node* parentNode() const {
+        if (_frame) {
+          return _frame->node;
+        }
+        return _parent ? _parent->_node : NULL;
+      }
+
     protected:
       template<class T>
       static T& cast(NodeWalker& node) {
@@ -89,41 +141,200 @@ namespace fbjs {
         }
       }
 
+      // Visits every child and returns the walkers used. In-place walkers have
+      // none to return, so for them this is the same as visitEachChild().
       std::auto_ptr<ptr_vector> visitChildren() {
         ptr_vector ret;
-        node_list_t::iterator ii = _node->childNodes().begin();
-        while (ii != _node->childNodes().end()) {
-          ret.push_back(visitChild(ii++).release());
+        _deferring = false;
+        if (_fused) {
+          _descend = true;
+          return ret.release();
+        }
+        node_list_t& children = _node->childNodes();
+        node_list_t::iterator ii = children.begin();
+        while (ii != children.end()) {
+          if (skipChild(ii)) {
+            ++ii;
+            continue;
+          }
+          NodeWalker* walker = visitChildAt(ii).release();
+          if (walker) {
+            ret.push_back(walker);
+          }
         }
         return ret.release();
       }
 
+      // Visits every child, throwing each walker away as soon as it's done.
+      // Past NODE_WALKER_RECURSION_LIMIT levels, children which get the
+      // default visit(Node&) are descended into from an explicit stack rather
+      // than through accept() for each, so long chains like a.b().c()... don't
+      // take native stack frames per level. That default only asks for the
+      // descent and returns, so a visit() which falls back to it and then does
+      // more work should call visitEachChild() itself instead.
+      void visitEachChild() {
+        _deferring = false;
+        if (_fused) {
+          _descend = true;
+          return;
+        } else if (_depth >= NODE_WALKER_RECURSION_LIMIT) {
+          visitEachChildIteratively();
+          return;
+        }
+        node_list_t& children = _node->childNodes();
+        node_list_t::iterator ii = children.begin();
+        while (ii != children.end()) {
+          if (skipChild(ii)) {
+            ++ii;
+            continue;
+          }
+          visitChildAt(ii);
+        }
+      }
+
+      // Visits one child with a clone() of this walker, or with this walker
+      // itself if it's in-place (and then returns NULL).
       ptr visitChild(node_list_t::iterator ii) {
+        _deferring = false;
+        if (_fused) {
+          _descend = true;
+          return ptr();
+        }
+        if (skipChild(ii)) {
+          return ptr();
+        }
+        return visitChildAt(ii);
+      }
+
+    private:
+      enum { NODE_WALKER_RECURSION_LIMIT = 256 };
+
+      // A node visitEachChildIteratively() is descending into, and how far
+      struct descent_t {
+        NodeWalker* walker;
+        frame_t frame;
+        size_t index;
+
+        // The node's own visit, for its parent's updateChild() once done
+        size_t at;
+        Node* visited;
+        size_t size;
+        bool remove;
+        bool skip_delete;
+      };
+
+      void visitEachChildIteratively();
+
+      // Visits the child at `ii` and moves `ii` on to the one after it
+      ptr visitChildAt(node_list_t::iterator& ii) {
+        if (_in_place) {
+          visitChildInPlace(ii);
+          return ptr();
+        }
+        Node* visited = *ii;
+        size_t size = _node->childNodes().size();
         ptr walker(clone());
         walker->_parent = this;
-        walker->_node = *ii;
-        if (*ii == NULL) {
+        walker->_node = visited;
+        walker->_scoped = _scoped;
+        walker->_depth = _depth + 1;
+        if (visited == NULL) {
           visit();
         } else {
-          (*ii)->accept(*walker);
+          visited->accept(*walker);
         }
-        if (_remove) {
-          if (!_skip_delete) {
-            delete _node->removeChild(ii);
+        ii = updateChild(ii, visited, size, walker->_node, walker->_remove, walker->_skip_delete);
+        return walker;
+      }
+
+      // A Pipeline runs scope-local passes over each function body separately,
+      // so they don't descend into the bodies of the functions they find.
+      bool skipChild(node_list_t::iterator ii) const {
+        return _scoped && ii.index() + 1 == _node->childNodes().size() &&
+          (_node->kind() == KIND_FUNCTION_DECLARATION || _node->kind() == KIND_FUNCTION_EXPRESSION);
+      }
+
+      void visitChildInPlace(node_list_t::iterator& ii) {
+        Node* visited = *ii;
+        size_t size = _node->childNodes().size();
+        frame_t frame = {_node, _frame};
+        bool remove = _remove, skip_delete = _skip_delete;
+        _frame = &frame;
+        _node = *ii;
+        _remove = false;
+        _skip_delete = false;
+        ++_depth;
+        try {
+          if (visited == NULL) {
+            visit();
+          } else {
+            visited->accept(*this);
           }
-        } else if (*ii != walker->_node) {
-          Node* old_node = _node->replaceChild(walker->_node, ii);
-          if (!_skip_delete && old_node) {
+        } catch (...) {
+          _node = frame.node;
+          _frame = frame.parent;
+          _remove = remove;
+          _skip_delete = skip_delete;
+          --_depth;
+          throw;
+        }
+        --_depth;
+        Node* child = _node;
+        bool child_remove = _remove, child_skip_delete = _skip_delete;
+        _node = frame.node;
+        _frame = frame.parent;
+        _remove = remove;
+        _skip_delete = skip_delete;
+        ii = updateChild(ii, visited, size, child, child_remove, child_skip_delete);
+      }
+
+      // Applies what the child's visit asked for and returns where the next
+      // child is. The visit may have added or removed siblings on either side,
+      // so `visited` is looked for again starting from where it was, `ii`.
+      node_list_t::iterator updateChild(node_list_t::iterator ii, Node* visited, size_t size, Node* child,
+        bool remove, bool skip_delete) {
+        node_list_t& children = _node->childNodes();
+        node_list_t::iterator pos = findChild(children, ii.index(), visited);
+        if (pos == children.end()) {
+          // It took itself out of the list, so count on the size alone
+          size_t next = ii.index() + 1 + children.size();
+          next = next > size ? next - size : 0;
+          return node_list_t::iterator(&children, next < children.size() ? next : children.size());
+        }
+        if (remove) {
+          Node* old_node = _node->removeChild(pos);
+          if (!skip_delete) {
+            delete old_node;
+          }
+          return pos;
+        } else if (*pos != child) {
+          Node* old_node = _node->replaceChild(child, pos);
+          if (!skip_delete && old_node) {
             delete old_node;
           }
         }
-        return walker;
+        return ++pos;
+      }
+
+      static node_list_t::iterator findChild(node_list_t& children, size_t index, const Node* child) {
+        for (size_t distance = 0; distance <= index || index + distance < children.size(); ++distance) {
+          if (index + distance < children.size() && children[index + distance] == child) {
+            return node_list_t::iterator(&children, index + distance);
+          } else if (distance <= index && index - distance < children.size() && children[index - distance] == child) {
+            return node_list_t::iterator(&children, index - distance);
+          }
+        }
+        return children.end();
       }
 
     public:
       virtual void visit() {}
       virtual void visit(Node& _node) {
-        visitChildren();
+        if (_deferring) {
+          _descend = true;
+        } else {
+          visitEachChild();
+        }
       }
       NODE_WALKER_VISIT_IMPL(NodeProgram, Node);
       NODE_WALKER_VISIT_IMPL(NodeStatementList, Node);
@@ -186,4 +397,220 @@ namespace fbjs {
       NODE_WALKER_VISIT_IMPL(NodeFilteringPredicate, NodeExpression);
       NODE_WALKER_VISIT_IMPL(NodeDescendantExpression, NodeExpression);
   };
+
+
+  //
+  // InPlaceNodeWalker: a NodeWalker which visits children itself instead of
+  // with a clone() for each, so a pass doesn't allocate a walker per node. Keep
+  // any per-level state of your own in locals around visitEachChild().
+  class InPlaceNodeWalker: public NodeWalker {
+    public:
+      InPlaceNodeWalker() : NodeWalker(true) {}
+      virtual NodeWalker* clone() const {
+        throw std::runtime_error("InPlaceNodeWalker can't be cloned");
+      }
+  };
+
+  //
+  // CompositeWalker: runs several walkers in one traversal. At each node every
+  // walker gets its visit() in turn, and then the composite descends once for
+  // all of them. A walker's calls to visitChildren(), visitEachChild() or
+  // visitChild() only ask for that descent, so the walkers being fused must do
+  // their work before descending and not rely on what their children did. A
+  // walker which doesn't descend doesn't see that subtree. Replacements are
+  // seen by the walkers after the one that made them; a removed node isn't
+  // seen by the rest at all. Up to 64 walkers can be fused.
+  class CompositeWalker: public InPlaceNodeWalker {
+    protected:
+      std::vector<NodeWalker*> _walkers;
+      uint64_t _active;
+      uint64_t visitWalkers(Node* original, const frame_t* frame, uint64_t active,
+        Node*& result, bool& remove, bool& skip_delete);
+      void visitNode(Node* node);
+
+    public:
+      CompositeWalker();
+      virtual ~CompositeWalker();
+
+      // Takes ownership of `walker`
+      void add(NodeWalker* walker);
+      size_t size() const;
+      virtual NodeWalker* clone() const;
+      virtual void visit();
+      virtual void visit(Node& node);
+
+    private:
+      // A node being descended into, and how far
+      struct level_t {
+        frame_t frame;
+        size_t index;
+        uint64_t active;
+      };
+
+      CompositeWalker(const CompositeWalker&);
+      CompositeWalker& operator= (const CompositeWalker&);
+  };
+  //
+  // StaticNodeWalker: a read-only walker with the same visit() fallbacks as
+  // NodeWalker, resolved at compile time. Derived classes pass themselves as T,
+  // pull in the defaults with `using StaticNodeWalker<T>::visit;` and define
+  // visit() for the types they care about. Nodes are dispatched with a switch
+  // on Node::kind() instead of accept(), so visits can be inlined and the
+  // walker is never cloned. Use NodeWalker to replace or remove nodes.
+  template<class T>
+  class StaticNodeWalker {
+    protected:
+      T& self() {
+        return *static_cast<T*>(this);
+      }
+
+    public:
+      void walk(Node* root) {
+        dispatch(root);
+      }
+
+      void dispatch(Node* node) {
+        if (node == NULL) {
+          self().visit();
+          return;
+        }
+        switch (node->kind()) {
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_PROGRAM, NodeProgram);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_STATEMENT_LIST, NodeStatementList);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_EXPRESSION, NodeExpression);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_NUMERIC_LITERAL, NodeNumericLiteral);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_STRING_LITERAL, NodeStringLiteral);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_REGEX_LITERAL, NodeRegexLiteral);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_BOOLEAN_LITERAL, NodeBooleanLiteral);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_NULL_LITERAL, NodeNullLiteral);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_THIS, NodeThis);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_EMPTY_EXPRESSION, NodeEmptyExpression);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_OPERATOR, NodeOperator);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_CONDITIONAL_EXPRESSION, NodeConditionalExpression);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_PARENTHETICAL, NodeParenthetical);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_ASSIGNMENT, NodeAssignment);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_UNARY, NodeUnary);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_POSTFIX, NodePostfix);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_IDENTIFIER, NodeIdentifier);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_FUNCTION_CALL, NodeFunctionCall);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_FUNCTION_CONSTRUCTOR, NodeFunctionConstructor);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_OBJECT_LITERAL, NodeObjectLiteral);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_ARRAY_LITERAL, NodeArrayLiteral);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_STATIC_MEMBER_EXPRESSION, NodeStaticMemberExpression);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_DYNAMIC_MEMBER_EXPRESSION, NodeDynamicMemberExpression);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_STATEMENT, NodeStatement);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_STATEMENT_WITH_EXPRESSION, NodeStatementWithExpression);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_VAR_DECLARATION, NodeVarDeclaration);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_TYPEHINT, NodeTypehint);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_FUNCTION_DECLARATION, NodeFunctionDeclaration);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_FUNCTION_EXPRESSION, NodeFunctionExpression);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_ARG_LIST, NodeArgList);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_IF, NodeIf);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_WITH, NodeWith);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_TRY, NodeTry);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_LABEL, NodeLabel);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_CASE_CLAUSE, NodeCaseClause);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_SWITCH, NodeSwitch);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_DEFAULT_CLAUSE, NodeDefaultClause);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_OBJECT_LITERAL_PROPERTY, NodeObjectLiteralProperty);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_FOR_LOOP, NodeForLoop);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_FOR_IN, NodeForIn);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_FOR_EACH_IN, NodeForEachIn);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_WHILE, NodeWhile);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_DO_WHILE, NodeDoWhile);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_XML_DEFAULT_NAMESPACE, NodeXMLDefaultNamespace);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_XML_NAME, NodeXMLName);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_XML_ELEMENT, NodeXMLElement);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_XML_COMMENT, NodeXMLComment);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_XML_PI, NodeXMLPI);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_XML_CONTENT_LIST, NodeXMLContentList);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_XML_TEXT_DATA, NodeXMLTextData);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_XML_EMBEDDED_EXPRESSION, NodeXMLEmbeddedExpression);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_XML_ATTRIBUTE_LIST, NodeXMLAttributeList);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_XML_ATTRIBUTE, NodeXMLAttribute);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_WILDCARD_IDENTIFIER, NodeWildcardIdentifier);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_STATIC_ATTRIBUTE_IDENTIFIER, NodeStaticAttributeIdentifier);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_DYNAMIC_ATTRIBUTE_IDENTIFIER, NodeDynamicAttributeIdentifier);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_STATIC_QUALIFIED_IDENTIFIER, NodeStaticQualifiedIdentifier);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_DYNAMIC_QUALIFIED_IDENTIFIER, NodeDynamicQualifiedIdentifier);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_FILTERING_PREDICATE, NodeFilteringPredicate);
+          STATIC_NODE_WALKER_DISPATCH_CASE(KIND_DESCENDANT_EXPRESSION, NodeDescendantExpression);
+          default:
+            self().visit(*node);
+            break;
+        }
+      }
+
+      void visitChildren(Node& node) {
+        node_list_t& children = node.childNodes();
+        for (size_t ii = 0; ii < children.size(); ++ii) {
+          dispatch(children[ii]);
+        }
+      }
+
+      void visit() {}
+      void visit(Node& node) {
+        self().visitChildren(node);
+      }
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeProgram, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeStatementList, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeExpression, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeNumericLiteral, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeStringLiteral, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeRegexLiteral, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeBooleanLiteral, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeNullLiteral, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeThis, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeEmptyExpression, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeOperator, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeConditionalExpression, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeParenthetical, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeAssignment, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeUnary, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodePostfix, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeIdentifier, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeFunctionCall, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeFunctionConstructor, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeObjectLiteral, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeArrayLiteral, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeStaticMemberExpression, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeDynamicMemberExpression, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeStatement, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeStatementWithExpression, NodeStatement);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeVarDeclaration, NodeStatement);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeTypehint, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeFunctionDeclaration, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeFunctionExpression, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeArgList, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeIf, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeWith, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeTry, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeLabel, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeCaseClause, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeSwitch, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeDefaultClause, NodeCaseClause);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeObjectLiteralProperty, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeForLoop, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeForIn, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeForEachIn, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeWhile, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeDoWhile, NodeStatement);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeXMLDefaultNamespace, NodeStatement);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeXMLName, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeXMLElement, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeXMLComment, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeXMLPI, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeXMLContentList, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeXMLTextData, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeXMLEmbeddedExpression, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeXMLAttributeList, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeXMLAttribute, Node);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeWildcardIdentifier, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeStaticAttributeIdentifier, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeDynamicAttributeIdentifier, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeStaticQualifiedIdentifier, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeDynamicQualifiedIdentifier, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeFilteringPredicate, NodeExpression);
+      STATIC_NODE_WALKER_VISIT_IMPL(NodeDescendantExpression, NodeExpression);
+  };
 }